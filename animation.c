@@ -0,0 +1,241 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "animation.h"
+
+#ifdef FRACTAL_USE_PTHREADS
+#include <pthread.h>
+#endif
+
+/**
+ * @brief Наибольшая длина имени файла кадра
+ */
+#define ANIM_PATH_MAX 4096
+
+void anim_options_init(anim_options_t *opt)
+{
+	assert(opt != NULL);
+	opt->width = 800;
+	opt->height = 600;
+	opt->julia = false;
+	opt->format = IMAGE_FORMAT_BMP;
+	opt->pattern = "frame_%05d.bmp";
+	opt->buffers = 0;
+	opt->render = NULL;
+}
+
+void anim_frame(const anim_keyframe_t *keys, int count, int frames, int k,
+		anim_keyframe_t *out)
+{
+	assert(keys != NULL && out != NULL);
+	assert(count > 0 && frames > 0);
+	assert(k >= 0 && k < frames);
+
+	if (count == 1 || frames == 1) {
+		*out = keys[0];
+		return;
+	}
+	// Положение кадра среди ключевых: отрезок i и доля t внутри него
+	double pos = (double)k * (count - 1) / (frames - 1);
+	int i = (int)pos;
+	if (i > count - 2)
+		i = count - 2;
+	double t = pos - i;
+	const anim_keyframe_t *a = &keys[i], *b = &keys[i + 1];
+
+	out->center_x = a->center_x + (b->center_x - a->center_x) * t;
+	out->center_y = a->center_y + (b->center_y - a->center_y) * t;
+	out->scale = a->scale * pow(b->scale / a->scale, t);
+	out->max_iter = (int)lround(a->max_iter + (b->max_iter - a->max_iter) * t);
+	out->c_real = a->c_real + (b->c_real - a->c_real) * t;
+	out->c_imag = a->c_imag + (b->c_imag - a->c_imag) * t;
+}
+
+/**
+ * @brief Состояние конвейера кадров
+ */
+struct anim_pipeline {
+	const anim_keyframe_t *keys;
+	int count, frames;
+	const anim_options_t *opt;
+	image_p images[ANIM_MAX_BUFFERS];   // Пул изображений: кадр k - images[k % buffers]
+	int buffers;
+	int rendered;                       // Кадров отрендерено
+	int written;                        // Кадров записано
+	bool failed;                        // Ошибка записи
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_t lock;
+	pthread_cond_t changed;             // Изменились rendered, written или failed
+#endif
+};
+
+/**
+ * @brief Рендерит кадр k в изображение
+ */
+static void render_frame(const struct anim_pipeline *pl, int k, image_p picture)
+{
+	const anim_options_t *opt = pl->opt;
+	anim_keyframe_t f;
+	anim_frame(pl->keys, pl->count, pl->frames, k, &f);
+
+	double half_x = f.scale / 2;
+	double half_y = half_x * opt->height / opt->width;
+	if (opt->julia)
+		julia_fractal_ex(picture, f.c_real, f.c_imag,
+				 f.center_x - half_x, f.center_x + half_x,
+				 f.center_y - half_y, f.center_y + half_y,
+				 f.max_iter, opt->render);
+	else
+		mandelbrot_fractal_ex(picture, f.center_x - half_x,
+				      f.center_x + half_x, f.center_y - half_y,
+				      f.center_y + half_y, f.max_iter, opt->render);
+}
+
+/**
+ * @brief Записывает кадр k в файл
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int write_frame(const struct anim_pipeline *pl, int k, image_p picture)
+{
+	char name[ANIM_PATH_MAX];
+	int n = snprintf(name, sizeof(name), pl->opt->pattern, k);
+	if (n < 0 || (size_t)n >= sizeof(name))
+		return -1;
+	return save_image(picture, name, pl->opt->format);
+}
+
+#ifdef FRACTAL_USE_PTHREADS
+
+/**
+ * @brief Поток записи: записывает кадры по порядку по мере готовности
+ */
+static void *writer_main(void *arg)
+{
+	struct anim_pipeline *pl = arg;
+
+	for (int k = 0; k < pl->frames; k++) {
+		pthread_mutex_lock(&pl->lock);
+		while (pl->rendered <= k && !pl->failed)
+			pthread_cond_wait(&pl->changed, &pl->lock);
+		bool failed = pl->failed;
+		pthread_mutex_unlock(&pl->lock);
+		if (failed)
+			break;
+
+		// Изображение кадра не меняется, пока written <= k
+		int result = write_frame(pl, k, pl->images[k % pl->buffers]);
+
+		pthread_mutex_lock(&pl->lock);
+		if (result == 0)
+			pl->written++;
+		else
+			pl->failed = true;
+		pthread_cond_broadcast(&pl->changed);
+		pthread_mutex_unlock(&pl->lock);
+		if (result != 0)
+			break;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Рендерит кадры в вызывающем потоке, пока поток записи пишет
+ * готовые; кадр k ждет, пока освободится изображение кадра k - buffers
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int run_pipeline(struct anim_pipeline *pl)
+{
+	pthread_t writer;
+	pthread_mutex_init(&pl->lock, NULL);
+	pthread_cond_init(&pl->changed, NULL);
+	if (pthread_create(&writer, NULL, writer_main, pl) != 0) {
+		pthread_cond_destroy(&pl->changed);
+		pthread_mutex_destroy(&pl->lock);
+		return -1;
+	}
+
+	for (int k = 0; k < pl->frames; k++) {
+		pthread_mutex_lock(&pl->lock);
+		while (k - pl->written >= pl->buffers && !pl->failed)
+			pthread_cond_wait(&pl->changed, &pl->lock);
+		bool failed = pl->failed;
+		pthread_mutex_unlock(&pl->lock);
+		if (failed)
+			break;
+
+		render_frame(pl, k, pl->images[k % pl->buffers]);
+
+		pthread_mutex_lock(&pl->lock);
+		pl->rendered++;
+		pthread_cond_broadcast(&pl->changed);
+		pthread_mutex_unlock(&pl->lock);
+	}
+
+	pthread_join(writer, NULL);
+	pthread_cond_destroy(&pl->changed);
+	pthread_mutex_destroy(&pl->lock);
+	return pl->failed ? -1 : 0;
+}
+
+#else
+
+/**
+ * @brief Последовательный рендеринг и запись кадров
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int run_pipeline(struct anim_pipeline *pl)
+{
+	for (int k = 0; k < pl->frames; k++) {
+		render_frame(pl, k, pl->images[0]);
+		if (write_frame(pl, k, pl->images[0]) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+#endif
+
+int anim_render(const anim_keyframe_t *keys, int count, int frames,
+		const anim_options_t *opt)
+{
+	assert(keys != NULL);
+	assert(count > 0 && frames > 0);
+
+	anim_options_t defaults;
+	if (opt == NULL) {
+		anim_options_init(&defaults);
+		opt = &defaults;
+	}
+	assert(opt->width > 0 && opt->height > 0);
+	assert(opt->pattern != NULL);
+	for (int i = 0; i < count; i++)
+		assert(keys[i].scale > 0 && keys[i].max_iter > 0);
+
+	struct anim_pipeline pl = {
+		.keys = keys,
+		.count = count,
+		.frames = frames,
+		.opt = opt,
+		.buffers = opt->buffers > 0 ? opt->buffers : 3,
+	};
+#ifndef FRACTAL_USE_PTHREADS
+	pl.buffers = 1;
+#endif
+	if (pl.buffers > ANIM_MAX_BUFFERS)
+		pl.buffers = ANIM_MAX_BUFFERS;
+	if (pl.buffers > frames)
+		pl.buffers = frames;
+
+	// Изображения создаются один раз и используются всеми кадрами
+	int result = 0;
+	for (int i = 0; i < pl.buffers && result == 0; i++)
+		if ((pl.images[i] = create_image(opt->width, opt->height)) == NULL)
+			result = -1;
+	if (result == 0)
+		result = run_pipeline(&pl);
+	for (int i = 0; i < pl.buffers; i++)
+		if (pl.images[i] != NULL)
+			free_image(pl.images[i]);
+	return result;
+}
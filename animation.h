@@ -0,0 +1,78 @@
+#ifndef _ANIMATION_H_
+#define _ANIMATION_H_
+
+#include <stdbool.h>
+
+#include "image.h"
+#include "fractal.h"
+
+/**
+ * @brief Наибольшее количество изображений в пуле кадров
+ */
+#define ANIM_MAX_BUFFERS 16
+
+/**
+ * @brief Ключевой кадр анимации
+ */
+typedef struct anim_keyframe {
+	double center_x, center_y;  // Центр вида
+	double scale;               // Ширина вида по оси X (по Y - пропорционально)
+	int max_iter;               // Максимальное количество итераций
+	double c_real, c_imag;      // Константа c для множества Жюлиа
+} anim_keyframe_t;
+
+/**
+ * @brief Параметры пакетного рендеринга анимации
+ */
+typedef struct anim_options {
+	pixel_coord width, height;      // Размеры кадров
+	bool julia;                     // true - Жюлиа, false - Мандельброт
+	image_format_t format;          // Формат файлов кадров
+	const char *pattern;            // Шаблон имени файла с номером кадра
+	                                // (например, "frame_%05d.bmp")
+	int buffers;                    // Изображений в пуле (0 - по умолчанию, 3)
+	const fractal_options_t *render; // Параметры рендеринга (NULL - по умолчанию)
+} anim_options_t;
+
+/**
+ * @brief Заполняет параметры анимации значениями по умолчанию
+ * (800x600, множество Мандельброта, BMP "frame_%05d.bmp")
+ *
+ * @param opt Параметры для заполнения
+ */
+void anim_options_init(anim_options_t *opt);
+
+/**
+ * @brief Вычисляет параметры кадра между ключевыми кадрами
+ *
+ * Ключевые кадры равномерно распределяются по кадрам анимации (первый -
+ * кадр 0, последний - кадр frames - 1). Центр, количество итераций и
+ * константа c интерполируются линейно, а ширина вида - геометрически,
+ * поэтому увеличение идет с постоянной скоростью.
+ *
+ * @param keys Ключевые кадры
+ * @param count Количество ключевых кадров (от 1)
+ * @param frames Количество кадров анимации (от 1)
+ * @param k Номер кадра (от 0 до frames - 1)
+ * @param out Параметры кадра
+ */
+void anim_frame(const anim_keyframe_t *keys, int count, int frames, int k,
+		anim_keyframe_t *out);
+
+/**
+ * @brief Рендерит и записывает кадры анимации
+ *
+ * Изображения берутся из пула и используются повторно. Запись кадра k в
+ * файл выполняется отдельным потоком одновременно с рендерингом следующих
+ * кадров (без pthreads - последовательно). Кадры пишутся по порядку.
+ *
+ * @param keys Ключевые кадры
+ * @param count Количество ключевых кадров (от 1)
+ * @param frames Количество кадров
+ * @param opt Параметры анимации (NULL - по умолчанию)
+ * @returns 0 при успехе, -1 при ошибке записи или нехватке памяти
+ */
+int anim_render(const anim_keyframe_t *keys, int count, int frames,
+		const anim_options_t *opt);
+
+#endif // _ANIMATION_H_
@@ -0,0 +1,618 @@
+/**
+ * @file bench.c
+ * @brief Замер производительности генераторов фракталов и записи файлов
+ *
+ * Запускает рендеринг и запись изображений для заданных размеров, количеств
+ * итераций и потоков, печатает результаты в JSON или CSV и при необходимости
+ * сравнивает их с сохраненным ранее прогоном.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#define setenv(name, value, overwrite) _putenv_s(name, value)
+#define unsetenv(name) _putenv_s(name, "")
+#endif
+
+#include "image.h"
+#include "fractal.h"
+#include "escape.h"
+#include "palette.h"
+
+// Максимальное количество значений в списке параметра
+#define BENCH_MAX_LIST 16
+// Максимальное количество результатов (и записей базового прогона)
+#define BENCH_MAX_RESULTS 1024
+// Порог замедления по умолчанию, проценты
+#define BENCH_TOLERANCE 5.0
+
+/**
+ * @brief Результат одного замера
+ */
+struct bench_result {
+	char name[32];          // Название замера
+	pixel_coord width, height;
+	int iterations;         // max_iter (глубина для геометрических фракталов)
+	int threads;            // Количество потоков (0 - по умолчанию)
+	double seconds;         // Лучшее время из повторов
+	double pixels_per_s;    // Пикселей в секунду
+	double iters_per_s;     // Итераций в секунду (0, если неприменимо)
+	double mb_per_s;        // Мегабайт записи в секунду (0, если неприменимо)
+};
+
+/**
+ * @brief Параметры прогона из командной строки
+ */
+struct bench_config {
+	pixel_coord widths[BENCH_MAX_LIST], heights[BENCH_MAX_LIST];
+	int sizes;
+	int iters[BENCH_MAX_LIST];
+	int iters_count;
+	int threads[BENCH_MAX_LIST];
+	int threads_count;
+	int repeat;                     // Количество повторов каждого замера
+	const char *cases;              // Список замеров через запятую (NULL - все)
+	bool csv;                       // CSV вместо JSON
+	const char *output;             // Файл результата (NULL - stdout)
+	const char *baseline;           // Файл базового прогона
+	double tolerance;               // Допустимое замедление, проценты
+	const char *tmp_file;           // Временный файл для замеров записи
+	const char *env_threads;        // FRACTAL_THREADS при запуске (NULL - нет)
+};
+
+/**
+ * @brief Монотонное время в секундах
+ */
+static double bench_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/**
+ * @brief Проверяет, включен ли замер name в список cases
+ */
+static bool case_enabled(const struct bench_config *cfg, const char *name)
+{
+	if (cfg->cases == NULL)
+		return true;
+	size_t len = strlen(name);
+	for (const char *s = cfg->cases; *s;) {
+		const char *end = strchr(s, ',');
+		size_t n = end ? (size_t)(end - s) : strlen(s);
+		if (n == len && strncmp(s, name, n) == 0)
+			return true;
+		s += n + (end != NULL);
+	}
+	return false;
+}
+
+/**
+ * @brief Разбирает список целых через запятую
+ * @returns количество значений или -1 при ошибке
+ */
+static int parse_int_list(const char *s, int *out)
+{
+	int count = 0;
+	while (*s) {
+		char *end;
+		long v = strtol(s, &end, 10);
+		if (end == s || v < 0 || count == BENCH_MAX_LIST)
+			return -1;
+		out[count++] = (int)v;
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return -1;
+		s = end;
+	}
+	return count;
+}
+
+/**
+ * @brief Разбирает список размеров вида 800x600,1920x1080
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int parse_sizes(const char *s, struct bench_config *cfg)
+{
+	cfg->sizes = 0;
+	while (*s) {
+		unsigned int w, h;
+		int n;
+		if (sscanf(s, "%ux%u%n", &w, &h, &n) != 2 || w == 0 || h == 0 ||
+		    cfg->sizes == BENCH_MAX_LIST)
+			return -1;
+		cfg->widths[cfg->sizes] = w;
+		cfg->heights[cfg->sizes] = h;
+		cfg->sizes++;
+		s += n;
+		if (*s == ',')
+			s++;
+		else if (*s != '\0')
+			return -1;
+	}
+	return cfg->sizes > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Считает суммарное количество итераций вида скалярным ядром
+ *
+ * Точки, отсеченные проверкой внутренности или периодичности, учитываются
+ * с max_iter итераций, поэтому результат не зависит от оптимизаций.
+ */
+static double count_iterations(const escape_params_t *p)
+{
+	int *row = malloc(sizeof(int) * p->width);
+	assert(row != NULL);
+	double total = 0.0;
+	for (pixel_coord y = 0; y < p->height; y++) {
+		escape_row_scalar(p, y, 0, p->width, 1, row);
+		for (pixel_coord x = 0; x < p->width; x++)
+			total += row[x];
+	}
+	free(row);
+	return total;
+}
+
+/**
+ * @brief Задает количество потоков для функций без параметра потоков
+ *
+ * tree_fractal и кодировщик PNG берут его из FRACTAL_THREADS. Значение 0
+ * восстанавливает переменную, заданную при запуске замера.
+ */
+static void set_default_threads(int threads, const char *initial)
+{
+	char value[16];
+	if (threads > 0) {
+		snprintf(value, sizeof(value), "%d", threads);
+		setenv("FRACTAL_THREADS", value, 1);
+	} else if (initial != NULL) {
+		setenv("FRACTAL_THREADS", initial, 1);
+	} else {
+		unsetenv("FRACTAL_THREADS");
+	}
+}
+
+/**
+ * @brief Возвращает размер файла в байтах (0 при ошибке)
+ */
+static double file_size(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f)
+		return 0.0;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	return size > 0 ? (double)size : 0.0;
+}
+
+// Виды, на которых проводятся замеры
+static const double MANDELBROT_VIEW[4] = { -2.5, 1.0, -1.0, 1.0 };
+static const double JULIA_VIEW[4] = { -1.5, 1.5, -1.0, 1.0 };
+static const double JULIA_C[2] = { -0.7, 0.27015 };
+
+/**
+ * @brief Выполняет один вариант замера
+ */
+static void run_case(const char *name, image_p picture, int iterations,
+		     const fractal_options_t *opt, const char *tmp_file,
+		     const escape_buffer_t *buffer)
+{
+	pixel_coord w = get_image_width(picture);
+	pixel_coord h = get_image_height(picture);
+
+	if (strncmp(name, "mandelbrot", 10) == 0) {
+		mandelbrot_fractal_ex(picture, MANDELBROT_VIEW[0], MANDELBROT_VIEW[1],
+				      MANDELBROT_VIEW[2], MANDELBROT_VIEW[3],
+				      iterations, opt);
+	} else if (strcmp(name, "julia") == 0) {
+		julia_fractal_ex(picture, JULIA_C[0], JULIA_C[1], JULIA_VIEW[0],
+				 JULIA_VIEW[1], JULIA_VIEW[2], JULIA_VIEW[3],
+				 iterations, opt);
+	} else if (strcmp(name, "sierpinski") == 0) {
+		pixel_coord size = (w < h ? w : h) * 6 / 7;
+		sierpinski_triangle(picture, w / 2, h / 14, size, iterations);
+	} else if (strcmp(name, "sierpinski_fast") == 0) {
+		pixel_coord size = (w < h ? w : h) * 6 / 7;
+		sierpinski_triangle_fast(picture, w / 2, h / 14, size, iterations);
+	} else if (strcmp(name, "tree") == 0) {
+		tree_fractal(picture, w / 2, h - h / 16, 0.0, h / 5.0, iterations);
+	} else if (strcmp(name, "tree_aa") == 0) {
+		tree_fractal_aa(picture, w / 2, h - h / 16, 0.0, h / 5.0,
+				iterations);
+	} else if (strcmp(name, "recolor") == 0) {
+		palette_t pal;
+		palette_init_gray(&pal, iterations);
+		palette_apply(&pal, buffer, picture);
+	} else if (strcmp(name, "write_pgm") == 0) {
+		save_pgm(picture, tmp_file);
+	} else if (strcmp(name, "write_pgm_binary") == 0) {
+		save_pgm_binary(picture, tmp_file);
+	} else if (strcmp(name, "write_bmp") == 0) {
+		save_bmp(picture, tmp_file);
+	} else if (strcmp(name, "write_png") == 0) {
+		save_png(picture, tmp_file, IMAGE_PNG_LEVEL_DEFAULT);
+	} else if (strcmp(name, "stream_pgm_binary") == 0) {
+		image_writer_p writer = image_writer_open(tmp_file,
+							  IMAGE_FORMAT_PGM_BINARY,
+							  w, h);
+		if (writer == NULL)
+			return;
+		mandelbrot_fractal_stream(writer, MANDELBROT_VIEW[0],
+					  MANDELBROT_VIEW[1], MANDELBROT_VIEW[2],
+					  MANDELBROT_VIEW[3], iterations, opt);
+		image_writer_close(writer);
+	}
+}
+
+/**
+ * @brief Замеряет вариант cfg->repeat раз и заполняет результат
+ */
+static void measure(const struct bench_config *cfg, const char *name,
+		    pixel_coord w, pixel_coord h, int iterations, int threads,
+		    struct bench_result *r)
+{
+	fractal_options_t opt;
+	fractal_options_init(&opt);
+	opt.threads = threads;
+	// mandelbrot_<точность> - тот же вид с принудительной точностью
+	if (strcmp(name, "mandelbrot_float") == 0)
+		opt.precision = FRACTAL_PRECISION_FLOAT;
+	else if (strcmp(name, "mandelbrot_double") == 0)
+		opt.precision = FRACTAL_PRECISION_DOUBLE;
+	else if (strcmp(name, "mandelbrot_dd") == 0)
+		opt.precision = FRACTAL_PRECISION_DOUBLE_DOUBLE;
+
+	set_default_threads(threads, cfg->env_threads);
+
+	image_p picture = create_image(w, h);
+	bool writer = strncmp(name, "write_", 6) == 0;
+	// Замеры записи сохраняют настоящий фрактал, а не пустое изображение
+	if (writer)
+		mandelbrot_fractal_ex(picture, MANDELBROT_VIEW[0], MANDELBROT_VIEW[1],
+				      MANDELBROT_VIEW[2], MANDELBROT_VIEW[3],
+				      iterations, &opt);
+	// Перекраска замеряется на готовом буфере итераций
+	escape_buffer_t *buffer = NULL;
+	if (strcmp(name, "recolor") == 0) {
+		escape_params_t params = {
+			.width = w, .height = h,
+			.x_min = MANDELBROT_VIEW[0], .x_max = MANDELBROT_VIEW[1],
+			.y_min = MANDELBROT_VIEW[2], .y_max = MANDELBROT_VIEW[3],
+			.max_iter = iterations,
+		};
+		buffer = escape_buffer_create(w, h);
+		assert(buffer != NULL);
+		escape_render_buffer(buffer, &params, &opt);
+	}
+
+	double best = 0.0;
+	for (int i = 0; i < cfg->repeat; i++) {
+		if (!writer)
+			clear_image(picture);
+		double start = bench_now();
+		run_case(name, picture, iterations, &opt, cfg->tmp_file, buffer);
+		double t = bench_now() - start;
+		if (i == 0 || t < best)
+			best = t;
+	}
+	if (best <= 0.0)
+		best = 1e-9;
+
+	memset(r, 0, sizeof(*r));
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->width = w;
+	r->height = h;
+	r->iterations = iterations;
+	r->threads = threads;
+	r->seconds = best;
+	r->pixels_per_s = (double)w * h / best;
+
+	bool mandelbrot = strncmp(name, "mandelbrot", 10) == 0 ||
+			  strcmp(name, "stream_pgm_binary") == 0;
+	if (mandelbrot || strcmp(name, "julia") == 0) {
+		const double *v = mandelbrot ? MANDELBROT_VIEW : JULIA_VIEW;
+		escape_params_t params = {
+			.width = w, .height = h,
+			.x_min = v[0], .x_max = v[1], .y_min = v[2], .y_max = v[3],
+			.max_iter = iterations,
+			.julia = !mandelbrot,
+			.c_real = JULIA_C[0], .c_imag = JULIA_C[1],
+			.interior_check = true,
+			.periodicity = true,
+		};
+		r->iters_per_s = count_iterations(&params) / best;
+	}
+	if (writer || strcmp(name, "stream_pgm_binary") == 0) {
+		r->mb_per_s = file_size(cfg->tmp_file) / 1e6 / best;
+		remove(cfg->tmp_file);
+	}
+	escape_buffer_free(buffer);
+	free_image(picture);
+	set_default_threads(0, cfg->env_threads);
+}
+
+/**
+ * @brief Печатает результаты в JSON (одна запись на строку) или CSV
+ */
+static void print_results(FILE *out, const struct bench_result *r, int count,
+			  bool csv)
+{
+	if (csv)
+		fprintf(out, "name,width,height,iterations,threads,seconds,"
+			"pixels_per_s,iters_per_s,mb_per_s\n");
+	else
+		fprintf(out, "[\n");
+	for (int i = 0; i < count; i++) {
+		if (csv)
+			fprintf(out, "%s,%u,%u,%d,%d,%.6f,%.0f,%.0f,%.3f\n",
+				r[i].name, r[i].width, r[i].height, r[i].iterations,
+				r[i].threads, r[i].seconds, r[i].pixels_per_s,
+				r[i].iters_per_s, r[i].mb_per_s);
+		else
+			fprintf(out, "  {\"name\": \"%s\", \"width\": %u, \"height\": %u, "
+				"\"iterations\": %d, \"threads\": %d, \"seconds\": %.6f, "
+				"\"pixels_per_s\": %.0f, \"iters_per_s\": %.0f, "
+				"\"mb_per_s\": %.3f}%s\n",
+				r[i].name, r[i].width, r[i].height, r[i].iterations,
+				r[i].threads, r[i].seconds, r[i].pixels_per_s,
+				r[i].iters_per_s, r[i].mb_per_s,
+				i + 1 < count ? "," : "");
+	}
+	if (!csv)
+		fprintf(out, "]\n");
+}
+
+/**
+ * @brief Находит числовое поле "key": в строке JSON
+ * @returns 0 при успехе, -1 если поля нет
+ */
+static int json_number(const char *line, const char *key, double *value)
+{
+	char pattern[40];
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	const char *s = strstr(line, pattern);
+	if (!s)
+		return -1;
+	char *end;
+	*value = strtod(s + strlen(pattern), &end);
+	return end == s + strlen(pattern) ? -1 : 0;
+}
+
+/**
+ * @brief Разбирает одну строку результата в JSON или CSV
+ * @returns 0 при успехе, -1 если строка не является записью
+ */
+static int parse_result(const char *line, struct bench_result *r)
+{
+	memset(r, 0, sizeof(*r));
+	const char *name = strstr(line, "\"name\": \"");
+	if (name) {
+		name += strlen("\"name\": \"");
+		const char *end = strchr(name, '"');
+		if (!end || end - name >= (long)sizeof(r->name))
+			return -1;
+		memcpy(r->name, name, end - name);
+		double w, h, it, th, sec;
+		if (json_number(line, "width", &w) || json_number(line, "height", &h) ||
+		    json_number(line, "iterations", &it) ||
+		    json_number(line, "threads", &th) ||
+		    json_number(line, "seconds", &sec))
+			return -1;
+		r->width = (pixel_coord)w;
+		r->height = (pixel_coord)h;
+		r->iterations = (int)it;
+		r->threads = (int)th;
+		r->seconds = sec;
+		return 0;
+	}
+	// CSV: name,width,height,iterations,threads,seconds,...
+	if (sscanf(line, "%31[^,],%u,%u,%d,%d,%lf", r->name, &r->width,
+		   &r->height, &r->iterations, &r->threads, &r->seconds) != 6)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Сравнивает результаты с базовым прогоном
+ * @returns количество замеров, замедлившихся больше допустимого, или -1
+ */
+static int compare_baseline(const struct bench_config *cfg,
+			    const struct bench_result *r, int count)
+{
+	FILE *f = fopen(cfg->baseline, "r");
+	if (!f) {
+		fprintf(stderr, "Не удалось открыть %s\n", cfg->baseline);
+		return -1;
+	}
+	static struct bench_result base[BENCH_MAX_RESULTS];
+	int base_count = 0;
+	char line[512];
+	while (base_count < BENCH_MAX_RESULTS && fgets(line, sizeof(line), f))
+		if (parse_result(line, &base[base_count]) == 0)
+			base_count++;
+	fclose(f);
+
+	int regressions = 0;
+	fprintf(stderr, "%-20s %11s %6s %3s %10s %10s %8s\n", "name", "size",
+		"iter", "thr", "base, s", "now, s", "change");
+	for (int i = 0; i < count; i++) {
+		const struct bench_result *b = NULL;
+		for (int j = 0; j < base_count && !b; j++)
+			if (strcmp(base[j].name, r[i].name) == 0 &&
+			    base[j].width == r[i].width &&
+			    base[j].height == r[i].height &&
+			    base[j].iterations == r[i].iterations &&
+			    base[j].threads == r[i].threads)
+				b = &base[j];
+		if (!b || b->seconds <= 0.0)
+			continue;
+		double change = (r[i].seconds / b->seconds - 1.0) * 100.0;
+		bool slower = change > cfg->tolerance;
+		regressions += slower;
+		fprintf(stderr, "%-20s %5ux%-5u %6d %3d %10.6f %10.6f %+7.1f%%%s\n",
+			r[i].name, r[i].width, r[i].height, r[i].iterations,
+			r[i].threads, b->seconds, r[i].seconds, change,
+			slower ? " РЕГРЕССИЯ" : "");
+	}
+	return regressions;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Использование: %s [параметры]\n"
+		"  --sizes WxH[,WxH...]     размеры изображений (800x600)\n"
+		"  --iters N[,N...]         итерации фракталов с временем убегания (256)\n"
+		"  --threads N[,N...]       количество потоков, 0 - по умолчанию (0)\n"
+		"  --repeat N               повторов каждого замера, берется лучший (3)\n"
+		"  --cases a,b,...          mandelbrot, julia, sierpinski, sierpinski_fast,\n"
+		"                           tree, tree_aa, write_pgm, write_pgm_binary,\n"
+		"                           write_bmp, write_png, stream_pgm_binary,\n"
+		"                           recolor,\n"
+		"                           mandelbrot_float, mandelbrot_double,\n"
+		"                           mandelbrot_dd\n"
+		"  --csv                    вывод в CSV вместо JSON\n"
+		"  --output FILE            записать результат в файл\n"
+		"  --baseline FILE          сравнить с сохраненным прогоном (JSON или CSV)\n"
+		"  --tolerance PCT          допустимое замедление, проценты (5)\n"
+		"  --tmp FILE               временный файл для замеров записи\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_config cfg = {
+		.widths = { 800 }, .heights = { 600 }, .sizes = 1,
+		.iters = { 256 }, .iters_count = 1,
+		.threads = { 0 }, .threads_count = 1,
+		.repeat = 3,
+		.tolerance = BENCH_TOLERANCE,
+		.tmp_file = "fractal_bench.tmp",
+	};
+	// Копия: setenv может освободить строку, возвращенную getenv
+	const char *env_threads = getenv("FRACTAL_THREADS");
+	if (env_threads != NULL)
+		cfg.env_threads = strdup(env_threads);
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		bool ok = true;
+		if (strcmp(arg, "--csv") == 0) {
+			cfg.csv = true;
+			continue;
+		}
+		if (strcmp(arg, "--help") == 0 || val == NULL) {
+			usage(argv[0]);
+			return strcmp(arg, "--help") == 0 ? 0 : 2;
+		}
+		i++;
+		if (strcmp(arg, "--sizes") == 0)
+			ok = parse_sizes(val, &cfg) == 0;
+		else if (strcmp(arg, "--iters") == 0)
+			ok = (cfg.iters_count = parse_int_list(val, cfg.iters)) > 0;
+		else if (strcmp(arg, "--threads") == 0)
+			ok = (cfg.threads_count = parse_int_list(val, cfg.threads)) > 0;
+		else if (strcmp(arg, "--repeat") == 0)
+			ok = (cfg.repeat = atoi(val)) > 0;
+		else if (strcmp(arg, "--cases") == 0)
+			cfg.cases = val;
+		else if (strcmp(arg, "--output") == 0)
+			cfg.output = val;
+		else if (strcmp(arg, "--baseline") == 0)
+			cfg.baseline = val;
+		else if (strcmp(arg, "--tolerance") == 0)
+			ok = (cfg.tolerance = atof(val)) >= 0.0;
+		else if (strcmp(arg, "--tmp") == 0)
+			cfg.tmp_file = val;
+		else
+			ok = false;
+		if (!ok) {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	static const char *const escape_cases[] = {
+		"mandelbrot", "julia", "stream_pgm_binary",
+		"mandelbrot_float", "mandelbrot_double", "mandelbrot_dd",
+	};
+	/* Дерево и запись PNG распараллелены на пуле потоков и замеряются для
+	   каждого количества потоков, остальные варианты однопоточные */
+	static const char *const geometry_cases[] = {
+		"sierpinski", "sierpinski_fast", "tree", "tree_aa",
+	};
+	static const int geometry_depth[] = { 7, 7, 10, 10 };
+	static const bool geometry_threaded[] = { false, false, true, false };
+	static const char *const writer_cases[] = {
+		"write_pgm", "write_pgm_binary", "write_bmp", "write_png", "recolor",
+	};
+	static const bool writer_threaded[] = { false, false, false, true, false };
+
+	static struct bench_result results[BENCH_MAX_RESULTS];
+	int count = 0;
+
+	for (int s = 0; s < cfg.sizes; s++) {
+		pixel_coord w = cfg.widths[s], h = cfg.heights[s];
+		// Фракталы с временем убегания: по всем итерациям и потокам
+		for (size_t c = 0; c < sizeof(escape_cases) / sizeof(*escape_cases); c++)
+			for (int it = 0; it < cfg.iters_count; it++)
+				for (int t = 0; t < cfg.threads_count; t++)
+					if (case_enabled(&cfg, escape_cases[c]) &&
+					    count < BENCH_MAX_RESULTS)
+						measure(&cfg, escape_cases[c], w, h,
+							cfg.iters[it], cfg.threads[t],
+							&results[count++]);
+		// Геометрические фракталы: глубина фиксирована
+		for (size_t c = 0; c < sizeof(geometry_cases) / sizeof(*geometry_cases); c++)
+			for (int t = 0; t < (geometry_threaded[c] ? cfg.threads_count : 1); t++)
+				if (case_enabled(&cfg, geometry_cases[c]) &&
+				    count < BENCH_MAX_RESULTS)
+					measure(&cfg, geometry_cases[c], w, h,
+						geometry_depth[c],
+						geometry_threaded[c] ? cfg.threads[t] : 1,
+						&results[count++]);
+		// Запись файлов и перекраска не зависят от итераций
+		for (size_t c = 0; c < sizeof(writer_cases) / sizeof(*writer_cases); c++)
+			for (int t = 0; t < (writer_threaded[c] ? cfg.threads_count : 1); t++)
+				if (case_enabled(&cfg, writer_cases[c]) &&
+				    count < BENCH_MAX_RESULTS)
+					measure(&cfg, writer_cases[c], w, h, cfg.iters[0],
+						writer_threaded[c] ? cfg.threads[t] : 1,
+						&results[count++]);
+	}
+
+	FILE *out = stdout;
+	if (cfg.output && !(out = fopen(cfg.output, "w"))) {
+		fprintf(stderr, "Не удалось создать %s\n", cfg.output);
+		return 1;
+	}
+	print_results(out, results, count, cfg.csv);
+	if (out != stdout)
+		fclose(out);
+
+	if (cfg.baseline) {
+		int regressions = compare_baseline(&cfg, results, count);
+		if (regressions < 0)
+			return 1;
+		if (regressions > 0) {
+			fprintf(stderr, "Замедлились замеров: %d\n", regressions);
+			return 3;
+		}
+	}
+	return 0;
+}
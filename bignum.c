@@ -0,0 +1,248 @@
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+
+int bignum_limbs_for_bits(int bits)
+{
+	assert(bits >= 0);
+	// Одно слово целой части плюс дробные слова
+	int limbs = 1 + (bits + 31) / 32;
+	return limbs <= BIGNUM_MAX_LIMBS ? limbs : 0;
+}
+
+void bignum_zero(bignum_t *a, int limbs)
+{
+	assert(a != NULL);
+	assert(limbs > 0 && limbs <= BIGNUM_MAX_LIMBS);
+	a->negative = false;
+	a->limbs = limbs;
+	memset(a->d, 0, sizeof(a->d));
+}
+
+/**
+ * @brief Проверяет модуль на равенство нулю
+ */
+static bool mag_is_zero(const bignum_t *a)
+{
+	for (int i = 0; i < a->limbs; i++)
+		if (a->d[i] != 0)
+			return false;
+	return true;
+}
+
+/**
+ * @brief Сравнивает модули: -1, 0 или 1
+ */
+static int mag_cmp(const bignum_t *a, const bignum_t *b)
+{
+	for (int i = 0; i < a->limbs; i++)
+		if (a->d[i] != b->d[i])
+			return a->d[i] < b->d[i] ? -1 : 1;
+	return 0;
+}
+
+/**
+ * @brief Сложение модулей r = |a| + |b|
+ */
+static void mag_add(bignum_t *r, const bignum_t *a, const bignum_t *b)
+{
+	uint64_t carry = 0;
+	for (int i = a->limbs - 1; i >= 0; i--) {
+		uint64_t t = (uint64_t)a->d[i] + b->d[i] + carry;
+		r->d[i] = (uint32_t)t;
+		carry = t >> 32;
+	}
+}
+
+/**
+ * @brief Вычитание модулей r = |a| - |b| при |a| >= |b|
+ */
+static void mag_sub(bignum_t *r, const bignum_t *a, const bignum_t *b)
+{
+	int64_t borrow = 0;
+	for (int i = a->limbs - 1; i >= 0; i--) {
+		int64_t t = (int64_t)a->d[i] - b->d[i] - borrow;
+		borrow = t < 0;
+		r->d[i] = (uint32_t)(t + (borrow ? ((int64_t)1 << 32) : 0));
+	}
+}
+
+/**
+ * @brief Умножение модуля на небольшое целое
+ * @returns перенос из целой части (0, если нет переполнения)
+ */
+static uint32_t mag_mul_small(bignum_t *a, uint32_t m)
+{
+	uint64_t carry = 0;
+	for (int i = a->limbs - 1; i >= 0; i--) {
+		uint64_t t = (uint64_t)a->d[i] * m + carry;
+		a->d[i] = (uint32_t)t;
+		carry = t >> 32;
+	}
+	return (uint32_t)carry;
+}
+
+/**
+ * @brief Деление модуля на небольшое целое (с отбрасыванием остатка)
+ */
+static void mag_div_small(bignum_t *a, uint32_t m)
+{
+	uint64_t rem = 0;
+	for (int i = 0; i < a->limbs; i++) {
+		uint64_t t = (rem << 32) | a->d[i];
+		a->d[i] = (uint32_t)(t / m);
+		rem = t % m;
+	}
+}
+
+/**
+ * @brief Сложение с учетом знаков: r = a + (negate_b ? -b : b)
+ */
+static void signed_add(bignum_t *r, const bignum_t *a, const bignum_t *b,
+		       bool negate_b)
+{
+	assert(a->limbs == b->limbs);
+	bool b_negative = b->negative != negate_b;
+	bool negative;
+
+	r->limbs = a->limbs;
+	if (a->negative == b_negative) {
+		negative = a->negative;
+		mag_add(r, a, b);
+	} else if (mag_cmp(a, b) >= 0) {
+		negative = a->negative;
+		mag_sub(r, a, b);
+	} else {
+		negative = b_negative;
+		mag_sub(r, b, a);
+	}
+	// Ноль всегда положителен
+	r->negative = negative && !mag_is_zero(r);
+}
+
+void bignum_add(bignum_t *r, const bignum_t *a, const bignum_t *b)
+{
+	signed_add(r, a, b, false);
+}
+
+void bignum_sub(bignum_t *r, const bignum_t *a, const bignum_t *b)
+{
+	signed_add(r, a, b, true);
+}
+
+void bignum_mul(bignum_t *r, const bignum_t *a, const bignum_t *b)
+{
+	assert(a->limbs == b->limbs);
+	int n = a->limbs;
+	/* Произведение в виде целого числа: слово k имеет вес 2^(32 k),
+	   младшие слова первыми */
+	uint32_t prod[2 * BIGNUM_MAX_LIMBS];
+	memset(prod, 0, sizeof(uint32_t) * 2 * n);
+
+	for (int i = 0; i < n; i++) {
+		uint64_t ai = a->d[n - 1 - i];
+		if (ai == 0)
+			continue;
+		uint64_t carry = 0;
+		for (int j = 0; j < n; j++) {
+			uint64_t t = ai * b->d[n - 1 - j] + prod[i + j] + carry;
+			prod[i + j] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		prod[i + n] = (uint32_t)carry;
+	}
+
+	/* Оба множителя масштабированы на 2^(32 (n-1)), поэтому
+	   результату соответствуют слова n-1 .. 2n-2 */
+	bool negative = a->negative != b->negative;
+	r->limbs = n;
+	for (int k = 0; k < n; k++)
+		r->d[k] = prod[2 * n - 2 - k];
+	r->negative = negative && !mag_is_zero(r);
+}
+
+double bignum_to_double(const bignum_t *a)
+{
+	assert(a != NULL);
+	double v = 0.0;
+	int taken = 0;
+
+	// Достаточно трех слов, начиная со старшего ненулевого
+	for (int i = 0; i < a->limbs && taken < 3; i++) {
+		if (a->d[i] == 0 && taken == 0)
+			continue;
+		v += ldexp((double)a->d[i], -32 * i);
+		taken++;
+	}
+	return a->negative ? -v : v;
+}
+
+int bignum_from_string(bignum_t *a, const char *s, int limbs)
+{
+	assert(a != NULL);
+	assert(s != NULL);
+	bignum_zero(a, limbs);
+
+	while (isspace((unsigned char)*s))
+		s++;
+	bool negative = false;
+	if (*s == '+' || *s == '-')
+		negative = (*s++ == '-');
+
+	/* Собираем значащие цифры мантиссы и положение запятой */
+	const char *digits = s;
+	int count = 0;          // Количество цифр
+	int int_count = -1;     // Количество цифр до точки
+	for (; isdigit((unsigned char)*s) || *s == '.'; s++) {
+		if (*s == '.') {
+			if (int_count >= 0)
+				return -1;
+			int_count = count;
+		} else {
+			count++;
+		}
+	}
+	const char *digits_end = s;
+	if (count == 0)
+		return -1;
+	if (int_count < 0)
+		int_count = count;
+
+	long exponent = 0;
+	if (*s == 'e' || *s == 'E') {
+		char *end;
+		exponent = strtol(s + 1, &end, 10);
+		if (end == s + 1)
+			return -1;
+		s = end;
+	}
+	while (isspace((unsigned char)*s))
+		s++;
+	if (*s != '\0')
+		return -1;
+
+	/* Значение = 0.d1 d2 ... dn * 10^(int_count + exponent).
+	   Дробь 0.d1...dn строится с конца: f = (d + f) / 10 */
+	for (const char *p = digits_end; p != digits;) {
+		if (*--p == '.')
+			continue;
+		a->d[0] += (uint32_t)(*p - '0');
+		mag_div_small(a, 10);
+	}
+
+	long scale = int_count + exponent;
+	if (scale < -100000 || scale > 100000)
+		return -1;
+	for (; scale > 0; scale--)
+		if (mag_mul_small(a, 10) != 0)
+			return -1;
+	for (; scale < 0; scale++)
+		mag_div_small(a, 10);
+
+	a->negative = negative && !mag_is_zero(a);
+	return 0;
+}
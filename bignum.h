@@ -0,0 +1,72 @@
+#ifndef _BIGNUM_H_
+#define _BIGNUM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Максимальное количество 32-битных слов в числе
+ * (1 слово целой части и до 63 слов дробной, около 600 десятичных знаков)
+ */
+#define BIGNUM_MAX_LIMBS 64
+
+/**
+ * @brief Число с фиксированной точкой произвольной точности
+ *
+ * Хранится как знак и модуль: d[0] - целая часть, d[1..limbs-1] - дробная
+ * часть, старшие слова первыми. Предназначено для опорных орбит глубокого
+ * увеличения, поэтому целая часть ограничена 32 битами.
+ */
+typedef struct bignum {
+	bool negative;                  // Знак числа
+	int limbs;                      // Количество используемых слов
+	uint32_t d[BIGNUM_MAX_LIMBS];   // Слова модуля
+} bignum_t;
+
+/**
+ * @brief Возвращает количество слов для заданного числа дробных бит
+ *
+ * @param bits Требуемое количество бит после запятой
+ * @returns количество слов или 0, если точность превышает BIGNUM_MAX_LIMBS
+ */
+int bignum_limbs_for_bits(int bits);
+
+/**
+ * @brief Инициализирует число нулем
+ *
+ * @param a Число
+ * @param limbs Количество слов (от 1 до BIGNUM_MAX_LIMBS)
+ */
+void bignum_zero(bignum_t *a, int limbs);
+
+/**
+ * @brief Разбирает десятичную запись числа ("-0.743643887037158704752191506114774e0")
+ *
+ * @param a Результат
+ * @param s Строка с числом (знак, цифры, точка, необязательная экспонента)
+ * @param limbs Количество слов
+ * @returns 0 при успехе, -1 при ошибке разбора или переполнении
+ */
+int bignum_from_string(bignum_t *a, const char *s, int limbs);
+
+/**
+ * @brief Преобразует число в double (с округлением к нулю)
+ */
+double bignum_to_double(const bignum_t *a);
+
+/**
+ * @brief Сложение r = a + b (числа должны иметь одинаковое количество слов)
+ */
+void bignum_add(bignum_t *r, const bignum_t *a, const bignum_t *b);
+
+/**
+ * @brief Вычитание r = a - b
+ */
+void bignum_sub(bignum_t *r, const bignum_t *a, const bignum_t *b);
+
+/**
+ * @brief Умножение r = a * b (младшие биты отбрасываются)
+ */
+void bignum_mul(bignum_t *r, const bignum_t *a, const bignum_t *b);
+
+#endif // _BIGNUM_H_
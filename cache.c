@@ -0,0 +1,717 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "cache.h"
+
+#ifdef FRACTAL_USE_PTHREADS
+#include <pthread.h>
+#endif
+
+/**
+ * @brief Сигнатура файла записи кэша
+ */
+#define CACHE_MAGIC "FRCACHE1"
+
+/**
+ * @brief Вид хранимого результата
+ */
+enum cache_kind {
+	CACHE_IMAGE = 1,    // Изображение в оттенках серого
+	CACHE_BUFFER = 2,   // Буфер итераций
+};
+
+/**
+ * @brief Ключ записи: все параметры, от которых зависит результат
+ *
+ * Перед заполнением обнуляется целиком, поэтому ключи можно сравнивать
+ * memcmp вместе с выравниванием.
+ */
+struct cache_key {
+	uint32_t kind;                  // enum cache_kind
+	uint32_t width, height;
+	int32_t max_iter;
+	uint32_t julia, smooth, subdivide, jitter;
+	int32_t antialias;
+	uint32_t precision;             // Выбранная точность арифметики
+	uint32_t formula;               // Итерируемая функция
+	int32_t power;                  // Степень z (для z^n + c)
+	double x_min, x_max, y_min, y_max;
+	double c_real, c_imag;
+};
+
+/**
+ * @brief Запись кэша
+ */
+struct cache_entry {
+	struct cache_key key;
+	uint64_t hash;
+	int32_t max_iter;                   // max_iter буфера итераций
+	uint32_t smooth;                    // Признак дробного буфера
+	size_t bytes;                       // Размер данных
+	void *data;                         // Пиксели или значения буфера
+	struct cache_entry *chain;          // Следующая запись корзины
+	struct cache_entry *prev, *next;    // Соседи в списке LRU
+};
+
+struct render_cache {
+	size_t max_bytes;                   // Лимит размера данных
+	size_t bytes;                       // Текущий размер данных
+	size_t entries;                     // Количество записей
+	char *directory;                    // Каталог записей (или NULL)
+	size_t disk_max_bytes;              // Лимит размера файлов каталога
+	size_t disk_bytes;                  // Оценка размера файлов каталога
+	unsigned long writes;               // Счетчик для имен временных файлов
+	struct cache_entry *buckets[RENDER_CACHE_BUCKETS];
+	struct cache_entry *head, *tail;    // Самая новая и самая старая записи
+	unsigned long hits, disk_hits, misses, evictions, disk_evictions;
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_t lock;
+	pthread_mutex_t disk_lock;          // Обход и очистка каталога
+#endif
+};
+
+/**
+ * @brief Файл записи в каталоге кэша
+ */
+struct disk_file {
+	char name[32];                      // Имя файла без каталога
+	struct timespec mtime;              // Время последнего использования
+	size_t bytes;                       // Размер файла
+};
+
+/**
+ * @brief Захватывает кэш
+ */
+static void cache_lock(render_cache_t *cache)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_lock(&cache->lock);
+#else
+	(void)cache;
+#endif
+}
+
+/**
+ * @brief Освобождает кэш
+ */
+static void cache_unlock(render_cache_t *cache)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_unlock(&cache->lock);
+#else
+	(void)cache;
+#endif
+}
+
+/**
+ * @brief Строит ключ вида
+ *
+ * Параметры, которые не меняют результат (количество потоков, набор
+ * инструкций, отсечение внутренних точек), в ключ не входят.
+ */
+static void make_key(struct cache_key *key, enum cache_kind kind,
+		     const escape_params_t *p, const fractal_options_t *opt)
+{
+	memset(key, 0, sizeof(*key));
+	key->kind = kind;
+	key->width = p->width;
+	key->height = p->height;
+	key->max_iter = p->max_iter;
+	key->julia = p->julia;
+	key->formula = p->formula;
+	key->power = p->formula == FRACTAL_FORMULA_POWER && p->power > 2 ?
+		p->power : 2;
+	key->x_min = p->x_min;
+	key->x_max = p->x_max;
+	key->y_min = p->y_min;
+	key->y_max = p->y_max;
+	if (p->julia) {
+		key->c_real = p->c_real;
+		key->c_imag = p->c_imag;
+	}
+	key->subdivide = opt->strategy == FRACTAL_STRATEGY_SUBDIVIDE;
+	key->precision = escape_select_precision(p, opt->precision);
+
+	if (kind == CACHE_BUFFER) {
+		key->smooth = opt->smooth;
+	} else if (opt->antialias > 1 &&
+		   opt->strategy != FRACTAL_STRATEGY_PROGRESSIVE) {
+		// Та же нормализация, что и при рендеринге
+		key->antialias = opt->antialias < ESCAPE_AA_MAX ?
+			opt->antialias : ESCAPE_AA_MAX;
+		key->jitter = opt->antialias_jitter;
+	}
+}
+
+/**
+ * @brief 64-битный хеш FNV-1a ключа
+ */
+static uint64_t key_hash(const struct cache_key *key)
+{
+	const unsigned char *b = (const unsigned char *)key;
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < sizeof(*key); i++) {
+		h ^= b[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * @brief Убирает запись из списка LRU
+ */
+static void lru_unlink(render_cache_t *cache, struct cache_entry *e)
+{
+	if (e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		cache->head = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		cache->tail = e->prev;
+	e->prev = e->next = NULL;
+}
+
+/**
+ * @brief Ставит запись в начало списка LRU (самая новая)
+ */
+static void lru_push(render_cache_t *cache, struct cache_entry *e)
+{
+	e->prev = NULL;
+	e->next = cache->head;
+	if (cache->head != NULL)
+		cache->head->prev = e;
+	cache->head = e;
+	if (cache->tail == NULL)
+		cache->tail = e;
+}
+
+/**
+ * @brief Удаляет запись из кэша и освобождает ее
+ */
+static void remove_entry(render_cache_t *cache, struct cache_entry *e)
+{
+	struct cache_entry **link = &cache->buckets[e->hash % RENDER_CACHE_BUCKETS];
+	while (*link != e)
+		link = &(*link)->chain;
+	*link = e->chain;
+	lru_unlink(cache, e);
+	cache->bytes -= e->bytes;
+	cache->entries--;
+	free(e->data);
+	free(e);
+}
+
+/**
+ * @brief Ищет запись в памяти и делает ее самой новой
+ */
+static struct cache_entry *find_entry(render_cache_t *cache,
+				      const struct cache_key *key,
+				      uint64_t hash)
+{
+	struct cache_entry *e = cache->buckets[hash % RENDER_CACHE_BUCKETS];
+	for (; e != NULL; e = e->chain)
+		if (e->hash == hash && memcmp(&e->key, key, sizeof(*key)) == 0)
+			break;
+	if (e != NULL && e != cache->head) {
+		lru_unlink(cache, e);
+		lru_push(cache, e);
+	}
+	return e;
+}
+
+/**
+ * @brief Добавляет запись в память, вытесняя самые старые
+ *
+ * Запись больше лимита не добавляется и освобождается.
+ */
+static void insert_entry(render_cache_t *cache, struct cache_entry *e)
+{
+	if (e->bytes > cache->max_bytes) {
+		free(e->data);
+		free(e);
+		return;
+	}
+	while (cache->bytes + e->bytes > cache->max_bytes && cache->tail != NULL) {
+		remove_entry(cache, cache->tail);
+		cache->evictions++;
+	}
+	struct cache_entry **bucket = &cache->buckets[e->hash % RENDER_CACHE_BUCKETS];
+	e->chain = *bucket;
+	*bucket = e;
+	lru_push(cache, e);
+	cache->bytes += e->bytes;
+	cache->entries++;
+}
+
+/**
+ * @brief Захватывает каталог кэша
+ */
+static void disk_lock(render_cache_t *cache)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_lock(&cache->disk_lock);
+#else
+	(void)cache;
+#endif
+}
+
+/**
+ * @brief Освобождает каталог кэша
+ */
+static void disk_unlock(render_cache_t *cache)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_unlock(&cache->disk_lock);
+#else
+	(void)cache;
+#endif
+}
+
+/**
+ * @brief Имя файла записи в каталоге кэша
+ */
+static void entry_path(const render_cache_t *cache, uint64_t hash,
+		       const char *suffix, char *path, size_t size)
+{
+	snprintf(path, size, "%s/%016llx.frc%s", cache->directory,
+		 (unsigned long long)hash, suffix);
+}
+
+/**
+ * @brief Размер файла записи с данными размером bytes
+ */
+static size_t entry_file_bytes(size_t bytes)
+{
+	return 8 + sizeof(struct cache_key) + sizeof(int32_t) +
+		sizeof(uint32_t) + sizeof(uint64_t) + bytes;
+}
+
+/**
+ * @brief Проверяет, что имя - файл записи кэша (хеш и .frc)
+ */
+static bool is_entry_name(const char *name)
+{
+	size_t len = strlen(name);
+	if (len != 16 + 4 || strcmp(name + 16, ".frc") != 0)
+		return false;
+	return strspn(name, "0123456789abcdef") == 16;
+}
+
+/**
+ * @brief Сравнивает файлы по времени использования (старые первыми)
+ */
+static int compare_files(const void *a, const void *b)
+{
+	const struct disk_file *fa = a, *fb = b;
+	if (fa->mtime.tv_sec != fb->mtime.tv_sec)
+		return fa->mtime.tv_sec < fb->mtime.tv_sec ? -1 : 1;
+	if (fa->mtime.tv_nsec != fb->mtime.tv_nsec)
+		return fa->mtime.tv_nsec < fb->mtime.tv_nsec ? -1 : 1;
+	return strcmp(fa->name, fb->name);
+}
+
+/**
+ * @brief Перечисляет файлы записей в каталоге кэша
+ *
+ * @param files Массив файлов (освобождается вызывающим), может быть NULL
+ * @param count Количество файлов
+ * @returns суммарный размер файлов
+ */
+static size_t scan_directory(const render_cache_t *cache,
+			     struct disk_file **files, size_t *count)
+{
+	size_t total = 0, capacity = 0;
+	*count = 0;
+	if (files != NULL)
+		*files = NULL;
+	DIR *dir = opendir(cache->directory);
+	if (dir == NULL)
+		return 0;
+	size_t size = strlen(cache->directory) + 64;
+	char *path = malloc(size);
+	struct dirent *d;
+	while (path != NULL && (d = readdir(dir)) != NULL) {
+		struct stat st;
+		if (!is_entry_name(d->d_name))
+			continue;
+		snprintf(path, size, "%s/%s", cache->directory, d->d_name);
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		total += (size_t)st.st_size;
+		if (files == NULL)
+			continue;
+		if (*count == capacity) {
+			capacity = capacity ? 2 * capacity : 64;
+			struct disk_file *grown = realloc(*files, sizeof(**files) * capacity);
+			if (grown == NULL)
+				break;
+			*files = grown;
+		}
+		struct disk_file *f = &(*files)[(*count)++];
+		snprintf(f->name, sizeof(f->name), "%s", d->d_name);
+		f->mtime = st.st_mtim;
+		f->bytes = (size_t)st.st_size;
+	}
+	free(path);
+	closedir(dir);
+	return total;
+}
+
+/**
+ * @brief Удаляет самые давно использованные файлы каталога, пока их
+ * размер превышает лимит
+ *
+ * Размер каталога отслеживается по записям этого кэша, но каталог могут
+ * делить несколько процессов, поэтому перед удалением он пересчитывается.
+ */
+static void trim_directory(render_cache_t *cache)
+{
+	disk_lock(cache);
+	if (cache->disk_bytes <= cache->disk_max_bytes) {
+		disk_unlock(cache);
+		return;
+	}
+	struct disk_file *files;
+	size_t count;
+	size_t total = scan_directory(cache, &files, &count);
+	unsigned long removed = 0;
+	if (files != NULL) {
+		qsort(files, count, sizeof(*files), compare_files);
+		size_t size = strlen(cache->directory) + 64;
+		char *path = malloc(size);
+		for (size_t i = 0; path != NULL && i < count &&
+		     total > cache->disk_max_bytes; i++) {
+			snprintf(path, size, "%s/%s", cache->directory, files[i].name);
+			if (remove(path) == 0) {
+				total -= files[i].bytes;
+				removed++;
+			}
+		}
+		free(path);
+		free(files);
+	}
+	cache->disk_bytes = total;
+	disk_unlock(cache);
+
+	cache_lock(cache);
+	cache->disk_evictions += removed;
+	cache_unlock(cache);
+}
+
+/**
+ * @brief Записывает запись в каталог кэша
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int save_entry(render_cache_t *cache, const struct cache_entry *e)
+{
+	size_t size = strlen(cache->directory) + 64;
+	char *path = malloc(2 * size);
+	if (path == NULL)
+		return -1;
+	/* Запись идет во временный файл, который затем переименовывается:
+	   другие процессы не увидят недописанную запись. Имя временного файла
+	   уникально для процесса и вызова, поэтому одновременные записи одного
+	   ключа не пишут в один файл */
+	char *tmp = path + size;
+	char suffix[48];
+	cache_lock(cache);
+	unsigned long write = cache->writes++;
+	cache_unlock(cache);
+	snprintf(suffix, sizeof(suffix), ".%ld.%lu.tmp", (long)getpid(), write);
+	entry_path(cache, e->hash, "", path, size);
+	entry_path(cache, e->hash, suffix, tmp, size);
+	struct stat old;
+	size_t old_bytes = stat(path, &old) == 0 ? (size_t)old.st_size : 0;
+
+	int result = -1;
+	FILE *file = fopen(tmp, "wb");
+	if (file != NULL) {
+		uint64_t bytes = e->bytes;
+		result = 0;
+		if (fwrite(CACHE_MAGIC, 8, 1, file) != 1 ||
+		    fwrite(&e->key, sizeof(e->key), 1, file) != 1 ||
+		    fwrite(&e->max_iter, sizeof(e->max_iter), 1, file) != 1 ||
+		    fwrite(&e->smooth, sizeof(e->smooth), 1, file) != 1 ||
+		    fwrite(&bytes, sizeof(bytes), 1, file) != 1 ||
+		    fwrite(e->data, 1, e->bytes, file) != e->bytes)
+			result = -1;
+		if (fclose(file) != 0)
+			result = -1;
+		if (result == 0 && rename(tmp, path) != 0)
+			result = -1;
+		if (result != 0)
+			remove(tmp);
+	}
+	free(path);
+	if (result == 0) {
+		disk_lock(cache);
+		cache->disk_bytes += entry_file_bytes(e->bytes);
+		cache->disk_bytes -= old_bytes < cache->disk_bytes ?
+			old_bytes : cache->disk_bytes;
+		disk_unlock(cache);
+	}
+	return result;
+}
+
+/**
+ * @brief Загружает запись из каталога кэша
+ * @returns запись или NULL, если файла нет или он не подходит к ключу
+ */
+static struct cache_entry *load_entry(const render_cache_t *cache,
+				      const struct cache_key *key,
+				      uint64_t hash, size_t bytes)
+{
+	size_t size = strlen(cache->directory) + 32;
+	char *path = malloc(size);
+	if (path == NULL)
+		return NULL;
+	entry_path(cache, hash, "", path, size);
+	FILE *file = fopen(path, "rb");
+	/* Время изменения отмечает использование: по нему вытесняются файлы
+	   (время доступа часто не обновляется файловой системой) */
+	if (file != NULL)
+		utimensat(AT_FDCWD, path, NULL, 0);
+	free(path);
+	if (file == NULL)
+		return NULL;
+
+	char magic[8];
+	struct cache_key stored;
+	uint64_t stored_bytes;
+	struct cache_entry *e = calloc(1, sizeof(*e));
+	bool ok = e != NULL &&
+		fread(magic, 8, 1, file) == 1 &&
+		memcmp(magic, CACHE_MAGIC, 8) == 0 &&
+		fread(&stored, sizeof(stored), 1, file) == 1 &&
+		memcmp(&stored, key, sizeof(stored)) == 0 &&
+		fread(&e->max_iter, sizeof(e->max_iter), 1, file) == 1 &&
+		fread(&e->smooth, sizeof(e->smooth), 1, file) == 1 &&
+		fread(&stored_bytes, sizeof(stored_bytes), 1, file) == 1 &&
+		stored_bytes == bytes &&
+		(e->data = malloc(bytes)) != NULL &&
+		fread(e->data, 1, bytes, file) == bytes;
+	fclose(file);
+	if (!ok) {
+		if (e != NULL)
+			free(e->data);
+		free(e);
+		return NULL;
+	}
+	e->key = *key;
+	e->hash = hash;
+	e->bytes = bytes;
+	return e;
+}
+
+render_cache_t *render_cache_create(size_t max_bytes, const char *directory,
+				    size_t disk_bytes)
+{
+	render_cache_t *cache = calloc(1, sizeof(render_cache_t));
+	if (cache == NULL)
+		return NULL;
+	cache->max_bytes = max_bytes;
+	cache->disk_max_bytes = disk_bytes > 0 ? disk_bytes : max_bytes;
+	if (directory != NULL) {
+		cache->directory = malloc(strlen(directory) + 1);
+		if (cache->directory == NULL) {
+			free(cache);
+			return NULL;
+		}
+		strcpy(cache->directory, directory);
+		size_t count;
+		cache->disk_bytes = scan_directory(cache, NULL, &count);
+	}
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_mutex_init(&cache->disk_lock, NULL);
+#endif
+	// Каталог мог остаться от запуска с большим лимитом
+	if (directory != NULL)
+		trim_directory(cache);
+	return cache;
+}
+
+void render_cache_free(render_cache_t *cache)
+{
+	if (cache == NULL)
+		return;
+	while (cache->head != NULL)
+		remove_entry(cache, cache->head);
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_destroy(&cache->lock);
+	pthread_mutex_destroy(&cache->disk_lock);
+#endif
+	free(cache->directory);
+	free(cache);
+}
+
+/**
+ * @brief Ищет запись в памяти, затем в каталоге, и копирует ее данные
+ *
+ * @param out Куда скопировать данные (bytes байт)
+ * @param entry_out Заголовок найденной записи (max_iter, smooth)
+ * @returns true, если запись найдена
+ */
+static bool cache_get(render_cache_t *cache, const struct cache_key *key,
+		      size_t bytes, void *out, struct cache_entry *entry_out)
+{
+	uint64_t hash = key_hash(key);
+	cache_lock(cache);
+	struct cache_entry *e = find_entry(cache, key, hash);
+	if (e != NULL) {
+		cache->hits++;
+		memcpy(out, e->data, bytes);
+		*entry_out = *e;
+		cache_unlock(cache);
+		return true;
+	}
+	cache_unlock(cache);
+
+	// Файл читается без блокировки, чтобы не задерживать другие потоки
+	if (cache->directory != NULL)
+		e = load_entry(cache, key, hash, bytes);
+
+	cache_lock(cache);
+	if (e == NULL) {
+		cache->misses++;
+		cache_unlock(cache);
+		return false;
+	}
+	cache->disk_hits++;
+	memcpy(out, e->data, bytes);
+	*entry_out = *e;
+	// Другой поток мог уже загрузить ту же запись
+	struct cache_entry *old = find_entry(cache, key, hash);
+	if (old != NULL)
+		remove_entry(cache, old);
+	insert_entry(cache, e);
+	cache_unlock(cache);
+	return true;
+}
+
+/**
+ * @brief Добавляет запись (копию данных) в память и в каталог
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int cache_put(render_cache_t *cache, const struct cache_key *key,
+		     const void *data, size_t bytes, int32_t max_iter,
+		     bool smooth)
+{
+	struct cache_entry *e = calloc(1, sizeof(*e));
+	if (e == NULL || (e->data = malloc(bytes)) == NULL) {
+		free(e);
+		return -1;
+	}
+	memcpy(e->data, data, bytes);
+	e->key = *key;
+	e->hash = key_hash(key);
+	e->bytes = bytes;
+	e->max_iter = max_iter;
+	e->smooth = smooth;
+
+	/* Каталог не меняется после создания, файл пишется без блокировки.
+	   Запись больше лимита каталога не сохраняется в нем (как и в памяти) */
+	int result = 0;
+	if (cache->directory != NULL &&
+	    entry_file_bytes(bytes) <= cache->disk_max_bytes) {
+		result = save_entry(cache, e);
+		trim_directory(cache);
+	}
+
+	cache_lock(cache);
+	struct cache_entry *old = find_entry(cache, key, e->hash);
+	if (old != NULL)
+		remove_entry(cache, old);
+	insert_entry(cache, e);
+	cache_unlock(cache);
+	return result;
+}
+
+bool render_cache_get_image(render_cache_t *cache, const escape_params_t *p,
+			    const fractal_options_t *opt, image_p picture)
+{
+	assert(cache != NULL && p != NULL && opt != NULL && picture != NULL);
+	assert(p->reference == NULL);
+	assert(get_image_width(picture) == p->width);
+	assert(get_image_height(picture) == p->height);
+
+	struct cache_key key;
+	struct cache_entry header;
+	make_key(&key, CACHE_IMAGE, p, opt);
+	// Строки изображения хранятся подряд (см. image_row)
+	return cache_get(cache, &key, (size_t)p->width * p->height,
+			 image_row(picture, 0), &header);
+}
+
+int render_cache_put_image(render_cache_t *cache, const escape_params_t *p,
+			   const fractal_options_t *opt, image_p picture)
+{
+	assert(cache != NULL && p != NULL && opt != NULL && picture != NULL);
+	assert(p->reference == NULL);
+
+	struct cache_key key;
+	make_key(&key, CACHE_IMAGE, p, opt);
+	return cache_put(cache, &key, image_row(picture, 0),
+			 (size_t)p->width * p->height, p->max_iter, false);
+}
+
+bool render_cache_get_buffer(render_cache_t *cache, const escape_params_t *p,
+			     const fractal_options_t *opt,
+			     escape_buffer_t *buffer)
+{
+	assert(cache != NULL && p != NULL && opt != NULL && buffer != NULL);
+	assert(p->reference == NULL);
+	assert(buffer->width == p->width && buffer->height == p->height);
+
+	struct cache_key key;
+	struct cache_entry header;
+	make_key(&key, CACHE_BUFFER, p, opt);
+	if (!cache_get(cache, &key, sizeof(float) * p->width * p->height,
+		       buffer->values, &header))
+		return false;
+	buffer->max_iter = header.max_iter;
+	buffer->smooth = header.smooth != 0;
+	return true;
+}
+
+int render_cache_put_buffer(render_cache_t *cache, const escape_params_t *p,
+			    const fractal_options_t *opt,
+			    const escape_buffer_t *buffer)
+{
+	assert(cache != NULL && p != NULL && opt != NULL && buffer != NULL);
+	assert(p->reference == NULL);
+
+	struct cache_key key;
+	make_key(&key, CACHE_BUFFER, p, opt);
+	return cache_put(cache, &key, buffer->values,
+			 sizeof(float) * p->width * p->height,
+			 buffer->max_iter, buffer->smooth);
+}
+
+void render_cache_stats(render_cache_t *cache, render_cache_stats_t *stats)
+{
+	assert(cache != NULL);
+	assert(stats != NULL);
+	cache_lock(cache);
+	stats->hits = cache->hits;
+	stats->disk_hits = cache->disk_hits;
+	stats->misses = cache->misses;
+	stats->evictions = cache->evictions;
+	stats->disk_evictions = cache->disk_evictions;
+	stats->entries = cache->entries;
+	stats->bytes = cache->bytes;
+	unsigned long found = cache->hits + cache->disk_hits;
+	unsigned long total = found + cache->misses;
+	stats->hit_rate = total > 0 ? (double)found / total : 0.0;
+	cache_unlock(cache);
+}
@@ -0,0 +1,114 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "image.h"
+#include "fractal.h"
+#include "escape.h"
+
+/**
+ * @brief Количество корзин хеш-таблицы кэша
+ */
+#define RENDER_CACHE_BUCKETS 256
+
+/**
+ * @brief Кэш результатов рендеринга фракталов с временем убегания
+ *
+ * Хранит готовые изображения и буферы итераций по ключу из всех параметров,
+ * влияющих на результат (тип фрактала, размеры, область, max_iter, константа
+ * Жюлиа, стратегия, сглаживание). Записи в памяти вытесняются по давности
+ * использования (LRU), когда их общий размер превышает лимит. Если задан
+ * каталог, записи также сохраняются в нем файлами с именем по хешу ключа и
+ * находятся после перезапуска. Файлы каталога вытесняются по времени
+ * изменения, которое обновляется при каждом чтении, когда их общий размер
+ * превышает лимит каталога. Все функции потокобезопасны.
+ */
+typedef struct render_cache render_cache_t;
+
+/**
+ * @brief Статистика кэша
+ */
+typedef struct render_cache_stats {
+	unsigned long hits;         // Найдено в памяти
+	unsigned long disk_hits;    // Найдено в каталоге
+	unsigned long misses;       // Не найдено (потребовался рендеринг)
+	unsigned long evictions;    // Вытеснено из памяти
+	unsigned long disk_evictions; // Удалено файлов каталога
+	size_t entries;             // Записей в памяти
+	size_t bytes;               // Размер данных записей в памяти
+	double hit_rate;            // Доля запросов, обслуженных без рендеринга
+} render_cache_stats_t;
+
+/**
+ * @brief Создает кэш
+ *
+ * Если файлы в каталоге уже превышают лимит, самые старые удаляются сразу.
+ *
+ * @param max_bytes Лимит размера данных в памяти
+ * @param directory Каталог для записей на диске (NULL - только память);
+ * должен существовать
+ * @param disk_bytes Лимит размера файлов записей в каталоге (0 - равен
+ * max_bytes)
+ * @returns кэш или NULL при нехватке памяти
+ */
+render_cache_t *render_cache_create(size_t max_bytes, const char *directory,
+				    size_t disk_bytes);
+
+/**
+ * @brief Освобождает кэш (файлы в каталоге остаются)
+ */
+void render_cache_free(render_cache_t *cache);
+
+/**
+ * @brief Ищет готовое изображение вида
+ *
+ * @param cache Кэш
+ * @param p Описание вида (без опорной орбиты)
+ * @param opt Параметры рендеринга
+ * @param picture Изображение размером p->width x p->height для результата
+ * @returns true, если изображение найдено и скопировано в picture
+ */
+bool render_cache_get_image(render_cache_t *cache, const escape_params_t *p,
+			    const fractal_options_t *opt, image_p picture);
+
+/**
+ * @brief Сохраняет изображение вида в кэше
+ *
+ * @returns 0 при успехе, -1 при нехватке памяти или ошибке записи файла
+ * @see render_cache_get_image
+ */
+int render_cache_put_image(render_cache_t *cache, const escape_params_t *p,
+			   const fractal_options_t *opt, image_p picture);
+
+/**
+ * @brief Ищет готовый буфер итераций вида
+ *
+ * @param buffer Буфер размером p->width x p->height для результата
+ * @returns true, если буфер найден и скопирован
+ * @see render_cache_get_image
+ */
+bool render_cache_get_buffer(render_cache_t *cache, const escape_params_t *p,
+			     const fractal_options_t *opt,
+			     escape_buffer_t *buffer);
+
+/**
+ * @brief Сохраняет буфер итераций вида в кэше
+ *
+ * @returns 0 при успехе, -1 при нехватке памяти или ошибке записи файла
+ * @see render_cache_get_buffer
+ */
+int render_cache_put_buffer(render_cache_t *cache, const escape_params_t *p,
+			    const fractal_options_t *opt,
+			    const escape_buffer_t *buffer);
+
+/**
+ * @brief Возвращает статистику кэша
+ *
+ * @param cache Кэш
+ * @param stats Результат
+ */
+void render_cache_stats(render_cache_t *cache, render_cache_stats_t *stats);
+
+#endif // _CACHE_H_
@@ -0,0 +1,135 @@
+#ifndef _DDOUBLE_H_
+#define _DDOUBLE_H_
+
+/*
+ * Арифметика пар double (double-double): значение hi + lo, |lo| <= ulp(hi)/2,
+ * около 106 бит мантиссы.
+ *
+ * Операции построены на точных преобразованиях суммы и произведения
+ * (Деккер, Кнут) без FMA; они корректны, пока компилятор не объединяет
+ * умножение со сложением (-ffp-contract=off) и не использует 80-битные
+ * регистры x87.
+ */
+
+/**
+ * @brief Число из пары double: значение hi + lo
+ */
+typedef struct dd {
+	double hi, lo;
+} dd_t;
+
+/**
+ * @brief Точная сумма: s + e = a + b (Кнут)
+ */
+static inline dd_t two_sum(double a, double b)
+{
+	double s = a + b;
+	double bb = s - a;
+	dd_t r = { s, (a - (s - bb)) + (b - bb) };
+	return r;
+}
+
+/**
+ * @brief Точная сумма при |a| >= |b|
+ */
+static inline dd_t quick_two_sum(double a, double b)
+{
+	double s = a + b;
+	dd_t r = { s, b - (s - a) };
+	return r;
+}
+
+/**
+ * @brief Точное произведение: p + e = a * b (Деккер)
+ */
+static inline dd_t two_prod(double a, double b)
+{
+	// Разбиение на половины по 26 бит: 2^27 + 1
+	const double split = 134217729.0;
+	double p = a * b;
+	double t = split * a;
+	double ah = t - (t - a), al = a - ah;
+	t = split * b;
+	double bh = t - (t - b), bl = b - bh;
+	dd_t r = { p, ((ah * bh - p) + ah * bl + al * bh) + al * bl };
+	return r;
+}
+
+static inline dd_t dd_add(dd_t a, dd_t b)
+{
+	dd_t s = two_sum(a.hi, b.hi);
+	dd_t t = two_sum(a.lo, b.lo);
+	s.lo += t.hi;
+	s = quick_two_sum(s.hi, s.lo);
+	s.lo += t.lo;
+	return quick_two_sum(s.hi, s.lo);
+}
+
+static inline dd_t dd_sub(dd_t a, dd_t b)
+{
+	dd_t nb = { -b.hi, -b.lo };
+	return dd_add(a, nb);
+}
+
+static inline dd_t dd_add_d(dd_t a, double b)
+{
+	dd_t s = two_sum(a.hi, b);
+	s.lo += a.lo;
+	return quick_two_sum(s.hi, s.lo);
+}
+
+static inline dd_t dd_mul(dd_t a, dd_t b)
+{
+	dd_t p = two_prod(a.hi, b.hi);
+	p.lo += a.hi * b.lo + a.lo * b.hi;
+	return quick_two_sum(p.hi, p.lo);
+}
+
+static inline dd_t dd_mul_d(dd_t a, double b)
+{
+	dd_t p = two_prod(a.hi, b);
+	p.lo += a.lo * b;
+	return quick_two_sum(p.hi, p.lo);
+}
+
+static inline dd_t dd_sqr(dd_t a)
+{
+	dd_t p = two_prod(a.hi, a.hi);
+	p.lo += 2.0 * a.hi * a.lo;
+	return quick_two_sum(p.hi, p.lo);
+}
+
+static inline dd_t dd_div_d(dd_t a, double b)
+{
+	double q1 = a.hi / b;
+	// Остаток a - q1 * b вычисляется точно
+	dd_t p = two_prod(q1, b);
+	dd_t s = two_sum(a.hi, -p.hi);
+	s.lo -= p.lo;
+	s.lo += a.lo;
+	double q2 = (s.hi + s.lo) / b;
+	return quick_two_sum(q1, q2);
+}
+
+/**
+ * @brief Координата точки: lo + (hi - lo) * i / n в паре double
+ */
+static inline dd_t dd_coord(double lo, double hi, double i, double n)
+{
+	dd_t span = two_sum(hi, -lo);
+	return dd_add_d(dd_div_d(dd_mul_d(span, i), n), lo);
+}
+
+/**
+ * @brief Модуль числа
+ */
+static inline dd_t dd_abs(dd_t a)
+{
+	if (a.hi < 0.0) {
+		a.hi = -a.hi;
+		a.lo = -a.lo;
+	}
+	return a;
+}
+
+#endif // _DDOUBLE_H_
@@ -0,0 +1,799 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deflate.h"
+
+/*
+ * Сжатие DEFLATE: LZ77 с цепочками хешей (жадный поиск на уровнях 1-3,
+ * отложенный на 4-9, как в zlib) и блоки с кодами Хаффмана. Для каждого
+ * блока выбирается самое короткое из представлений: динамические коды,
+ * фиксированные коды или несжатые данные.
+ */
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define WINDOW_MASK (DEFLATE_WINDOW - 1)
+
+// Символов LZ77 в блоке (литералы и пары длина-расстояние)
+#define BLOCK_SYMBOLS (1 << 14)
+
+// Наибольший размер несжатого блока
+#define STORED_MAX 65535
+
+// Ссылки длины 3 дальше этого расстояния обычно длиннее литералов
+#define TOO_FAR 4096
+
+#define LITLEN_CODES 286
+#define DIST_CODES 30
+#define CODELEN_CODES 19
+#define MAX_BITS 15
+#define MAX_CODELEN_BITS 7
+
+/**
+ * @brief Параметры поиска совпадений уровня сжатия (таблица zlib)
+ */
+static const struct {
+	int good;   // После совпадения такой длины цепочка укорачивается в 4 раза
+	int lazy;   // Не искать лучшее совпадение после такого (жадно: не
+	            // вставлять хеши внутри совпадения длиннее этого)
+	int nice;   // Прекратить поиск на совпадении такой длины
+	int chain;  // Наибольшая длина просматриваемой цепочки
+} levels[DEFLATE_LEVEL_MAX + 1] = {
+	{ 0, 0, 0, 0 },
+	{ 4, 4, 8, 4 },
+	{ 4, 5, 16, 8 },
+	{ 4, 6, 32, 32 },
+	{ 4, 4, 16, 16 },
+	{ 8, 16, 32, 32 },
+	{ 8, 16, 128, 128 },
+	{ 8, 32, 128, 256 },
+	{ 32, 128, 258, 1024 },
+	{ 32, 258, 258, 4096 },
+};
+
+// Основания и дополнительные биты кодов длины 257..285
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// Основания и дополнительные биты кодов расстояния 0..29
+static const uint16_t dist_base[DIST_CODES] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+	16385, 24577
+};
+static const uint8_t dist_extra[DIST_CODES] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Порядок длин кодов алфавита длин в заголовке блока
+static const uint8_t codelen_order[CODELEN_CODES] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/**
+ * @brief Код Хаффмана: длины и коды (биты в порядке записи) символов
+ */
+struct huffman {
+	uint8_t lengths[LITLEN_CODES + 2];
+	uint16_t codes[LITLEN_CODES + 2];
+};
+
+/**
+ * @brief Состояние сжатия фрагмента
+ */
+struct deflate_state {
+	const uint8_t *data;        // Словарь и фрагмент
+	size_t end;                 // Конец фрагмента в data
+	int level;
+
+	uint8_t *out;               // Результат
+	size_t out_pos;
+	uint64_t bits;              // Еще не записанные биты
+	int bit_count;
+
+	size_t block_start;         // Первый байт текущего блока в data
+	size_t sym_count;           // Символов в блоке
+	uint16_t sym_len[BLOCK_SYMBOLS];    // Литерал или длина совпадения
+	uint16_t sym_dist[BLOCK_SYMBOLS];   // Расстояние (0 - литерал)
+	uint32_t litlen_freq[LITLEN_CODES];
+	uint32_t dist_freq[DIST_CODES];
+
+	uint8_t length_code[MAX_MATCH + 1]; // Номер кода длины (0..28)
+	uint8_t dist_code[512];             // См. dist_index
+
+	int32_t head[HASH_SIZE];            // Последняя позиция хеша (-1 - нет)
+	int32_t prev[DEFLATE_WINDOW];       // Предыдущая позиция того же хеша
+};
+
+/**
+ * @brief Номер кода расстояния: до 256 - по таблице, дальше - по
+ * старшим битам (коды выше 256 покрывают интервалы, кратные 128)
+ */
+static inline int dist_index(const struct deflate_state *s, unsigned int dist)
+{
+	return dist <= 256 ? s->dist_code[dist - 1]
+			   : s->dist_code[256 + ((dist - 1) >> 7)];
+}
+
+/**
+ * @brief Заполняет таблицы номеров кодов длины и расстояния
+ */
+static void init_tables(struct deflate_state *s)
+{
+	for (int code = 0; code < 29; code++) {
+		int end = code + 1 < 29 ? length_base[code + 1] : MAX_MATCH + 1;
+		for (int len = length_base[code]; len < end; len++)
+			s->length_code[len] = (uint8_t)code;
+	}
+
+	for (int code = 0; code < DIST_CODES; code++) {
+		unsigned int end = code + 1 < DIST_CODES ? dist_base[code + 1]
+							 : DEFLATE_WINDOW + 1;
+		for (unsigned int d = dist_base[code]; d < end; d++) {
+			if (d <= 256)
+				s->dist_code[d - 1] = (uint8_t)code;
+			else
+				s->dist_code[256 + ((d - 1) >> 7)] = (uint8_t)code;
+		}
+	}
+}
+
+/**
+ * @brief Добавляет count младших бит value (count <= 32)
+ */
+static inline void put_bits(struct deflate_state *s, uint32_t value, int count)
+{
+	s->bits |= (uint64_t)value << s->bit_count;
+	s->bit_count += count;
+	if (s->bit_count >= 32) {
+		uint8_t *p = s->out + s->out_pos;
+		p[0] = (uint8_t)s->bits;
+		p[1] = (uint8_t)(s->bits >> 8);
+		p[2] = (uint8_t)(s->bits >> 16);
+		p[3] = (uint8_t)(s->bits >> 24);
+		s->out_pos += 4;
+		s->bits >>= 32;
+		s->bit_count -= 32;
+	}
+}
+
+/**
+ * @brief Дополняет биты нулями до границы байта и записывает их
+ */
+static void align_bits(struct deflate_state *s)
+{
+	while (s->bit_count > 0) {
+		s->out[s->out_pos++] = (uint8_t)s->bits;
+		s->bits >>= 8;
+		s->bit_count = s->bit_count > 8 ? s->bit_count - 8 : 0;
+	}
+	s->bits = 0;
+}
+
+/**
+ * @brief Сравнение символов по частоте (затем по номеру) для сортировки
+ */
+static int compare_keys(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Строит длины кодов Хаффмана не длиннее limit бит
+ *
+ * Оптимальные длины получаются двумя очередями по отсортированным
+ * частотам, затем слишком длинные коды укорачиваются перераспределением
+ * количества кодов по длинам (как в miniz): неравенство Крафта
+ * восстанавливается удлинением более коротких кодов. Всегда строится
+ * не меньше двух кодов - некоторые декодеры не принимают один.
+ *
+ * @param freq Частоты символов
+ * @param n Количество символов алфавита (не меньше 2)
+ * @param limit Наибольшая длина кода
+ * @param lengths Длины кодов (0 - символ не используется)
+ */
+static void build_lengths(const uint32_t *freq, int n, int limit,
+			  uint8_t *lengths)
+{
+	uint64_t keys[LITLEN_CODES];
+	int count = 0;
+
+	memset(lengths, 0, (size_t)n);
+	for (int i = 0; i < n; i++)
+		if (freq[i] > 0)
+			keys[count++] = (uint64_t)freq[i] << 16 | (uint64_t)i;
+	if (count < 2) {
+		int used = count == 1 ? (int)(keys[0] & 0xFFFF) : 0;
+		lengths[used] = 1;
+		lengths[used == 0 ? 1 : 0] = 1;
+		return;
+	}
+	qsort(keys, (size_t)count, sizeof(keys[0]), compare_keys);
+
+	/* Узлы 0..count-1 - листья по возрастанию частот, далее внутренние
+	   узлы в порядке создания (их веса тоже не убывают) */
+	uint64_t weight[2 * LITLEN_CODES];
+	int parent[2 * LITLEN_CODES];
+	for (int i = 0; i < count; i++)
+		weight[i] = keys[i] >> 16;
+	int leaf = 0, inner = count, next = count;
+	while (next < 2 * count - 1) {
+		int pick[2];
+		for (int k = 0; k < 2; k++) {
+			if (leaf < count && (inner >= next || weight[leaf] <= weight[inner]))
+				pick[k] = leaf++;
+			else
+				pick[k] = inner++;
+		}
+		weight[next] = weight[pick[0]] + weight[pick[1]];
+		parent[pick[0]] = parent[pick[1]] = next;
+		next++;
+	}
+
+	// Глубины: родитель всегда создан позже потомка
+	int depth[2 * LITLEN_CODES];
+	int root = 2 * count - 2;
+	depth[root] = 0;
+	int lengths_count[2 * LITLEN_CODES] = { 0 };
+	for (int i = root - 1; i >= 0; i--) {
+		depth[i] = depth[parent[i]] + 1;
+		if (i < count)
+			lengths_count[depth[i] < limit ? depth[i] : limit]++;
+	}
+
+	uint32_t total = 0;
+	for (int len = 1; len <= limit; len++)
+		total += (uint32_t)lengths_count[len] << (limit - len);
+	while (total != 1u << limit) {
+		lengths_count[limit]--;
+		for (int len = limit - 1; len > 0; len--)
+			if (lengths_count[len] > 0) {
+				lengths_count[len]--;
+				lengths_count[len + 1] += 2;
+				break;
+			}
+		total--;
+	}
+
+	// Самые частые символы получают самые короткие коды
+	int pos = count - 1;
+	for (int len = 1; len <= limit; len++)
+		for (int k = 0; k < lengths_count[len]; k++)
+			lengths[keys[pos--] & 0xFFFF] = (uint8_t)len;
+}
+
+/**
+ * @brief Строит канонические коды по длинам (биты в порядке записи)
+ */
+static void build_codes(struct huffman *h, int n)
+{
+	int bl_count[MAX_BITS + 1] = { 0 };
+	uint16_t next_code[MAX_BITS + 1];
+
+	for (int i = 0; i < n; i++)
+		bl_count[h->lengths[i]]++;
+	bl_count[0] = 0;
+	unsigned int code = 0;
+	for (int bits = 1; bits <= MAX_BITS; bits++) {
+		code = (code + (unsigned int)bl_count[bits - 1]) << 1;
+		next_code[bits] = (uint16_t)code;
+	}
+	for (int i = 0; i < n; i++) {
+		int len = h->lengths[i];
+		if (len == 0)
+			continue;
+		// DEFLATE записывает коды Хаффмана старшим битом вперед
+		unsigned int c = next_code[len]++, r = 0;
+		for (int b = 0; b < len; b++, c >>= 1)
+			r = (r << 1) | (c & 1);
+		h->codes[i] = (uint16_t)r;
+	}
+}
+
+/**
+ * @brief Фиксированные коды DEFLATE
+ */
+static void fixed_codes(struct huffman *litlen, struct huffman *dist)
+{
+	for (int i = 0; i < LITLEN_CODES + 2; i++)
+		litlen->lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+	build_codes(litlen, LITLEN_CODES + 2);
+	for (int i = 0; i < DIST_CODES; i++)
+		dist->lengths[i] = 5;
+	build_codes(dist, DIST_CODES);
+}
+
+/**
+ * @brief Кодирует длины кодов серийными символами 16, 17, 18
+ *
+ * @param lens Длины кодов литералов/длин и расстояний подряд
+ * @param n Их количество
+ * @param syms Символы алфавита длин
+ * @param extra Значения дополнительных бит символов
+ * @returns количество символов
+ */
+static int encode_lengths(const uint8_t *lens, int n, uint8_t *syms,
+			  uint8_t *extra)
+{
+	int count = 0;
+	for (int i = 0; i < n;) {
+		int cur = lens[i];
+		int run = 1;
+		while (i + run < n && lens[i + run] == cur)
+			run++;
+		i += run;
+
+		if (cur == 0) {
+			while (run >= 11) {
+				int r = run < 138 ? run : 138;
+				syms[count] = 18;
+				extra[count++] = (uint8_t)(r - 11);
+				run -= r;
+			}
+			if (run >= 3) {
+				syms[count] = 17;
+				extra[count++] = (uint8_t)(run - 3);
+				run = 0;
+			}
+		} else {
+			// Первое значение записывается явно, повторы - символом 16
+			syms[count] = (uint8_t)cur;
+			extra[count++] = 0;
+			run--;
+			while (run >= 3) {
+				int r = run < 6 ? run : 6;
+				syms[count] = 16;
+				extra[count++] = (uint8_t)(r - 3);
+				run -= r;
+			}
+		}
+		for (; run > 0; run--) {
+			syms[count] = (uint8_t)cur;
+			extra[count++] = 0;
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Размер данных блока в битах при заданных кодах (без заголовка)
+ */
+static uint64_t block_bits(const struct deflate_state *s,
+			   const struct huffman *litlen,
+			   const struct huffman *dist)
+{
+	uint64_t bits = 0;
+	for (int i = 0; i < LITLEN_CODES; i++)
+		if (s->litlen_freq[i] > 0) {
+			uint64_t len = litlen->lengths[i];
+			if (i > 256)
+				len += length_extra[i - 257];
+			bits += s->litlen_freq[i] * len;
+		}
+	for (int i = 0; i < DIST_CODES; i++)
+		if (s->dist_freq[i] > 0)
+			bits += s->dist_freq[i] *
+				(uint64_t)(dist->lengths[i] + dist_extra[i]);
+	return bits;
+}
+
+/**
+ * @brief Записывает символы блока и код конца блока
+ */
+static void write_symbols(struct deflate_state *s, const struct huffman *litlen,
+			  const struct huffman *dist)
+{
+	for (size_t i = 0; i < s->sym_count; i++) {
+		unsigned int len = s->sym_len[i];
+		unsigned int d = s->sym_dist[i];
+		if (d == 0) {
+			put_bits(s, litlen->codes[len], litlen->lengths[len]);
+			continue;
+		}
+		int lc = s->length_code[len];
+		put_bits(s, litlen->codes[257 + lc], litlen->lengths[257 + lc]);
+		put_bits(s, len - length_base[lc], length_extra[lc]);
+		int dc = dist_index(s, d);
+		put_bits(s, dist->codes[dc], dist->lengths[dc]);
+		put_bits(s, d - dist_base[dc], dist_extra[dc]);
+	}
+	put_bits(s, litlen->codes[256], litlen->lengths[256]);
+}
+
+/**
+ * @brief Записывает данные [begin, end) несжатыми блоками
+ */
+static void write_stored(struct deflate_state *s, size_t begin, size_t end,
+			 bool last)
+{
+	do {
+		size_t n = end - begin < STORED_MAX ? end - begin : STORED_MAX;
+		put_bits(s, last && begin + n == end, 1);
+		put_bits(s, 0, 2);
+		align_bits(s);
+		uint8_t *p = s->out + s->out_pos;
+		p[0] = (uint8_t)n;
+		p[1] = (uint8_t)(n >> 8);
+		p[2] = (uint8_t)~n;
+		p[3] = (uint8_t)(~n >> 8);
+		memcpy(p + 4, s->data + begin, n);
+		s->out_pos += 4 + n;
+		begin += n;
+	} while (begin < end);
+}
+
+/**
+ * @brief Завершает блок, выбирая самое короткое представление
+ *
+ * @param end Конец данных блока в data
+ * @param last Последний блок потока
+ */
+static void flush_block(struct deflate_state *s, size_t end, bool last)
+{
+	struct huffman litlen, dist, codelen;
+
+	s->litlen_freq[256]++;
+	build_lengths(s->litlen_freq, LITLEN_CODES, MAX_BITS, litlen.lengths);
+	build_lengths(s->dist_freq, DIST_CODES, MAX_BITS, dist.lengths);
+
+	// Заголовок динамического блока
+	int hlit = LITLEN_CODES, hdist = DIST_CODES;
+	while (hlit > 257 && litlen.lengths[hlit - 1] == 0)
+		hlit--;
+	while (hdist > 1 && dist.lengths[hdist - 1] == 0)
+		hdist--;
+	uint8_t lens[LITLEN_CODES + DIST_CODES];
+	memcpy(lens, litlen.lengths, (size_t)hlit);
+	memcpy(lens + hlit, dist.lengths, (size_t)hdist);
+	uint8_t syms[LITLEN_CODES + DIST_CODES], extra[LITLEN_CODES + DIST_CODES];
+	int nsyms = encode_lengths(lens, hlit + hdist, syms, extra);
+	uint32_t codelen_freq[CODELEN_CODES] = { 0 };
+	for (int i = 0; i < nsyms; i++)
+		codelen_freq[syms[i]]++;
+	build_lengths(codelen_freq, CODELEN_CODES, MAX_CODELEN_BITS,
+		      codelen.lengths);
+	int hclen = CODELEN_CODES;
+	while (hclen > 4 && codelen.lengths[codelen_order[hclen - 1]] == 0)
+		hclen--;
+
+	uint64_t dynamic = 3 + 5 + 5 + 4 + 3 * (uint64_t)hclen +
+		block_bits(s, &litlen, &dist);
+	for (int i = 0; i < nsyms; i++)
+		dynamic += codelen.lengths[syms[i]] +
+			(syms[i] == 16 ? 2 : syms[i] == 17 ? 3 : syms[i] == 18 ? 7 : 0);
+
+	struct huffman fixed_litlen, fixed_dist;
+	fixed_codes(&fixed_litlen, &fixed_dist);
+	uint64_t fixed = 3 + block_bits(s, &fixed_litlen, &fixed_dist);
+
+	// Несжатые блоки: заголовок, выравнивание, LEN и NLEN, данные
+	size_t raw = end - s->block_start;
+	uint64_t chunks = raw == 0 ? 1 : (raw + STORED_MAX - 1) / STORED_MAX;
+	uint64_t stored = 3 + (8 - (uint64_t)(s->bit_count + 3) % 8) % 8 + 32 +
+		(chunks - 1) * 40 + 8 * (uint64_t)raw;
+
+	if (stored <= dynamic && stored <= fixed) {
+		write_stored(s, s->block_start, end, last);
+	} else if (fixed <= dynamic) {
+		put_bits(s, last, 1);
+		put_bits(s, 1, 2);
+		write_symbols(s, &fixed_litlen, &fixed_dist);
+	} else {
+		build_codes(&litlen, LITLEN_CODES);
+		build_codes(&dist, DIST_CODES);
+		build_codes(&codelen, CODELEN_CODES);
+		put_bits(s, last, 1);
+		put_bits(s, 2, 2);
+		put_bits(s, (uint32_t)(hlit - 257), 5);
+		put_bits(s, (uint32_t)(hdist - 1), 5);
+		put_bits(s, (uint32_t)(hclen - 4), 4);
+		for (int i = 0; i < hclen; i++)
+			put_bits(s, codelen.lengths[codelen_order[i]], 3);
+		for (int i = 0; i < nsyms; i++) {
+			put_bits(s, codelen.codes[syms[i]], codelen.lengths[syms[i]]);
+			if (syms[i] >= 16)
+				put_bits(s, extra[i], syms[i] == 16 ? 2 : syms[i] == 17 ? 3 : 7);
+		}
+		write_symbols(s, &litlen, &dist);
+	}
+
+	memset(s->litlen_freq, 0, sizeof(s->litlen_freq));
+	memset(s->dist_freq, 0, sizeof(s->dist_freq));
+	s->sym_count = 0;
+	s->block_start = end;
+}
+
+/**
+ * @brief Добавляет литерал; при заполнении буфера символов завершает блок
+ *
+ * @param pos Позиция за последним байтом, покрытым символами блока
+ */
+static inline void emit_literal(struct deflate_state *s, uint8_t c, size_t pos)
+{
+	s->sym_len[s->sym_count] = c;
+	s->sym_dist[s->sym_count++] = 0;
+	s->litlen_freq[c]++;
+	if (s->sym_count == BLOCK_SYMBOLS)
+		flush_block(s, pos, false);
+}
+
+/**
+ * @brief Добавляет ссылку; при заполнении буфера символов завершает блок
+ * @see emit_literal
+ */
+static inline void emit_match(struct deflate_state *s, unsigned int len,
+			      unsigned int dist, size_t pos)
+{
+	s->sym_len[s->sym_count] = (uint16_t)len;
+	s->sym_dist[s->sym_count++] = (uint16_t)dist;
+	s->litlen_freq[257 + s->length_code[len]]++;
+	s->dist_freq[dist_index(s, dist)]++;
+	if (s->sym_count == BLOCK_SYMBOLS)
+		flush_block(s, pos, false);
+}
+
+/**
+ * @brief Хеш трех байт, начиная с позиции pos
+ */
+static inline unsigned int hash3(const uint8_t *p)
+{
+	return ((unsigned int)p[0] << 10 ^ (unsigned int)p[1] << 5 ^ p[2]) &
+		(HASH_SIZE - 1);
+}
+
+/**
+ * @brief Вставляет позицию в цепочку своего хеша
+ * @returns предыдущая позиция с тем же хешем (или -1)
+ */
+static inline int32_t insert(struct deflate_state *s, size_t pos)
+{
+	unsigned int h = hash3(s->data + pos);
+	int32_t candidate = s->head[h];
+	s->prev[pos & WINDOW_MASK] = candidate;
+	s->head[h] = (int32_t)pos;
+	return candidate;
+}
+
+/**
+ * @brief Ищет самое длинное совпадение для позиции pos
+ *
+ * @param candidate Первая позиция цепочки
+ * @param best Длина, которую нужно превзойти
+ * @param chain Наибольшее количество просматриваемых позиций
+ * @param dist Расстояние найденного совпадения
+ * @returns длина совпадения (best, если лучшего нет)
+ */
+static unsigned int longest_match(const struct deflate_state *s, size_t pos,
+				  int32_t candidate, unsigned int best,
+				  int chain, unsigned int *dist)
+{
+	const uint8_t *data = s->data;
+	size_t limit = pos > DEFLATE_WINDOW ? pos - DEFLATE_WINDOW : 0;
+	size_t avail = s->end - pos;
+	unsigned int max_len = avail < MAX_MATCH ? (unsigned int)avail : MAX_MATCH;
+	unsigned int nice = (unsigned int)levels[s->level].nice;
+	if (nice > max_len)
+		nice = max_len;
+	if (best >= max_len)
+		return best;
+
+	const uint8_t *scan = data + pos;
+	for (; candidate >= 0 && (size_t)candidate >= limit && chain-- > 0;
+	     candidate = s->prev[candidate & WINDOW_MASK]) {
+		const uint8_t *match = data + candidate;
+		// Сначала байт, которым совпадение должно превзойти лучшее
+		if (match[best] != scan[best] || match[0] != scan[0] ||
+		    match[1] != scan[1])
+			continue;
+		unsigned int len = 2;
+		while (len < max_len && match[len] == scan[len])
+			len++;
+		if (len > best) {
+			best = len;
+			*dist = (unsigned int)(pos - (size_t)candidate);
+			if (len >= nice)
+				break;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief Жадное сжатие (уровни 1-3): совпадение принимается сразу
+ */
+static void compress_greedy(struct deflate_state *s, size_t pos)
+{
+	int chain = levels[s->level].chain;
+	unsigned int max_insert = (unsigned int)levels[s->level].lazy;
+
+	while (pos < s->end) {
+		unsigned int len = 0, dist = 0;
+		if (s->end - pos >= MIN_MATCH) {
+			int32_t candidate = insert(s, pos);
+			len = longest_match(s, pos, candidate, MIN_MATCH - 1,
+					    chain, &dist);
+			if (len == MIN_MATCH && dist > TOO_FAR)
+				len = 0;
+		}
+		if (len < MIN_MATCH) {
+			emit_literal(s, s->data[pos], pos + 1);
+			pos++;
+			continue;
+		}
+		emit_match(s, len, dist, pos + len);
+		// Внутри длинных совпадений хеши не вставляются ради скорости
+		if (len <= max_insert)
+			for (size_t i = pos + 1; i < pos + len && s->end - i >= MIN_MATCH; i++)
+				insert(s, i);
+		pos += len;
+	}
+}
+
+/**
+ * @brief Сжатие с отложенным выбором (уровни 4-9): совпадение принимается,
+ * только если со следующей позиции не начинается более длинное
+ */
+static void compress_lazy(struct deflate_state *s, size_t pos)
+{
+	int chain = levels[s->level].chain;
+	unsigned int good = (unsigned int)levels[s->level].good;
+	unsigned int max_lazy = (unsigned int)levels[s->level].lazy;
+	unsigned int prev_len = 0, prev_dist = 0;
+	bool pending = false;   // Литерал data[pos - 1] еще не записан
+
+	while (pos < s->end) {
+		unsigned int len = 0, dist = 0;
+		if (s->end - pos >= MIN_MATCH) {
+			int32_t candidate = insert(s, pos);
+			if (prev_len < max_lazy) {
+				int c = prev_len >= good ? chain >> 2 : chain;
+				len = longest_match(s, pos, candidate,
+						    prev_len >= MIN_MATCH ? prev_len : MIN_MATCH - 1,
+						    c, &dist);
+				if (len == MIN_MATCH && dist > TOO_FAR)
+					len = 0;
+				if (len <= prev_len)
+					len = 0;
+			}
+		}
+
+		if (pending && prev_len >= MIN_MATCH && len == 0) {
+			// Совпадение с предыдущей позиции не улучшено
+			size_t start = pos - 1;
+			emit_match(s, prev_len, prev_dist, start + prev_len);
+			for (size_t i = pos + 1; i < start + prev_len &&
+			     s->end - i >= MIN_MATCH; i++)
+				insert(s, i);
+			pos = start + prev_len;
+			prev_len = 0;
+			pending = false;
+			continue;
+		}
+		if (pending)
+			emit_literal(s, s->data[pos - 1], pos);
+		prev_len = len;
+		prev_dist = dist;
+		pending = true;
+		pos++;
+	}
+	if (pending) {
+		if (prev_len >= MIN_MATCH)
+			emit_match(s, prev_len, prev_dist, pos - 1 + prev_len);
+		else
+			emit_literal(s, s->data[pos - 1], pos);
+	}
+}
+
+size_t deflate_bound(size_t size)
+{
+	/* Худший случай - несжатые блоки: до 6 байт заголовка на каждые
+	   STORED_MAX байт и на каждый блок из BLOCK_SYMBOLS символов */
+	return size + 6 * (size / STORED_MAX + size / BLOCK_SYMBOLS + 2) + 16;
+}
+
+int deflate_compress(const uint8_t *data, size_t dict_size, size_t size,
+		     int level, bool last, uint8_t *out, size_t *out_size)
+{
+	assert(data != NULL || dict_size + size == 0);
+	assert(out != NULL && out_size != NULL);
+	assert(level >= 0 && level <= DEFLATE_LEVEL_MAX);
+	assert(dict_size + size <= INT32_MAX);
+
+	struct deflate_state *s = malloc(sizeof(struct deflate_state));
+	if (s == NULL)
+		return -1;
+	s->data = data;
+	s->end = dict_size + size;
+	s->level = level;
+	s->out = out;
+	s->out_pos = 0;
+	s->bits = 0;
+	s->bit_count = 0;
+	s->block_start = dict_size;
+	s->sym_count = 0;
+	memset(s->litlen_freq, 0, sizeof(s->litlen_freq));
+	memset(s->dist_freq, 0, sizeof(s->dist_freq));
+
+	if (level == 0) {
+		write_stored(s, dict_size, s->end, last);
+	} else {
+		init_tables(s);
+		memset(s->head, 0xFF, sizeof(s->head));
+		// Последние DEFLATE_WINDOW байт словаря доступны для ссылок
+		size_t from = dict_size > DEFLATE_WINDOW ? dict_size - DEFLATE_WINDOW : 0;
+		for (size_t i = from; i + MIN_MATCH <= dict_size; i++)
+			insert(s, i);
+		if (level <= 3)
+			compress_greedy(s, dict_size);
+		else
+			compress_lazy(s, dict_size);
+		flush_block(s, s->end, last);
+	}
+
+	if (!last) {
+		// Пустой несжатый блок выравнивает фрагмент на границу байта
+		put_bits(s, 0, 3);
+		align_bits(s);
+		static const uint8_t sync[4] = { 0x00, 0x00, 0xFF, 0xFF };
+		memcpy(s->out + s->out_pos, sync, sizeof(sync));
+		s->out_pos += sizeof(sync);
+	} else {
+		align_bits(s);
+	}
+
+	*out_size = s->out_pos;
+	assert(s->out_pos <= deflate_bound(size));
+	free(s);
+	return 0;
+}
+
+// Модуль сумм Adler-32 и наибольший блок без переполнения 32 бит
+#define ADLER_BASE 65521u
+#define ADLER_NMAX 5552
+
+uint32_t deflate_adler32(uint32_t adler, const uint8_t *data, size_t size)
+{
+	uint32_t a = adler & 0xFFFF, b = adler >> 16;
+	while (size > 0) {
+		size_t n = size < ADLER_NMAX ? size : ADLER_NMAX;
+		size -= n;
+		while (n-- > 0) {
+			a += *data++;
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return b << 16 | a;
+}
+
+uint32_t deflate_adler32_combine(uint32_t adler1, uint32_t adler2,
+				 size_t size2)
+{
+	// Как adler32_combine в zlib: b второй части сдвигается на a1 * size2
+	uint32_t rem = (uint32_t)(size2 % ADLER_BASE);
+	uint32_t a = adler1 & 0xFFFF;
+	uint32_t b = (uint32_t)(((uint64_t)rem * a) % ADLER_BASE);
+	a += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+	b += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+	if (a >= ADLER_BASE)
+		a -= ADLER_BASE;
+	if (a >= ADLER_BASE)
+		a -= ADLER_BASE;
+	if (b >= ADLER_BASE * 2)
+		b -= ADLER_BASE * 2;
+	if (b >= ADLER_BASE)
+		b -= ADLER_BASE;
+	return b << 16 | a;
+}
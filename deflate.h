@@ -0,0 +1,68 @@
+#ifndef _DEFLATE_H_
+#define _DEFLATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Размер окна LZ77 (наибольшее расстояние ссылки) в байтах
+ */
+#define DEFLATE_WINDOW 32768
+
+/**
+ * @brief Наибольший уровень сжатия (0 - без сжатия, 9 - наилучшее)
+ */
+#define DEFLATE_LEVEL_MAX 9
+
+/**
+ * @brief Возвращает размер буфера, достаточный для сжатого фрагмента
+ *
+ * @param size Размер сжимаемых данных
+ * @returns наибольший размер результата deflate_compress
+ */
+size_t deflate_bound(size_t size);
+
+/**
+ * @brief Сжимает фрагмент потока DEFLATE (RFC 1951)
+ *
+ * Фрагменты сжимаются независимо и склеиваются в один поток, как в pigz:
+ * каждый, кроме последнего, завершается пустым несжатым блоком и
+ * выравнивается на границу байта, а последний содержит блок с признаком
+ * конца потока. Ссылки могут указывать в словарь - до DEFLATE_WINDOW
+ * байт, предшествующих фрагменту в потоке, - поэтому склейка почти не
+ * ухудшает сжатие.
+ *
+ * @param data Словарь (dict_size байт), за которым следует фрагмент
+ * @param dict_size Размер словаря
+ * @param size Размер фрагмента
+ * @param level Уровень сжатия (0..DEFLATE_LEVEL_MAX)
+ * @param last Последний фрагмент потока
+ * @param out Буфер результата размером не меньше deflate_bound(size)
+ * @param out_size Размер результата
+ * @returns 0 при успехе, -1 при нехватке памяти
+ */
+int deflate_compress(const uint8_t *data, size_t dict_size, size_t size,
+		     int level, bool last, uint8_t *out, size_t *out_size);
+
+/**
+ * @brief Продолжает контрольную сумму Adler-32 (RFC 1950)
+ *
+ * @param adler Сумма предыдущих данных (1 - для пустых)
+ * @param data,size Данные
+ * @returns сумма с учетом данных
+ */
+uint32_t deflate_adler32(uint32_t adler, const uint8_t *data, size_t size);
+
+/**
+ * @brief Объединяет суммы Adler-32 двух соседних частей данных
+ *
+ * @param adler1 Сумма первой части
+ * @param adler2 Сумма второй части
+ * @param size2 Размер второй части
+ * @returns сумма склейки частей
+ */
+uint32_t deflate_adler32_combine(uint32_t adler1, uint32_t adler2,
+				 size_t size2);
+
+#endif // _DEFLATE_H_
@@ -0,0 +1,1048 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#define DISTRIB_HAVE_SOCKETS 1
+#endif
+
+#if defined(DISTRIB_HAVE_SOCKETS) && defined(FRACTAL_USE_PTHREADS)
+#include <pthread.h>
+#endif
+
+#include "distrib.h"
+#include "escape.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * @brief Наибольшая длина строки протокола
+ */
+#define DISTRIB_LINE_MAX 512
+
+/**
+ * @brief Наибольшая сторона тайла, принимаемая рабочим
+ */
+#define DISTRIB_TILE_MAX 4096
+
+/**
+ * @brief Запрос тайла
+ */
+struct distrib_request {
+	unsigned long id;               // Номер тайла
+	pixel_coord width, height;      // Размеры тайла
+	pixel_coord x0, y0;             // Левый верхний пиксель тайла в изображении
+	pixel_coord view_width, view_height; // Размеры изображения
+	fractal_formula_t formula;      // Итерируемая функция
+	double x_min, x_max, y_min, y_max; // Область изображения
+	int max_iter;                   // Максимальное количество итераций
+	fractal_options_t options;      // Параметры рендеринга
+};
+
+void distrib_options_init(distrib_options_t *d)
+{
+	assert(d != NULL);
+	d->workers = 0;
+	d->worker_command = NULL;
+	d->hosts = NULL;
+	d->tile_size = DISTRIB_TILE_SIZE;
+	d->timeout_ms = DISTRIB_TIMEOUT_MS;
+}
+
+#ifdef DISTRIB_HAVE_SOCKETS
+
+/**
+ * @brief Формирует строку запроса тайла
+ * @returns длина строки или -1, если она не поместилась
+ */
+static int format_request(const struct distrib_request *q, char *line,
+			  size_t size)
+{
+	const fractal_options_t *o = &q->options;
+	int n = snprintf(line, size,
+			 "tile %lu %u %u %u %u %u %u %d %d %d %a %a %a %a %a %a "
+			 "%d %d %d %d %d %d %d %d %d\n",
+			 q->id, q->width, q->height, q->x0, q->y0,
+			 q->view_width, q->view_height, (int)q->formula.kind,
+			 q->formula.power, (int)q->formula.julia,
+			 q->formula.c_real, q->formula.c_imag, q->x_min,
+			 q->x_max, q->y_min, q->y_max, q->max_iter, o->threads,
+			 (int)o->simd, (int)o->precision, (int)o->interior_check,
+			 (int)o->periodicity, (int)o->strategy, o->antialias,
+			 (int)o->antialias_jitter);
+	return n < 0 || (size_t)n >= size ? -1 : n;
+}
+
+/**
+ * @brief Разбирает строку запроса тайла (без перевода строки)
+ * @returns 0 при успехе, -1 при ошибке (q->id заполнен, если номер прочитан)
+ */
+static int parse_request(const char *line, struct distrib_request *q)
+{
+	int kind, power, julia, threads, simd, precision, interior, periodicity;
+	int strategy, antialias, jitter;
+	int end = 0;
+	q->id = 0;
+	if (sscanf(line, "tile %lu %u %u %u %u %u %u %d %d %d %lf %lf %lf %lf "
+		   "%lf %lf %d %d %d %d %d %d %d %d %d%n",
+		   &q->id, &q->width, &q->height, &q->x0, &q->y0,
+		   &q->view_width, &q->view_height, &kind, &power, &julia,
+		   &q->formula.c_real, &q->formula.c_imag, &q->x_min,
+		   &q->x_max, &q->y_min, &q->y_max, &q->max_iter, &threads,
+		   &simd, &precision, &interior, &periodicity, &strategy,
+		   &antialias, &jitter, &end) < 25 || line[end] != '\0')
+		return -1;
+	if (q->width < 1 || q->width > DISTRIB_TILE_MAX || q->height < 1 ||
+	    q->height > DISTRIB_TILE_MAX || q->view_width < q->width ||
+	    q->view_height < q->height || q->x0 > q->view_width - q->width ||
+	    q->y0 > q->view_height - q->height || !(q->x_max > q->x_min) ||
+	    !(q->y_max > q->y_min) || q->max_iter < 1 ||
+	    kind < FRACTAL_FORMULA_POWER || kind > FRACTAL_FORMULA_TRICORN ||
+	    power < 0 || power > FRACTAL_POWER_MAX || threads < 0 ||
+	    simd < FRACTAL_SIMD_AUTO || simd > FRACTAL_SIMD_AVX512 ||
+	    precision < FRACTAL_PRECISION_AUTO ||
+	    precision > FRACTAL_PRECISION_DOUBLE_DOUBLE ||
+	    strategy < FRACTAL_STRATEGY_BRUTE ||
+	    strategy > FRACTAL_STRATEGY_PROGRESSIVE ||
+	    antialias < 0 || antialias > ESCAPE_AA_MAX)
+		return -1;
+
+	q->formula.kind = (fractal_formula_kind_t)kind;
+	q->formula.power = power;
+	q->formula.julia = julia != 0;
+	fractal_options_init(&q->options);
+	q->options.threads = threads;
+	q->options.simd = (fractal_simd_t)simd;
+	q->options.precision = (fractal_precision_t)precision;
+	q->options.interior_check = interior != 0;
+	q->options.periodicity = periodicity != 0;
+	q->options.strategy = (fractal_strategy_t)strategy;
+	q->options.antialias = antialias;
+	q->options.antialias_jitter = jitter != 0;
+	return 0;
+}
+
+/**
+ * @brief Рендерит тайл запроса как часть всего изображения
+ */
+static void render_request(image_p tile, const struct distrib_request *q)
+{
+	formula_fractal_window(tile, &q->formula, q->view_width,
+			       q->view_height, q->x0, q->y0, q->x_min,
+			       q->x_max, q->y_min, q->y_max, q->max_iter,
+			       &q->options);
+}
+
+/**
+ * @brief Записывает все байты в сокет или канал
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int write_all(int fd, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	while (size > 0) {
+		ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == ENOTSOCK)
+			n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= (size_t)n;
+	}
+	return 0;
+}
+
+/**
+ * @brief Буферизованное чтение строк из дескриптора
+ */
+struct line_reader {
+	int fd;                         // Дескриптор
+	size_t used;                    // Байт в буфере
+	char data[DISTRIB_LINE_MAX];    // Буфер
+};
+
+/**
+ * @brief Читает строку без перевода строки
+ * @returns 1 - строка прочитана, 0 - конец потока, -1 - ошибка или
+ * слишком длинная строка
+ */
+static int read_line(struct line_reader *r, char *line, size_t size)
+{
+	for (;;) {
+		char *nl = memchr(r->data, '\n', r->used);
+		if (nl != NULL) {
+			size_t len = (size_t)(nl - r->data);
+			if (len >= size)
+				return -1;
+			memcpy(line, r->data, len);
+			line[len] = '\0';
+			r->used -= len + 1;
+			memmove(r->data, nl + 1, r->used);
+			return 1;
+		}
+		if (r->used == sizeof(r->data))
+			return -1;
+		ssize_t n = read(r->fd, r->data + r->used, sizeof(r->data) - r->used);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -1;
+		if (n == 0)
+			return 0;
+		r->used += (size_t)n;
+	}
+}
+
+/**
+ * @brief Сообщения "busy ID" координатору, пока рабочий рендерит тайл
+ *
+ * Без pthreads строка отправляется только в начале тайла.
+ */
+struct heartbeat {
+	int fd;                         // Дескриптор ответов
+	unsigned long id;               // Рендерируемый тайл
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_t lock;           // Защищает поля и запись в fd
+	pthread_cond_t changed;         // Начало или конец тайла, остановка
+	pthread_t thread;               // Поток сообщений
+	bool running;                   // Поток запущен
+	bool busy;                      // Тайл рендерится
+	bool stop;                      // Поток должен завершиться
+#endif
+};
+
+// Отправляет строку "busy ID" (ошибку записи обнаружит ответ на тайл)
+static void heartbeat_send(struct heartbeat *h)
+{
+	char line[32];
+	int n = snprintf(line, sizeof(line), "busy %lu\n", h->id);
+	write_all(h->fd, line, (size_t)n);
+}
+
+#ifdef FRACTAL_USE_PTHREADS
+static void *heartbeat_main(void *arg)
+{
+	struct heartbeat *h = arg;
+	pthread_mutex_lock(&h->lock);
+	while (!h->stop) {
+		if (!h->busy) {
+			pthread_cond_wait(&h->changed, &h->lock);
+			continue;
+		}
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += DISTRIB_HEARTBEAT_MS * 1000000L;
+		ts.tv_sec += ts.tv_nsec / 1000000000L;
+		ts.tv_nsec %= 1000000000L;
+		if (pthread_cond_timedwait(&h->changed, &h->lock, &ts) == ETIMEDOUT &&
+		    h->busy && !h->stop)
+			heartbeat_send(h);
+	}
+	pthread_mutex_unlock(&h->lock);
+	return NULL;
+}
+#endif
+
+// Запускает поток сообщений (если не удалось - только строка в начале тайла)
+static void heartbeat_init(struct heartbeat *h, int fd)
+{
+	h->fd = fd;
+	h->id = 0;
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_init(&h->lock, NULL);
+	pthread_cond_init(&h->changed, NULL);
+	h->busy = false;
+	h->stop = false;
+	h->running = pthread_create(&h->thread, NULL, heartbeat_main, h) == 0;
+#endif
+}
+
+// Начало рендеринга тайла id
+static void heartbeat_begin(struct heartbeat *h, unsigned long id)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_lock(&h->lock);
+	h->id = id;
+	h->busy = true;
+	heartbeat_send(h);
+	pthread_cond_signal(&h->changed);
+	pthread_mutex_unlock(&h->lock);
+#else
+	h->id = id;
+	heartbeat_send(h);
+#endif
+}
+
+// Конец рендеринга: после возврата можно писать ответ
+static void heartbeat_end(struct heartbeat *h)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_lock(&h->lock);
+	h->busy = false;
+	pthread_mutex_unlock(&h->lock);
+#else
+	(void)h;
+#endif
+}
+
+static void heartbeat_free(struct heartbeat *h)
+{
+#ifdef FRACTAL_USE_PTHREADS
+	pthread_mutex_lock(&h->lock);
+	h->stop = true;
+	pthread_cond_signal(&h->changed);
+	pthread_mutex_unlock(&h->lock);
+	if (h->running)
+		pthread_join(h->thread, NULL);
+	pthread_cond_destroy(&h->changed);
+	pthread_mutex_destroy(&h->lock);
+#else
+	(void)h;
+#endif
+}
+
+int distrib_worker_serve(int in_fd, int out_fd, int threads)
+{
+	struct line_reader reader = { .fd = in_fd, .used = 0 };
+	char line[DISTRIB_LINE_MAX];
+	image_p tile = NULL;
+	pixel_coord tile_w = 0, tile_h = 0;
+	struct heartbeat heartbeat;
+	int result;
+
+	heartbeat_init(&heartbeat, out_fd);
+	while ((result = read_line(&reader, line, sizeof(line))) > 0) {
+		struct distrib_request q;
+		char header[64];
+		if (parse_request(line, &q) != 0) {
+			int n = snprintf(header, sizeof(header), "error %lu\n", q.id);
+			if (write_all(out_fd, header, (size_t)n) != 0) {
+				result = -1;
+				break;
+			}
+			continue;
+		}
+		if (threads > 0)
+			q.options.threads = threads;
+
+		// Изображение переиспользуется, пока размер тайла не меняется
+		if (tile == NULL || tile_w != q.width || tile_h != q.height) {
+			free_image(tile);
+			tile = create_image(q.width, q.height);
+			tile_w = q.width;
+			tile_h = q.height;
+		}
+		heartbeat_begin(&heartbeat, q.id);
+		render_request(tile, &q);
+		heartbeat_end(&heartbeat);
+
+		int n = snprintf(header, sizeof(header), "done %lu %u %u\n", q.id,
+				 q.width, q.height);
+		if (write_all(out_fd, header, (size_t)n) != 0 ||
+		    write_all(out_fd, image_row(tile, 0),
+			      (size_t)q.width * q.height) != 0) {
+			result = -1;
+			break;
+		}
+	}
+	heartbeat_free(&heartbeat);
+	free_image(tile);
+	return result < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Отключает алгоритм Нейгла: строка запроса и заголовок ответа
+ * короткие, и без этого каждый тайл ждал бы отложенного подтверждения
+ */
+static void set_nodelay(int fd)
+{
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+int distrib_worker_listen(int port, int threads)
+{
+	int fd = socket(AF_INET6, SOCK_STREAM, 0);
+	bool v6 = fd >= 0;
+	if (!v6)
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	int bound;
+	if (v6) {
+		// Двойной стек: принимаются и соединения IPv4
+		int off = 0;
+		setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+		struct sockaddr_in6 addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin6_family = AF_INET6;
+		addr.sin6_addr = in6addr_any;
+		addr.sin6_port = htons((uint16_t)port);
+		bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	} else {
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons((uint16_t)port);
+		bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	}
+	if (bound != 0 || listen(fd, 8) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	for (;;) {
+		int conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			close(fd);
+			return -1;
+		}
+		set_nodelay(conn);
+		// Ошибка одного координатора не останавливает рабочего
+		distrib_worker_serve(conn, conn, threads);
+		close(conn);
+	}
+}
+
+const char *distrib_default_command(void)
+{
+	static char command[4096];
+	const char *env = getenv("FRACTAL_WORKER");
+	if (env != NULL && env[0] != '\0')
+		return env;
+
+	// fractal_worker из каталога исполняемого файла
+	char exe[3072];
+	ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (n > 0) {
+		exe[n] = '\0';
+		char *slash = strrchr(exe, '/');
+		if (slash != NULL) {
+			strcpy(slash + 1, "fractal_worker");
+			if (access(exe, X_OK) == 0 && strchr(exe, '\'') == NULL) {
+				snprintf(command, sizeof(command), "'%s' --stdio", exe);
+				return command;
+			}
+		}
+	}
+	return "fractal_worker --stdio";
+}
+
+/**
+ * @brief Тайл распределенного рендеринга
+ */
+struct distrib_tile {
+	pixel_coord x, y, width, height; // Положение и размеры в изображении
+	int holders;                    // Рабочих, которым выдан тайл
+	bool done;                      // Пиксели получены
+	long deadline;                  // Срок последней выдачи (мс)
+};
+
+/**
+ * @brief Состояние рабочего в координаторе
+ */
+struct distrib_worker {
+	int fd;                         // Сокет (-1 - рабочий упал)
+	pid_t pid;                      // Процесс локального рабочего (0 - TCP)
+	unsigned long queue[DISTRIB_PIPELINE]; // Выданные тайлы по порядку
+	int queued;                     // Выдано тайлов
+	long heard;                     // Последние данные или выдача тайла простаивающему (мс)
+	size_t header_used;             // Байт строки ответа в header
+	char header[DISTRIB_LINE_MAX];  // Строка ответа
+	size_t payload;                 // Осталось байт пикселей (0 - ждем строку)
+	uint8_t *pixels;                // Пиксели принимаемого тайла
+};
+
+/**
+ * @brief Состояние координатора
+ */
+struct distrib_run {
+	image_view_t view;              // Пиксели изображения
+	double bounds[4];               // Область изображения
+	const fractal_formula_t *formula; // Итерируемая функция
+	int max_iter;                   // Максимальное количество итераций
+	const fractal_options_t *opt;   // Параметры рендеринга
+	int timeout_ms;                 // Срок тайла
+	struct distrib_tile *tiles;     // Тайлы
+	unsigned long count;            // Количество тайлов
+	unsigned long next;             // Следующий еще не выданный тайл
+	unsigned long *requeue;         // Стек тайлов упавших рабочих
+	unsigned long requeue_count;    // Размер стека
+	unsigned long done;             // Готово тайлов
+	struct distrib_worker *workers; // Рабочие
+	int worker_count;               // Количество рабочих
+	distrib_stats_t *stats;         // Статистика
+};
+
+// Монотонное время в миллисекундах
+static long now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Запускает локального рабочего: /bin/sh -c command с сокетом
+ * на стандартных вводе и выводе
+ *
+ * Рабочий получает свою группу процессов, чтобы stop_worker завершил и
+ * процессы, запущенные оболочкой (конвейеры, ssh).
+ *
+ * @returns сокет координатора или -1
+ */
+static int spawn_worker(const char *command, pid_t *pid)
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		return -1;
+	// Сокеты координатора не наследуются следующими рабочими
+	fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	pid_t child = fork();
+	if (child < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	if (child == 0) {
+		setpgid(0, 0);
+		dup2(sv[1], STDIN_FILENO);
+		dup2(sv[1], STDOUT_FILENO);
+		if (sv[1] > STDOUT_FILENO)
+			close(sv[1]);
+		execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+		_exit(127);
+	}
+	close(sv[1]);
+	setpgid(child, child);
+	*pid = child;
+	return sv[0];
+}
+
+// Завершает группу процессов локального рабочего
+static void stop_worker(pid_t pid)
+{
+	kill(-pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+/**
+ * @brief Подключается к рабочему "узел:порт"
+ * @returns сокет или -1
+ */
+static int connect_worker(const char *spec, size_t len)
+{
+	char host[256];
+	if (len >= sizeof(host))
+		return -1;
+	memcpy(host, spec, len);
+	host[len] = '\0';
+	char *colon = strrchr(host, ':');
+	if (colon == NULL || colon == host)
+		return -1;
+	*colon = '\0';
+	// Адрес IPv6 записывается в квадратных скобках: [::1]:7000
+	char *name = host;
+	if (name[0] == '[' && colon[-1] == ']') {
+		name++;
+		colon[-1] = '\0';
+	}
+
+	struct addrinfo hints, *list;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(name, colon + 1, &hints, &list) != 0)
+		return -1;
+	int fd = -1;
+	for (struct addrinfo *a = list; a != NULL && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(list);
+	if (fd >= 0) {
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		set_nodelay(fd);
+	}
+	return fd;
+}
+
+/**
+ * @brief Добавляет рабочего с сокетом fd
+ * @returns 0 при успехе, -1 при нехватке памяти (сокет закрывается)
+ */
+static int add_worker(struct distrib_run *run, int fd, pid_t pid,
+		      size_t tile_bytes)
+{
+	struct distrib_worker *w = &run->workers[run->worker_count];
+	memset(w, 0, sizeof(*w));
+	w->pixels = malloc(tile_bytes);
+	if (w->pixels == NULL) {
+		close(fd);
+		if (pid > 0)
+			stop_worker(pid);
+		return -1;
+	}
+	w->fd = fd;
+	w->pid = pid;
+	run->worker_count++;
+	run->stats->workers++;
+	return 0;
+}
+
+// Снимает тайл с рабочего; недоделанный тайл без рабочих - снова в очередь
+static void release_tile(struct distrib_run *run, unsigned long t, bool failed)
+{
+	struct distrib_tile *tile = &run->tiles[t];
+	if (--tile->holders == 0 && !tile->done) {
+		run->requeue[run->requeue_count++] = t;
+		if (failed)
+			run->stats->requeued++;
+	}
+}
+
+// Отключает упавшего рабочего и возвращает его тайлы в очередь
+static void fail_worker(struct distrib_run *run, struct distrib_worker *w)
+{
+	close(w->fd);
+	w->fd = -1;
+	for (int i = 0; i < w->queued; i++)
+		release_tile(run, w->queue[i], true);
+	w->queued = 0;
+	run->stats->failed++;
+}
+
+// Копирует пиксели тайла в изображение
+static void store_tile(struct distrib_run *run, unsigned long t,
+		       const uint8_t *pixels)
+{
+	struct distrib_tile *tile = &run->tiles[t];
+	for (pixel_coord r = 0; r < tile->height; r++)
+		memcpy(run->view.data + (size_t)(tile->y + r) * run->view.stride +
+		       tile->x, pixels + (size_t)r * tile->width, tile->width);
+	tile->done = true;
+	run->done++;
+}
+
+// Заполняет запрос тайла t
+static void make_request(const struct distrib_run *run, unsigned long t,
+			 struct distrib_request *q)
+{
+	const struct distrib_tile *tile = &run->tiles[t];
+	q->id = t;
+	q->width = tile->width;
+	q->height = tile->height;
+	q->x0 = tile->x;
+	q->y0 = tile->y;
+	q->view_width = run->view.width;
+	q->view_height = run->view.height;
+	q->formula = *run->formula;
+	q->x_min = run->bounds[0];
+	q->x_max = run->bounds[1];
+	q->y_min = run->bounds[2];
+	q->y_max = run->bounds[3];
+	q->max_iter = run->max_iter;
+	q->options = *run->opt;
+}
+
+/**
+ * @brief Выбирает тайл для рабочего: возвращенный, затем еще не выданный,
+ * затем (для простаивающего рабочего) просроченный на другом рабочем
+ * @returns номер тайла или -1
+ */
+static long pick_tile(struct distrib_run *run, const struct distrib_worker *w,
+		      long now)
+{
+	while (run->requeue_count > 0) {
+		unsigned long t = run->requeue[--run->requeue_count];
+		if (!run->tiles[t].done && run->tiles[t].holders == 0)
+			return (long)t;
+	}
+	if (run->next < run->count)
+		return (long)run->next++;
+	if (run->timeout_ms <= 0 || w->queued > 0)
+		return -1;
+
+	// Дубли выдаются только для тайлов, еще не выданных повторно
+	for (int i = 0; i < run->worker_count; i++) {
+		const struct distrib_worker *other = &run->workers[i];
+		if (other->fd < 0)
+			continue;
+		for (int k = 0; k < other->queued; k++) {
+			struct distrib_tile *tile = &run->tiles[other->queue[k]];
+			if (!tile->done && tile->holders == 1 && now >= tile->deadline) {
+				run->stats->duplicated++;
+				return (long)other->queue[k];
+			}
+		}
+	}
+	return -1;
+}
+
+// Выдает рабочему тайлы, пока очередь рабочего не заполнена
+static void feed_worker(struct distrib_run *run, struct distrib_worker *w,
+			long now)
+{
+	while (w->fd >= 0 && w->queued < DISTRIB_PIPELINE) {
+		long t = pick_tile(run, w, now);
+		if (t < 0)
+			return;
+		struct distrib_request q;
+		char line[DISTRIB_LINE_MAX];
+		make_request(run, (unsigned long)t, &q);
+		int n = format_request(&q, line, sizeof(line));
+		assert(n > 0);
+
+		struct distrib_tile *tile = &run->tiles[t];
+		tile->holders++;
+		tile->deadline = now + run->timeout_ms;
+		if (w->queued == 0)
+			w->heard = now;
+		w->queue[w->queued++] = (unsigned long)t;
+		if (write_all(w->fd, line, (size_t)n) != 0)
+			fail_worker(run, w);
+	}
+}
+
+// Обрабатывает строку ответа
+static int handle_header(struct distrib_run *run, struct distrib_worker *w)
+{
+	unsigned long id;
+	unsigned int width, height;
+	int end = 0;
+	// Рабочий жив и рендерит первый тайл очереди
+	if (w->queued > 0 && sscanf(w->header, "busy %lu%n", &id, &end) == 1 &&
+	    w->header[end] == '\0' && id == w->queue[0])
+		return 0;
+	end = 0;
+	if (w->queued == 0 ||
+	    sscanf(w->header, "done %lu %u %u%n", &id, &width, &height, &end) < 3 ||
+	    w->header[end] != '\0' || id != w->queue[0])
+		return -1;
+	const struct distrib_tile *tile = &run->tiles[id];
+	if (width != tile->width || height != tile->height)
+		return -1;
+	w->payload = (size_t)width * height;
+	return 0;
+}
+
+/**
+ * @brief Читает доступные данные рабочего и принимает готовые тайлы
+ * @returns 0 при успехе, -1 при разрыве соединения или ошибке протокола
+ */
+static int receive(struct distrib_run *run, struct distrib_worker *w)
+{
+	uint8_t data[1 << 16];
+	ssize_t n = recv(w->fd, data, sizeof(data), 0);
+	if (n < 0)
+		return errno == EINTR || errno == EAGAIN ? 0 : -1;
+	if (n == 0)
+		return -1;
+	w->heard = now_ms();
+
+	size_t pos = 0;
+	while (pos < (size_t)n) {
+		if (w->payload > 0) {
+			const struct distrib_tile *tile = &run->tiles[w->queue[0]];
+			size_t total = (size_t)tile->width * tile->height;
+			size_t got = total - w->payload;
+			size_t chunk = (size_t)n - pos < w->payload ? (size_t)n - pos
+								     : w->payload;
+			memcpy(w->pixels + got, data + pos, chunk);
+			pos += chunk;
+			w->payload -= chunk;
+			if (w->payload == 0) {
+				unsigned long t = w->queue[0];
+				// Результат дубля, пришедший вторым, отбрасывается
+				if (!run->tiles[t].done)
+					store_tile(run, t, w->pixels);
+				memmove(w->queue, w->queue + 1,
+					(size_t)(w->queued - 1) * sizeof(w->queue[0]));
+				w->queued--;
+				release_tile(run, t, false);
+			}
+			continue;
+		}
+
+		uint8_t c = data[pos++];
+		if (c != '\n') {
+			if (w->header_used + 1 >= sizeof(w->header))
+				return -1;
+			w->header[w->header_used++] = (char)c;
+			continue;
+		}
+		w->header[w->header_used] = '\0';
+		w->header_used = 0;
+		if (handle_header(run, w) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+// Рендерит тайл в координаторе
+static void render_local(struct distrib_run *run, unsigned long t,
+			 image_p *buffer)
+{
+	struct distrib_request q;
+	make_request(run, t, &q);
+	if (*buffer == NULL || get_image_width(*buffer) != q.width ||
+	    get_image_height(*buffer) != q.height) {
+		free_image(*buffer);
+		*buffer = create_image(q.width, q.height);
+	}
+	render_request(*buffer, &q);
+	store_tile(run, t, image_row(*buffer, 0));
+	run->stats->local++;
+}
+
+// Основной цикл координатора: раздача тайлов и прием результатов
+static void coordinate(struct distrib_run *run)
+{
+	struct pollfd fds[DISTRIB_MAX_WORKERS];
+	struct distrib_worker *polled[DISTRIB_MAX_WORKERS];
+
+	while (run->done < run->count) {
+		long now = now_ms();
+		int alive = 0;
+		bool idle = false;
+		/* Рабочий с тайлами, от которого не пришло ни байта (даже строки
+		   busy) за срок молчания, считается зависшим: его тайлы
+		   возвращаются в очередь, иначе координатор ждал бы его вечно,
+		   если свободных рабочих нет. Медленный, но живой рабочий шлет
+		   busy и не отключается */
+		long stall_ms = (long)run->timeout_ms * DISTRIB_STALL_FACTOR;
+		if (stall_ms < DISTRIB_SILENCE_MIN_MS)
+			stall_ms = DISTRIB_SILENCE_MIN_MS;
+		for (int i = 0; i < run->worker_count; i++) {
+			struct distrib_worker *w = &run->workers[i];
+			if (w->fd >= 0 && w->queued > 0 && run->timeout_ms > 0 &&
+			    now - w->heard >= stall_ms) {
+				fail_worker(run, w);
+				run->stats->stalled++;
+			}
+		}
+		for (int i = 0; i < run->worker_count; i++) {
+			struct distrib_worker *w = &run->workers[i];
+			feed_worker(run, w, now);
+			if (w->fd < 0)
+				continue;
+			if (w->queued == 0)
+				idle = true;
+			fds[alive].fd = w->fd;
+			fds[alive].events = POLLIN;
+			polled[alive++] = w;
+		}
+
+		// Живых рабочих не осталось: досчитываем сами
+		if (alive == 0) {
+			image_p buffer = NULL;
+			for (unsigned long t = 0; t < run->count; t++)
+				if (!run->tiles[t].done)
+					render_local(run, t, &buffer);
+			free_image(buffer);
+			return;
+		}
+
+		/* Просыпаемся к ближайшему сроку тайла (если есть простаивающий
+		   рабочий для дубля) или к сроку зависания рабочего */
+		int timeout = -1;
+		if (run->timeout_ms > 0) {
+			long wake = -1;
+			for (int i = 0; i < alive; i++) {
+				const struct distrib_worker *w = polled[i];
+				if (w->queued > 0 &&
+				    (wake < 0 || w->heard + stall_ms < wake))
+					wake = w->heard + stall_ms;
+				for (int k = 0; idle && k < w->queued; k++) {
+					const struct distrib_tile *tile =
+						&run->tiles[w->queue[k]];
+					if (tile->holders == 1 &&
+					    (wake < 0 || tile->deadline < wake))
+						wake = tile->deadline;
+				}
+			}
+			if (wake >= 0)
+				timeout = wake > now ? (int)(wake - now) : 0;
+		}
+
+		if (poll(fds, (nfds_t)alive, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			for (int i = 0; i < alive; i++)
+				fail_worker(run, polled[i]);
+			continue;
+		}
+		for (int i = 0; i < alive; i++)
+			if (fds[i].revents != 0 && polled[i]->fd >= 0 &&
+			    receive(run, polled[i]) != 0)
+				fail_worker(run, polled[i]);
+	}
+}
+
+int distrib_render(image_p picture, const fractal_formula_t *formula,
+		   double x_min, double x_max, double y_min, double y_max,
+		   int max_iter, const fractal_options_t *opt,
+		   const distrib_options_t *d, distrib_stats_t *stats)
+{
+	assert(picture != NULL);
+	assert(formula != NULL);
+	assert(d != NULL);
+
+	fractal_options_t defaults;
+	if (opt == NULL) {
+		fractal_options_init(&defaults);
+		opt = &defaults;
+	}
+	distrib_stats_t unused;
+	if (stats == NULL)
+		stats = &unused;
+	memset(stats, 0, sizeof(*stats));
+
+	struct distrib_run run;
+	memset(&run, 0, sizeof(run));
+	run.view = image_get_view(picture);
+	run.bounds[0] = x_min;
+	run.bounds[1] = x_max;
+	run.bounds[2] = y_min;
+	run.bounds[3] = y_max;
+	run.formula = formula;
+	run.max_iter = max_iter;
+	run.opt = opt;
+	run.timeout_ms = d->timeout_ms;
+	run.stats = stats;
+
+	// Тайлы выравниваются по тайлам escape.c, чтобы совпасть с локальным рендерингом
+	pixel_coord size = d->tile_size > 0 ? d->tile_size : DISTRIB_TILE_SIZE;
+	if (size > DISTRIB_TILE_MAX)
+		size = DISTRIB_TILE_MAX;
+	size = (size + ESCAPE_TILE - 1) / ESCAPE_TILE * ESCAPE_TILE;
+	unsigned long cols = (run.view.width + size - 1) / size;
+	unsigned long rows = (run.view.height + size - 1) / size;
+	run.count = cols * rows;
+	stats->tiles = run.count;
+	run.tiles = calloc(run.count, sizeof(struct distrib_tile));
+	run.requeue = malloc(run.count * sizeof(unsigned long));
+	run.workers = calloc(DISTRIB_MAX_WORKERS, sizeof(struct distrib_worker));
+	if (!run.tiles || !run.requeue || !run.workers) {
+		free(run.tiles);
+		free(run.requeue);
+		free(run.workers);
+		return -1;
+	}
+	for (unsigned long t = 0; t < run.count; t++) {
+		struct distrib_tile *tile = &run.tiles[t];
+		tile->x = (pixel_coord)(t % cols) * size;
+		tile->y = (pixel_coord)(t / cols) * size;
+		tile->width = run.view.width - tile->x < size ? run.view.width - tile->x : size;
+		tile->height = run.view.height - tile->y < size ? run.view.height - tile->y : size;
+	}
+
+	// Запуск локальных рабочих и подключение к удаленным
+	size_t tile_bytes = (size_t)size * size;
+	const char *command = d->worker_command != NULL ? d->worker_command
+						       : distrib_default_command();
+	for (int i = 0; i < d->workers && run.worker_count < DISTRIB_MAX_WORKERS; i++) {
+		pid_t pid;
+		int fd = spawn_worker(command, &pid);
+		if (fd >= 0)
+			add_worker(&run, fd, pid, tile_bytes);
+	}
+	for (const char *s = d->hosts; s != NULL && *s != '\0';) {
+		size_t len = strcspn(s, ",");
+		if (len > 0 && run.worker_count < DISTRIB_MAX_WORKERS) {
+			int fd = connect_worker(s, len);
+			if (fd >= 0)
+				add_worker(&run, fd, 0, tile_bytes);
+		}
+		s += len;
+		if (*s == ',')
+			s++;
+	}
+
+	int result = run.worker_count > 0 ? 0 : -1;
+	if (result == 0)
+		coordinate(&run);
+
+	// Закрытый сокет завершает рабочих; зависшие локальные - принудительно
+	for (int i = 0; i < run.worker_count; i++) {
+		struct distrib_worker *w = &run.workers[i];
+		if (w->fd >= 0)
+			close(w->fd);
+		if (w->pid > 0)
+			stop_worker(w->pid);
+		free(w->pixels);
+	}
+	free(run.tiles);
+	free(run.requeue);
+	free(run.workers);
+	return result;
+}
+
+#else
+
+int distrib_worker_serve(int in_fd, int out_fd, int threads)
+{
+	(void)in_fd;
+	(void)out_fd;
+	(void)threads;
+	return -1;
+}
+
+int distrib_worker_listen(int port, int threads)
+{
+	(void)port;
+	(void)threads;
+	return -1;
+}
+
+const char *distrib_default_command(void)
+{
+	return "fractal_worker --stdio";
+}
+
+int distrib_render(image_p picture, const fractal_formula_t *formula,
+		   double x_min, double x_max, double y_min, double y_max,
+		   int max_iter, const fractal_options_t *opt,
+		   const distrib_options_t *d, distrib_stats_t *stats)
+{
+	(void)picture;
+	(void)formula;
+	(void)x_min;
+	(void)x_max;
+	(void)y_min;
+	(void)y_max;
+	(void)max_iter;
+	(void)opt;
+	(void)d;
+	(void)stats;
+	return -1;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef _DISTRIB_H_
+#define _DISTRIB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "image.h"
+#include "fractal.h"
+
+/**
+ * @file distrib.h
+ * @brief Распределенный рендеринг: координатор и рабочие процессы
+ *
+ * Координатор делит изображение на тайлы и раздает их рабочим процессам
+ * по сокетам. Рабочий процесс (fractal_worker) получает область всего
+ * изображения и положение тайла в нем и рендерит тайл formula_fractal_window
+ * (координаты пикселей, точность и соседи сглаживания - как у всего
+ * изображения), поэтому результат побайтово совпадает с formula_fractal_ex.
+ * Рабочие запускаются локально (socketpair и
+ * /bin/sh -c КОМАНДА, например "ssh узел fractal_worker --stdio") или
+ * принимают соединения по TCP (fractal_worker --listen ПОРТ).
+ *
+ * Протокол текстовый, по строке на запрос:
+ *
+ *   tile ID W H X0 Y0 VW VH KIND POWER JULIA CRE CIM XMIN XMAX YMIN YMAX
+ *        ITERS THREADS SIMD PRECISION INTERIOR PERIODICITY STRATEGY AA JITTER
+ *
+ * (W x H - тайл с левым верхним пикселем X0, Y0 в изображении VW x VH,
+ * XMIN..YMAX - область всего изображения; вещественные числа -
+ * в шестнадцатеричном виде %a, без потери точности).
+ * Ответ - строка "done ID W H", за которой следуют W*H байт пикселей, или
+ * "error ID". Рабочий отвечает в порядке запросов, поэтому координатор
+ * держит у каждого до DISTRIB_PIPELINE тайлов, чтобы тот не простаивал
+ * между ними. Пока тайл рендерится, рабочий между ответами шлет строку
+ * "busy ID" в начале тайла и затем каждые DISTRIB_HEARTBEAT_MS.
+ *
+ * Тайлы упавших рабочих (разрыв соединения, неверный ответ) возвращаются
+ * в очередь. Тайл, не готовый через timeout_ms после выдачи, дублируется
+ * на освободившемся рабочем; принимается первый пришедший результат.
+ * Рабочий с выданными тайлами, от которого за DISTRIB_STALL_FACTOR *
+ * timeout_ms (не меньше DISTRIB_SILENCE_MIN_MS) не пришло ни одной строки,
+ * отключается как зависший, даже если свободных рабочих нет; медленный
+ * рабочий шлет "busy" и остается подключенным. Если живых рабочих не
+ * осталось, оставшиеся тайлы рендерятся в самом координаторе, поэтому при
+ * timeout_ms > 0 рендеринг всегда завершается.
+ */
+
+/**
+ * @brief Сторона тайла по умолчанию (сторона округляется вверх до кратной
+ * ESCAPE_TILE)
+ */
+#define DISTRIB_TILE_SIZE 256
+
+/**
+ * @brief Срок тайла по умолчанию, мс
+ */
+#define DISTRIB_TIMEOUT_MS 30000
+
+/**
+ * @brief Период строк "busy" рабочего во время рендеринга тайла, мс
+ */
+#define DISTRIB_HEARTBEAT_MS 100
+
+/**
+ * @brief Во сколько сроков тайла рабочий с выданными тайлами может молчать,
+ * прежде чем будет признан зависшим
+ */
+#define DISTRIB_STALL_FACTOR 2
+
+/**
+ * @brief Наименьший срок молчания рабочего до признания зависшим, мс
+ */
+#define DISTRIB_SILENCE_MIN_MS (10 * DISTRIB_HEARTBEAT_MS)
+
+/**
+ * @brief Наибольшее количество тайлов, одновременно выданных одному рабочему
+ */
+#define DISTRIB_PIPELINE 2
+
+/**
+ * @brief Наибольшее количество рабочих
+ */
+#define DISTRIB_MAX_WORKERS 256
+
+/**
+ * @brief Параметры распределенного рендеринга
+ */
+typedef struct distrib_options {
+	int workers;                    // Локальных рабочих процессов
+	const char *worker_command;     // Команда рабочего (NULL - по умолчанию)
+	const char *hosts;              // "узел:порт,..." - рабочие по TCP (NULL - нет)
+	pixel_coord tile_size;          // Сторона тайла
+	int timeout_ms;                 // Срок тайла до дублирования (0 - без срока)
+} distrib_options_t;
+
+/**
+ * @brief Статистика распределенного рендеринга
+ */
+typedef struct distrib_stats {
+	unsigned long tiles;            // Тайлов в изображении
+	unsigned long duplicated;       // Тайлов, выданных повторно после срока
+	unsigned long requeued;         // Тайлов, возвращенных от упавших рабочих
+	unsigned long local;            // Тайлов, отрендеренных координатором
+	int workers;                    // Подключенных рабочих
+	int failed;                     // Упавших (в том числе зависших) рабочих
+	int stalled;                    // Рабочих, отключенных за молчание
+} distrib_stats_t;
+
+/**
+ * @brief Заполняет параметры значениями по умолчанию (без рабочих, тайл
+ * DISTRIB_TILE_SIZE, срок DISTRIB_TIMEOUT_MS)
+ *
+ * @param d Параметры
+ */
+void distrib_options_init(distrib_options_t *d);
+
+/**
+ * @brief Возвращает команду локального рабочего по умолчанию
+ *
+ * Переменная окружения FRACTAL_WORKER, иначе fractal_worker рядом
+ * с исполняемым файлом, иначе fractal_worker из PATH (с ключом --stdio).
+ *
+ * @returns строка команды (статический буфер)
+ */
+const char *distrib_default_command(void);
+
+/**
+ * @brief Рисует фрактал с временем убегания на рабочих процессах
+ *
+ * @param picture Изображение (задает размеры)
+ * @param formula Итерируемая функция
+ * @param x_min,x_max,y_min,y_max Область комплексной плоскости
+ * @param max_iter Максимальное количество итераций
+ * @param opt Параметры рендеринга, передаваемые рабочим (NULL - по умолчанию;
+ *            кэш и progress не передаются)
+ * @param d Параметры распределения
+ * @param stats Статистика (NULL - не нужна)
+ * @returns 0 при успехе, -1 если не удалось запустить ни одного рабочего
+ */
+int distrib_render(image_p picture, const fractal_formula_t *formula,
+		   double x_min, double x_max, double y_min, double y_max,
+		   int max_iter, const fractal_options_t *opt,
+		   const distrib_options_t *d, distrib_stats_t *stats);
+
+/**
+ * @brief Обслуживает запросы координатора до конца входного потока
+ *
+ * @param in_fd Дескриптор запросов
+ * @param out_fd Дескриптор ответов
+ * @param threads Потоков на тайл, если больше 0 (иначе - из запроса)
+ * @returns 0 при закрытии входного потока, -1 при ошибке ввода-вывода
+ */
+int distrib_worker_serve(int in_fd, int out_fd, int threads);
+
+/**
+ * @brief Принимает соединения координаторов по TCP и обслуживает их
+ * по очереди
+ *
+ * @param port Порт
+ * @param threads Потоков на тайл, если больше 0
+ * @returns -1 при ошибке создания сокета (при успехе не возвращает управление)
+ */
+int distrib_worker_listen(int port, int threads);
+
+#endif // _DISTRIB_H_
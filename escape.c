@@ -0,0 +1,898 @@
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "escape.h"
+#include "metrics.h"
+#include "perturb.h"
+#include "pool.h"
+
+/**
+ * @brief Вычисляет количество итераций для точки (x0, y0) вида
+ *
+ * @param steps Выполненные итерации (меньше результата, если точка
+ * отсечена проверкой кардиоиды или периодичности)
+ */
+static inline int iterate_point(const escape_params_t *p, double x0, double y0,
+				int *steps)
+{
+	double x, y, cx, cy;
+
+	if (p->julia) {
+		// Для Жюлиа точка - начальное значение, c фиксирована
+		x = x0;
+		y = y0;
+		cx = p->c_real;
+		cy = p->c_imag;
+	} else {
+		// Для Мандельброта z0 = 0, а точка играет роль c
+		x = 0.0;
+		y = 0.0;
+		cx = x0;
+		cy = y0;
+	}
+
+	// Точки кардиоиды и круга периода 2 не итерируем вовсе
+	*steps = 0;
+	if (p->interior_check && !p->julia && escape_in_interior(cx, cy))
+		return p->max_iter;
+
+	/* Проверка периодичности по Бренту: z сравнивается с сохраненным
+	   значением, которое обновляется через удваивающиеся интервалы.
+	   Сравнение точное, поэтому найденный цикл повторялся бы и при
+	   полном переборе, и результат не меняется */
+	double saved_x = x, saved_y = y;
+	int check_at = ESCAPE_PERIOD_START;
+
+	int iteration = 0;
+	// Критерий остановки: |z| > 2 или достигнут max_iter
+	while (x * x + y * y <= 4.0 && iteration < p->max_iter) {
+		double xtemp = x * x - y * y + cx;
+		y = 2.0 * x * y + cy;
+		x = xtemp;
+		iteration++;
+
+		if (p->periodicity) {
+			if (x == saved_x && y == saved_y) {
+				*steps = iteration;
+				return p->max_iter;
+			}
+			if (iteration == check_at) {
+				saved_x = x;
+				saved_y = y;
+				if (check_at <= INT_MAX / 2)
+					check_at *= 2;
+			}
+		}
+	}
+	*steps = iteration;
+	return iteration;
+}
+
+int escape_point(const escape_params_t *p, double x, double y)
+{
+	assert(p != NULL);
+	int steps;
+	return iterate_point(p, x, y, &steps);
+}
+
+uint64_t escape_row_scalar(const escape_params_t *p, pixel_coord py,
+			   pixel_coord x_begin, pixel_coord x_end,
+			   pixel_coord step, int *out)
+{
+	assert(p != NULL);
+	assert(out != NULL);
+	assert(step > 0);
+	assert(x_end <= p->width);
+
+	// Мнимая часть одинакова для всей строки
+	double y0 = p->y_min + (p->y_max - p->y_min) * py / p->height;
+	uint64_t total = 0;
+
+	for (pixel_coord px = x_begin; px < x_end; px += step) {
+		// Преобразуем координаты пикселя в координаты комплексной плоскости
+		double x0 = p->x_min + (p->x_max - p->x_min) * px / p->width;
+		int steps;
+		*out++ = iterate_point(p, x0, y0, &steps);
+		total += (unsigned int)steps;
+	}
+	return total;
+}
+
+/**
+ * @brief Разбирает значение переменной окружения FRACTAL_SIMD
+ */
+static fractal_simd_t simd_from_env(void)
+{
+	const char *env = getenv("FRACTAL_SIMD");
+	if (env == NULL)
+		return FRACTAL_SIMD_AUTO;
+	if (strcmp(env, "scalar") == 0)
+		return FRACTAL_SIMD_SCALAR;
+	if (strcmp(env, "sse2") == 0)
+		return FRACTAL_SIMD_SSE2;
+	if (strcmp(env, "avx2") == 0)
+		return FRACTAL_SIMD_AVX2;
+	if (strcmp(env, "avx512") == 0)
+		return FRACTAL_SIMD_AVX512;
+	return FRACTAL_SIMD_AUTO;
+}
+
+/**
+ * @brief Заменяет FRACTAL_SIMD_AUTO и ограничивает запрошенный набор
+ * инструкций возможностями процессора
+ */
+static fractal_simd_t resolve_simd(fractal_simd_t simd)
+{
+	if (simd == FRACTAL_SIMD_AUTO)
+		simd = simd_from_env();
+
+	fractal_simd_t best = escape_simd_best();
+	if (simd == FRACTAL_SIMD_AUTO || simd > best)
+		simd = best;
+	return simd;
+}
+
+/**
+ * @brief Выбирает ядро из набора ядер одной точности
+ *
+ * @param simd Запрошенный набор инструкций
+ * @param table Векторные ядра по наборам инструкций
+ * @param scalar Скалярное ядро
+ */
+static escape_row_fn select_kernel(fractal_simd_t simd,
+				   escape_row_fn (*table)(fractal_simd_t),
+				   escape_row_fn scalar)
+{
+	// Спускаемся к более простым наборам, если ядро не собрано
+	for (simd = resolve_simd(simd); simd > FRACTAL_SIMD_SCALAR; simd--) {
+		escape_row_fn kernel = table(simd);
+		if (kernel != NULL)
+			return kernel;
+	}
+	return scalar;
+}
+
+escape_row_fn escape_select_kernel(fractal_simd_t simd)
+{
+	return select_kernel(simd, escape_simd_kernel, escape_row_scalar);
+}
+
+escape_row_fn escape_select_kernel_precision(fractal_simd_t simd,
+					     fractal_precision_t precision)
+{
+	switch (precision) {
+	case FRACTAL_PRECISION_FLOAT:
+		return select_kernel(simd, escape_simd_kernel_float,
+				     escape_row_float);
+	case FRACTAL_PRECISION_DOUBLE_DOUBLE:
+		// Пары double считаются только скалярным ядром
+		return escape_row_dd;
+	default:
+		return escape_select_kernel(simd);
+	}
+}
+
+/**
+ * @brief Выбирает ядро функции вида, отличной от z^2 + c
+ * @see escape_formula_kernel
+ */
+static escape_row_fn select_formula_kernel(fractal_simd_t simd,
+					   fractal_precision_t precision,
+					   const escape_params_t *p)
+{
+	// Скалярное ядро есть для любой функции и точности
+	for (simd = resolve_simd(simd); simd > FRACTAL_SIMD_SCALAR; simd--) {
+		escape_row_fn kernel = escape_formula_kernel(simd, precision, p);
+		if (kernel != NULL)
+			return kernel;
+	}
+	return escape_formula_kernel(FRACTAL_SIMD_SCALAR, precision, p);
+}
+
+uint64_t escape_row(const escape_params_t *p, pixel_coord py,
+		    pixel_coord x_begin, pixel_coord x_end, pixel_coord step,
+		    int *out)
+{
+	escape_row_fn kernel = escape_is_quadratic(p) ?
+		escape_select_kernel(FRACTAL_SIMD_AUTO) :
+		select_formula_kernel(FRACTAL_SIMD_AUTO, FRACTAL_PRECISION_DOUBLE, p);
+	return kernel(p, py, x_begin, x_end, step, out);
+}
+
+pixel_data escape_color(int iteration, int max_iter)
+{
+	// Если точка принадлежит множеству - черный цвет, иначе градации серого
+	return (iteration == max_iter) ? 0 :
+		(pixel_data)(255 * iteration / max_iter);
+}
+
+/**
+ * @brief Контекст параллельного рендеринга по тайлам
+ */
+struct escape_job {
+	image_p picture;
+	const escape_params_t *params;
+	escape_row_fn kernel;           // Ядро для вычисления итераций
+	fractal_precision_t precision;  // Точность арифметики ядра
+	fractal_strategy_t strategy;    // Стратегия обхода пикселей тайла
+	unsigned int tiles_x;           // Количество тайлов по горизонтали
+	pixel_coord x_origin;           // Столбец вида, соответствующий столбцу 0 изображения
+	pixel_coord x_begin, x_end;     // Обрабатываемые столбцы вида
+	pixel_coord y_origin;           // Строка вида, соответствующая строке 0 изображения
+	pixel_coord y_begin, y_end;     // Обрабатываемые строки вида
+	pixel_coord step;               // Шаг сетки прогрессивного прохода
+	bool first_pass;                // Первый (самый грубый) проход
+	int antialias;                  // Сторона сетки выборок (1 - без сглаживания)
+	bool jitter;                    // Случайные смещения выборок
+	escape_buffer_t *buffer;        // Буфер итераций вместо изображения (или NULL)
+	bool smooth;                    // Дробное количество итераций в буфере
+};
+
+/**
+ * @brief Буфер итераций одного тайла
+ */
+struct escape_tile {
+	const escape_params_t *params;
+	escape_row_fn kernel;
+	pixel_coord x0, y0;     // Левый верхний угол тайла в координатах вида
+	int *iters;             // Итерации (строки длиной ESCAPE_TILE)
+	uint64_t computed;      // Выполненные итерации
+};
+
+/**
+ * @brief Возвращает ячейку буфера тайла для пикселя изображения
+ */
+static inline int *tile_at(struct escape_tile *t, pixel_coord x, pixel_coord y)
+{
+	return &t->iters[(size_t)(y - t->y0) * ESCAPE_TILE + (x - t->x0)];
+}
+
+/**
+ * @brief Вычисляет пиксели [xa, xb) строки y
+ */
+static void tile_row(struct escape_tile *t, pixel_coord y,
+		     pixel_coord xa, pixel_coord xb)
+{
+	if (xa < xb)
+		t->computed += t->kernel(t->params, y, xa, xb, 1,
+					 tile_at(t, xa, y));
+}
+
+/**
+ * @brief Вычисляет пиксели [ya, yb) столбца x
+ */
+static void tile_column(struct escape_tile *t, pixel_coord x,
+			pixel_coord ya, pixel_coord yb)
+{
+	for (pixel_coord y = ya; y < yb; y++)
+		t->computed += t->kernel(t->params, y, x, x + 1, 1,
+					 tile_at(t, x, y));
+}
+
+/**
+ * @brief Проверяет, что вся граница прямоугольника имеет одно значение
+ *
+ * @param x0,y0,x1,y1 Углы прямоугольника (включительно)
+ */
+static bool border_uniform(struct escape_tile *t, pixel_coord x0,
+			   pixel_coord y0, pixel_coord x1, pixel_coord y1)
+{
+	int v = *tile_at(t, x0, y0);
+
+	for (pixel_coord x = x0; x <= x1; x++)
+		if (*tile_at(t, x, y0) != v || *tile_at(t, x, y1) != v)
+			return false;
+	for (pixel_coord y = y0 + 1; y < y1; y++)
+		if (*tile_at(t, x0, y) != v || *tile_at(t, x1, y) != v)
+			return false;
+	return true;
+}
+
+/**
+ * @brief Рекурсивное разбиение Мариани-Сильвера
+ *
+ * Граница прямоугольника уже вычислена. Если она однородна, внутренность
+ * заливается тем же значением; иначе прямоугольник делится средней строкой
+ * и средним столбцом на четыре части с общими границами.
+ *
+ * @param x0,y0,x1,y1 Углы прямоугольника (включительно)
+ */
+static void subdivide(struct escape_tile *t, pixel_coord x0, pixel_coord y0,
+		      pixel_coord x1, pixel_coord y1)
+{
+	if (border_uniform(t, x0, y0, x1, y1)) {
+		int v = *tile_at(t, x0, y0);
+		for (pixel_coord y = y0 + 1; y < y1; y++)
+			for (pixel_coord x = x0 + 1; x < x1; x++)
+				*tile_at(t, x, y) = v;
+		return;
+	}
+
+	// Маленькие прямоугольники дешевле досчитать целиком
+	if (x1 - x0 < ESCAPE_SUBDIVIDE_MIN || y1 - y0 < ESCAPE_SUBDIVIDE_MIN) {
+		for (pixel_coord y = y0 + 1; y < y1; y++)
+			tile_row(t, y, x0 + 1, x1);
+		return;
+	}
+
+	pixel_coord mx = x0 + (x1 - x0) / 2;
+	pixel_coord my = y0 + (y1 - y0) / 2;
+	tile_row(t, my, x0 + 1, x1);
+	tile_column(t, mx, y0 + 1, my);
+	tile_column(t, mx, my + 1, y1);
+
+	subdivide(t, x0, y0, mx, my);
+	subdivide(t, mx, y0, x1, my);
+	subdivide(t, x0, my, mx, y1);
+	subdivide(t, mx, my, x1, y1);
+}
+
+/**
+ * @brief Хеш координат выборки для детерминированных случайных смещений
+ */
+static uint32_t sample_hash(uint32_t x, uint32_t y, uint32_t s)
+{
+	uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ s * 0xC2B2AE3Du;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return h;
+}
+
+/**
+ * @brief Вычисляет сглаженный цвет пикселя по n x n выборкам со случайными
+ * смещениями внутри ячеек сетки
+ *
+ * Пиксель (px, py) занимает на плоскости ячейку от своей точки до точки
+ * пикселя (px + 1, py + 1).
+ */
+static pixel_data antialias_pixel(const struct escape_job *job,
+				  pixel_coord px, pixel_coord py)
+{
+	const escape_params_t *p = job->params;
+	int n = job->antialias;
+	double sx = (p->x_max - p->x_min) / p->width;
+	double sy = (p->y_max - p->y_min) / p->height;
+	unsigned int sum = 0;
+
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < n; i++) {
+			uint32_t h = sample_hash(px, py, (uint32_t)(j * n + i));
+			double ox = (h & 0xFFFF) / 65536.0;
+			double oy = (h >> 16) / 65536.0;
+			double fx = px + (i + ox) / n;
+			double fy = py + (j + oy) / n;
+			int it, steps;
+			if (!escape_is_quadratic(p))
+				it = escape_formula_sample(p, job->precision, fx, fy);
+			else if (job->precision == FRACTAL_PRECISION_DOUBLE)
+				it = iterate_point(p, p->x_min + sx * fx,
+						   p->y_min + sy * fy, &steps);
+			else
+				it = escape_sample_precision(p, job->precision, fx, fy);
+			sum += escape_color(it, p->max_iter);
+		}
+	return (pixel_data)((sum + n * n / 2) / (n * n));
+}
+
+/**
+ * @brief Адаптивное сглаживание тайла: пиксели, у которых количество
+ * итераций отличается хотя бы от одного из четырех соседей, пересчитываются
+ * по сетке выборок, а однородные области остаются с одной выборкой
+ *
+ * Соседи за границей тайла вычисляются дополнительно (кольцо шириной
+ * в пиксель), поэтому результат не зависит от разбиения на тайлы.
+ */
+static void antialias_tile(const struct escape_job *job, struct escape_tile *t,
+			   pixel_coord x0, pixel_coord y0, pixel_coord x1,
+			   pixel_coord y1)
+{
+	const escape_params_t *p = job->params;
+	// Тайл с кольцом соседей; -1 - соседа нет (край вида)
+	enum { W = ESCAPE_TILE + 2 };
+	int ext[W * W];
+	pixel_coord w = x1 - x0, h = y1 - y0;
+	for (int i = 0; i < W * W; i++)
+		ext[i] = -1;
+	for (pixel_coord y = y0; y < y1; y++)
+		memcpy(&ext[(y - y0 + 1) * W + 1], tile_at(t, x0, y),
+		       sizeof(int) * w);
+
+	// Строки над и под тайлом
+	pixel_coord xa = x0 > 0 ? x0 - 1 : 0;
+	pixel_coord xb = x1 < p->width ? x1 + 1 : p->width;
+	if (y0 > 0)
+		t->kernel(p, y0 - 1, xa, xb, 1, &ext[xa - x0 + 1]);
+	if (y1 < p->height)
+		t->kernel(p, y1, xa, xb, 1, &ext[(h + 1) * W + xa - x0 + 1]);
+	// Столбцы слева и справа
+	for (pixel_coord y = y0; y < y1; y++) {
+		int *row = &ext[(y - y0 + 1) * W];
+		if (x0 > 0)
+			t->kernel(p, y, x0 - 1, x0, 1, &row[0]);
+		if (x1 < p->width)
+			t->kernel(p, y, x1, x1 + 1, 1, &row[w + 1]);
+	}
+
+	/* Без случайных смещений выборки образуют регулярную сетку в n раз
+	   мельче пикселей (со сдвигом на полшага к центрам ячеек), поэтому
+	   их можно считать векторным ядром по отрезкам подряд идущих
+	   граничных пикселей. Центры ячеек - нечетные точки сетки в 2n раз
+	   мельче: границы вида не сдвигаются, и точность выборок та же, что
+	   у пикселей */
+	int n = job->antialias;
+	escape_params_t fine = *p;
+	fine.width = p->width * 2 * n;
+	fine.height = p->height * 2 * n;
+	int samples[ESCAPE_TILE * ESCAPE_AA_MAX];
+	unsigned int sums[ESCAPE_TILE];
+
+	for (pixel_coord y = y0; y < y1; y++) {
+		pixel_data *out = image_row(job->picture, y - job->y_origin) +
+			(x0 - job->x_origin);
+		const int *c = &ext[(y - y0 + 1) * W + 1];
+		bool edge[ESCAPE_TILE];
+		for (int x = 0; x < (int)w; x++) {
+			int v = c[x];
+			edge[x] = (c[x - 1] >= 0 && c[x - 1] != v) ||
+				  (c[x + 1] >= 0 && c[x + 1] != v) ||
+				  (c[x - W] >= 0 && c[x - W] != v) ||
+				  (c[x + W] >= 0 && c[x + W] != v);
+		}
+
+		if (job->jitter) {
+			for (int x = 0; x < (int)w; x++)
+				if (edge[x])
+					out[x] = antialias_pixel(job, x0 + x, y);
+			continue;
+		}
+		for (int a = 0; a < (int)w;) {
+			if (!edge[a]) {
+				a++;
+				continue;
+			}
+			int b = a + 1;
+			while (b < (int)w && edge[b])
+				b++;
+			memset(sums, 0, sizeof(unsigned int) * (b - a));
+			for (int j = 0; j < n; j++) {
+				t->kernel(&fine, 2 * (y * n + j) + 1,
+					  2 * (x0 + a) * n + 1, 2 * (x0 + b) * n,
+					  2, samples);
+				for (int k = 0; k < (b - a) * n; k++)
+					sums[k / n] += escape_color(samples[k],
+								    p->max_iter);
+			}
+			for (int x = a; x < b; x++)
+				out[x] = (pixel_data)((sums[x - a] + n * n / 2) /
+						      (n * n));
+			a = b;
+		}
+	}
+}
+
+/**
+ * @brief Вычисляет n + 1 - log2(log2 |z|) для вышедшей точки пикселя в double
+ * @see smooth_iteration
+ */
+static double smooth_double(const escape_params_t *p, pixel_coord px,
+			    pixel_coord py, int n)
+{
+	double x0 = p->x_min + (p->x_max - p->x_min) * px / p->width;
+	double y0 = p->y_min + (p->y_max - p->y_min) * py / p->height;
+	double x = 0.0, y = 0.0, cx = x0, cy = y0;
+	if (p->julia) {
+		x = x0;
+		y = y0;
+		cx = p->c_real;
+		cy = p->c_imag;
+	}
+
+	int total = n + ESCAPE_SMOOTH_EXTRA;
+	for (int i = 0; i < total; i++) {
+		double xtemp = x * x - y * y + cx;
+		y = 2.0 * x * y + cy;
+		x = xtemp;
+	}
+	// log2 |z| = log2(|z|^2) / 2
+	return total + 1 - log2(0.5 * log2(x * x + y * y));
+}
+
+/**
+ * @brief Вычисляет дробное количество итераций вышедшей точки пикселя
+ *
+ * Орбита повторяется до выхода (n итераций) и продолжается еще на
+ * ESCAPE_SMOOTH_EXTRA итераций: |z| при этом растет как 2^(2^k), и оценка
+ * N + 1 - log2(log2 |z_N|) почти не зависит от того, насколько точка
+ * перешла радиус 2, и результат непрерывно меняется на границах полос
+ * с одинаковым n. Орбита считается с той же точностью, что и ядро.
+ */
+static float smooth_iteration(const struct escape_job *job, pixel_coord px,
+			      pixel_coord py, int n)
+{
+	const escape_params_t *p = job->params;
+	double mu;
+	if (!escape_is_quadratic(p))
+		mu = escape_formula_smooth(p, job->precision, px, py, n);
+	else if (job->precision == FRACTAL_PRECISION_DOUBLE)
+		mu = smooth_double(p, px, py, n);
+	else
+		mu = escape_smooth_precision(p, job->precision, px, py, n);
+	if (!(mu > 0))
+		return 0.0f;
+	float v = (float)mu;
+	return v < (float)p->max_iter ? v : (float)(p->max_iter - 1);
+}
+
+/**
+ * @brief Записывает итерации тайла в буфер итераций
+ */
+static void store_tile(const struct escape_job *job, struct escape_tile *t,
+		       pixel_coord x0, pixel_coord y0, pixel_coord x1,
+		       pixel_coord y1)
+{
+	const escape_params_t *p = job->params;
+	escape_buffer_t *b = job->buffer;
+
+	for (pixel_coord py = y0; py < y1; py++) {
+		float *row = &b->values[(size_t)py * b->width];
+		const int *it = tile_at(t, x0, py);
+		for (pixel_coord px = x0; px < x1; px++, it++)
+			row[px] = job->smooth && *it < p->max_iter ?
+				smooth_iteration(job, px, py, *it) : (float)*it;
+	}
+}
+
+/**
+ * @brief Рендерит один тайл (задача пула потоков)
+ */
+static void render_tile(void *ctx, unsigned int task, int worker)
+{
+	struct escape_job *job = ctx;
+	const escape_params_t *p = job->params;
+	int iters[ESCAPE_TILE * ESCAPE_TILE];
+	metrics_t *m = metrics_current;
+	int64_t start = m != NULL ? metrics_now() : 0;
+	(void)worker;
+
+	// Границы тайла
+	pixel_coord x0 = job->x_begin + (task % job->tiles_x) * ESCAPE_TILE;
+	pixel_coord y0 = job->y_begin + (task / job->tiles_x) * ESCAPE_TILE;
+	pixel_coord x1 = x0 + ESCAPE_TILE < job->x_end ? x0 + ESCAPE_TILE : job->x_end;
+	pixel_coord y1 = y0 + ESCAPE_TILE < job->y_end ? y0 + ESCAPE_TILE : job->y_end;
+
+	struct escape_tile tile = { p, job->kernel, x0, y0, iters, 0 };
+
+	if (job->strategy == FRACTAL_STRATEGY_SUBDIVIDE &&
+	    x1 - x0 >= 3 && y1 - y0 >= 3) {
+		/* Сначала вычисляем границу всего тайла */
+		tile_row(&tile, y0, x0, x1);
+		tile_row(&tile, y1 - 1, x0, x1);
+		tile_column(&tile, x0, y0 + 1, y1 - 1);
+		tile_column(&tile, x1 - 1, y0 + 1, y1 - 1);
+		subdivide(&tile, x0, y0, x1 - 1, y1 - 1);
+	} else {
+		for (pixel_coord py = y0; py < y1; py++)
+			tile_row(&tile, py, x0, x1);
+	}
+
+	if (job->buffer != NULL) {
+		store_tile(job, &tile, x0, y0, x1, y1);
+	} else {
+		/* Переводим итерации в оттенки серого, записывая строки тайла
+		   напрямую в изображение */
+		for (pixel_coord py = y0; py < y1; py++) {
+			pixel_data *row = image_row(job->picture, py - job->y_origin) +
+				(x0 - job->x_origin);
+			const int *it = tile_at(&tile, x0, py);
+			for (pixel_coord px = x0; px < x1; px++)
+				*row++ = escape_color(*it++, p->max_iter);
+		}
+
+		if (job->antialias > 1)
+			antialias_tile(job, &tile, x0, y0, x1, y1);
+	}
+
+	if (m != NULL) {
+		metrics_histogram(m, tile_at(&tile, x0, y0), x1 - x0, y1 - y0,
+				  ESCAPE_TILE, p->max_iter);
+		metrics_tile(m, x0 / ESCAPE_TILE, y0 / ESCAPE_TILE,
+			     metrics_now() - start, tile.computed);
+	}
+}
+
+/**
+ * @brief Вычисляет одну строку выборок прогрессивного прохода и заливает
+ * блоки step x step их цветом (задача пула потоков)
+ */
+static void render_pass_row(void *ctx, unsigned int task, int worker)
+{
+	struct escape_job *job = ctx;
+	const escape_params_t *p = job->params;
+	pixel_coord s = job->step;
+	pixel_coord py = job->y_begin + task * s;
+	pixel_coord y_end = py + s < job->y_end ? py + s : job->y_end;
+	int iters[ESCAPE_TILE];
+	(void)worker;
+
+	/* В строках, кратных 2 * step, выборки с четными номерами уже
+	   вычислены предыдущим проходом - считаем только нечетные */
+	pixel_coord x_begin = 0;
+	pixel_coord x_step = s;
+	if (!job->first_pass && (py - job->y_begin) % (2 * s) == 0) {
+		x_begin = s;
+		x_step = 2 * s;
+	}
+
+	// Вычисляем выборки порциями по ESCAPE_TILE
+	for (pixel_coord x = x_begin; x < p->width; x += ESCAPE_TILE * x_step) {
+		pixel_coord x_end = x + ESCAPE_TILE * x_step < p->width ?
+			x + ESCAPE_TILE * x_step : p->width;
+		uint64_t computed = job->kernel(p, py, x, x_end, x_step, iters);
+		if (metrics_current != NULL) {
+			pixel_coord n = (x_end - x + x_step - 1) / x_step;
+			metrics_add_iterations(metrics_current, computed);
+			metrics_histogram(metrics_current, iters, n, 1, n, p->max_iter);
+		}
+
+		int *it = iters;
+		for (pixel_coord bx = x; bx < x_end; bx += x_step, it++) {
+			pixel_data color = escape_color(*it, p->max_iter);
+			pixel_coord bx_end = bx + s < p->width ? bx + s : p->width;
+			for (pixel_coord by = py; by < y_end; by++)
+				memset(image_row(job->picture, by - job->y_origin) + bx,
+				       color, bx_end - bx);
+		}
+	}
+}
+
+/**
+ * @brief Прогрессивный рендеринг: проходы с шагом step, step/2, ..., 1
+ *
+ * Каждый проход вычисляет только новые выборки своей сетки и заливает
+ * блоки их цветом, поэтому после последнего прохода изображение совпадает
+ * с попиксельным рендерингом, а общий объем вычислений не растет.
+ */
+static void render_progressive(image_p picture, struct escape_job *job,
+			       const fractal_options_t *opt)
+{
+	pixel_coord rows = job->y_end - job->y_begin;
+
+	// Начальный шаг - степень двойки не больше запрошенной
+	pixel_coord start = 1;
+	while (opt->progressive_step > 0 &&
+	       start * 2 <= (pixel_coord)opt->progressive_step)
+		start *= 2;
+
+	for (pixel_coord s = start; s > 0; s /= 2) {
+		job->step = s;
+		job->first_pass = (s == start);
+		pool_run((rows + s - 1) / s, opt->threads, render_pass_row, job);
+		if (opt->progress != NULL)
+			opt->progress(picture, (int)s, opt->progress_data);
+	}
+}
+
+void escape_render(image_p picture, const escape_params_t *p,
+		   const fractal_options_t *opt)
+{
+	/* Кэшируются целые виды в памяти; для глубокого увеличения ключом
+	   была бы опорная орбита, поэтому такие виды всегда рендерятся */
+	bool cached = opt != NULL && opt->cache != NULL &&
+		p->reference == NULL && !image_is_mapped(picture) &&
+		get_image_height(picture) == p->height;
+	if (cached && render_cache_get_image(opt->cache, p, opt, picture)) {
+		if (opt->strategy == FRACTAL_STRATEGY_PROGRESSIVE &&
+		    opt->progress != NULL)
+			opt->progress(picture, 1, opt->progress_data);
+		return;
+	}
+	escape_render_rows(picture, p, opt, 0);
+	if (cached)
+		render_cache_put_image(opt->cache, p, opt, picture);
+}
+
+/**
+ * @brief Заполняет общие поля задания рендеринга строк [y_begin, y_end)
+ *
+ * @param job Задание
+ * @param params Копия описания вида, к которой применяются параметры
+ * рендеринга (должна жить до конца рендеринга)
+ * @param opt Параметры рендеринга
+ */
+static void job_init(struct escape_job *job, escape_params_t *params,
+		     const fractal_options_t *opt, pixel_coord y_begin,
+		     pixel_coord y_end)
+{
+	const escape_params_t *p = params;
+	assert(p->max_iter > 0);
+	assert(p->x_max > p->x_min);
+	assert(p->y_max > p->y_min);
+	assert(y_end <= p->height);
+
+	params->interior_check = opt->interior_check;
+	params->periodicity = opt->periodicity;
+
+	job->picture = NULL;
+	job->buffer = NULL;
+	job->params = params;
+	job->precision = escape_select_precision(p, opt->precision);
+	if (p->reference != NULL)
+		job->kernel = escape_row_perturb;
+	else if (escape_is_quadratic(p))
+		job->kernel = escape_select_kernel_precision(opt->simd,
+							     job->precision);
+	else
+		job->kernel = select_formula_kernel(opt->simd, job->precision, p);
+	job->strategy = opt->strategy;
+	/* Сглаживание выборками по плоскости недоступно при глубоком
+	   увеличении (точки задаются смещениями от опорной орбиты) */
+	job->antialias = p->reference == NULL && opt->antialias > 1 ?
+		opt->antialias : 1;
+	if (job->antialias > ESCAPE_AA_MAX)
+		job->antialias = ESCAPE_AA_MAX;
+	job->jitter = opt->antialias_jitter;
+	job->smooth = p->reference == NULL && opt->smooth;
+	job->tiles_x = (p->width + ESCAPE_TILE - 1) / ESCAPE_TILE;
+	if (metrics_current != NULL)
+		metrics_tile_grid(metrics_current, job->tiles_x,
+				  (p->height + ESCAPE_TILE - 1) / ESCAPE_TILE,
+				  ESCAPE_TILE);
+	job->x_origin = 0;
+	job->x_begin = 0;
+	job->x_end = p->width;
+	job->y_origin = y_begin;
+	job->y_begin = y_begin;
+	job->y_end = y_end;
+}
+
+void escape_render_buffer(escape_buffer_t *buffer, const escape_params_t *p,
+			  const fractal_options_t *opt)
+{
+	assert(buffer != NULL);
+	assert(p != NULL);
+	assert(buffer->width == p->width && buffer->height == p->height);
+
+	fractal_options_t defaults;
+	if (opt == NULL) {
+		fractal_options_init(&defaults);
+		opt = &defaults;
+	}
+	bool cached = opt->cache != NULL && p->reference == NULL;
+	if (cached && render_cache_get_buffer(opt->cache, p, opt, buffer))
+		return;
+
+	metrics_span_t span = metrics_begin(METRICS_STAGE_ESCAPE);
+	escape_params_t params = *p;
+	struct escape_job job;
+	job_init(&job, &params, opt, 0, p->height);
+	job.buffer = buffer;
+	job.antialias = 1;
+	if (job.strategy == FRACTAL_STRATEGY_PROGRESSIVE)
+		job.strategy = FRACTAL_STRATEGY_BRUTE;
+	buffer->max_iter = p->max_iter;
+	buffer->smooth = job.smooth;
+
+	unsigned int tiles_y = (p->height + ESCAPE_TILE - 1) / ESCAPE_TILE;
+	pool_run(job.tiles_x * tiles_y, opt->threads, render_tile, &job);
+	metrics_end(&span);
+	if (cached)
+		render_cache_put_buffer(opt->cache, p, opt, buffer);
+}
+
+void escape_render_rows(image_p picture, const escape_params_t *p,
+			const fractal_options_t *opt, pixel_coord y_begin)
+{
+	assert(picture != NULL);
+	assert(p != NULL);
+	assert(p->width == get_image_width(picture));
+
+	fractal_options_t defaults;
+	if (opt == NULL) {
+		fractal_options_init(&defaults);
+		opt = &defaults;
+	}
+
+	// Применяем параметры рендеринга к копии описания вида
+	metrics_span_t span = metrics_begin(METRICS_STAGE_ESCAPE);
+	escape_params_t params = *p;
+	struct escape_job job;
+	job_init(&job, &params, opt, y_begin, y_begin + get_image_height(picture));
+	job.picture = picture;
+	unsigned int tiles_y = (job.y_end - y_begin + ESCAPE_TILE - 1) / ESCAPE_TILE;
+
+	if (opt->strategy == FRACTAL_STRATEGY_PROGRESSIVE) {
+		render_progressive(picture, &job, opt);
+	} else if (!image_is_mapped(picture)) {
+		pool_run(job.tiles_x * tiles_y, opt->threads, render_tile, &job);
+	} else {
+		/* Изображение в файле: рендерим полосами и сразу выгружаем
+		   готовые строки, чтобы в памяти была только текущая полоса */
+		pixel_coord band = ESCAPE_TILE * ESCAPE_STREAM_BAND;
+		pixel_coord end = job.y_end;
+		for (pixel_coord y = y_begin; y < end; y += band) {
+			job.y_begin = y;
+			job.y_end = end - y < band ? end : y + band;
+			tiles_y = (job.y_end - y + ESCAPE_TILE - 1) / ESCAPE_TILE;
+			pool_run(job.tiles_x * tiles_y, opt->threads, render_tile, &job);
+			image_evict_rows(picture, y - job.y_origin, job.y_end - job.y_origin);
+		}
+	}
+	metrics_end(&span);
+}
+
+void escape_render_window(image_p picture, const escape_params_t *p,
+			  const fractal_options_t *opt, pixel_coord x_begin,
+			  pixel_coord y_begin)
+{
+	assert(picture != NULL);
+	assert(p != NULL);
+	assert(!image_is_mapped(picture));
+	assert(x_begin + get_image_width(picture) <= p->width);
+
+	fractal_options_t defaults;
+	if (opt == NULL) {
+		fractal_options_init(&defaults);
+		opt = &defaults;
+	}
+
+	metrics_span_t span = metrics_begin(METRICS_STAGE_ESCAPE);
+	escape_params_t params = *p;
+	struct escape_job job;
+	job_init(&job, &params, opt, y_begin, y_begin + get_image_height(picture));
+	job.picture = picture;
+	job.x_origin = x_begin;
+	job.x_begin = x_begin;
+	job.x_end = x_begin + get_image_width(picture);
+	job.tiles_x = (job.x_end - x_begin + ESCAPE_TILE - 1) / ESCAPE_TILE;
+
+	/* Прогрессивный рендеринг заканчивается попиксельным проходом без
+	   сглаживания - окну нужен только его результат */
+	if (job.strategy == FRACTAL_STRATEGY_PROGRESSIVE) {
+		job.strategy = FRACTAL_STRATEGY_BRUTE;
+		job.antialias = 1;
+	}
+	unsigned int tiles_y = (job.y_end - y_begin + ESCAPE_TILE - 1) / ESCAPE_TILE;
+	pool_run(job.tiles_x * tiles_y, opt->threads, render_tile, &job);
+	metrics_end(&span);
+}
+
+int escape_render_stream(image_writer_p writer, const escape_params_t *p,
+			 const fractal_options_t *opt)
+{
+	assert(writer != NULL);
+	assert(p != NULL);
+
+	// Полоса из нескольких рядов тайлов, чтобы загрузить все потоки
+	pixel_coord band = ESCAPE_TILE * ESCAPE_STREAM_BAND;
+	if (band > p->height)
+		band = p->height;
+	image_p picture = create_image(p->width, band);
+	if (picture == NULL)
+		return -1;
+
+	int result = 0;
+	for (pixel_coord y = 0; y < p->height && result == 0; y += band) {
+		pixel_coord rows = p->height - y < band ? p->height - y : band;
+		if (rows < band) {
+			// Последняя неполная полоса
+			free_image(picture);
+			picture = create_image(p->width, rows);
+			if (picture == NULL)
+				return -1;
+		}
+		escape_render_rows(picture, p, opt, y);
+		result = image_writer_write_image(writer, picture, rows);
+	}
+
+	free_image(picture);
+	return result;
+}
@@ -0,0 +1,434 @@
+#ifndef _ESCAPE_H_
+#define _ESCAPE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+#include "fractal.h"
+
+/**
+ * @brief Размер стороны квадратного тайла при параллельном рендеринге
+ */
+#define ESCAPE_TILE 64
+
+/**
+ * @brief Минимальная сторона прямоугольника, который еще делится
+ * в стратегии Мариани-Сильвера (меньшие досчитываются построчно)
+ */
+#define ESCAPE_SUBDIVIDE_MIN 16
+
+/**
+ * @brief Высота полосы потоковой записи в рядах тайлов
+ */
+#define ESCAPE_STREAM_BAND 4
+
+// Опорная орбита метода возмущений (см. perturb.h)
+struct escape_reference;
+
+/**
+ * @brief Описание вида для фракталов с временем убегания
+ *
+ * Связывает сетку пикселей изображения с областью комплексной плоскости
+ * и задает итерируемую функцию.
+ */
+typedef struct escape_params {
+	pixel_coord width, height;          // Размеры сетки пикселей
+	double x_min, x_max, y_min, y_max;  // Область комплексной плоскости
+	int max_iter;                       // Максимальное количество итераций
+	fractal_formula_kind_t formula;     // Итерируемая функция
+	int power;                          // Степень z для FRACTAL_FORMULA_POWER
+	                                    // (0 - 2)
+	bool julia;                         // true - Жюлиа, false - Мандельброт
+	double c_real, c_imag;              // Константа c для множества Жюлиа
+	bool interior_check;                // Отсекать главную кардиоиду и круг периода 2
+	bool periodicity;                   // Останавливать зациклившиеся орбиты
+	const struct escape_reference *reference; // Опорная орбита глубокого
+	                                    // увеличения; тогда область задает
+	                                    // смещения от опорной точки
+} escape_params_t;
+
+/**
+ * @brief Проверяет, что функция вида - z^2 + c (классические множества
+ * Мандельброта и Жюлиа с отдельными ядрами, отсечением внутренности и
+ * методом возмущений)
+ */
+static inline bool escape_is_quadratic(const escape_params_t *p)
+{
+	return p->formula == FRACTAL_FORMULA_POWER && p->power <= 2;
+}
+
+/**
+ * @brief Наибольшая сторона сетки выборок сглаживания
+ */
+#define ESCAPE_AA_MAX 16
+
+/**
+ * @brief Дополнительные итерации после выхода точки при вычислении
+ * дробного количества итераций
+ */
+#define ESCAPE_SMOOTH_EXTRA 4
+
+/**
+ * @brief Первый интервал проверки периодичности (затем удваивается)
+ */
+#define ESCAPE_PERIOD_START 8
+
+/**
+ * @brief Проверяет, лежит ли точка c строго внутри главной кардиоиды
+ * или круга периода 2 множества Мандельброта
+ *
+ * Орбиты таких точек притягиваются к неподвижной точке или 2-циклу и никогда
+ * не убегают, поэтому для них сразу можно вернуть max_iter.
+ *
+ * @param x,y Точка комплексной плоскости
+ * @returns true, если точка заведомо принадлежит множеству
+ */
+static inline bool escape_in_interior(double x, double y)
+{
+	double y2 = y * y;
+	// Главная кардиоида: q * (q + (x - 1/4)) < y^2 / 4
+	double xq = x - 0.25;
+	double q = xq * xq + y2;
+	if (q * (q + xq) < 0.25 * y2)
+		return true;
+	// Круг периода 2: (x + 1)^2 + y^2 < 1/16
+	double xb = x + 1.0;
+	return xb * xb + y2 < 0.0625;
+}
+
+/**
+ * @brief Ядро, вычисляющее количество итераций для части строки пикселей
+ *
+ * @param p Описание вида
+ * @param py Номер строки
+ * @param x_begin,x_end Полуинтервал столбцов [x_begin, x_end)
+ * @param step Шаг по столбцам: вычисляются x_begin, x_begin + step, ...
+ * @param out Массив для результата (по элементу на вычисленный пиксель)
+ * @returns количество выполненных итераций: 0 для точки, отсеченной
+ * проверкой кардиоиды, и номер итерации, на которой найден цикл, для
+ * остановленной проверкой периодичности
+ */
+typedef uint64_t (*escape_row_fn)(const escape_params_t *p, pixel_coord py,
+				  pixel_coord x_begin, pixel_coord x_end,
+				  pixel_coord step, int *out);
+
+/**
+ * @brief Вычисляет количество итераций для части строки пикселей
+ * лучшим доступным ядром
+ * @see escape_row_fn
+ */
+uint64_t escape_row(const escape_params_t *p, pixel_coord py,
+		    pixel_coord x_begin, pixel_coord x_end, pixel_coord step,
+		    int *out);
+
+/**
+ * @brief Вычисляет количество итераций для произвольной точки вида
+ * (так же, как скалярное ядро для точки пикселя)
+ *
+ * @param p Описание вида z^2 + c (без опорной орбиты)
+ * @param x,y Точка комплексной плоскости
+ * @returns количество итераций
+ */
+int escape_point(const escape_params_t *p, double x, double y);
+
+/**
+ * @brief Скалярное ядро (эталон для векторных ядер)
+ * @see escape_row_fn
+ */
+uint64_t escape_row_scalar(const escape_params_t *p, pixel_coord py,
+			   pixel_coord x_begin, pixel_coord x_end,
+			   pixel_coord step, int *out);
+
+/**
+ * @brief Возвращает лучший набор инструкций, поддерживаемый процессором
+ */
+fractal_simd_t escape_simd_best(void);
+
+/**
+ * @brief Возвращает векторное ядро для заданного набора инструкций
+ *
+ * @param simd Набор инструкций
+ * @returns ядро или NULL, если набор не поддерживается сборкой
+ */
+escape_row_fn escape_simd_kernel(fractal_simd_t simd);
+
+/**
+ * @brief Выбирает ядро с учетом запроса, переменной окружения FRACTAL_SIMD
+ * и возможностей процессора
+ *
+ * @param simd Запрошенный набор инструкций (FRACTAL_SIMD_AUTO - лучший)
+ * @returns ядро для вычисления итераций (не NULL)
+ */
+escape_row_fn escape_select_kernel(fractal_simd_t simd);
+
+/**
+ * @brief Ошибка округления float за итерацию (ulp float для |z| = 2)
+ */
+#define ESCAPE_FLOAT_ULP 0x1p-22
+
+/**
+ * @brief Запас точности автоматического выбора float: накопленная за
+ * max_iter итераций ошибка (max_iter * ESCAPE_FLOAT_ULP) должна быть во
+ * столько раз меньше шага пикселя
+ *
+ * Вблизи границы множества ошибка растет быстрее, чем линейно, поэтому
+ * запас большой: float выбирается только для грубых видов с малым max_iter
+ * (800x600 обзорного вида - до 18 итераций).
+ */
+#define ESCAPE_FLOAT_MARGIN 1024
+
+/**
+ * @brief Наименьший шаг пикселя, при котором автоматически выбирается
+ * double (около 128 ulp double для |z| = 2); меньший шаг - пара double
+ */
+#define ESCAPE_DOUBLE_SPACING 0x1p-44
+
+/**
+ * @brief Наибольшее max_iter для float (счетчики векторных ядер точны до 2^24)
+ */
+#define ESCAPE_FLOAT_MAX_ITER (1 << 24)
+
+/**
+ * @brief Выбирает точность арифметики вида
+ *
+ * FRACTAL_PRECISION_AUTO заменяется значением переменной окружения
+ * FRACTAL_PRECISION (float, double, dd), а без нее - выбором по меньшему из
+ * шагов пикселя по осям и max_iter: float - только если накопленная ошибка
+ * укладывается в запас ESCAPE_FLOAT_MARGIN, пара double - если шаг меньше
+ * ESCAPE_DOUBLE_SPACING. float не используется при max_iter больше
+ * ESCAPE_FLOAT_MAX_ITER, а при глубоком увеличении (опорная орбита)
+ * точность всегда double.
+ *
+ * @param p Описание вида
+ * @param precision Запрошенная точность
+ * @returns точность (не FRACTAL_PRECISION_AUTO)
+ */
+fractal_precision_t escape_select_precision(const escape_params_t *p,
+					    fractal_precision_t precision);
+
+/**
+ * @brief Выбирает ядро заданной точности для функции z^2 + c
+ *
+ * @param simd Запрошенный набор инструкций (см. escape_select_kernel)
+ * @param precision Точность (не FRACTAL_PRECISION_AUTO); для пары double
+ * векторных ядер нет
+ * @returns ядро для вычисления итераций (не NULL)
+ */
+escape_row_fn escape_select_kernel_precision(fractal_simd_t simd,
+					     fractal_precision_t precision);
+
+/**
+ * @brief Скалярное ядро в float (эталон для векторных ядер float)
+ * @see escape_row_fn
+ */
+uint64_t escape_row_float(const escape_params_t *p, pixel_coord py,
+			  pixel_coord x_begin, pixel_coord x_end,
+			  pixel_coord step, int *out);
+
+/**
+ * @brief Скалярное ядро в арифметике пар double
+ *
+ * Точки пикселей вычисляются от границ вида с точностью около 106 бит,
+ * поэтому различаются и при шаге пикселя меньше ulp double.
+ * @see escape_row_fn
+ */
+uint64_t escape_row_dd(const escape_params_t *p, pixel_coord py,
+		       pixel_coord x_begin, pixel_coord x_end,
+		       pixel_coord step, int *out);
+
+/**
+ * @brief Возвращает векторное ядро float для заданного набора инструкций
+ *
+ * @param simd Набор инструкций
+ * @returns ядро или NULL, если набор не поддерживается сборкой
+ */
+escape_row_fn escape_simd_kernel_float(fractal_simd_t simd);
+
+/**
+ * @brief Вычисляет количество итераций для дробных координат пикселя
+ * (fx, fy) с заданной точностью (float или пара double)
+ *
+ * @param p Описание вида (без опорной орбиты)
+ * @param precision Точность: FRACTAL_PRECISION_FLOAT или
+ * FRACTAL_PRECISION_DOUBLE_DOUBLE
+ * @param fx,fy Координаты в пикселях (пиксель (px, py) - точка (px, py))
+ * @returns количество итераций
+ */
+int escape_sample_precision(const escape_params_t *p,
+			    fractal_precision_t precision, double fx, double fy);
+
+/**
+ * @brief Вычисляет дробное количество итераций вышедшей точки пикселя
+ * с заданной точностью (float или пара double)
+ *
+ * @param p Описание вида (без опорной орбиты)
+ * @param precision Точность: FRACTAL_PRECISION_FLOAT или
+ * FRACTAL_PRECISION_DOUBLE_DOUBLE
+ * @param px,py Пиксель
+ * @param n Количество итераций до выхода
+ * @returns n + 1 - log2(log2 |z|) после ESCAPE_SMOOTH_EXTRA итераций сверх n
+ * (без ограничения снизу и сверху)
+ */
+double escape_smooth_precision(const escape_params_t *p,
+			       fractal_precision_t precision, pixel_coord px,
+			       pixel_coord py, int n);
+
+/**
+ * @brief Возвращает ядро функции вида, отличной от z^2 + c
+ *
+ * @param simd Набор инструкций (не FRACTAL_SIMD_AUTO)
+ * @param precision Точность (не FRACTAL_PRECISION_AUTO); для пары double
+ * есть только скалярное ядро
+ * @param p Описание вида (escape_is_quadratic(p) == false)
+ * @returns ядро или NULL, если набор не поддерживается сборкой
+ */
+escape_row_fn escape_formula_kernel(fractal_simd_t simd,
+				    fractal_precision_t precision,
+				    const escape_params_t *p);
+
+/**
+ * @brief Вычисляет количество итераций для дробных координат пикселя
+ * (fx, fy) функции вида, отличной от z^2 + c
+ * @see escape_sample_precision
+ */
+int escape_formula_sample(const escape_params_t *p,
+			  fractal_precision_t precision, double fx, double fy);
+
+/**
+ * @brief Вычисляет дробное количество итераций вышедшей точки пикселя
+ * для функции вида, отличной от z^2 + c
+ *
+ * Для z^n + c двойной логарифм модуля делится на log2 n, а дополнительных
+ * итераций меньше ESCAPE_SMOOTH_EXTRA, чтобы модуль не переполнялся.
+ * @see escape_smooth_precision
+ */
+double escape_formula_smooth(const escape_params_t *p,
+			     fractal_precision_t precision, pixel_coord px,
+			     pixel_coord py, int n);
+
+/**
+ * @brief Сопоставляет количеству итераций оттенок серого
+ *
+ * @param iteration Количество итераций
+ * @param max_iter Максимальное количество итераций
+ * @returns 0 для точек множества, иначе градация серого
+ */
+pixel_data escape_color(int iteration, int max_iter);
+
+/**
+ * @brief Буфер количества итераций вида
+ *
+ * Хранит результат ядер до раскраски, поэтому смена палитры (см. palette.h)
+ * не требует повторного вычисления итераций. Точки множества имеют значение
+ * max_iter, остальные - количество итераций до выхода за радиус 2 (с дробной
+ * частью, если буфер вычислен со сглаживанием).
+ */
+typedef struct escape_buffer {
+	pixel_coord width, height;  // Размеры сетки пикселей
+	int max_iter;               // Максимальное количество итераций вида
+	bool smooth;                // Значения с дробной частью
+	float *values;              // Значения, строки длиной width подряд
+} escape_buffer_t;
+
+/**
+ * @brief Создает буфер итераций
+ *
+ * @param width,height Размеры сетки пикселей
+ * @returns буфер или NULL при нехватке памяти
+ */
+escape_buffer_t *escape_buffer_create(pixel_coord width, pixel_coord height);
+
+/**
+ * @brief Освобождает буфер итераций
+ */
+void escape_buffer_free(escape_buffer_t *buffer);
+
+/**
+ * @brief Сохраняет буфер итераций в файл (двоичный формат этой программы)
+ *
+ * @param buffer Буфер
+ * @param filename Имя выходного файла
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int escape_buffer_save(const escape_buffer_t *buffer, const char *filename);
+
+/**
+ * @brief Загружает буфер итераций, сохраненный escape_buffer_save
+ *
+ * @param filename Имя файла
+ * @returns буфер или NULL при ошибке чтения или неверном формате
+ */
+escape_buffer_t *escape_buffer_load(const char *filename);
+
+/**
+ * @brief Вычисляет буфер итераций вида
+ *
+ * Использует те же тайлы, ядра и стратегии, что и escape_render
+ * (прогрессивная стратегия заменяется попиксельной, сглаживание выборками
+ * не применяется). С opt->smooth для вышедших точек вычисляется дробное
+ * количество итераций n + 1 - log2(log2 |z|); при глубоком увеличении
+ * значения остаются целыми.
+ *
+ * @param buffer Буфер размером p->width x p->height
+ * @param p Описание вида
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ */
+void escape_render_buffer(escape_buffer_t *buffer, const escape_params_t *p,
+			  const fractal_options_t *opt);
+
+/**
+ * @brief Рисует фрактал с временем убегания на изображении
+ *
+ * @param picture Изображение (его размеры должны совпадать с p->width, p->height)
+ * @param p Описание вида
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ */
+void escape_render(image_p picture, const escape_params_t *p,
+		   const fractal_options_t *opt);
+
+/**
+ * @brief Рисует полосу строк [y_begin, y_begin + высота изображения) вида
+ *
+ * Используется для потоковой записи, когда весь вид не помещается в память.
+ *
+ * @param picture Изображение шириной p->width
+ * @param p Описание вида
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ * @param y_begin Первая строка вида
+ */
+void escape_render_rows(image_p picture, const escape_params_t *p,
+			const fractal_options_t *opt, pixel_coord y_begin);
+
+/**
+ * @brief Рисует окно вида: пиксели [x_begin, x_begin + ширина) x
+ * [y_begin, y_begin + высота изображения)
+ *
+ * Координаты пикселей, точность и соседи сглаживания берутся из всего
+ * вида, поэтому окно совпадает с той же частью escape_render побайтово,
+ * если x_begin и y_begin кратны ESCAPE_TILE (иначе тайлы стратегии
+ * FRACTAL_STRATEGY_SUBDIVIDE лягут по-другому). Вместо прогрессивного
+ * рендеринга выполняется его последний проход. Используется рабочими
+ * распределенного рендеринга.
+ *
+ * @param picture Изображение размером окна (не отображенное в файл)
+ * @param p Описание всего вида
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ * @param x_begin,y_begin Левый верхний пиксель окна в виде
+ */
+void escape_render_window(image_p picture, const escape_params_t *p,
+			  const fractal_options_t *opt, pixel_coord x_begin,
+			  pixel_coord y_begin);
+
+/**
+ * @brief Рисует вид полосами и сразу записывает их в файл
+ *
+ * @param writer Объект записи с размерами p->width x p->height
+ * @param p Описание вида
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ * @returns 0 при успехе, -1 при ошибке записи
+ */
+int escape_render_stream(image_writer_p writer, const escape_params_t *p,
+			 const fractal_options_t *opt);
+
+#endif // _ESCAPE_H_
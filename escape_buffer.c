@@ -0,0 +1,111 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "escape.h"
+
+/*
+ * Файл буфера итераций: сигнатура, заголовок и значения float построчно
+ * в порядке байтов машины, записавшей файл (сигнатура позволяет
+ * обнаружить файл с другим порядком байтов).
+ */
+
+/**
+ * @brief Сигнатура файла буфера итераций
+ */
+#define BUFFER_MAGIC "FRACITR1"
+
+/**
+ * @brief Заголовок файла буфера итераций
+ */
+struct buffer_header {
+	char magic[8];          // BUFFER_MAGIC без завершающего нуля
+	uint32_t byte_order;    // 0x01020304 в порядке байтов записавшей машины
+	uint32_t width, height; // Размеры сетки пикселей
+	int32_t max_iter;       // Максимальное количество итераций
+	uint32_t smooth;        // 1 - значения с дробной частью
+};
+
+escape_buffer_t *escape_buffer_create(pixel_coord width, pixel_coord height)
+{
+	assert(width > 0 && height > 0);
+	escape_buffer_t *b = malloc(sizeof(escape_buffer_t));
+	if (b == NULL)
+		return NULL;
+	b->width = width;
+	b->height = height;
+	b->max_iter = 0;
+	b->smooth = false;
+	b->values = calloc((size_t)width * height, sizeof(float));
+	if (b->values == NULL) {
+		free(b);
+		return NULL;
+	}
+	return b;
+}
+
+void escape_buffer_free(escape_buffer_t *buffer)
+{
+	if (buffer == NULL)
+		return;
+	free(buffer->values);
+	free(buffer);
+}
+
+int escape_buffer_save(const escape_buffer_t *buffer, const char *filename)
+{
+	assert(buffer != NULL);
+	assert(filename != NULL);
+
+	struct buffer_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, BUFFER_MAGIC, sizeof(h.magic));
+	h.byte_order = 0x01020304;
+	h.width = buffer->width;
+	h.height = buffer->height;
+	h.max_iter = buffer->max_iter;
+	h.smooth = buffer->smooth;
+
+	FILE *file = fopen(filename, "wb");
+	if (file == NULL)
+		return -1;
+	size_t count = (size_t)buffer->width * buffer->height;
+	int result = 0;
+	if (fwrite(&h, sizeof(h), 1, file) != 1 ||
+	    fwrite(buffer->values, sizeof(float), count, file) != count)
+		result = -1;
+	if (fclose(file) != 0)
+		result = -1;
+	return result;
+}
+
+escape_buffer_t *escape_buffer_load(const char *filename)
+{
+	assert(filename != NULL);
+
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL)
+		return NULL;
+
+	struct buffer_header h;
+	escape_buffer_t *b = NULL;
+	if (fread(&h, sizeof(h), 1, file) == 1 &&
+	    memcmp(h.magic, BUFFER_MAGIC, sizeof(h.magic)) == 0 &&
+	    h.byte_order == 0x01020304 && h.width > 0 && h.height > 0 &&
+	    h.max_iter > 0)
+		b = escape_buffer_create(h.width, h.height);
+
+	if (b != NULL) {
+		b->max_iter = h.max_iter;
+		b->smooth = h.smooth != 0;
+		size_t count = (size_t)b->width * b->height;
+		if (fread(b->values, sizeof(float), count, file) != count) {
+			escape_buffer_free(b);
+			b = NULL;
+		}
+	}
+	fclose(file);
+	return b;
+}
@@ -0,0 +1,605 @@
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+
+#include "ddouble.h"
+#include "escape.h"
+
+/*
+ * Ядра для остальных итерируемых функций (z^n + c при n > 2, Burning Ship,
+ * Tricorn) и их вариантов Жюлиа.
+ *
+ * Тело ядра написано один раз - для скаляров и для векторов расширений GCC -
+ * и принимает вид функции и степень как параметры. Для каждой функции из
+ * FORMULA_LIST собираются отдельные обертки, в которые тело встраивается
+ * с константами: ветвления по виду исчезают, а возведение в степень
+ * раскрывается в фиксированную цепочку возведений в квадрат и умножений.
+ * Так новая функция получает скалярные и векторные ядра float и double
+ * добавлением одной строки в FORMULA_LIST и шага в FORMULA_STEP.
+ *
+ * Порядок операций в векторных и скалярных ядрах одинаков, поэтому, как
+ * и в escape_simd.c, результаты побайтово совпадают. Отсечения внутренности
+ * для этих функций нет, проверка периодичности - та же, что у z^2 + c.
+ */
+
+#ifdef __GNUC__
+#define FORMULA_INLINE inline __attribute__((always_inline))
+#else
+#define FORMULA_INLINE inline
+#endif
+
+/**
+ * @brief Функции, для которых собираются отдельные ядра:
+ * X(аргумент, имя, вид, степень)
+ */
+#define FORMULA_LIST(X, A) \
+	X(A, power3, FRACTAL_FORMULA_POWER, 3) \
+	X(A, power4, FRACTAL_FORMULA_POWER, 4) \
+	X(A, power5, FRACTAL_FORMULA_POWER, 5) \
+	X(A, power6, FRACTAL_FORMULA_POWER, 6) \
+	X(A, power7, FRACTAL_FORMULA_POWER, 7) \
+	X(A, power8, FRACTAL_FORMULA_POWER, 8) \
+	X(A, ship, FRACTAL_FORMULA_BURNING_SHIP, 2) \
+	X(A, tricorn, FRACTAL_FORMULA_TRICORN, 2)
+
+/**
+ * @brief Один шаг z -> f(z) + c над скалярами или векторами типа T
+ *
+ * z^n вычисляется бинарным возведением в степень: при постоянной n цикл
+ * по битам раскрывается полностью (для n = 8 - три возведения в квадрат).
+ *
+ * @param ABS Модуль значения типа T
+ */
+#define FORMULA_STEP(T, ABS, kind, power, x, y, cx, cy) do { \
+	if ((kind) == FRACTAL_FORMULA_POWER) { \
+		int top_ = 1; \
+		while (top_ * 2 <= (power)) \
+			top_ *= 2; \
+		T zr_ = x, zi_ = y; \
+		for (int bit_ = top_ / 2; bit_ > 0; bit_ /= 2) { \
+			T t_ = zr_ * zr_ - zi_ * zi_; \
+			zi_ = (zr_ + zr_) * zi_; \
+			zr_ = t_; \
+			if ((power) & bit_) { \
+				t_ = zr_ * x - zi_ * y; \
+				zi_ = zr_ * y + zi_ * x; \
+				zr_ = t_; \
+			} \
+		} \
+		x = zr_ + cx; \
+		y = zi_ + cy; \
+	} else { \
+		T a_ = x, b_ = y; \
+		if ((kind) == FRACTAL_FORMULA_BURNING_SHIP) { \
+			a_ = ABS(x); \
+			b_ = ABS(y); \
+		} \
+		T xtemp_ = a_ * a_ - b_ * b_ + cx; \
+		T ytemp_ = (a_ + a_) * b_; \
+		/* Tricorn итерирует сопряженное z: мнимая часть меняет знак */ \
+		y = (kind) == FRACTAL_FORMULA_TRICORN ? cy - ytemp_ : ytemp_ + cy; \
+		x = xtemp_; \
+	} \
+} while (0)
+
+/**
+ * @brief Скалярные ядра в типе T: iterate_<prec> для точки (в *steps -
+ * выполненные итерации), row_<prec> для части строки (эталон для векторных
+ * ядер) и orbit_<prec> - квадрат модуля после total итераций для сглаживания
+ */
+#define FORMULA_SCALAR(prec, T, ABS) \
+static FORMULA_INLINE int iterate_##prec(const escape_params_t *p, T x0, T y0, \
+					 fractal_formula_kind_t kind, int power, \
+					 int *steps) \
+{ \
+	T x, y, cx, cy; \
+	if (p->julia) { \
+		x = x0; \
+		y = y0; \
+		cx = (T)p->c_real; \
+		cy = (T)p->c_imag; \
+	} else { \
+		x = 0; \
+		y = 0; \
+		cx = x0; \
+		cy = y0; \
+	} \
+	T saved_x = x, saved_y = y; \
+	int check_at = ESCAPE_PERIOD_START; \
+	int iteration = 0; \
+	while (x * x + y * y <= (T)4 && iteration < p->max_iter) { \
+		FORMULA_STEP(T, ABS, kind, power, x, y, cx, cy); \
+		iteration++; \
+		if (p->periodicity) { \
+			if (x == saved_x && y == saved_y) { \
+				*steps = iteration; \
+				return p->max_iter; \
+			} \
+			if (iteration == check_at) { \
+				saved_x = x; \
+				saved_y = y; \
+				if (check_at <= INT_MAX / 2) \
+					check_at *= 2; \
+			} \
+		} \
+	} \
+	*steps = iteration; \
+	return iteration; \
+} \
+\
+static FORMULA_INLINE uint64_t row_##prec(const escape_params_t *p, \
+					  pixel_coord py, pixel_coord x_begin, \
+					  pixel_coord x_end, pixel_coord step, \
+					  int *out, fractal_formula_kind_t kind, \
+					  int power) \
+{ \
+	T y0 = (T)p->y_min + (T)(p->y_max - p->y_min) * (T)py / (T)p->height; \
+	T x_min = (T)p->x_min; \
+	T x_span = (T)(p->x_max - p->x_min); \
+	T width = (T)p->width; \
+	uint64_t total = 0; \
+	for (pixel_coord px = x_begin; px < x_end; px += step) { \
+		int steps; \
+		*out++ = iterate_##prec(p, x_min + x_span * (T)px / width, y0, \
+					kind, power, &steps); \
+		total += (unsigned int)steps; \
+	} \
+	return total; \
+} \
+\
+static double orbit_##prec(const escape_params_t *p, T x0, T y0, int total) \
+{ \
+	T x = 0, y = 0, cx = x0, cy = y0; \
+	if (p->julia) { \
+		x = x0; \
+		y = y0; \
+		cx = (T)p->c_real; \
+		cy = (T)p->c_imag; \
+	} \
+	for (int i = 0; i < total; i++) \
+		FORMULA_STEP(T, ABS, p->formula, p->power, x, y, cx, cy); \
+	/* Квадрат модуля в double: float переполнился бы раньше */ \
+	return (double)x * x + (double)y * y; \
+}
+
+FORMULA_SCALAR(double, double, fabs)
+FORMULA_SCALAR(float, float, fabsf)
+
+/**
+ * @brief Обертки скалярных ядер с постоянными видом и степенью
+ */
+#define SCALAR_KERNELS(A, name, kind, power) \
+static uint64_t row_double_##name(const escape_params_t *p, pixel_coord py, \
+				  pixel_coord x_begin, pixel_coord x_end, \
+				  pixel_coord step, int *out) \
+{ \
+	return row_double(p, py, x_begin, x_end, step, out, kind, power); \
+} \
+static uint64_t row_float_##name(const escape_params_t *p, pixel_coord py, \
+				 pixel_coord x_begin, pixel_coord x_end, \
+				 pixel_coord step, int *out) \
+{ \
+	return row_float(p, py, x_begin, x_end, step, out, kind, power); \
+}
+
+FORMULA_LIST(SCALAR_KERNELS, )
+
+/**
+ * @brief Один шаг z -> f(z) + c в паре double
+ * @see FORMULA_STEP
+ */
+static void step_dd(const escape_params_t *p, dd_t *x, dd_t *y, dd_t cx,
+		    dd_t cy)
+{
+	if (p->formula == FRACTAL_FORMULA_POWER) {
+		int top = 1;
+		while (top * 2 <= p->power)
+			top *= 2;
+		dd_t zr = *x, zi = *y;
+		for (int bit = top / 2; bit > 0; bit /= 2) {
+			dd_t t = dd_sub(dd_sqr(zr), dd_sqr(zi));
+			zi = dd_mul(dd_add(zr, zr), zi);
+			zr = t;
+			if (p->power & bit) {
+				t = dd_sub(dd_mul(zr, *x), dd_mul(zi, *y));
+				zi = dd_add(dd_mul(zr, *y), dd_mul(zi, *x));
+				zr = t;
+			}
+		}
+		*x = dd_add(zr, cx);
+		*y = dd_add(zi, cy);
+		return;
+	}
+
+	dd_t a = *x, b = *y;
+	if (p->formula == FRACTAL_FORMULA_BURNING_SHIP) {
+		a = dd_abs(a);
+		b = dd_abs(b);
+	}
+	dd_t xtemp = dd_add(dd_sub(dd_sqr(a), dd_sqr(b)), cx);
+	dd_t ytemp = dd_mul(dd_add(a, a), b);
+	*y = p->formula == FRACTAL_FORMULA_TRICORN ?
+		dd_sub(cy, ytemp) : dd_add(ytemp, cy);
+	*x = xtemp;
+}
+
+/**
+ * @brief Вычисляет количество итераций для точки (x0, y0) в паре double
+ *
+ * Ядро пар double одно на все функции: шаг арифметики пар во много раз
+ * дороже выбора функции.
+ *
+ * @param steps Выполненные итерации
+ */
+static int iterate_dd(const escape_params_t *p, dd_t x0, dd_t y0, int *steps)
+{
+	dd_t x, y, cx, cy;
+
+	if (p->julia) {
+		x = x0;
+		y = y0;
+		cx.hi = p->c_real;
+		cx.lo = 0.0;
+		cy.hi = p->c_imag;
+		cy.lo = 0.0;
+	} else {
+		x.hi = x.lo = y.hi = y.lo = 0.0;
+		cx = x0;
+		cy = y0;
+	}
+
+	dd_t saved_x = x, saved_y = y;
+	int check_at = ESCAPE_PERIOD_START;
+	int iteration = 0;
+	while (iteration < p->max_iter) {
+		// Как и для z^2 + c, выход проверяется по старшим частям
+		if (x.hi * x.hi + y.hi * y.hi > 4.0)
+			break;
+		step_dd(p, &x, &y, cx, cy);
+		iteration++;
+
+		if (p->periodicity) {
+			if (x.hi == saved_x.hi && x.lo == saved_x.lo &&
+			    y.hi == saved_y.hi && y.lo == saved_y.lo) {
+				*steps = iteration;
+				return p->max_iter;
+			}
+			if (iteration == check_at) {
+				saved_x = x;
+				saved_y = y;
+				if (check_at <= INT_MAX / 2)
+					check_at *= 2;
+			}
+		}
+	}
+	*steps = iteration;
+	return iteration;
+}
+
+/**
+ * @brief Скалярное ядро в паре double для любой функции
+ * @see escape_row_fn
+ */
+static uint64_t row_dd(const escape_params_t *p, pixel_coord py,
+		       pixel_coord x_begin, pixel_coord x_end, pixel_coord step,
+		       int *out)
+{
+	dd_t y0 = dd_coord(p->y_min, p->y_max, py, p->height);
+	uint64_t total = 0;
+	for (pixel_coord px = x_begin; px < x_end; px += step) {
+		dd_t x0 = dd_coord(p->x_min, p->x_max, px, p->width);
+		int steps;
+		*out++ = iterate_dd(p, x0, y0, &steps);
+		total += (unsigned int)steps;
+	}
+	return total;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#define FORMULA_HAVE_X86 1
+
+/*
+ * Векторы расширений GCC: арифметика записывается так же, как для скаляров,
+ * а сравнения дают маски из целых -1/0 того же размера, что и линии.
+ * Счетчики итераций - целые, поэтому точны при любом max_iter.
+ */
+typedef double v2df __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+typedef float v4sf __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef double v4df __attribute__((vector_size(32)));
+typedef long long v4di __attribute__((vector_size(32)));
+typedef float v8sf __attribute__((vector_size(32)));
+typedef int v8si __attribute__((vector_size(32)));
+typedef double v8df __attribute__((vector_size(64)));
+typedef long long v8di __attribute__((vector_size(64)));
+typedef float v16sf __attribute__((vector_size(64)));
+typedef int v16si __attribute__((vector_size(64)));
+
+// Набор инструкций каждого ядра
+#define TARGET_sse2 "sse2"
+#define TARGET_avx2 "avx2"
+#define TARGET_avx512 "avx512f"
+
+// Есть ли в маске активные линии
+#define ANY_sse2_double(m) (_mm_movemask_pd((__m128d)(m)) != 0)
+#define ANY_sse2_float(m) (_mm_movemask_ps((__m128)(m)) != 0)
+#define ANY_avx2_double(m) (_mm256_movemask_pd((__m256d)(m)) != 0)
+#define ANY_avx2_float(m) (_mm256_movemask_ps((__m256)(m)) != 0)
+#define ANY_avx512_double(m) \
+	(_mm512_test_epi64_mask((__m512i)(m), (__m512i)(m)) != 0)
+#define ANY_avx512_float(m) \
+	(_mm512_test_epi32_mask((__m512i)(m), (__m512i)(m)) != 0)
+
+// Модуль вектора: сброс знаковых битов линий (маска sign - в теле ядра)
+#define VABS(v) ((__typeof__(v))((__typeof__(sign))(v) & ~sign))
+
+/**
+ * @brief Векторное тело row_<isa>_<prec>: LANES пикселей за итерацию,
+ * остаток строки - скалярным телом
+ *
+ * @param VT,MT Типы вектора значений и вектора масок
+ * @param SIGN Знаковый бит линии
+ */
+#define FORMULA_VECTOR(isa, prec, T, VT, MT, LANES, SIGN) \
+__attribute__((target(TARGET_##isa))) \
+static FORMULA_INLINE uint64_t row_##isa##_##prec(const escape_params_t *p, \
+					      pixel_coord py, \
+					      pixel_coord x_begin, \
+					      pixel_coord x_end, \
+					      pixel_coord step, int *out, \
+					      fractal_formula_kind_t kind, \
+					      int power) \
+{ \
+	T y0 = (T)p->y_min + (T)(p->y_max - p->y_min) * (T)py / (T)p->height; \
+	T x_min = (T)p->x_min; \
+	T x_span = (T)(p->x_max - p->x_min); \
+	T width = (T)p->width; \
+	const VT zero = { 0 }; \
+	const MT none = { 0 }; \
+	const MT sign = none + (SIGN); \
+	const MT max_iter = none + p->max_iter; \
+	pixel_coord px = x_begin; \
+	uint64_t total = 0; \
+\
+	for (; px + (LANES - 1) * step < x_end; px += LANES * step, out += LANES) { \
+		/* Координаты точек так же, как в скалярном ядре */ \
+		VT idx; \
+		for (int k = 0; k < LANES; k++) \
+			idx[k] = (T)(px + k * step); \
+		VT x0 = x_min + x_span * idx / width; \
+		VT x, y, cx, cy; \
+		if (p->julia) { \
+			x = x0; \
+			y = zero + y0; \
+			cx = zero + (T)p->c_real; \
+			cy = zero + (T)p->c_imag; \
+		} else { \
+			x = zero; \
+			y = zero; \
+			cx = x0; \
+			cy = zero + y0; \
+		} \
+\
+		MT count = none; \
+		MT steps = none; \
+		MT active = none - 1; \
+		VT saved_x = x, saved_y = y; \
+		int check_at = ESCAPE_PERIOD_START; \
+		for (int i = 0; i < p->max_iter; i++) { \
+			active &= x * x + y * y <= (T)4; \
+			if (!ANY_##isa##_##prec(active)) \
+				break; \
+			/* Маска активной линии равна -1 */ \
+			count -= active; \
+			steps -= active; \
+			FORMULA_STEP(VT, VABS, kind, power, x, y, cx, cy); \
+\
+			if (p->periodicity) { \
+				MT cycle = active & (x == saved_x) & (y == saved_y); \
+				count = (count & ~cycle) | (cycle & max_iter); \
+				active &= ~cycle; \
+				if (i + 1 == check_at) { \
+					saved_x = x; \
+					saved_y = y; \
+					if (check_at <= INT_MAX / 2) \
+						check_at *= 2; \
+				} \
+			} \
+		} \
+		for (int k = 0; k < LANES; k++) { \
+			out[k] = (int)count[k]; \
+			total += (uint64_t)steps[k]; \
+		} \
+	} \
+\
+	return total + row_##prec(p, py, px, x_end, step, out, kind, power); \
+}
+
+FORMULA_VECTOR(sse2, double, double, v2df, v2di, 2, LLONG_MIN)
+FORMULA_VECTOR(sse2, float, float, v4sf, v4si, 4, INT_MIN)
+FORMULA_VECTOR(avx2, double, double, v4df, v4di, 4, LLONG_MIN)
+FORMULA_VECTOR(avx2, float, float, v8sf, v8si, 8, INT_MIN)
+FORMULA_VECTOR(avx512, double, double, v8df, v8di, 8, LLONG_MIN)
+FORMULA_VECTOR(avx512, float, float, v16sf, v16si, 16, INT_MIN)
+
+/**
+ * @brief Обертки векторных ядер набора isa с постоянными видом и степенью
+ */
+#define VECTOR_KERNELS(isa, name, kind, power) \
+__attribute__((target(TARGET_##isa))) \
+static uint64_t row_##isa##_double_##name(const escape_params_t *p, \
+					  pixel_coord py, pixel_coord x_begin, \
+					  pixel_coord x_end, pixel_coord step, \
+					  int *out) \
+{ \
+	return row_##isa##_double(p, py, x_begin, x_end, step, out, kind, power); \
+} \
+__attribute__((target(TARGET_##isa))) \
+static uint64_t row_##isa##_float_##name(const escape_params_t *p, \
+					 pixel_coord py, pixel_coord x_begin, \
+					 pixel_coord x_end, pixel_coord step, \
+					 int *out) \
+{ \
+	return row_##isa##_float(p, py, x_begin, x_end, step, out, kind, power); \
+}
+
+FORMULA_LIST(VECTOR_KERNELS, sse2)
+FORMULA_LIST(VECTOR_KERNELS, avx2)
+FORMULA_LIST(VECTOR_KERNELS, avx512)
+
+#endif /* __GNUC__ && x86 */
+
+// Элемент таблицы ядер
+#define KERNEL_ENTRY(prefix, name, kind, power) prefix##name,
+
+/**
+ * @brief Функции в порядке FORMULA_LIST (индексы таблиц ядер)
+ */
+static const struct {
+	fractal_formula_kind_t kind;
+	int power;
+} formulas[] = {
+#define FORMULA_ENTRY(A, name, kind, power) { kind, power },
+	FORMULA_LIST(FORMULA_ENTRY, )
+#undef FORMULA_ENTRY
+};
+
+/**
+ * @brief Ядра по наборам инструкций (fractal_simd_t) и функциям
+ */
+static const escape_row_fn kernels_double[][sizeof(formulas) / sizeof(formulas[0])] = {
+	[FRACTAL_SIMD_SCALAR] = { FORMULA_LIST(KERNEL_ENTRY, row_double_) },
+#ifdef FORMULA_HAVE_X86
+	[FRACTAL_SIMD_SSE2] = { FORMULA_LIST(KERNEL_ENTRY, row_sse2_double_) },
+	[FRACTAL_SIMD_AVX2] = { FORMULA_LIST(KERNEL_ENTRY, row_avx2_double_) },
+	[FRACTAL_SIMD_AVX512] = { FORMULA_LIST(KERNEL_ENTRY, row_avx512_double_) },
+#endif
+};
+
+static const escape_row_fn kernels_float[][sizeof(formulas) / sizeof(formulas[0])] = {
+	[FRACTAL_SIMD_SCALAR] = { FORMULA_LIST(KERNEL_ENTRY, row_float_) },
+#ifdef FORMULA_HAVE_X86
+	[FRACTAL_SIMD_SSE2] = { FORMULA_LIST(KERNEL_ENTRY, row_sse2_float_) },
+	[FRACTAL_SIMD_AVX2] = { FORMULA_LIST(KERNEL_ENTRY, row_avx2_float_) },
+	[FRACTAL_SIMD_AVX512] = { FORMULA_LIST(KERNEL_ENTRY, row_avx512_float_) },
+#endif
+};
+
+escape_row_fn escape_formula_kernel(fractal_simd_t simd,
+				    fractal_precision_t precision,
+				    const escape_params_t *p)
+{
+	assert(p != NULL);
+	assert(!escape_is_quadratic(p));
+
+	if (precision == FRACTAL_PRECISION_DOUBLE_DOUBLE)
+		return simd == FRACTAL_SIMD_SCALAR ? row_dd : NULL;
+
+	size_t count = sizeof(formulas) / sizeof(formulas[0]);
+	size_t f = 0;
+	while (f < count && !(formulas[f].kind == p->formula &&
+			      (p->formula != FRACTAL_FORMULA_POWER ||
+			       formulas[f].power == p->power)))
+		f++;
+	assert(f < count);
+
+	size_t levels = sizeof(kernels_double) / sizeof(kernels_double[0]);
+	if (f == count || simd < FRACTAL_SIMD_SCALAR || (size_t)simd >= levels)
+		return NULL;
+	return precision == FRACTAL_PRECISION_FLOAT ?
+		kernels_float[simd][f] : kernels_double[simd][f];
+}
+
+/**
+ * @brief Количество итераций сглаживания сверх выхода
+ *
+ * После выхода |z| растет как 2^(d^k) для функции степени d; итераций
+ * столько, чтобы d^k не превышало 16 (для d = 2 - ESCAPE_SMOOTH_EXTRA)
+ * и модуль не переполнял float.
+ */
+static int smooth_extra(const escape_params_t *p)
+{
+	int d = p->formula == FRACTAL_FORMULA_POWER ? p->power : 2;
+	int extra = 0;
+	for (int m = d; m <= 16; m *= d)
+		extra++;
+	return extra;
+}
+
+int escape_formula_sample(const escape_params_t *p,
+			  fractal_precision_t precision, double fx, double fy)
+{
+	assert(p != NULL);
+	int steps;
+
+	switch (precision) {
+	case FRACTAL_PRECISION_FLOAT:
+		return iterate_float(p, (float)p->x_min +
+				     (float)(p->x_max - p->x_min) * (float)fx /
+				     (float)p->width,
+				     (float)p->y_min +
+				     (float)(p->y_max - p->y_min) * (float)fy /
+				     (float)p->height,
+				     p->formula, p->power, &steps);
+	case FRACTAL_PRECISION_DOUBLE_DOUBLE:
+		return iterate_dd(p, dd_coord(p->x_min, p->x_max, fx, p->width),
+				  dd_coord(p->y_min, p->y_max, fy, p->height),
+				  &steps);
+	default:
+		return iterate_double(p, p->x_min +
+				      (p->x_max - p->x_min) * fx / p->width,
+				      p->y_min +
+				      (p->y_max - p->y_min) * fy / p->height,
+				      p->formula, p->power, &steps);
+	}
+}
+
+double escape_formula_smooth(const escape_params_t *p,
+			     fractal_precision_t precision, pixel_coord px,
+			     pixel_coord py, int n)
+{
+	assert(p != NULL);
+	int total = n + smooth_extra(p);
+	double r2;
+
+	switch (precision) {
+	case FRACTAL_PRECISION_FLOAT:
+		r2 = orbit_float(p, (float)p->x_min +
+				 (float)(p->x_max - p->x_min) * (float)px /
+				 (float)p->width,
+				 (float)p->y_min +
+				 (float)(p->y_max - p->y_min) * (float)py /
+				 (float)p->height, total);
+		break;
+	case FRACTAL_PRECISION_DOUBLE_DOUBLE: {
+		dd_t x0 = dd_coord(p->x_min, p->x_max, px, p->width);
+		dd_t y0 = dd_coord(p->y_min, p->y_max, py, p->height);
+		dd_t x = { 0.0, 0.0 }, y = { 0.0, 0.0 }, cx = x0, cy = y0;
+		if (p->julia) {
+			x = x0;
+			y = y0;
+			cx.hi = p->c_real;
+			cx.lo = 0.0;
+			cy.hi = p->c_imag;
+			cy.lo = 0.0;
+		}
+		for (int i = 0; i < total; i++)
+			step_dd(p, &x, &y, cx, cy);
+		r2 = x.hi * x.hi + y.hi * y.hi;
+		break;
+	}
+	default:
+		r2 = orbit_double(p, p->x_min + (p->x_max - p->x_min) * px / p->width,
+				  p->y_min + (p->y_max - p->y_min) * py / p->height,
+				  total);
+	}
+
+	// n + 1 - log_d(log2 |z|): для степени d двойной логарифм растет на log2 d
+	double d = p->formula == FRACTAL_FORMULA_POWER ? p->power : 2;
+	return total + 1 - log2(0.5 * log2(r2)) / log2(d);
+}
@@ -0,0 +1,304 @@
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddouble.h"
+#include "escape.h"
+
+/*
+ * Ядра пониженной и повышенной точности.
+ *
+ * float вдвое сокращает данные на пиксель, поэтому векторные ядра float
+ * (escape_simd.c) обрабатывают вдвое больше пикселей за итерацию, но
+ * ошибка округления копится с каждой итерацией, и на границе множества
+ * отдельные пиксели отличаются от double. Поэтому автоматически float
+ * выбирается только с большим запасом (ESCAPE_FLOAT_MARGIN). Пара double (hi + lo, |lo| <= ulp(hi)/2)
+ * хранит около 106 бит мантиссы и нужна, когда шаг пикселя приближается
+ * к ulp double: точки соседних пикселей в double совпадали бы.
+ *
+ * Арифметика пар - в ddouble.h.
+ */
+
+/**
+ * @brief Разбирает значение переменной окружения FRACTAL_PRECISION
+ */
+static fractal_precision_t precision_from_env(void)
+{
+	const char *env = getenv("FRACTAL_PRECISION");
+	if (env == NULL)
+		return FRACTAL_PRECISION_AUTO;
+	if (strcmp(env, "float") == 0)
+		return FRACTAL_PRECISION_FLOAT;
+	if (strcmp(env, "double") == 0)
+		return FRACTAL_PRECISION_DOUBLE;
+	if (strcmp(env, "dd") == 0)
+		return FRACTAL_PRECISION_DOUBLE_DOUBLE;
+	return FRACTAL_PRECISION_AUTO;
+}
+
+fractal_precision_t escape_select_precision(const escape_params_t *p,
+					    fractal_precision_t precision)
+{
+	assert(p != NULL);
+
+	// Точки глубокого увеличения - смещения от опорной орбиты в double
+	if (p->reference != NULL)
+		return FRACTAL_PRECISION_DOUBLE;
+
+	if (precision == FRACTAL_PRECISION_AUTO)
+		precision = precision_from_env();
+	if (precision == FRACTAL_PRECISION_AUTO) {
+		double sx = (p->x_max - p->x_min) / p->width;
+		double sy = (p->y_max - p->y_min) / p->height;
+		double spacing = sx < sy ? sx : sy;
+		double error = (double)p->max_iter * ESCAPE_FLOAT_ULP;
+		if (error * ESCAPE_FLOAT_MARGIN <= spacing)
+			precision = FRACTAL_PRECISION_FLOAT;
+		else if (spacing >= ESCAPE_DOUBLE_SPACING)
+			precision = FRACTAL_PRECISION_DOUBLE;
+		else
+			precision = FRACTAL_PRECISION_DOUBLE_DOUBLE;
+	}
+	if (precision == FRACTAL_PRECISION_FLOAT &&
+	    p->max_iter > ESCAPE_FLOAT_MAX_ITER)
+		precision = FRACTAL_PRECISION_DOUBLE;
+	return precision;
+}
+
+/**
+ * @brief Проверка главной кардиоиды и круга периода 2 в float
+ * @see escape_in_interior
+ */
+static inline bool in_interior_float(float x, float y)
+{
+	float y2 = y * y;
+	float xq = x - 0.25f;
+	float q = xq * xq + y2;
+	if (q * (q + xq) < 0.25f * y2)
+		return true;
+	float xb = x + 1.0f;
+	return xb * xb + y2 < 0.0625f;
+}
+
+/**
+ * @brief Вычисляет количество итераций для точки (x0, y0) в float
+ *
+ * Порядок операций совпадает с векторными ядрами float.
+ *
+ * @param steps Выполненные итерации
+ */
+static int iterate_float(const escape_params_t *p, float x0, float y0,
+			 int *steps)
+{
+	float x, y, cx, cy;
+
+	if (p->julia) {
+		x = x0;
+		y = y0;
+		cx = (float)p->c_real;
+		cy = (float)p->c_imag;
+	} else {
+		x = 0.0f;
+		y = 0.0f;
+		cx = x0;
+		cy = y0;
+	}
+
+	*steps = 0;
+	if (p->interior_check && !p->julia && in_interior_float(cx, cy))
+		return p->max_iter;
+
+	float saved_x = x, saved_y = y;
+	int check_at = ESCAPE_PERIOD_START;
+	int iteration = 0;
+	while (x * x + y * y <= 4.0f && iteration < p->max_iter) {
+		float xtemp = x * x - y * y + cx;
+		y = 2.0f * x * y + cy;
+		x = xtemp;
+		iteration++;
+
+		if (p->periodicity) {
+			if (x == saved_x && y == saved_y) {
+				*steps = iteration;
+				return p->max_iter;
+			}
+			if (iteration == check_at) {
+				saved_x = x;
+				saved_y = y;
+				if (check_at <= INT_MAX / 2)
+					check_at *= 2;
+			}
+		}
+	}
+	*steps = iteration;
+	return iteration;
+}
+
+uint64_t escape_row_float(const escape_params_t *p, pixel_coord py,
+			  pixel_coord x_begin, pixel_coord x_end,
+			  pixel_coord step, int *out)
+{
+	assert(p != NULL);
+	assert(out != NULL);
+	assert(step > 0);
+	assert(x_end <= p->width);
+
+	// Координаты вычисляются в float так же, как в векторных ядрах
+	float y0 = (float)p->y_min +
+		(float)(p->y_max - p->y_min) * (float)py / (float)p->height;
+	float x_min = (float)p->x_min;
+	float x_span = (float)(p->x_max - p->x_min);
+	float width = (float)p->width;
+	uint64_t total = 0;
+
+	for (pixel_coord px = x_begin; px < x_end; px += step) {
+		float x0 = x_min + x_span * (float)px / width;
+		int steps;
+		*out++ = iterate_float(p, x0, y0, &steps);
+		total += (unsigned int)steps;
+	}
+	return total;
+}
+
+/**
+ * @brief Вычисляет количество итераций для точки (x0, y0) в паре double
+ * @see iterate_float
+ */
+static int iterate_dd(const escape_params_t *p, dd_t x0, dd_t y0, int *steps)
+{
+	dd_t x, y, cx, cy;
+
+	if (p->julia) {
+		x = x0;
+		y = y0;
+		cx.hi = p->c_real;
+		cx.lo = 0.0;
+		cy.hi = p->c_imag;
+		cy.lo = 0.0;
+	} else {
+		x.hi = x.lo = y.hi = y.lo = 0.0;
+		cx = x0;
+		cy = y0;
+	}
+
+	// Погрешность старшей части не влияет на отсечение внутренности
+	*steps = 0;
+	if (p->interior_check && !p->julia && escape_in_interior(cx.hi, cy.hi))
+		return p->max_iter;
+
+	dd_t saved_x = x, saved_y = y;
+	int check_at = ESCAPE_PERIOD_START;
+	int iteration = 0;
+	while (iteration < p->max_iter) {
+		dd_t x2 = dd_sqr(x), y2 = dd_sqr(y);
+		if (x2.hi + y2.hi > 4.0)
+			break;
+		dd_t xtemp = dd_add(dd_sub(x2, y2), cx);
+		y = dd_add(dd_mul_d(dd_mul(x, y), 2.0), cy);
+		x = xtemp;
+		iteration++;
+
+		if (p->periodicity) {
+			if (x.hi == saved_x.hi && x.lo == saved_x.lo &&
+			    y.hi == saved_y.hi && y.lo == saved_y.lo) {
+				*steps = iteration;
+				return p->max_iter;
+			}
+			if (iteration == check_at) {
+				saved_x = x;
+				saved_y = y;
+				if (check_at <= INT_MAX / 2)
+					check_at *= 2;
+			}
+		}
+	}
+	*steps = iteration;
+	return iteration;
+}
+
+uint64_t escape_row_dd(const escape_params_t *p, pixel_coord py,
+		       pixel_coord x_begin, pixel_coord x_end,
+		       pixel_coord step, int *out)
+{
+	assert(p != NULL);
+	assert(out != NULL);
+	assert(step > 0);
+	assert(x_end <= p->width);
+
+	dd_t y0 = dd_coord(p->y_min, p->y_max, py, p->height);
+	uint64_t total = 0;
+	for (pixel_coord px = x_begin; px < x_end; px += step) {
+		dd_t x0 = dd_coord(p->x_min, p->x_max, px, p->width);
+		int steps;
+		*out++ = iterate_dd(p, x0, y0, &steps);
+		total += (unsigned int)steps;
+	}
+	return total;
+}
+
+int escape_sample_precision(const escape_params_t *p,
+			    fractal_precision_t precision, double fx, double fy)
+{
+	assert(p != NULL);
+	int steps;
+
+	if (precision == FRACTAL_PRECISION_FLOAT) {
+		float x0 = (float)p->x_min +
+			(float)(p->x_max - p->x_min) * (float)fx / (float)p->width;
+		float y0 = (float)p->y_min +
+			(float)(p->y_max - p->y_min) * (float)fy / (float)p->height;
+		return iterate_float(p, x0, y0, &steps);
+	}
+	return iterate_dd(p, dd_coord(p->x_min, p->x_max, fx, p->width),
+			  dd_coord(p->y_min, p->y_max, fy, p->height), &steps);
+}
+
+double escape_smooth_precision(const escape_params_t *p,
+			       fractal_precision_t precision, pixel_coord px,
+			       pixel_coord py, int n)
+{
+	assert(p != NULL);
+	int total = n + ESCAPE_SMOOTH_EXTRA;
+
+	if (precision == FRACTAL_PRECISION_FLOAT) {
+		float y0 = (float)p->y_min +
+			(float)(p->y_max - p->y_min) * (float)py / (float)p->height;
+		float x0 = (float)p->x_min +
+			(float)(p->x_max - p->x_min) * (float)px / (float)p->width;
+		float x = 0.0f, y = 0.0f, cx = x0, cy = y0;
+		if (p->julia) {
+			x = x0;
+			y = y0;
+			cx = (float)p->c_real;
+			cy = (float)p->c_imag;
+		}
+		for (int i = 0; i < total; i++) {
+			float xtemp = x * x - y * y + cx;
+			y = 2.0f * x * y + cy;
+			x = xtemp;
+		}
+		// Модуль в double: после дополнительных итераций float переполнился бы
+		return total + 1 - log2(0.5 * log2((double)x * x + (double)y * y));
+	}
+
+	dd_t x0 = dd_coord(p->x_min, p->x_max, px, p->width);
+	dd_t y0 = dd_coord(p->y_min, p->y_max, py, p->height);
+	dd_t x = { 0.0, 0.0 }, y = { 0.0, 0.0 }, cx = x0, cy = y0;
+	if (p->julia) {
+		x = x0;
+		y = y0;
+		cx.hi = p->c_real;
+		cx.lo = 0.0;
+		cy.hi = p->c_imag;
+		cy.lo = 0.0;
+	}
+	for (int i = 0; i < total; i++) {
+		dd_t xtemp = dd_add(dd_sub(dd_sqr(x), dd_sqr(y)), cx);
+		y = dd_add(dd_mul_d(dd_mul(x, y), 2.0), cy);
+		x = xtemp;
+	}
+	// Дробной части хватает точности старших частей
+	return total + 1 - log2(0.5 * log2(x.hi * x.hi + y.hi * y.hi));
+}
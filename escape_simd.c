@@ -0,0 +1,730 @@
+#include <limits.h>
+#include <stddef.h>
+
+#include "escape.h"
+
+/*
+ * Векторные ядра вычисляют итерации сразу для нескольких соседних пикселей
+ * строки. Каждая линия вектора хранит свою маску активности: после выхода
+ * точки за радиус 2 линия перестает учитываться в счетчике, а цикл
+ * завершается, когда вышли все линии. Порядок операций совпадает со
+ * скалярным ядром, а сжатие в FMA запрещено флагом -ffp-contract=off,
+ * поэтому результаты побайтово совпадают со скалярным кодом.
+ *
+ * Ядра собираются только для GCC/Clang на x86; набор инструкций выбирается
+ * во время выполнения по CPUID, сама сборка не требует -mavx2 и т.п.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#define ESCAPE_HAVE_X86 1
+
+/**
+ * @brief Суммирует выполненные итерации линий вектора
+ *
+ * Итерации считаются отдельным от count вектором: count линий, отсеченных
+ * проверкой кардиоиды или периодичности, заменяется на max_iter.
+ */
+static inline uint64_t sum_lanes(const int *lanes, int count)
+{
+	uint64_t total = 0;
+	for (int k = 0; k < count; k++)
+		total += (unsigned int)lanes[k];
+	return total;
+}
+
+/**
+ * @brief Маска линий внутри главной кардиоиды или круга периода 2 (SSE2)
+ * @see escape_in_interior
+ */
+__attribute__((target("sse2")))
+static inline __m128d interior_mask_sse2(__m128d x, __m128d y)
+{
+	__m128d y2 = _mm_mul_pd(y, y);
+	__m128d xq = _mm_sub_pd(x, _mm_set1_pd(0.25));
+	__m128d q = _mm_add_pd(_mm_mul_pd(xq, xq), y2);
+	__m128d cardioid = _mm_cmplt_pd(_mm_mul_pd(q, _mm_add_pd(q, xq)),
+					_mm_mul_pd(_mm_set1_pd(0.25), y2));
+	__m128d xb = _mm_add_pd(x, _mm_set1_pd(1.0));
+	__m128d bulb = _mm_cmplt_pd(_mm_add_pd(_mm_mul_pd(xb, xb), y2),
+				    _mm_set1_pd(0.0625));
+	return _mm_or_pd(cardioid, bulb);
+}
+
+/**
+ * @brief Ядро SSE2: 2 пикселя за итерацию
+ */
+__attribute__((target("sse2")))
+static uint64_t escape_row_sse2(const escape_params_t *p, pixel_coord py,
+				pixel_coord x_begin, pixel_coord x_end,
+				pixel_coord step, int *out)
+{
+	double y0 = p->y_min + (p->y_max - p->y_min) * py / p->height;
+	const __m128d four = _mm_set1_pd(4.0);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d x_min = _mm_set1_pd(p->x_min);
+	const __m128d x_span = _mm_set1_pd(p->x_max - p->x_min);
+	const __m128d width = _mm_set1_pd((double)p->width);
+	const __m128d max_iter = _mm_set1_pd((double)p->max_iter);
+	bool interior = p->interior_check && !p->julia;
+	pixel_coord px = x_begin;
+	uint64_t total = 0;
+
+	for (; px + step < x_end; px += 2 * step, out += 2) {
+		// Координаты точек так же, как в скалярном ядре
+		__m128d idx = _mm_set_pd((double)(px + step), (double)px);
+		__m128d x0 = _mm_add_pd(x_min, _mm_div_pd(_mm_mul_pd(x_span, idx), width));
+		__m128d x, y, cx, cy;
+
+		if (p->julia) {
+			x = x0;
+			y = _mm_set1_pd(y0);
+			cx = _mm_set1_pd(p->c_real);
+			cy = _mm_set1_pd(p->c_imag);
+		} else {
+			x = _mm_setzero_pd();
+			y = _mm_setzero_pd();
+			cx = x0;
+			cy = _mm_set1_pd(y0);
+		}
+
+		__m128d count = _mm_setzero_pd();
+		__m128d steps = _mm_setzero_pd();
+		__m128d active = _mm_castsi128_pd(_mm_set1_epi32(-1));
+		if (interior) {
+			// Линии внутри кардиоиды или круга сразу получают max_iter
+			__m128d inside = interior_mask_sse2(cx, cy);
+			count = _mm_and_pd(inside, max_iter);
+			active = _mm_andnot_pd(inside, active);
+		}
+
+		__m128d saved_x = x, saved_y = y;
+		int check_at = ESCAPE_PERIOD_START;
+		for (int i = 0; i < p->max_iter; i++) {
+			__m128d x2 = _mm_mul_pd(x, x);
+			__m128d y2 = _mm_mul_pd(y, y);
+			active = _mm_and_pd(active, _mm_cmple_pd(_mm_add_pd(x2, y2), four));
+			if (_mm_movemask_pd(active) == 0)
+				break;
+			count = _mm_add_pd(count, _mm_and_pd(active, one));
+			steps = _mm_add_pd(steps, _mm_and_pd(active, one));
+			__m128d xtemp = _mm_add_pd(_mm_sub_pd(x2, y2), cx);
+			y = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, x), y), cy);
+			x = xtemp;
+
+			if (p->periodicity) {
+				// Зациклившиеся линии получают max_iter и выключаются
+				__m128d cycle = _mm_and_pd(active,
+					_mm_and_pd(_mm_cmpeq_pd(x, saved_x), _mm_cmpeq_pd(y, saved_y)));
+				count = _mm_or_pd(_mm_andnot_pd(cycle, count),
+						  _mm_and_pd(cycle, max_iter));
+				active = _mm_andnot_pd(cycle, active);
+				if (i + 1 == check_at) {
+					saved_x = x;
+					saved_y = y;
+					if (check_at <= INT_MAX / 2)
+						check_at *= 2;
+				}
+			}
+		}
+		_mm_storel_epi64((__m128i *)out, _mm_cvtpd_epi32(count));
+		int lanes[2];
+		_mm_storel_epi64((__m128i *)lanes, _mm_cvtpd_epi32(steps));
+		total += sum_lanes(lanes, 2);
+	}
+
+	// Оставшиеся пиксели - скалярным ядром
+	return total + escape_row_scalar(p, py, px, x_end, step, out);
+}
+
+/**
+ * @brief Маска линий внутри главной кардиоиды или круга периода 2 (AVX2)
+ * @see escape_in_interior
+ */
+__attribute__((target("avx2")))
+static inline __m256d interior_mask_avx2(__m256d x, __m256d y)
+{
+	__m256d y2 = _mm256_mul_pd(y, y);
+	__m256d xq = _mm256_sub_pd(x, _mm256_set1_pd(0.25));
+	__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), y2);
+	__m256d cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)),
+					 _mm256_mul_pd(_mm256_set1_pd(0.25), y2),
+					 _CMP_LT_OQ);
+	__m256d xb = _mm256_add_pd(x, _mm256_set1_pd(1.0));
+	__m256d bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(xb, xb), y2),
+				     _mm256_set1_pd(0.0625), _CMP_LT_OQ);
+	return _mm256_or_pd(cardioid, bulb);
+}
+
+/**
+ * @brief Ядро AVX2: 4 пикселя за итерацию
+ */
+__attribute__((target("avx2")))
+static uint64_t escape_row_avx2(const escape_params_t *p, pixel_coord py,
+				pixel_coord x_begin, pixel_coord x_end,
+				pixel_coord step, int *out)
+{
+	double y0 = p->y_min + (p->y_max - p->y_min) * py / p->height;
+	const __m256d four = _mm256_set1_pd(4.0);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d x_min = _mm256_set1_pd(p->x_min);
+	const __m256d x_span = _mm256_set1_pd(p->x_max - p->x_min);
+	const __m256d width = _mm256_set1_pd((double)p->width);
+	const __m256d max_iter = _mm256_set1_pd((double)p->max_iter);
+	bool interior = p->interior_check && !p->julia;
+	pixel_coord px = x_begin;
+	uint64_t total = 0;
+
+	for (; px + 3 * step < x_end; px += 4 * step, out += 4) {
+		__m256d idx = _mm256_set_pd((double)(px + 3 * step), (double)(px + 2 * step),
+					    (double)(px + step), (double)px);
+		__m256d x0 = _mm256_add_pd(x_min,
+					   _mm256_div_pd(_mm256_mul_pd(x_span, idx), width));
+		__m256d x, y, cx, cy;
+
+		if (p->julia) {
+			x = x0;
+			y = _mm256_set1_pd(y0);
+			cx = _mm256_set1_pd(p->c_real);
+			cy = _mm256_set1_pd(p->c_imag);
+		} else {
+			x = _mm256_setzero_pd();
+			y = _mm256_setzero_pd();
+			cx = x0;
+			cy = _mm256_set1_pd(y0);
+		}
+
+		__m256d count = _mm256_setzero_pd();
+		__m256d steps = _mm256_setzero_pd();
+		__m256d active = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+		if (interior) {
+			__m256d inside = interior_mask_avx2(cx, cy);
+			count = _mm256_and_pd(inside, max_iter);
+			active = _mm256_andnot_pd(inside, active);
+		}
+
+		__m256d saved_x = x, saved_y = y;
+		int check_at = ESCAPE_PERIOD_START;
+		for (int i = 0; i < p->max_iter; i++) {
+			__m256d x2 = _mm256_mul_pd(x, x);
+			__m256d y2 = _mm256_mul_pd(y, y);
+			active = _mm256_and_pd(active,
+					       _mm256_cmp_pd(_mm256_add_pd(x2, y2), four, _CMP_LE_OQ));
+			if (_mm256_movemask_pd(active) == 0)
+				break;
+			count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+			steps = _mm256_add_pd(steps, _mm256_and_pd(active, one));
+			__m256d xtemp = _mm256_add_pd(_mm256_sub_pd(x2, y2), cx);
+			y = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, x), y), cy);
+			x = xtemp;
+
+			if (p->periodicity) {
+				__m256d cycle = _mm256_and_pd(active, _mm256_and_pd(
+					_mm256_cmp_pd(x, saved_x, _CMP_EQ_OQ),
+					_mm256_cmp_pd(y, saved_y, _CMP_EQ_OQ)));
+				count = _mm256_blendv_pd(count, max_iter, cycle);
+				active = _mm256_andnot_pd(cycle, active);
+				if (i + 1 == check_at) {
+					saved_x = x;
+					saved_y = y;
+					if (check_at <= INT_MAX / 2)
+						check_at *= 2;
+				}
+			}
+		}
+		_mm_storeu_si128((__m128i *)out, _mm256_cvtpd_epi32(count));
+		int lanes[4];
+		_mm_storeu_si128((__m128i *)lanes, _mm256_cvtpd_epi32(steps));
+		total += sum_lanes(lanes, 4);
+	}
+
+	return total + escape_row_scalar(p, py, px, x_end, step, out);
+}
+
+/**
+ * @brief Маска линий внутри главной кардиоиды или круга периода 2 (AVX-512F)
+ * @see escape_in_interior
+ */
+__attribute__((target("avx512f")))
+static inline __mmask8 interior_mask_avx512(__m512d x, __m512d y)
+{
+	__m512d y2 = _mm512_mul_pd(y, y);
+	__m512d xq = _mm512_sub_pd(x, _mm512_set1_pd(0.25));
+	__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), y2);
+	__mmask8 cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)),
+					       _mm512_mul_pd(_mm512_set1_pd(0.25), y2),
+					       _CMP_LT_OQ);
+	__m512d xb = _mm512_add_pd(x, _mm512_set1_pd(1.0));
+	__mmask8 bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(xb, xb), y2),
+					   _mm512_set1_pd(0.0625), _CMP_LT_OQ);
+	return cardioid | bulb;
+}
+
+/**
+ * @brief Ядро AVX-512F: 8 пикселей за итерацию
+ */
+__attribute__((target("avx512f")))
+static uint64_t escape_row_avx512(const escape_params_t *p, pixel_coord py,
+				  pixel_coord x_begin, pixel_coord x_end,
+				  pixel_coord step, int *out)
+{
+	double y0 = p->y_min + (p->y_max - p->y_min) * py / p->height;
+	const __m512d four = _mm512_set1_pd(4.0);
+	const __m512d two = _mm512_set1_pd(2.0);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d x_min = _mm512_set1_pd(p->x_min);
+	const __m512d x_span = _mm512_set1_pd(p->x_max - p->x_min);
+	const __m512d width = _mm512_set1_pd((double)p->width);
+	const __m512d max_iter = _mm512_set1_pd((double)p->max_iter);
+	bool interior = p->interior_check && !p->julia;
+	pixel_coord px = x_begin;
+	uint64_t total = 0;
+
+	for (; px + 7 * step < x_end; px += 8 * step, out += 8) {
+		__m512d idx = _mm512_set_pd((double)(px + 7 * step), (double)(px + 6 * step),
+					    (double)(px + 5 * step), (double)(px + 4 * step),
+					    (double)(px + 3 * step), (double)(px + 2 * step),
+					    (double)(px + step), (double)px);
+		__m512d x0 = _mm512_add_pd(x_min,
+					   _mm512_div_pd(_mm512_mul_pd(x_span, idx), width));
+		__m512d x, y, cx, cy;
+
+		if (p->julia) {
+			x = x0;
+			y = _mm512_set1_pd(y0);
+			cx = _mm512_set1_pd(p->c_real);
+			cy = _mm512_set1_pd(p->c_imag);
+		} else {
+			x = _mm512_setzero_pd();
+			y = _mm512_setzero_pd();
+			cx = x0;
+			cy = _mm512_set1_pd(y0);
+		}
+
+		__m512d count = _mm512_setzero_pd();
+		__m512d steps = _mm512_setzero_pd();
+		__mmask8 active = 0xFF;
+		if (interior) {
+			__mmask8 inside = interior_mask_avx512(cx, cy);
+			count = _mm512_mask_mov_pd(count, inside, max_iter);
+			active &= (__mmask8)~inside;
+		}
+
+		__m512d saved_x = x, saved_y = y;
+		int check_at = ESCAPE_PERIOD_START;
+		for (int i = 0; i < p->max_iter; i++) {
+			__m512d x2 = _mm512_mul_pd(x, x);
+			__m512d y2 = _mm512_mul_pd(y, y);
+			active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(x2, y2),
+							 four, _CMP_LE_OQ);
+			if (active == 0)
+				break;
+			count = _mm512_mask_add_pd(count, active, count, one);
+			steps = _mm512_mask_add_pd(steps, active, steps, one);
+			__m512d xtemp = _mm512_add_pd(_mm512_sub_pd(x2, y2), cx);
+			y = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, x), y), cy);
+			x = xtemp;
+
+			if (p->periodicity) {
+				__mmask8 cycle = _mm512_mask_cmp_pd_mask(
+					_mm512_mask_cmp_pd_mask(active, x, saved_x, _CMP_EQ_OQ),
+					y, saved_y, _CMP_EQ_OQ);
+				count = _mm512_mask_mov_pd(count, cycle, max_iter);
+				active &= (__mmask8)~cycle;
+				if (i + 1 == check_at) {
+					saved_x = x;
+					saved_y = y;
+					if (check_at <= INT_MAX / 2)
+						check_at *= 2;
+				}
+			}
+		}
+		_mm256_storeu_si256((__m256i *)out, _mm512_cvtpd_epi32(count));
+		int lanes[8];
+		_mm256_storeu_si256((__m256i *)lanes, _mm512_cvtpd_epi32(steps));
+		total += sum_lanes(lanes, 8);
+	}
+
+	return total + escape_row_scalar(p, py, px, x_end, step, out);
+}
+
+/*
+ * Ядра float: вдвое больше линий в векторе той же ширины. Координаты
+ * точек и порядок операций совпадают с escape_row_float, счетчики в float
+ * точны до ESCAPE_FLOAT_MAX_ITER.
+ */
+
+/**
+ * @brief Номера столбцов линий вектора в float (как (float)px в скалярном ядре)
+ */
+static inline void float_columns(float *idx, int lanes, pixel_coord px,
+				 pixel_coord step)
+{
+	for (int k = 0; k < lanes; k++)
+		idx[k] = (float)(px + k * step);
+}
+
+/**
+ * @brief Маска линий внутри главной кардиоиды или круга периода 2 (SSE2, float)
+ */
+__attribute__((target("sse2")))
+static inline __m128 interior_mask_sse2_float(__m128 x, __m128 y)
+{
+	__m128 y2 = _mm_mul_ps(y, y);
+	__m128 xq = _mm_sub_ps(x, _mm_set1_ps(0.25f));
+	__m128 q = _mm_add_ps(_mm_mul_ps(xq, xq), y2);
+	__m128 cardioid = _mm_cmplt_ps(_mm_mul_ps(q, _mm_add_ps(q, xq)),
+				       _mm_mul_ps(_mm_set1_ps(0.25f), y2));
+	__m128 xb = _mm_add_ps(x, _mm_set1_ps(1.0f));
+	__m128 bulb = _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(xb, xb), y2),
+				   _mm_set1_ps(0.0625f));
+	return _mm_or_ps(cardioid, bulb);
+}
+
+/**
+ * @brief Ядро SSE2 в float: 4 пикселя за итерацию
+ */
+__attribute__((target("sse2")))
+static uint64_t escape_row_sse2_float(const escape_params_t *p, pixel_coord py,
+				      pixel_coord x_begin, pixel_coord x_end,
+				      pixel_coord step, int *out)
+{
+	float y0 = (float)p->y_min +
+		(float)(p->y_max - p->y_min) * (float)py / (float)p->height;
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 x_min = _mm_set1_ps((float)p->x_min);
+	const __m128 x_span = _mm_set1_ps((float)(p->x_max - p->x_min));
+	const __m128 width = _mm_set1_ps((float)p->width);
+	const __m128 max_iter = _mm_set1_ps((float)p->max_iter);
+	bool interior = p->interior_check && !p->julia;
+	pixel_coord px = x_begin;
+	uint64_t total = 0;
+	float idx[4];
+
+	for (; px + 3 * step < x_end; px += 4 * step, out += 4) {
+		float_columns(idx, 4, px, step);
+		__m128 x0 = _mm_add_ps(x_min, _mm_div_ps(_mm_mul_ps(x_span,
+						_mm_loadu_ps(idx)), width));
+		__m128 x, y, cx, cy;
+
+		if (p->julia) {
+			x = x0;
+			y = _mm_set1_ps(y0);
+			cx = _mm_set1_ps((float)p->c_real);
+			cy = _mm_set1_ps((float)p->c_imag);
+		} else {
+			x = _mm_setzero_ps();
+			y = _mm_setzero_ps();
+			cx = x0;
+			cy = _mm_set1_ps(y0);
+		}
+
+		__m128 count = _mm_setzero_ps();
+		__m128 steps = _mm_setzero_ps();
+		__m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		if (interior) {
+			__m128 inside = interior_mask_sse2_float(cx, cy);
+			count = _mm_and_ps(inside, max_iter);
+			active = _mm_andnot_ps(inside, active);
+		}
+
+		__m128 saved_x = x, saved_y = y;
+		int check_at = ESCAPE_PERIOD_START;
+		for (int i = 0; i < p->max_iter; i++) {
+			__m128 x2 = _mm_mul_ps(x, x);
+			__m128 y2 = _mm_mul_ps(y, y);
+			active = _mm_and_ps(active, _mm_cmple_ps(_mm_add_ps(x2, y2), four));
+			if (_mm_movemask_ps(active) == 0)
+				break;
+			count = _mm_add_ps(count, _mm_and_ps(active, one));
+			steps = _mm_add_ps(steps, _mm_and_ps(active, one));
+			__m128 xtemp = _mm_add_ps(_mm_sub_ps(x2, y2), cx);
+			y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, x), y), cy);
+			x = xtemp;
+
+			if (p->periodicity) {
+				__m128 cycle = _mm_and_ps(active,
+					_mm_and_ps(_mm_cmpeq_ps(x, saved_x), _mm_cmpeq_ps(y, saved_y)));
+				count = _mm_or_ps(_mm_andnot_ps(cycle, count),
+						  _mm_and_ps(cycle, max_iter));
+				active = _mm_andnot_ps(cycle, active);
+				if (i + 1 == check_at) {
+					saved_x = x;
+					saved_y = y;
+					if (check_at <= INT_MAX / 2)
+						check_at *= 2;
+				}
+			}
+		}
+		_mm_storeu_si128((__m128i *)out, _mm_cvtps_epi32(count));
+		int lanes[4];
+		_mm_storeu_si128((__m128i *)lanes, _mm_cvtps_epi32(steps));
+		total += sum_lanes(lanes, 4);
+	}
+
+	return total + escape_row_float(p, py, px, x_end, step, out);
+}
+
+/**
+ * @brief Маска линий внутри главной кардиоиды или круга периода 2 (AVX2, float)
+ */
+__attribute__((target("avx2")))
+static inline __m256 interior_mask_avx2_float(__m256 x, __m256 y)
+{
+	__m256 y2 = _mm256_mul_ps(y, y);
+	__m256 xq = _mm256_sub_ps(x, _mm256_set1_ps(0.25f));
+	__m256 q = _mm256_add_ps(_mm256_mul_ps(xq, xq), y2);
+	__m256 cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xq)),
+					_mm256_mul_ps(_mm256_set1_ps(0.25f), y2),
+					_CMP_LT_OQ);
+	__m256 xb = _mm256_add_ps(x, _mm256_set1_ps(1.0f));
+	__m256 bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(xb, xb), y2),
+				    _mm256_set1_ps(0.0625f), _CMP_LT_OQ);
+	return _mm256_or_ps(cardioid, bulb);
+}
+
+/**
+ * @brief Ядро AVX2 в float: 8 пикселей за итерацию
+ */
+__attribute__((target("avx2")))
+static uint64_t escape_row_avx2_float(const escape_params_t *p, pixel_coord py,
+				      pixel_coord x_begin, pixel_coord x_end,
+				      pixel_coord step, int *out)
+{
+	float y0 = (float)p->y_min +
+		(float)(p->y_max - p->y_min) * (float)py / (float)p->height;
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 x_min = _mm256_set1_ps((float)p->x_min);
+	const __m256 x_span = _mm256_set1_ps((float)(p->x_max - p->x_min));
+	const __m256 width = _mm256_set1_ps((float)p->width);
+	const __m256 max_iter = _mm256_set1_ps((float)p->max_iter);
+	bool interior = p->interior_check && !p->julia;
+	pixel_coord px = x_begin;
+	uint64_t total = 0;
+	float idx[8];
+
+	for (; px + 7 * step < x_end; px += 8 * step, out += 8) {
+		float_columns(idx, 8, px, step);
+		__m256 x0 = _mm256_add_ps(x_min, _mm256_div_ps(_mm256_mul_ps(x_span,
+						_mm256_loadu_ps(idx)), width));
+		__m256 x, y, cx, cy;
+
+		if (p->julia) {
+			x = x0;
+			y = _mm256_set1_ps(y0);
+			cx = _mm256_set1_ps((float)p->c_real);
+			cy = _mm256_set1_ps((float)p->c_imag);
+		} else {
+			x = _mm256_setzero_ps();
+			y = _mm256_setzero_ps();
+			cx = x0;
+			cy = _mm256_set1_ps(y0);
+		}
+
+		__m256 count = _mm256_setzero_ps();
+		__m256 steps = _mm256_setzero_ps();
+		__m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		if (interior) {
+			__m256 inside = interior_mask_avx2_float(cx, cy);
+			count = _mm256_and_ps(inside, max_iter);
+			active = _mm256_andnot_ps(inside, active);
+		}
+
+		__m256 saved_x = x, saved_y = y;
+		int check_at = ESCAPE_PERIOD_START;
+		for (int i = 0; i < p->max_iter; i++) {
+			__m256 x2 = _mm256_mul_ps(x, x);
+			__m256 y2 = _mm256_mul_ps(y, y);
+			active = _mm256_and_ps(active,
+					       _mm256_cmp_ps(_mm256_add_ps(x2, y2), four, _CMP_LE_OQ));
+			if (_mm256_movemask_ps(active) == 0)
+				break;
+			count = _mm256_add_ps(count, _mm256_and_ps(active, one));
+			steps = _mm256_add_ps(steps, _mm256_and_ps(active, one));
+			__m256 xtemp = _mm256_add_ps(_mm256_sub_ps(x2, y2), cx);
+			y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, x), y), cy);
+			x = xtemp;
+
+			if (p->periodicity) {
+				__m256 cycle = _mm256_and_ps(active, _mm256_and_ps(
+					_mm256_cmp_ps(x, saved_x, _CMP_EQ_OQ),
+					_mm256_cmp_ps(y, saved_y, _CMP_EQ_OQ)));
+				count = _mm256_blendv_ps(count, max_iter, cycle);
+				active = _mm256_andnot_ps(cycle, active);
+				if (i + 1 == check_at) {
+					saved_x = x;
+					saved_y = y;
+					if (check_at <= INT_MAX / 2)
+						check_at *= 2;
+				}
+			}
+		}
+		_mm256_storeu_si256((__m256i *)out, _mm256_cvtps_epi32(count));
+		int lanes[8];
+		_mm256_storeu_si256((__m256i *)lanes, _mm256_cvtps_epi32(steps));
+		total += sum_lanes(lanes, 8);
+	}
+
+	return total + escape_row_float(p, py, px, x_end, step, out);
+}
+
+/**
+ * @brief Маска линий внутри главной кардиоиды или круга периода 2
+ * (AVX-512F, float)
+ */
+__attribute__((target("avx512f")))
+static inline __mmask16 interior_mask_avx512_float(__m512 x, __m512 y)
+{
+	__m512 y2 = _mm512_mul_ps(y, y);
+	__m512 xq = _mm512_sub_ps(x, _mm512_set1_ps(0.25f));
+	__m512 q = _mm512_add_ps(_mm512_mul_ps(xq, xq), y2);
+	__mmask16 cardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xq)),
+						_mm512_mul_ps(_mm512_set1_ps(0.25f), y2),
+						_CMP_LT_OQ);
+	__m512 xb = _mm512_add_ps(x, _mm512_set1_ps(1.0f));
+	__mmask16 bulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(xb, xb), y2),
+					    _mm512_set1_ps(0.0625f), _CMP_LT_OQ);
+	return cardioid | bulb;
+}
+
+/**
+ * @brief Ядро AVX-512F в float: 16 пикселей за итерацию
+ */
+__attribute__((target("avx512f")))
+static uint64_t escape_row_avx512_float(const escape_params_t *p, pixel_coord py,
+					pixel_coord x_begin, pixel_coord x_end,
+					pixel_coord step, int *out)
+{
+	float y0 = (float)p->y_min +
+		(float)(p->y_max - p->y_min) * (float)py / (float)p->height;
+	const __m512 four = _mm512_set1_ps(4.0f);
+	const __m512 two = _mm512_set1_ps(2.0f);
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 x_min = _mm512_set1_ps((float)p->x_min);
+	const __m512 x_span = _mm512_set1_ps((float)(p->x_max - p->x_min));
+	const __m512 width = _mm512_set1_ps((float)p->width);
+	const __m512 max_iter = _mm512_set1_ps((float)p->max_iter);
+	bool interior = p->interior_check && !p->julia;
+	pixel_coord px = x_begin;
+	uint64_t total = 0;
+	float idx[16];
+
+	for (; px + 15 * step < x_end; px += 16 * step, out += 16) {
+		float_columns(idx, 16, px, step);
+		__m512 x0 = _mm512_add_ps(x_min, _mm512_div_ps(_mm512_mul_ps(x_span,
+						_mm512_loadu_ps(idx)), width));
+		__m512 x, y, cx, cy;
+
+		if (p->julia) {
+			x = x0;
+			y = _mm512_set1_ps(y0);
+			cx = _mm512_set1_ps((float)p->c_real);
+			cy = _mm512_set1_ps((float)p->c_imag);
+		} else {
+			x = _mm512_setzero_ps();
+			y = _mm512_setzero_ps();
+			cx = x0;
+			cy = _mm512_set1_ps(y0);
+		}
+
+		__m512 count = _mm512_setzero_ps();
+		__m512 steps = _mm512_setzero_ps();
+		__mmask16 active = 0xFFFF;
+		if (interior) {
+			__mmask16 inside = interior_mask_avx512_float(cx, cy);
+			count = _mm512_mask_mov_ps(count, inside, max_iter);
+			active &= (__mmask16)~inside;
+		}
+
+		__m512 saved_x = x, saved_y = y;
+		int check_at = ESCAPE_PERIOD_START;
+		for (int i = 0; i < p->max_iter; i++) {
+			__m512 x2 = _mm512_mul_ps(x, x);
+			__m512 y2 = _mm512_mul_ps(y, y);
+			active = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(x2, y2),
+							 four, _CMP_LE_OQ);
+			if (active == 0)
+				break;
+			count = _mm512_mask_add_ps(count, active, count, one);
+			steps = _mm512_mask_add_ps(steps, active, steps, one);
+			__m512 xtemp = _mm512_add_ps(_mm512_sub_ps(x2, y2), cx);
+			y = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(two, x), y), cy);
+			x = xtemp;
+
+			if (p->periodicity) {
+				__mmask16 cycle = _mm512_mask_cmp_ps_mask(
+					_mm512_mask_cmp_ps_mask(active, x, saved_x, _CMP_EQ_OQ),
+					y, saved_y, _CMP_EQ_OQ);
+				count = _mm512_mask_mov_ps(count, cycle, max_iter);
+				active &= (__mmask16)~cycle;
+				if (i + 1 == check_at) {
+					saved_x = x;
+					saved_y = y;
+					if (check_at <= INT_MAX / 2)
+						check_at *= 2;
+				}
+			}
+		}
+		_mm512_storeu_si512((void *)out, _mm512_cvtps_epi32(count));
+		int lanes[16];
+		_mm512_storeu_si512((void *)lanes, _mm512_cvtps_epi32(steps));
+		total += sum_lanes(lanes, 16);
+	}
+
+	return total + escape_row_float(p, py, px, x_end, step, out);
+}
+
+#endif /* __GNUC__ && x86 */
+
+fractal_simd_t escape_simd_best(void)
+{
+#ifdef ESCAPE_HAVE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return FRACTAL_SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return FRACTAL_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return FRACTAL_SIMD_SSE2;
+#endif
+	return FRACTAL_SIMD_SCALAR;
+}
+
+escape_row_fn escape_simd_kernel(fractal_simd_t simd)
+{
+	switch (simd) {
+#ifdef ESCAPE_HAVE_X86
+	case FRACTAL_SIMD_SSE2:
+		return escape_row_sse2;
+	case FRACTAL_SIMD_AVX2:
+		return escape_row_avx2;
+	case FRACTAL_SIMD_AVX512:
+		return escape_row_avx512;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+escape_row_fn escape_simd_kernel_float(fractal_simd_t simd)
+{
+	switch (simd) {
+#ifdef ESCAPE_HAVE_X86
+	case FRACTAL_SIMD_SSE2:
+		return escape_row_sse2_float;
+	case FRACTAL_SIMD_AVX2:
+		return escape_row_avx2_float;
+	case FRACTAL_SIMD_AVX512:
+		return escape_row_avx512_float;
+#endif
+	default:
+		return NULL;
+	}
+}
@@ -1,9 +1,19 @@
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h> 
+#include <string.h>
 #include "image.h"
 #include "fractal.h"
+#include "escape.h"
+#include "metrics.h"
+#include "perturb.h"
+#include "pool.h"
 
+/**
+ * @brief Число пи
+ */
+#define FRACTAL_PI 3.14159265358979323846
 
 void empty_fractal(image_p picture)
 {
@@ -13,13 +23,15 @@ void empty_fractal(image_p picture)
 }
 
 /**
- * @brief Вспомогательная функция для рисования линии алгоритмом Брезенхэма
+ * @brief Рисует линию алгоритмом Брезенхэма
+ *
+ * @param view Изображение
+ * @param lighten true - пиксель получает больший из старого цвета и color,
+ * false - цвет color
  */
-static void draw_line(image_p picture, int x0, int y0, int x1, int y1,
-		      pixel_data color)
+static void draw_line_view(const image_view_t *view, int x0, int y0, int x1,
+			   int y1, pixel_data color, bool lighten)
 {
-	assert(picture != NULL);
-	
 	// Разницы координат
 	int dx = abs(x1 - x0);
 	int dy = abs(y1 - y0);
@@ -32,9 +44,9 @@ static void draw_line(image_p picture, int x0, int y0, int x1, int y1,
 	// Основной цикл алгоритма Брезенхэма
 	while (1) {
 		// Устанавливаем пиксель, если он в пределах изображения
-		if (x0 >= 0 && x0 < (int)get_image_width(picture) &&
-		    y0 >= 0 && y0 < (int)get_image_height(picture))
-			set_pixel(picture, x0, y0, color);
+		if (image_view_contains(view, x0, y0) &&
+		    (!lighten || image_view_get(view, x0, y0) < color))
+			image_view_set(view, x0, y0, color);
 		
 		// Если достигли конечной точки, выходим
 		if (x0 == x1 && y0 == y1)
@@ -53,6 +65,181 @@ static void draw_line(image_p picture, int x0, int y0, int x1, int y1,
 	}
 }
 
+/**
+ * @brief Вспомогательная функция для рисования линии алгоритмом Брезенхэма
+ */
+static void draw_line(image_p picture, int x0, int y0, int x1, int y1,
+		      pixel_data color)
+{
+	assert(picture != NULL);
+	image_view_t view = image_get_view(picture);
+	draw_line_view(&view, x0, y0, x1, y1, color, false);
+}
+
+/**
+ * @brief Смешивает цвет пикселя с color с покрытием coverage / 256
+ * (точка (x, y) в транспонированных координатах, если steep)
+ */
+static inline void blend_pixel(const image_view_t *view, int x, int y,
+			       bool steep, pixel_data color, int coverage)
+{
+	if (steep) {
+		int t = x;
+		x = y;
+		y = t;
+	}
+	if (coverage <= 0 || !image_view_contains(view, x, y))
+		return;
+	pixel_data *p = image_view_row(view, y) + x;
+	*p = (pixel_data)(*p + ((int)color - *p) * coverage / 256);
+}
+
+/**
+ * @brief Рисует сглаженную линию алгоритмом Ву с дробными концами
+ *
+ * Пиксель (x, y) имеет центр в точке (x, y). Вдоль основной оси линия
+ * проходит по два пикселя на шаг; их покрытия - дробная часть и ее
+ * дополнение. Концы учитываются с долей покрытия по основной оси, а сама
+ * линия проходится в фиксированной точке 16.16.
+ *
+ * @param view Изображение
+ * @param x0,y0,x1,y1 Концы линии
+ * @param color Цвет, с которым смешиваются пиксели
+ */
+static void draw_line_aa(const image_view_t *view, double x0, double y0,
+			 double x1, double y1, pixel_data color)
+{
+	// NaN и бесконечность нельзя привести к целым координатам
+	if (!isfinite(x0) || !isfinite(y0) || !isfinite(x1) || !isfinite(y1))
+		return;
+	// Основная ось - та, вдоль которой линия длиннее
+	bool steep = fabs(y1 - y0) > fabs(x1 - x0);
+	if (steep) {
+		double t;
+		t = x0; x0 = y0; y0 = t;
+		t = x1; x1 = y1; y1 = t;
+	}
+	if (x0 > x1) {
+		double t;
+		t = x0; x0 = x1; x1 = t;
+		t = y0; y0 = y1; y1 = t;
+	}
+	double dx = x1 - x0;
+	double gradient = dx > 0.0 ? (y1 - y0) / dx : 1.0;
+	if (!isfinite(gradient))
+		return;
+	// Предел по основной оси (ширина или высота изображения)
+	long long limit = steep ? view->height : view->width;
+	if (x1 < -1.0 || x0 > (double)limit)
+		return;
+	/* Отсекаем отрезок по основной оси до [-1, limit + 1]: отброшенные
+	   части не попадают в изображение. |gradient| <= 1, поэтому у
+	   пересекающего изображение отрезка и координаты по дополнительной
+	   оси не дальше limit + 2 от края и помещаются в int. Дальше они
+	   бывают только из-за потери точности у очень длинных отрезков */
+	if (x0 < -1.0) {
+		y0 += gradient * (-1.0 - x0);
+		x0 = -1.0;
+	}
+	if (x1 > (double)limit + 1.0) {
+		y1 -= gradient * (x1 - ((double)limit + 1.0));
+		x1 = (double)limit + 1.0;
+	}
+	// Линия целиком выше или ниже изображения
+	double minor = steep ? view->width : view->height;
+	if ((y0 < -1.0 && y1 < -1.0) || (y0 > minor + 1.0 && y1 > minor + 1.0))
+		return;
+	double reach = (double)limit + 3.0;
+	if (y0 < -reach || y1 < -reach || y0 > minor + reach || y1 > minor + reach)
+		return;
+	
+	/* Концы: покрытие по основной оси равно доле пикселя, занятой
+	   линией */
+	int x_first = (int)floor(x0 + 0.5);
+	int x_last = (int)floor(x1 + 0.5);
+	if (x_first == x_last) {
+		// Вся линия внутри одного столбца
+		double y = y0 + gradient * (x_first - x0);
+		double fy = y - floor(y);
+		int cov = (int)((x1 - x0) * 256.0);
+		blend_pixel(view, x_first, (int)floor(y), steep, color,
+			    (int)(cov * (1.0 - fy)));
+		blend_pixel(view, x_first, (int)floor(y) + 1, steep, color,
+			    (int)(cov * fy));
+		return;
+	}
+	double ends[2][2] = {
+		{ x_first, (x_first + 0.5) - x0 },
+		{ x_last, x1 - (x_last - 0.5) },
+	};
+	for (int e = 0; e < 2; e++) {
+		int x = (int)ends[e][0];
+		double y = y0 + gradient * (x - x0);
+		double fy = y - floor(y);
+		int gap = (int)(ends[e][1] * 256.0);
+		blend_pixel(view, x, (int)floor(y), steep, color,
+			    (int)(gap * (1.0 - fy)));
+		blend_pixel(view, x, (int)floor(y) + 1, steep, color,
+			    (int)(gap * fy));
+	}
+	
+	// Внутренние столбцы, обрезанные по изображению
+	long long x_begin = x_first + 1;
+	long long x_end = x_last;       // Не включительно
+	if (x_begin < 0)
+		x_begin = 0;
+	if (x_end > limit)
+		x_end = limit;
+	if (x_begin >= x_end)
+		return;
+	double y_begin = y0 + gradient * (x_begin - x0);
+	int64_t inter = (int64_t)floor(y_begin * 65536.0);
+	int64_t step = (int64_t)floor(gradient * 65536.0 + 0.5);
+	for (long long x = x_begin; x < x_end; x++, inter += step) {
+		int y = (int)(inter >> 16);
+		int frac = (int)((inter >> 8) & 0xFF);
+		blend_pixel(view, (int)x, y, steep, color, 256 - frac);
+		blend_pixel(view, (int)x, y + 1, steep, color, frac);
+	}
+}
+
+/**
+ * @brief Деление с округлением вниз (b > 0)
+ */
+static long long floor_div(long long a, long long b)
+{
+	long long q = a / b;
+	return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+/**
+ * @brief Сужает отрезок [lo, hi] до точек x, в которых все три функции
+ * a_i x + b_i имеют знак sign или равны нулю
+ *
+ * @returns true, если отрезок не пуст
+ */
+static bool triangle_span(const long long a[3], const long long b[3],
+			  int sign, long long *lo, long long *hi)
+{
+	for (int i = 0; i < 3; i++) {
+		// Условие a x + b >= 0
+		long long ai = a[i] * sign;
+		long long bi = b[i] * sign;
+		if (ai > 0) {
+			long long x = -floor_div(bi, ai);   // ceil(-b / a)
+			if (x > *lo)
+				*lo = x;
+		} else if (ai < 0) {
+			long long x = floor_div(bi, -ai);
+			if (x < *hi)
+				*hi = x;
+		} else if (bi < 0) {
+			return false;
+		}
+	}
+	return *lo <= *hi;
+}
+
 /**
  * @brief Вспомогательная функция для рисования закрашенного треугольника
  */
@@ -66,7 +253,11 @@ static void draw_filled_triangle(image_p picture, int x1, int y1, int x2,
 	draw_line(picture, x2, y2, x3, y3, color);
 	draw_line(picture, x3, y3, x1, y1, color);
 	
-	/* Простая заливка - метод сканирующих строк */
+	/* Заливка сканирующими строками: точка (x, y) принадлежит треугольнику,
+	   если три векторных произведения не имеют разных знаков. В строке y
+	   каждое произведение линейно по x: d_i(x) = a_i x + b_i, поэтому
+	   точки с d_i >= 0 (или d_i <= 0) для всех i образуют отрезок,
+	   который заливается целиком */
 	// Находим минимальную и максимальную Y-координаты
 	int min_y = y1;
 	int max_y = y1;
@@ -80,121 +271,243 @@ static void draw_filled_triangle(image_p picture, int x1, int y1, int x2,
 	if (y3 > max_y)
 		max_y = y3;
 	
-	// Сканируем каждую строку между min_y и max_y
+	image_view_t view = image_get_view(picture);
+	// Отсекаем строки вне изображения
+	if (min_y < 0)
+		min_y = 0;
+	if (max_y >= (int)view.height)
+		max_y = (int)view.height - 1;
+	
+	// Коэффициенты при x не зависят от строки
+	long long a[3] = { y1 - y2, y2 - y3, y3 - y1 };
+	
 	for (int y = min_y; y <= max_y; y++) {
-		// Пропускаем строки вне изображения
-		if (y < 0 || y >= (int)get_image_height(picture))
-			continue;
+		long long b[3] = {
+			-(long long)x2 * (y1 - y2) - (long long)(x1 - x2) * (y - y2),
+			-(long long)x3 * (y2 - y3) - (long long)(x2 - x3) * (y - y3),
+			-(long long)x1 * (y3 - y1) - (long long)(x3 - x1) * (y - y1),
+		};
+		pixel_data *row = image_view_row(&view, y);
 		
-		// Проверяем каждый пиксель в строке
-		for (int x = 0; x < (int)get_image_width(picture); x++) {
-			/* Проверка принадлежности точки треугольнику 
-			   с использованием барицентрических координат */
-			// Вычисляем векторные произведения
-			int d1 = (x - x2) * (y1 - y2) - (x1 - x2) * (y - y2);
-			int d2 = (x - x3) * (y2 - y3) - (x2 - x3) * (y - y3);
-			int d3 = (x - x1) * (y3 - y1) - (x3 - x1) * (y - y1);
-			
-			// Проверяем знаки векторных произведений
-			int has_neg = (d1 < 0) || (d2 < 0) || (d3 < 0);
-			int has_pos = (d1 > 0) || (d2 > 0) || (d3 > 0);
-			
-			// Если все три имеют одинаковый знак, точка внутри треугольника
-			if (!(has_neg && has_pos))
-				set_pixel(picture, x, y, color);
+		// Отрезки с неотрицательными и неположительными произведениями
+		for (int sign = 1; sign >= -1; sign -= 2) {
+			long long lo = 0, hi = (long long)view.width - 1;
+			if (triangle_span(a, b, sign, &lo, &hi))
+				memset(row + lo, color, (size_t)(hi - lo + 1));
 		}
 	}
 }
 
+void fractal_options_init(fractal_options_t *opt)
+{
+	assert(opt != NULL);
+	opt->threads = 0;
+	opt->simd = FRACTAL_SIMD_AUTO;
+	opt->precision = FRACTAL_PRECISION_AUTO;
+	opt->interior_check = true;
+	opt->periodicity = true;
+	opt->strategy = FRACTAL_STRATEGY_BRUTE;
+	opt->progressive_step = 8;
+	opt->progress = NULL;
+	opt->progress_data = NULL;
+	opt->antialias = 0;
+	opt->antialias_jitter = false;
+	opt->smooth = false;
+	opt->cache = NULL;
+}
+
+/**
+ * @brief Параметры рендеринга исходных mandelbrot_fractal и julia_fractal
+ *
+ * Точность - всегда double, как до появления выбора точности, чтобы
+ * результат не менялся.
+ */
+static fractal_options_t legacy_options(void)
+{
+	fractal_options_t opt;
+	fractal_options_init(&opt);
+	opt.precision = FRACTAL_PRECISION_DOUBLE;
+	return opt;
+}
+
 void mandelbrot_fractal(image_p picture, double x_min, double x_max,
 			double y_min, double y_max, int max_iter)
 {
-	assert(picture != NULL);
+	fractal_options_t opt = legacy_options();
+	mandelbrot_fractal_ex(picture, x_min, x_max, y_min, y_max, max_iter,
+			      &opt);
+}
+
+/**
+ * @brief Заполняет описание вида для итерируемой функции
+ */
+static escape_params_t formula_params(const fractal_formula_t *formula,
+				      pixel_coord width, pixel_coord height,
+				      double x_min, double x_max, double y_min,
+				      double y_max, int max_iter)
+{
+	assert(formula != NULL);
 	assert(max_iter > 0);
 	assert(x_max > x_min);
 	assert(y_max > y_min);
+	assert(formula->kind != FRACTAL_FORMULA_POWER ||
+	       (formula->power >= 0 && formula->power != 1 &&
+		formula->power <= FRACTAL_POWER_MAX));
 	
-	// Получаем размеры изображения
-	pixel_coord width = get_image_width(picture);
-	pixel_coord height = get_image_height(picture);
+	/* Для Мандельброта z0 = 0, а точка пикселя играет роль c; для Жюлиа
+	   точка пикселя - начальное значение, c фиксирована */
+	escape_params_t params = {
+		.width = width,
+		.height = height,
+		.x_min = x_min, .x_max = x_max,
+		.y_min = y_min, .y_max = y_max,
+		.max_iter = max_iter,
+		.formula = formula->kind,
+		.power = formula->kind == FRACTAL_FORMULA_POWER ? formula->power : 2,
+		.julia = formula->julia,
+		.c_real = formula->c_real, .c_imag = formula->c_imag,
+	};
+	if (params.power == 0)
+		params.power = 2;
+	return params;
+}
+
+void formula_fractal_ex(image_p picture, const fractal_formula_t *formula,
+			double x_min, double x_max, double y_min, double y_max,
+			int max_iter, const fractal_options_t *opt)
+{
+	assert(picture != NULL);
 	
-	// Обрабатываем каждый пиксель изображения
-	for (pixel_coord py = 0; py < height; py++) {
-		for (pixel_coord px = 0; px < width; px++) {
-			// Преобразуем координаты пикселя в координаты комплексной плоскости
-			double x0 = x_min + (x_max - x_min) * px / width;
-			double y0 = y_min + (y_max - y_min) * py / height;
-			
-			// Итерации для проверки принадлежности множеству Мандельброта
-			double x = 0.0;
-			double y = 0.0;
-			int iteration = 0;
-			
-			// Критерий остановки: |z| > 2 или достигнут max_iter
-			while (x * x + y * y <= 4.0 && iteration < max_iter) {
-				double xtemp = x * x - y * y + x0;
-				y = 2.0 * x * y + y0;
-				x = xtemp;
-				iteration++;
-			}
-			
-			/* Сопоставляем количество итераций с оттенком серого */
-			// Если точка принадлежит множеству - черный цвет, иначе градации серого
-			pixel_data color = (iteration == max_iter) ? 0 :
-				(pixel_data)(255 * iteration / max_iter);
-			set_pixel(picture, px, py, color);
-		}
-	}
+	escape_params_t params = formula_params(formula,
+						get_image_width(picture),
+						get_image_height(picture),
+						x_min, x_max, y_min, y_max,
+						max_iter);
+	escape_render(picture, &params, opt);
 }
 
-void julia_fractal(image_p picture, double c_real, double c_imag,
-		   double x_min, double x_max, double y_min, double y_max,
-		   int max_iter)
+int formula_fractal_stream(image_writer_p writer,
+			   const fractal_formula_t *formula, double x_min,
+			   double x_max, double y_min, double y_max,
+			   int max_iter, const fractal_options_t *opt)
+{
+	assert(writer != NULL);
+	
+	escape_params_t params = formula_params(formula,
+						image_writer_width(writer),
+						image_writer_height(writer),
+						x_min, x_max, y_min, y_max,
+						max_iter);
+	return escape_render_stream(writer, &params, opt);
+}
+
+void formula_fractal_window(image_p picture, const fractal_formula_t *formula,
+			    pixel_coord width, pixel_coord height,
+			    pixel_coord x0, pixel_coord y0, double x_min,
+			    double x_max, double y_min, double y_max,
+			    int max_iter, const fractal_options_t *opt)
 {
 	assert(picture != NULL);
+	assert(x0 + get_image_width(picture) <= width);
+	assert(y0 + get_image_height(picture) <= height);
+	
+	escape_params_t params = formula_params(formula, width, height,
+						x_min, x_max, y_min, y_max,
+						max_iter);
+	escape_render_window(picture, &params, opt, x0, y0);
+}
+
+void mandelbrot_fractal_ex(image_p picture, double x_min, double x_max,
+			   double y_min, double y_max, int max_iter,
+			   const fractal_options_t *opt)
+{
+	fractal_formula_t formula = { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 };
+	formula_fractal_ex(picture, &formula, x_min, x_max, y_min, y_max,
+			   max_iter, opt);
+}
+
+int mandelbrot_fractal_stream(image_writer_p writer, double x_min,
+			      double x_max, double y_min, double y_max,
+			      int max_iter, const fractal_options_t *opt)
+{
+	fractal_formula_t formula = { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 };
+	return formula_fractal_stream(writer, &formula, x_min, x_max, y_min,
+				      y_max, max_iter, opt);
+}
+
+int mandelbrot_deep_fractal(image_p picture, const char *center_re,
+			    const char *center_im, double span, int max_iter,
+			    const fractal_options_t *opt)
+{
+	assert(picture != NULL);
+	assert(center_re != NULL && center_im != NULL);
 	assert(max_iter > 0);
-	assert(x_max > x_min);
-	assert(y_max > y_min);
+	assert(span > 0.0);
 	
-	// Получаем размеры изображения
 	pixel_coord width = get_image_width(picture);
 	pixel_coord height = get_image_height(picture);
+	double span_y = span * height / width;
 	
-	// Обрабатываем каждый пиксель изображения
-	for (pixel_coord py = 0; py < height; py++) {
-		for (pixel_coord px = 0; px < width; px++) {
-			// Преобразуем координаты пикселя в координаты комплексной плоскости
-			double x = x_min + (x_max - x_min) * px / width;
-			double y = y_min + (y_max - y_min) * py / height;
-			
-			int iteration = 0;
-			
-			// Итерации для проверки принадлежности множеству Жюлиа
-			// Используем фиксированную константу c вместо начальной точки
-			while (x * x + y * y <= 4.0 && iteration < max_iter) {
-				double xtemp = x * x - y * y + c_real;
-				y = 2.0 * x * y + c_imag;
-				x = xtemp;
-				iteration++;
-			}
-			
-			/* Сопоставляем количество итераций с оттенком серого */
-			// Если точка принадлежит множеству - черный цвет, иначе градации серого
-			pixel_data color = (iteration == max_iter) ? 0 :
-				(pixel_data)(255 * iteration / max_iter);
-			set_pixel(picture, px, py, color);
-		}
-	}
+	// Опорная орбита центра вида с нужной точностью
+	escape_reference_t *ref = perturb_reference_create(center_re, center_im,
+							    span / width, max_iter);
+	if (ref == NULL)
+		return -1;
+	
+	// Область вида задается смещениями от центра
+	escape_params_t params = {
+		.width = width,
+		.height = height,
+		.x_min = -span / 2, .x_max = span / 2,
+		.y_min = -span_y / 2, .y_max = span_y / 2,
+		.max_iter = max_iter,
+		.julia = false,
+		.reference = ref,
+	};
+	escape_render(picture, &params, opt);
+	
+	perturb_reference_free(ref);
+	return 0;
 }
 
-void sierpinski_triangle(image_p picture, int x, int y, int size, int depth)
+void julia_fractal(image_p picture, double c_real, double c_imag,
+		   double x_min, double x_max, double y_min, double y_max,
+		   int max_iter)
 {
-	assert(picture != NULL);
-	assert(size > 0);
-	assert(depth >= 0);
-	
-	// Базовый случай рекурсии
-	if (depth == 0) {
+	fractal_options_t opt = legacy_options();
+	julia_fractal_ex(picture, c_real, c_imag, x_min, x_max, y_min, y_max,
+			 max_iter, &opt);
+}
+
+void julia_fractal_ex(image_p picture, double c_real, double c_imag,
+		      double x_min, double x_max, double y_min, double y_max,
+		      int max_iter, const fractal_options_t *opt)
+{
+	fractal_formula_t formula = { FRACTAL_FORMULA_POWER, 2, true,
+				      c_real, c_imag };
+	formula_fractal_ex(picture, &formula, x_min, x_max, y_min, y_max,
+			   max_iter, opt);
+}
+
+int julia_fractal_stream(image_writer_p writer, double c_real, double c_imag,
+			 double x_min, double x_max, double y_min, double y_max,
+			 int max_iter, const fractal_options_t *opt)
+{
+	fractal_formula_t formula = { FRACTAL_FORMULA_POWER, 2, true,
+				      c_real, c_imag };
+	return formula_fractal_stream(writer, &formula, x_min, x_max, y_min,
+				      y_max, max_iter, opt);
+}
+
+/**
+ * @brief Рекурсивно рисует треугольник Серпинского (см. sierpinski_triangle)
+ */
+static void sierpinski_level(image_p picture, int x, int y, int size,
+			     int depth)
+{
+	/* Базовый случай рекурсии. Треугольник размером 1 пиксель дальше не
+	   делится: листья нулевого размера исходная рекурсия запрещала */
+	if (depth == 0 || size < 2) {
 		/* Рисуем закрашенный треугольник */
 		// Вершины равностороннего треугольника
 		int x1 = x;              // Верхняя вершина
@@ -210,43 +523,593 @@ void sierpinski_triangle(image_p picture, int x, int y, int size, int depth)
 		int new_size = size / 2;
 		
 		/* Верхний треугольник */
-		sierpinski_triangle(picture, x, y, new_size, depth - 1);
+		sierpinski_level(picture, x, y, new_size, depth - 1);
 		
 		/* Левый нижний треугольник */
-		sierpinski_triangle(picture, x - new_size / 2, y + new_size,
-				    new_size, depth - 1);
+		sierpinski_level(picture, x - new_size / 2, y + new_size,
+				 new_size, depth - 1);
 		
 		/* Правый нижний треугольник */
-		sierpinski_triangle(picture, x + new_size / 2, y + new_size,
-				    new_size, depth - 1);
+		sierpinski_level(picture, x + new_size / 2, y + new_size,
+				 new_size, depth - 1);
+	}
+}
+
+void sierpinski_triangle(image_p picture, int x, int y, int size, int depth)
+{
+	assert(picture != NULL);
+	assert(size > 0);
+	assert(depth >= 0);
+	
+	metrics_span_t span = metrics_begin(METRICS_STAGE_RASTER);
+	sierpinski_level(picture, x, y, size, depth);
+	metrics_end(&span);
+}
+
+/**
+ * @brief Логическое ИЛИ строки src со строкой dst (по 8 пикселей за раз)
+ */
+static void or_row(pixel_data *dst, const pixel_data *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+		memcpy(&a, dst + i, sizeof(a));
+		memcpy(&b, src + i, sizeof(b));
+		a |= b;
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	for (; i < n; i++)
+		dst[i] |= src[i];
+}
+
+/**
+ * @brief Максимальный размер треугольника, маска которого строится целиком
+ */
+#define SIERPINSKI_BLOCK 64
+
+/**
+ * @brief Геометрия треугольника Серпинского для sierpinski_triangle_fast
+ *
+ * Уровень j - треугольник размером size, деленным пополам j раз. Маска
+ * строится для уровня block и копируется во все его положения.
+ */
+struct sierpinski {
+	image_p picture;                // Изображение
+	image_view_t view;
+	int size[32];                   // Размер треугольника уровня j
+	int half[32];                   // От вершины до края описывающего прямоугольника
+	int height[32];                 // Высота описывающего прямоугольника
+	int block;                      // Уровень маски
+	image_p mask;                   // Маска уровня block (покрытые пиксели - 255),
+	                                // NULL, если листья крупнее SIERPINSKI_BLOCK
+	int *lo, *hi;                   // Используемая часть строк маски
+};
+
+/**
+ * @brief Строит маску треугольника уровня block из листа уровня levels,
+ * объединяя на каждом уровне три сдвинутые копии
+ */
+static void sierpinski_build_mask(struct sierpinski *s, int levels)
+{
+	int b = s->block;
+	int apex = s->half[b];
+	s->mask = create_image(2 * apex + 1, s->height[b]);
+	clear_image(s->mask);
+	size_t stride = image_stride(s->mask);
+	pixel_data *data = image_row(s->mask, 0);
+	s->lo = malloc(sizeof(int) * 2 * s->height[b]);
+	assert(s->lo != NULL);
+	s->hi = s->lo + s->height[b];
+	
+	// Лист с вершиной в верхней строке маски
+	int leaf = s->size[levels];
+	draw_filled_triangle(s->mask, apex, 0, apex - leaf / 2, leaf,
+			     apex + leaf / 2, leaf, 255);
+	for (int row = 0; row < s->height[b]; row++) {
+		s->lo[row] = row <= leaf ? apex - leaf / 2 : 2 * apex + 1;
+		s->hi[row] = row <= leaf ? apex + leaf / 2 : -1;
+	}
+	
+	/* Верхняя копия уровня совпадает с уже построенной частью, нижние
+	   дописываются под нее. Строки копируются снизу вверх: нижние копии
+	   пишутся только в строки, которые уже прочитаны */
+	for (int level = levels - 1; level >= b; level--) {
+		int dx = s->size[level] / 2 / 2;
+		int dy = s->size[level] / 2;
+		for (int row = s->height[level + 1] - 1; row >= 0; row--) {
+			if (s->lo[row] > s->hi[row])
+				continue;
+			const pixel_data *src = data + stride * row + s->lo[row];
+			pixel_data *dst = data + stride * (row + dy) + s->lo[row];
+			size_t n = s->hi[row] - s->lo[row] + 1;
+			or_row(dst - dx, src, n);
+			or_row(dst + dx, src, n);
+			int r = row + dy;
+			if (s->lo[row] - dx < s->lo[r])
+				s->lo[r] = s->lo[row] - dx;
+			if (s->hi[row] + dx > s->hi[r])
+				s->hi[r] = s->hi[row] + dx;
+		}
+	}
+}
+
+/**
+ * @brief Копирует маску во все положения треугольников уровня block
+ * внутри треугольника уровня level с вершиной (x, y)
+ */
+static void sierpinski_place(const struct sierpinski *s, long long x,
+			     long long y, int level)
+{
+	// Треугольник целиком вне изображения
+	if (x + s->half[level] < 0 || x - s->half[level] >= s->view.width ||
+	    y + s->height[level] <= 0 || y >= s->view.height)
+		return;
+	
+	if (level < s->block) {
+		int new_size = s->size[level] / 2;
+		sierpinski_place(s, x, y, level + 1);
+		sierpinski_place(s, x - new_size / 2, y + new_size, level + 1);
+		sierpinski_place(s, x + new_size / 2, y + new_size, level + 1);
+		return;
+	}
+	
+	// Крупный лист рисуется напрямую
+	if (s->mask == NULL) {
+		int leaf = s->size[level];
+		draw_filled_triangle(s->picture, x, y, x - leaf / 2, y + leaf,
+				     x + leaf / 2, y + leaf, 255);
+		return;
+	}
+	
+	/* Цвет 255, поэтому логическое ИЛИ совпадает с рисованием покрытых
+	   пикселей */
+	long long x0 = x - s->half[level];
+	for (int row = 0; row < s->height[level]; row++) {
+		long long py = y + row;
+		if (py < 0 || py >= s->view.height)
+			continue;
+		// Покрытая часть строки, обрезанная по изображению
+		long long begin = x0 + s->lo[row] < 0 ? -x0 : s->lo[row];
+		long long end = x0 + s->hi[row] >= s->view.width ?
+				(long long)s->view.width - 1 - x0 : s->hi[row];
+		if (begin <= end)
+			or_row(image_view_row(&s->view, py) + (x0 + begin),
+			       image_row(s->mask, row) + begin, end - begin + 1);
 	}
 }
 
+void sierpinski_triangle_fast(image_p picture, int x, int y, int size,
+			      int depth)
+{
+	assert(picture != NULL);
+	assert(size > 0);
+	assert(depth >= 0);
+	
+	metrics_span_t span = metrics_begin(METRICS_STAGE_RASTER);
+	struct sierpinski s;
+	s.picture = picture;
+	s.view = image_get_view(picture);
+	
+	/* Размеры уровней. Треугольник размером 1 пиксель дальше не делится
+	   (sierpinski_triangle требует листьев размером не меньше 1), поэтому
+	   лишняя глубина ничего не меняет */
+	int levels = 0;
+	s.size[0] = size;
+	while (levels < depth && s.size[levels] > 1) {
+		s.size[levels + 1] = s.size[levels] / 2;
+		levels++;
+	}
+	// Описывающие прямоугольники от листа вверх
+	s.half[levels] = s.size[levels] / 2;
+	s.height[levels] = s.size[levels] + 1;
+	for (int level = levels - 1; level >= 0; level--) {
+		s.half[level] = s.half[level + 1] + s.size[level] / 2 / 2;
+		s.height[level] = s.height[level + 1] + s.size[level] / 2;
+	}
+	
+	/* Уровень маски: первый, помещающийся в SIERPINSKI_BLOCK. Если даже
+	   листья крупнее, маска не нужна: листья рисуются по одному */
+	s.block = 0;
+	while (s.block < levels && s.height[s.block] > SIERPINSKI_BLOCK + 1)
+		s.block++;
+	s.mask = NULL;
+	if (s.height[s.block] <= SIERPINSKI_BLOCK + 1)
+		sierpinski_build_mask(&s, levels);
+	
+	sierpinski_place(&s, x, y, 0);
+	if (s.mask != NULL) {
+		free(s.lo);
+		free_image(s.mask);
+	}
+	metrics_end(&span);
+}
+
+/**
+ * @brief Максимальное количество уровней веток дерева
+ * (длина уменьшается в 0.7 раза, так что глубже ветки короче 2 пикселей
+ * при любой разумной начальной длине)
+ */
+#define TREE_MAX_LEVELS 64
+
+/**
+ * @brief Количество уровней, до которого дерево рисуется сразу в изображение
+ * в одном потоке (не больше 2^TREE_DIRECT_LEVELS веток)
+ */
+#define TREE_DIRECT_LEVELS 14
+
+/**
+ * @brief Количество отрезков, накапливаемых перед растеризацией
+ */
+#define TREE_BATCH 1024
+
+/**
+ * @brief Высота полосы строк при сведении буферов потоков
+ */
+#define TREE_MERGE_ROWS 64
+
+/**
+ * @brief Начало ветки: точка, уровень и сумма поворотов (-1 или +1 на уровень)
+ */
+struct tree_node {
+	int x, y;
+	int level;
+	int turn;
+};
+
+/**
+ * @brief Отрезок ветки
+ */
+struct tree_line {
+	int x0, y0, x1, y1;
+	int level;
+};
+
+/**
+ * @brief Задание на построение дерева
+ *
+ * Смещения концов веток зависят только от уровня и суммы поворотов, поэтому
+ * вычисляются заранее: вместо 2^depth вызовов sin/cos их 2 * levels + 1.
+ *
+ * Ветки более глубокого уровня рисуются поверх менее глубоких, а порядок
+ * внутри уровня не важен (цвет зависит только от уровня). Поэтому буфер
+ * потока хранит максимальный номер уровня + 1 (0 - пусто), и результат
+ * не зависит от количества потоков и распределения задач.
+ */
+struct tree_job {
+	int levels;                                 // Уровней веток
+	int dx[TREE_MAX_LEVELS][2 * TREE_MAX_LEVELS + 1]; // Смещение конца по X
+	int dy[TREE_MAX_LEVELS][2 * TREE_MAX_LEVELS + 1]; // Смещение конца по Y
+	pixel_data color[TREE_MAX_LEVELS];          // Цвет веток уровня
+	const struct tree_node *roots;              // Корни поддеревьев-задач
+	int threads;                                // Количество потоков
+	image_p buffers[POOL_MAX_THREADS];          // Буферы потоков
+	int box[POOL_MAX_THREADS][4];               // Затронутые прямоугольники буферов
+	image_p picture;                            // Изображение для результата
+	int ox, oy;                                 // Начало области дерева в изображении
+	pixel_coord width, height;                  // Размеры области дерева
+};
+
+/**
+ * @brief Возвращает буфер потока worker, создавая его при первом обращении
+ */
+static image_p tree_buffer(struct tree_job *job, int worker)
+{
+	if (job->buffers[worker] == NULL) {
+		job->buffers[worker] = create_image(job->width, job->height);
+		clear_image(job->buffers[worker]);
+		job->box[worker][0] = job->width;
+		job->box[worker][1] = job->height;
+		job->box[worker][2] = -1;
+		job->box[worker][3] = -1;
+	}
+	return job->buffers[worker];
+}
+
+/**
+ * @brief Растеризует накопленные отрезки в буфер потока
+ */
+static void tree_flush(struct tree_job *job, int worker,
+		       const struct tree_line *lines, int count)
+{
+	image_view_t view = image_get_view(tree_buffer(job, worker));
+	int *box = job->box[worker];
+	for (int i = 0; i < count; i++) {
+		const struct tree_line *l = &lines[i];
+		draw_line_view(&view, l->x0, l->y0, l->x1, l->y1,
+			       (pixel_data)(l->level + 1), true);
+		// Линия не выходит за прямоугольник своих концов
+		int x_lo = l->x0 < l->x1 ? l->x0 : l->x1;
+		int x_hi = l->x0 < l->x1 ? l->x1 : l->x0;
+		int y_lo = l->y0 < l->y1 ? l->y0 : l->y1;
+		int y_hi = l->y0 < l->y1 ? l->y1 : l->y0;
+		box[0] = x_lo < box[0] ? (x_lo < 0 ? 0 : x_lo) : box[0];
+		box[1] = y_lo < box[1] ? (y_lo < 0 ? 0 : y_lo) : box[1];
+		box[2] = x_hi > box[2] ? x_hi : box[2];
+		box[3] = y_hi > box[3] ? y_hi : box[3];
+	}
+	if (box[2] >= (int)job->width)
+		box[2] = job->width - 1;
+	if (box[3] >= (int)job->height)
+		box[3] = job->height - 1;
+}
+
+/**
+ * @brief Строит поддерево обходом в глубину с явным стеком
+ * и растеризует его ветки пачками (задача пула потоков)
+ */
+static void tree_task(void *ctx, unsigned int task, int worker)
+{
+	struct tree_job *job = ctx;
+	struct tree_node stack[TREE_MAX_LEVELS + 1];
+	struct tree_line lines[TREE_BATCH];
+	int top = 0, count = 0;
+	
+	stack[top++] = job->roots[task];
+	while (top > 0) {
+		struct tree_node n = stack[--top];
+		if (n.level >= job->levels)
+			continue;
+		int t = n.turn + TREE_MAX_LEVELS;
+		int x2 = n.x + job->dx[n.level][t];
+		int y2 = n.y - job->dy[n.level][t];
+		lines[count++] = (struct tree_line){ n.x, n.y, x2, y2, n.level };
+		if (count == TREE_BATCH) {
+			tree_flush(job, worker, lines, count);
+			count = 0;
+		}
+		// Правая и левая ветки (поворот на +25 и -25 градусов)
+		stack[top++] = (struct tree_node){ x2, y2, n.level + 1, n.turn + 1 };
+		stack[top++] = (struct tree_node){ x2, y2, n.level + 1, n.turn - 1 };
+	}
+	tree_flush(job, worker, lines, count);
+}
+
+/**
+ * @brief Сводит буферы потоков в изображение для полосы строк
+ * (задача пула потоков)
+ */
+static void tree_merge_rows(void *ctx, unsigned int task, int worker)
+{
+	struct tree_job *job = ctx;
+	pixel_coord y_begin = task * TREE_MERGE_ROWS;
+	pixel_coord y_end = y_begin + TREE_MERGE_ROWS < job->height ?
+			    y_begin + TREE_MERGE_ROWS : job->height;
+	pixel_data *merged = malloc(job->width);
+	assert(merged != NULL);
+	(void)worker;
+	
+	for (pixel_coord y = y_begin; y < y_end; y++) {
+		// Строки буферов, затронутые ветками
+		const pixel_data *rows[POOL_MAX_THREADS];
+		const int *boxes[POOL_MAX_THREADS];
+		int n = 0;
+		int x_lo = job->width, x_hi = -1;
+		for (int w = 0; w < job->threads; w++) {
+			const int *box = job->box[w];
+			if (job->buffers[w] == NULL || (int)y < box[1] ||
+			    (int)y > box[3] || box[0] > box[2])
+				continue;
+			rows[n] = image_row(job->buffers[w], y);
+			boxes[n++] = box;
+			x_lo = box[0] < x_lo ? box[0] : x_lo;
+			x_hi = box[2] > x_hi ? box[2] : x_hi;
+		}
+		if (n == 0)
+			continue;
+		
+		// Самый глубокий уровень по всем буферам
+		memset(merged + x_lo, 0, x_hi - x_lo + 1);
+		for (int i = 0; i < n; i++)
+			for (int x = boxes[i][0]; x <= boxes[i][2]; x++)
+				if (merged[x] < rows[i][x])
+					merged[x] = rows[i][x];
+		
+		// Нарисованные пиксели заменяют фон изображения
+		pixel_data *dst = image_row(job->picture, y + job->oy) + job->ox;
+		for (int x = x_lo; x <= x_hi; x++)
+			if (merged[x] != 0)
+				dst[x] = job->color[merged[x] - 1];
+	}
+	free(merged);
+}
+
 void tree_fractal(image_p picture, int x, int y, double angle,
 		  double length, int depth)
 {
 	assert(picture != NULL);
 	assert(depth >= 0);
 	
-	// Условие остановки рекурсии
-	if (depth == 0 || length < 2.0)
+	metrics_span_t span = metrics_begin(METRICS_STAGE_RASTER);
+	struct tree_job *job = calloc(1, sizeof(*job));
+	assert(job != NULL);
+	job->picture = picture;
+	
+	/* Уровни веток: ветка уровня k рисуется, пока не исчерпана глубина
+	   и длина не меньше 2 пикселей */
+	double len[TREE_MAX_LEVELS];
+	for (double l = length; job->levels < depth &&
+	     job->levels < TREE_MAX_LEVELS && l >= 2.0; l *= 0.7)
+		len[job->levels++] = l;
+	int levels = job->levels;
+	
+	/* Дерево лежит в круге радиуса суммы длин веток, поэтому буферы
+	   потоков покрывают только пересечение этого квадрата с изображением */
+	double radius = 1.0;
+	for (int k = 0; k < levels; k++)
+		radius += len[k];
+	long long r = radius < 1e9 ? (long long)radius : 1000000000;
+	long long x_lo = x - r > 0 ? x - r : 0;
+	long long y_lo = y - r > 0 ? y - r : 0;
+	long long x_hi = (long long)x + r < get_image_width(picture) ?
+			 (long long)x + r : (long long)get_image_width(picture) - 1;
+	long long y_hi = (long long)y + r < get_image_height(picture) ?
+			 (long long)y + r : (long long)get_image_height(picture) - 1;
+	if (levels == 0 || x_lo > x_hi || y_lo > y_hi) {
+		free(job);
+		metrics_end(&span);
 		return;
+	}
+	job->ox = (int)x_lo;
+	job->oy = (int)y_lo;
+	job->width = x_hi - x_lo + 1;
+	job->height = y_hi - y_lo + 1;
 	
-	// Преобразуем угол из градусов в радианы
-	double angle_rad = angle * 3.14 / 180.0;
+	/* Таблица смещений: на уровне k сумма поворотов t лежит в [-k, k],
+	   угол ветки равен angle + 25 t градусов */
+	for (int t = -levels; t <= levels; t++) {
+		double angle_rad = (angle + 25.0 * t) * FRACTAL_PI / 180.0;
+		double s = sin(angle_rad), c = cos(angle_rad);
+		for (int k = 0; k < levels; k++) {
+			job->dx[k][t + TREE_MAX_LEVELS] = (int)(len[k] * s);
+			job->dy[k][t + TREE_MAX_LEVELS] = (int)(len[k] * c);
+		}
+	}
+	// Цвет ветки зависит от оставшейся глубины
+	for (int k = 0; k < levels; k++)
+		job->color[k] = (pixel_data)(255 - (depth - k) * 20);
+	
+	/* Небольшое дерево рисуется в ширину уровень за уровнем прямо в
+	   изображение. Для большого так строятся только верхние уровни (в буфер
+	   вызывающего потока), а поддеревья с уровня split - задачи пула,
+	   примерно 8 на поток */
+	job->threads = pool_default_threads();
+	bool direct = levels <= TREE_DIRECT_LEVELS;
+	int split = 0;
+	if (direct)
+		split = levels;
+	else
+		while (split < 16 && (1 << split) < 8 * job->threads)
+			split++;
+	
+	struct tree_node *roots = malloc(sizeof(*roots) << split);
+	assert(roots != NULL);
+	struct tree_line lines[TREE_BATCH];
+	int count = 0, tasks = 1;
+	image_view_t view = image_get_view(picture);
+	// Координаты отсчитываются от начала области
+	roots[0] = (struct tree_node){ x - job->ox, y - job->oy, 0, 0 };
+	for (int k = 0; k < split; k++) {
+		// Заменяем каждый корень двумя дочерними (с конца, чтобы не затереть)
+		for (int i = tasks - 1; i >= 0; i--) {
+			struct tree_node n = roots[i];
+			int t = n.turn + TREE_MAX_LEVELS;
+			int x2 = n.x + job->dx[k][t];
+			int y2 = n.y - job->dy[k][t];
+			if (direct)
+				draw_line_view(&view, n.x + job->ox, n.y + job->oy,
+					       x2 + job->ox, y2 + job->oy,
+					       job->color[k], false);
+			else
+				lines[count++] = (struct tree_line){ n.x, n.y,
+								     x2, y2, k };
+			if (count == TREE_BATCH) {
+				tree_flush(job, 0, lines, count);
+				count = 0;
+			}
+			roots[2 * i] = (struct tree_node){ x2, y2, k + 1, n.turn - 1 };
+			roots[2 * i + 1] = (struct tree_node){ x2, y2, k + 1, n.turn + 1 };
+		}
+		tasks *= 2;
+	}
+	
+	if (!direct) {
+		tree_flush(job, 0, lines, count);
+		job->roots = roots;
+		pool_run(tasks, job->threads, tree_task, job);
+		pool_run((job->height + TREE_MERGE_ROWS - 1) / TREE_MERGE_ROWS,
+			 job->threads, tree_merge_rows, job);
+		for (int w = 0; w < job->threads; w++)
+			if (job->buffers[w] != NULL)
+				free_image(job->buffers[w]);
+	}
+	free(roots);
+	free(job);
+	metrics_end(&span);
+}
 
-	/* Вычисляем конечную точку ветки */
-	int x2 = x + (int)(length * sin(angle_rad));
-	int y2 = y - (int)(length * cos(angle_rad));
+/**
+ * @brief Таблицы смещений концов веток для сглаженного дерева
+ */
+struct tree_aa_table {
+	double dx[TREE_MAX_LEVELS][2 * TREE_MAX_LEVELS + 1];
+	double dy[TREE_MAX_LEVELS][2 * TREE_MAX_LEVELS + 1];
+};
+
+/**
+ * @brief Рисует сглаженными линиями ветки уровня level дерева с корнем
+ * (x, y) (обход в глубину с явным стеком)
+ */
+static void tree_aa_level(const image_view_t *view,
+			  const struct tree_aa_table *table, double x,
+			  double y, int level, pixel_data color)
+{
+	struct {
+		double x, y;
+		int level, turn;
+	} stack[TREE_MAX_LEVELS + 1];
+	int top = 0;
+	
+	stack[top].x = x;
+	stack[top].y = y;
+	stack[top].level = 0;
+	stack[top++].turn = 0;
+	while (top > 0) {
+		top--;
+		double nx = stack[top].x, ny = stack[top].y;
+		int k = stack[top].level, turn = stack[top].turn;
+		int t = turn + TREE_MAX_LEVELS;
+		double x2 = nx + table->dx[k][t];
+		double y2 = ny - table->dy[k][t];
+		if (k == level) {
+			draw_line_aa(view, nx, ny, x2, y2, color);
+			continue;
+		}
+		// Левая и правая ветки (поворот на -25 и +25 градусов)
+		for (int side = -1; side <= 1; side += 2) {
+			stack[top].x = x2;
+			stack[top].y = y2;
+			stack[top].level = k + 1;
+			stack[top++].turn = turn + side;
+		}
+	}
+}
+
+void tree_fractal_aa(image_p picture, double x, double y, double angle,
+		     double length, int depth)
+{
+	assert(picture != NULL);
+	assert(depth >= 0);
 	
-	/* Рисуем ветку */
-	// Цвет ветки зависит от глубины рекурсии (чем глубже, тем темнее)
-	pixel_data color = (pixel_data)(255 - depth * 20);
-	draw_line(picture, x, y, x2, y2, color);
+	// Уровни веток - как в tree_fractal
+	double len[TREE_MAX_LEVELS];
+	int levels = 0;
+	for (double l = length; levels < depth && levels < TREE_MAX_LEVELS &&
+	     l >= 2.0; l *= 0.7)
+		len[levels++] = l;
+	if (levels == 0)
+		return;
+	
+	metrics_span_t span = metrics_begin(METRICS_STAGE_RASTER);
+	// Смещения без округления до целых
+	struct tree_aa_table *table = malloc(sizeof(*table));
+	assert(table != NULL);
+	for (int t = -levels; t <= levels; t++) {
+		double angle_rad = (angle + 25.0 * t) * FRACTAL_PI / 180.0;
+		double s = sin(angle_rad), c = cos(angle_rad);
+		for (int k = 0; k < levels; k++) {
+			table->dx[k][t + TREE_MAX_LEVELS] = len[k] * s;
+			table->dy[k][t + TREE_MAX_LEVELS] = len[k] * c;
+		}
+	}
 	
-	/* Рекурсивно рисуем левую и правую ветки */
-	// Левая ветка: угол уменьшен на 25 градусов
-	tree_fractal(picture, x2, y2, angle - 25.0, length * 0.7, depth - 1);
-	// Правая ветка: угол увеличен на 25 градусов
-	tree_fractal(picture, x2, y2, angle + 25.0, length * 0.7, depth - 1);
+	/* Уровни рисуются по порядку, чтобы более глубокие ветки ложились
+	   поверх (как в tree_fractal). Проход до уровня k повторяет обход
+	   верхних уровней, но их веток вдвое меньше, чем веток уровня k */
+	image_view_t view = image_get_view(picture);
+	for (int k = 0; k < levels; k++)
+		tree_aa_level(&view, table, x, y, k,
+			      (pixel_data)(255 - (depth - k) * 20));
+	free(table);
+	metrics_end(&span);
 }
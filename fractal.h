@@ -3,6 +3,110 @@
 
 #include "image.h"
 
+/**
+ * @brief Набор векторных инструкций для вычисления итераций
+ */
+typedef enum fractal_simd {
+	FRACTAL_SIMD_AUTO = 0,  // Лучший доступный (или из FRACTAL_SIMD)
+	FRACTAL_SIMD_SCALAR,    // Скалярный код без векторизации
+	FRACTAL_SIMD_SSE2,      // SSE2, 2 пикселя за раз
+	FRACTAL_SIMD_AVX2,      // AVX2, 4 пикселя за раз
+	FRACTAL_SIMD_AVX512,    // AVX-512F, 8 пикселей за раз
+} fractal_simd_t;
+
+/**
+ * @brief Точность арифметики при вычислении итераций
+ */
+typedef enum fractal_precision {
+	FRACTAL_PRECISION_AUTO = 0,    // По шагу пикселя (или из FRACTAL_PRECISION)
+	FRACTAL_PRECISION_FLOAT,       // float: вдвое больше пикселей на вектор
+	FRACTAL_PRECISION_DOUBLE,      // double
+	FRACTAL_PRECISION_DOUBLE_DOUBLE, // Пара double (около 106 бит мантиссы)
+} fractal_precision_t;
+
+/**
+ * @brief Вид итерируемой функции фракталов с временем убегания
+ */
+typedef enum fractal_formula_kind {
+	FRACTAL_FORMULA_POWER = 0,     // z^n + c (n = 2 - Мандельброт, больше - Multibrot)
+	FRACTAL_FORMULA_BURNING_SHIP,  // (|Re z| + i |Im z|)^2 + c
+	FRACTAL_FORMULA_TRICORN,       // conj(z)^2 + c
+} fractal_formula_kind_t;
+
+/**
+ * @brief Наибольшая степень z в FRACTAL_FORMULA_POWER
+ */
+#define FRACTAL_POWER_MAX 8
+
+/**
+ * @brief Итерируемая функция фрактала с временем убегания
+ *
+ * Для каждой функции собраны отдельные ядра с раскрытой степенью (скалярные
+ * и векторные, float и double), поэтому новые формулы получают потоки,
+ * векторизацию, стратегии и раскраску без потерь на выбор формулы в цикле.
+ */
+typedef struct fractal_formula {
+	fractal_formula_kind_t kind;   // Вид функции
+	int power;                     // Степень n для FRACTAL_FORMULA_POWER
+	                               // (2..FRACTAL_POWER_MAX, 0 - 2)
+	bool julia;                    // Вариант Жюлиа: точка пикселя - z0,
+	                               // c фиксирована; иначе z0 = 0, c - точка
+	double c_real, c_imag;         // Константа c варианта Жюлиа
+} fractal_formula_t;
+
+/**
+ * @brief Стратегия обхода пикселей при рендеринге
+ */
+typedef enum fractal_strategy {
+	FRACTAL_STRATEGY_BRUTE = 0,    // Каждый пиксель вычисляется отдельно
+	FRACTAL_STRATEGY_SUBDIVIDE,    // Разбиение Мариани-Сильвера: однородные
+	                               // по границе прямоугольники заливаются целиком
+	FRACTAL_STRATEGY_PROGRESSIVE,  // Проходы от грубой сетки к полной с
+	                               // заливкой блоков и обратным вызовом
+} fractal_strategy_t;
+
+/**
+ * @brief Функция обратного вызова прогрессивного рендеринга
+ *
+ * Вызывается в вызывающем потоке после каждого прохода.
+ *
+ * @param picture Изображение с результатом прохода
+ * @param step Шаг сетки выборок пройденного прохода (1 - последний проход)
+ * @param data Пользовательские данные из fractal_options_t
+ */
+typedef void (*fractal_progress_fn)(image_p picture, int step, void *data);
+
+// Кэш результатов рендеринга (см. cache.h)
+struct render_cache;
+
+/**
+ * @brief Параметры рендеринга фракталов с временем убегания
+ * (множества Мандельброта и Жюлиа)
+ */
+typedef struct fractal_options {
+	int threads;                   // Количество потоков (0 - FRACTAL_THREADS или число ядер)
+	fractal_simd_t simd;           // Набор инструкций (неподдерживаемый заменяется лучшим доступным)
+	fractal_precision_t precision; // Точность арифметики (AUTO - по шагу пикселя)
+	bool interior_check;           // Не итерировать точки главной кардиоиды и круга периода 2
+	bool periodicity;              // Останавливать орбиты, попавшие в цикл (метод Брента)
+	fractal_strategy_t strategy;   // Стратегия обхода пикселей
+	int progressive_step;          // Шаг первого прогрессивного прохода (степень 2)
+	fractal_progress_fn progress;  // Вызывается после прогрессивного прохода
+	void *progress_data;           // Данные для progress
+	int antialias;                 // Сторона сетки выборок для пикселей на границах
+	                               // (antialias^2 выборок; 0 или 1 - без сглаживания)
+	bool antialias_jitter;         // Случайные смещения выборок внутри ячеек сетки
+	bool smooth;                   // Дробное количество итераций в буфере итераций
+	struct render_cache *cache;    // Кэш готовых видов (NULL - без кэша)
+} fractal_options_t;
+
+/**
+ * @brief Заполняет параметры рендеринга значениями по умолчанию
+ *
+ * @param opt Параметры для заполнения
+ */
+void fractal_options_init(fractal_options_t *opt);
+
 /**
  * @brief Рисует пустой фрактал (заглушку), предполагая, что изображение чистое
  *
@@ -23,6 +127,55 @@ void empty_fractal(image_p picture);
 void mandelbrot_fractal(image_p picture, double x_min, double x_max,
 			double y_min, double y_max, int max_iter);
 
+/**
+ * @brief Рисует множество Мандельброта с заданными параметрами рендеринга
+ *
+ * Изображение разбивается на тайлы, которые динамически распределяются
+ * между потоками. Результат побайтово совпадает с однопоточным.
+ * Точность арифметики (float, double или пара double) выбирается по шагу
+ * пикселя, если не задана в opt->precision.
+ *
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ * @see mandelbrot_fractal
+ */
+void mandelbrot_fractal_ex(image_p picture, double x_min, double x_max,
+			   double y_min, double y_max, int max_iter,
+			   const fractal_options_t *opt);
+
+/**
+ * @brief Рисует множество Мандельброта полосами прямо в файл
+ *
+ * Изображение целиком в памяти не хранится: готовые полосы строк сразу
+ * передаются объекту записи.
+ *
+ * @param writer Объект записи (задает размеры изображения)
+ * @returns 0 при успехе, -1 при ошибке записи
+ * @see mandelbrot_fractal_ex
+ */
+int mandelbrot_fractal_stream(image_writer_p writer, double x_min,
+			      double x_max, double y_min, double y_max,
+			      int max_iter, const fractal_options_t *opt);
+
+/**
+ * @brief Рисует множество Мандельброта при глубоком увеличении
+ *
+ * Опорная орбита центра вида вычисляется с произвольной точностью, а все
+ * пиксели - в double как отклонения от нее (метод возмущений). Позволяет
+ * увеличение далеко за пределы точности double (1e-50 и глубже, пока
+ * размер пикселя представим в double).
+ *
+ * @param picture Изображение для рисования
+ * @param center_re Действительная часть центра вида (десятичная строка)
+ * @param center_im Мнимая часть центра вида (десятичная строка)
+ * @param span Ширина вида по оси X (по оси Y - пропорционально изображению)
+ * @param max_iter Максимальное количество итераций для проверки сходимости
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ * @returns 0 при успехе, -1 при ошибке разбора центра или слишком большой глубине
+ */
+int mandelbrot_deep_fractal(image_p picture, const char *center_re,
+			    const char *center_im, double span, int max_iter,
+			    const fractal_options_t *opt);
+
 /**
  * @brief Рисует фрактал множества Жюлиа
  *
@@ -39,9 +192,80 @@ void julia_fractal(image_p picture, double c_real, double c_imag,
 		   double x_min, double x_max, double y_min, double y_max,
 		   int max_iter);
 
+/**
+ * @brief Рисует множество Жюлиа с заданными параметрами рендеринга
+ *
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ * @see julia_fractal, mandelbrot_fractal_ex
+ */
+void julia_fractal_ex(image_p picture, double c_real, double c_imag,
+		      double x_min, double x_max, double y_min, double y_max,
+		      int max_iter, const fractal_options_t *opt);
+
+/**
+ * @brief Рисует множество Жюлиа полосами прямо в файл
+ *
+ * @param writer Объект записи (задает размеры изображения)
+ * @returns 0 при успехе, -1 при ошибке записи
+ * @see julia_fractal_ex, mandelbrot_fractal_stream
+ */
+int julia_fractal_stream(image_writer_p writer, double c_real, double c_imag,
+			 double x_min, double x_max, double y_min, double y_max,
+			 int max_iter, const fractal_options_t *opt);
+
+/**
+ * @brief Рисует фрактал с временем убегания для заданной функции
+ *
+ * Общая точка входа для всех формул: множества Мандельброта и Жюлиа -
+ * частные случаи (z^2 + c). Точность, потоки, векторизация, стратегии и
+ * сглаживание те же, что у mandelbrot_fractal_ex.
+ *
+ * @param picture Изображение для рисования
+ * @param formula Итерируемая функция
+ * @param x_min,x_max,y_min,y_max Область комплексной плоскости
+ * @param max_iter Максимальное количество итераций
+ * @param opt Параметры рендеринга (NULL - по умолчанию)
+ */
+void formula_fractal_ex(image_p picture, const fractal_formula_t *formula,
+			double x_min, double x_max, double y_min, double y_max,
+			int max_iter, const fractal_options_t *opt);
+
+/**
+ * @brief Рисует фрактал с временем убегания полосами прямо в файл
+ *
+ * @param writer Объект записи (задает размеры изображения)
+ * @returns 0 при успехе, -1 при ошибке записи
+ * @see formula_fractal_ex, mandelbrot_fractal_stream
+ */
+int formula_fractal_stream(image_writer_p writer,
+			   const fractal_formula_t *formula, double x_min,
+			   double x_max, double y_min, double y_max,
+			   int max_iter, const fractal_options_t *opt);
+
+/**
+ * @brief Рисует часть изображения width x height, начинающуюся
+ * с пикселя (x0, y0)
+ *
+ * Результат совпадает с той же частью formula_fractal_ex для всего
+ * изображения, если x0 и y0 кратны ESCAPE_TILE (64).
+ *
+ * @param picture Изображение размером части
+ * @param width,height Размеры всего изображения
+ * @param x0,y0 Левый верхний пиксель части
+ * @see formula_fractal_ex, escape_render_window
+ */
+void formula_fractal_window(image_p picture, const fractal_formula_t *formula,
+			    pixel_coord width, pixel_coord height,
+			    pixel_coord x0, pixel_coord y0, double x_min,
+			    double x_max, double y_min, double y_max,
+			    int max_iter, const fractal_options_t *opt);
+
 /**
  * @brief Рисует фрактал треугольника Серпинского
  *
+ * Треугольники размером 1 пиксель дальше не делятся, поэтому глубина
+ * больше log2(size) не меняет результат и не увеличивает число листьев.
+ *
  * @param picture Изображение для рисования
  * @param x X-координата верхней вершины
  * @param y Y-координата верхней вершины
@@ -50,9 +274,34 @@ void julia_fractal(image_p picture, double c_real, double c_imag,
  */
 void sierpinski_triangle(image_p picture, int x, int y, int size, int depth);
 
+/**
+ * @brief Рисует треугольник Серпинского без рекурсии по листьям
+ *
+ * Результат попиксельно совпадает с sierpinski_triangle. Треугольник уровня k
+ * состоит из трех сдвинутых копий треугольника уровня k + 1, поэтому маска
+ * небольшого подтреугольника строится снизу вверх объединением копий строк,
+ * начиная с одного листа, а затем копируется во все свои положения. Время
+ * работы определяется размером треугольника и не зависит от глубины;
+ * глубина больше log2(size) не меняет результат.
+ *
+ * @param picture Изображение для рисования
+ * @param x Координата X верхней вершины
+ * @param y Координата Y верхней вершины
+ * @param size Размер треугольника
+ * @param depth Глубина разбиения
+ */
+void sierpinski_triangle_fast(image_p picture, int x, int y, int size,
+			      int depth);
+
 /**
  * @brief Рисует простой древовидный фрактал
  *
+ * Каждая ветка делится на две, повернутые на -25 и +25 градусов, длиной
+ * 0.7 от исходной. Ветки строятся без рекурсии по таблицам смещений,
+ * большие деревья - параллельно по поддеревьям. Более глубокие ветки
+ * рисуются поверх менее глубоких, поэтому результат не зависит от
+ * количества потоков.
+ *
  * @param picture Изображение для рисования
  * @param x Начальная X-координата
  * @param y Начальная Y-координата
@@ -63,4 +312,20 @@ void sierpinski_triangle(image_p picture, int x, int y, int size, int depth);
 void tree_fractal(image_p picture, int x, int y, double angle,
 		  double length, int depth);
 
+/**
+ * @brief Рисует древовидный фрактал сглаженными линиями
+ *
+ * Концы веток не округляются до целых, а линии рисуются алгоритмом Ву:
+ * пиксели смешиваются с цветом ветки пропорционально покрытию. Это дает
+ * гладкое изображение в исходном разрешении без суперсэмплинга.
+ *
+ * @param picture Изображение для рисования
+ * @param x,y Начальная точка (центр пикселя (x, y) - точка (x, y))
+ * @param angle Угол в градусах
+ * @param length Длина ветви
+ * @param depth Глубина рекурсии
+ */
+void tree_fractal_aa(image_p picture, double x, double y, double angle,
+		     double length, int depth);
+
 #endif // _FRACTAL_H_
@@ -2,7 +2,18 @@
 #include <assert.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define IMAGE_HAVE_MMAP 1
+#endif
+
+#include "deflate.h"
 #include "image.h"
+#include "metrics.h"
+#include "pool.h"
+
 /**
  * @brief Структура для хранения данных изображения и метаданных
  */
@@ -10,13 +21,24 @@ struct image
 {
     pixel_coord width, height;  // Ширина и высота изображения
     pixel_data *data;           // Массив пикселей (ширина * высота)
+    void *mapping;              // Отображение файла (NULL - данные в куче)
+    size_t mapping_size;        // Размер отображения в байтах
 };
 
+// Количество пикселей изображения (0 при переполнении size_t)
+static size_t pixel_count(pixel_coord width, pixel_coord height)
+{
+    if (height != 0 && width > SIZE_MAX / sizeof(pixel_data) / height)
+        return 0;
+    return (size_t)width * height;
+}
+
 // Создает новое изображение с заданными размерами
 image_p create_image(pixel_coord width, pixel_coord height)
 {
     assert(width > 0 && height > 0);
-    assert(width <= 65536 && height <= 65536); /* Разумные максимальные размеры */
+    size_t count = pixel_count(width, height);
+    assert(count > 0); /* Размер должен помещаться в адресное пространство */
     
     // Выделяем память под структуру изображения
     image_t *v = malloc(sizeof(image_t));
@@ -25,20 +47,107 @@ image_p create_image(pixel_coord width, pixel_coord height)
     // Инициализируем поля структуры
     v->width = width;
     v->height = height;
+    v->mapping = NULL;
+    v->mapping_size = 0;
     // Выделяем память под данные пикселей
-    v->data = malloc(sizeof(pixel_data) * width * height);
+    v->data = malloc(sizeof(pixel_data) * count);
     assert(v->data != NULL);
 
     return v;
 }
 
+// Создает изображение в файле, отображенном в память
+image_p create_image_mapped(pixel_coord width, pixel_coord height,
+                            const char *filename)
+{
+    assert(width > 0 && height > 0);
+    assert(filename != NULL);
+#ifdef IMAGE_HAVE_MMAP
+    size_t count = pixel_count(width, height);
+    if (count == 0)
+        return NULL;
+
+    /* Файл - двоичный PGM: заголовок, затем строки пикселей */
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "P5\n%u %u\n255\n",
+                              width, height);
+    if (count > SIZE_MAX - (size_t)header_len)
+        return NULL;
+    size_t size = (size_t)header_len + count;
+    if ((off_t)size < 0 || (size_t)(off_t)size != size)
+        return NULL;
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return NULL;
+    // Файл нужного размера создается разреженным, без записи нулей
+    if (ftruncate(fd, (off_t)size) != 0 ||
+        pwrite(fd, header, (size_t)header_len, 0) != header_len) {
+        close(fd);
+        return NULL;
+    }
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // Отображение остается действительным и после закрытия файла
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    image_t *v = malloc(sizeof(image_t));
+    if (!v) {
+        munmap(mapping, size);
+        return NULL;
+    }
+    v->width = width;
+    v->height = height;
+    v->mapping = mapping;
+    v->mapping_size = size;
+    v->data = (pixel_data *)mapping + header_len;
+    return v;
+#else
+    (void)width;
+    (void)height;
+    (void)filename;
+    return NULL;
+#endif
+}
+
+// Проверяет, хранится ли изображение в файле
+bool image_is_mapped(image_p picture)
+{
+    assert(picture != NULL);
+    return picture->mapping != NULL;
+}
+
+// Сбрасывает строки изображения в файл и освобождает их память
+void image_evict_rows(image_p picture, pixel_coord y_begin, pixel_coord y_end)
+{
+    assert(picture != NULL);
+    assert(y_begin <= y_end && y_end <= picture->height);
+#ifdef IMAGE_HAVE_MMAP
+    if (!picture->mapping || y_begin == y_end)
+        return;
+
+    /* Границы выравниваются внутрь по страницам, чтобы не задеть
+       соседние строки, которые еще могут изменяться */
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)&picture->data[(size_t)y_begin * picture->width];
+    uintptr_t end = (uintptr_t)&picture->data[(size_t)y_end * picture->width];
+    begin = (begin + page - 1) & ~(page - 1);
+    end &= ~(page - 1);
+    if (begin >= end)
+        return;
+    msync((void *)begin, end - begin, MS_SYNC);
+    madvise((void *)begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
 // Очищает изображение (заполняет нулями/черным цветом)
 void clear_image(image_p picture)
 {
     assert(picture != NULL);
     assert(picture->data != NULL);
     // Заполняем весь массив данных нулями
-    memset(picture->data, 0, sizeof(pixel_data) * picture->width * picture->height);
+    memset(picture->data, 0, sizeof(pixel_data) * pixel_count(picture->width, picture->height));
 }
 
 // Заполняет изображение случайными значениями
@@ -48,8 +157,9 @@ void fill_random(image_p picture)
     assert(picture->data != NULL);
     
     pixel_data *p = picture->data;
+    size_t count = pixel_count(picture->width, picture->height);
     // Заполняем каждый пиксель случайным значением
-    for (pixel_coord z = 0; z < picture->height * picture->width; ++z, ++p)
+    for (size_t z = 0; z < count; ++z, ++p)
         *p = (pixel_data)rand();
 }
 
@@ -57,49 +167,775 @@ void fill_random(image_p picture)
 void free_image(image_p picture)
 {
     if (picture) {
+#ifdef IMAGE_HAVE_MMAP
+        if (picture->mapping) {
+            // Дописываем данные в файл и снимаем отображение
+            msync(picture->mapping, picture->mapping_size, MS_SYNC);
+            munmap(picture->mapping, picture->mapping_size);
+        } else
+#endif
         free(picture->data);   // Освобождаем данные пикселей
         free(picture);         // Освобождаем саму структуру
     }
 }
 
-// Сохраняет изображение в формате PGM (Portable Graymap)
-int save_pgm(image_p picture, const char *filename)
+/**
+ * @brief Буферизованный вывод в файл крупными блоками
+ */
+struct out_buffer
 {
-    assert(picture != NULL);
-    assert(filename != NULL);
-    
-    // Открываем файл для записи
-    FILE *to = fopen(filename, "w");
-    if (!to)
+    FILE *file;                         // Выходной файл
+    size_t used;                        // Заполнено байт в буфере
+    bool error;                         // Была ошибка записи
+    uint8_t data[IMAGE_WRITE_BUFFER];   // Буфер
+};
+
+// Сбрасывает буфер в файл
+static void out_flush(struct out_buffer *out)
+{
+    if (out->used > 0 && !out->error &&
+        fwrite(out->data, 1, out->used, out->file) != out->used)
+        out->error = true;
+    if (metrics_current != NULL && !out->error)
+        metrics_add_bytes(metrics_current, out->used);
+    out->used = 0;
+}
+
+// Добавляет байты в буфер (крупные блоки пишутся напрямую)
+static void out_write(struct out_buffer *out, const void *bytes, size_t size)
+{
+    if (out->used + size > sizeof(out->data)) {
+        out_flush(out);
+        if (size >= sizeof(out->data)) {
+            if (!out->error && fwrite(bytes, 1, size, out->file) != size)
+                out->error = true;
+            if (metrics_current != NULL && !out->error)
+                metrics_add_bytes(metrics_current, size);
+            return;
+        }
+    }
+    memcpy(out->data + out->used, bytes, size);
+    out->used += size;
+}
+
+// Записывает строку пикселей в текстовом виде PGM ("12 0 255\n")
+static void out_write_ascii_row(struct out_buffer *out, const pixel_data *row,
+                                pixel_coord width)
+{
+    for (pixel_coord x = 0; x < width; ++x) {
+        // Не более 3 цифр и разделитель на пиксель
+        if (out->used + 4 > sizeof(out->data))
+            out_flush(out);
+        uint8_t *p = out->data + out->used;
+        unsigned int v = row[x];
+        if (v >= 100)
+            *p++ = (uint8_t)('0' + v / 100);
+        if (v >= 10)
+            *p++ = (uint8_t)('0' + v / 10 % 10);
+        *p++ = (uint8_t)('0' + v % 10);
+        *p++ = x == width - 1 ? '\n' : ' ';
+        out->used = (size_t)(p - out->data);
+    }
+}
+
+/**
+ * @brief Формирует заголовки BMP (14 + 40 байт) для 8-битного изображения
+ * с палитрой оттенков серого
+ *
+ * @param header Буфер для заголовков
+ * @param width Ширина изображения
+ * @param height Высота (отрицательная - строки хранятся сверху вниз)
+ * @returns 0 при успехе, -1 если размер файла не помещается в 32 бита
+ */
+static int bmp_header(uint8_t header[54], pixel_coord width, int32_t height)
+{
+    /* BMP требует выравнивания строк по границе 4 байт */
+    uint64_t row_padded = ((uint64_t)width + 3) & ~(uint64_t)3;
+    uint64_t rows = height < 0 ? (uint64_t)(-(int64_t)height) : (uint64_t)height;
+    uint64_t image_size64 = row_padded * rows;
+    /* 54 = размер заголовков, 1024 = палитра из 256 цветов */
+    if (width > INT32_MAX || image_size64 + 54 + 1024 > UINT32_MAX)
         return -1;
-    
-    // Записываем заголовок PGM
-    fprintf(to, "P2\n%u %u\n255\n", picture->width, picture->height);
+    uint32_t image_size = (uint32_t)image_size64;
+    uint32_t file_size = 54 + 1024 + image_size;
+    uint32_t offset = 54 + 1024;
+    uint32_t h = (uint32_t)height;
 
-    pixel_data *p = picture->data;
-    // Записываем данные пикселей
-    for (pixel_coord y = 0; y < picture->height; ++y) {
-        for (pixel_coord x = 0; x < picture->width; ++x) {
-            fprintf(to, "%u%c", *(p++), x == picture->width - 1 ? '\n' : ' ');
+    /* Заголовок BMP (14 байт) */
+    uint8_t bmp[14] = {
+        'B', 'M',                    /* Магическое число */
+        file_size & 0xFF,            /* Размер файла */
+        (file_size >> 8) & 0xFF,
+        (file_size >> 16) & 0xFF,
+        (file_size >> 24) & 0xFF,
+        0, 0, 0, 0,                  /* Зарезервировано */
+        offset & 0xFF,               /* Смещение до данных пикселей */
+        (offset >> 8) & 0xFF,
+        0, 0
+    };
+
+    /* Заголовок DIB (40 байт) */
+    uint8_t dib[40] = {
+        40, 0, 0, 0,                            /* Размер заголовка DIB */
+        width & 0xFF,                           /* Ширина */
+        (width >> 8) & 0xFF,
+        (width >> 16) & 0xFF,
+        (width >> 24) & 0xFF,
+        h & 0xFF,                               /* Высота */
+        (h >> 8) & 0xFF,
+        (h >> 16) & 0xFF,
+        (h >> 24) & 0xFF,
+        1, 0,                                   /* Количество цветовых плоскостей */
+        8, 0,                                   /* Бит на пиксель */
+        0, 0, 0, 0,                            /* Без сжатия */
+        image_size & 0xFF,                      /* Размер изображения */
+        (image_size >> 8) & 0xFF,
+        (image_size >> 16) & 0xFF,
+        (image_size >> 24) & 0xFF,
+        0x13, 0x0B, 0, 0,                      /* Разрешение печати */
+        0x13, 0x0B, 0, 0,
+        0, 0, 0, 0,                            /* Количество цветов в палитре */
+        0, 0, 0, 0                             /* Важные цвета */
+    };
+
+    memcpy(header, bmp, 14);
+    memcpy(header + 14, dib, 40);
+    return 0;
+}
+
+// Записывает заголовки и палитру BMP
+static int out_write_bmp_header(struct out_buffer *out, pixel_coord width,
+                                int32_t height)
+{
+    uint8_t header[54];
+    if (bmp_header(header, width, height) != 0)
+        return -1;
+    out_write(out, header, sizeof(header));
+
+    /* Записываем палитру оттенков серого (256 цветов) */
+    for (int i = 0; i < 256; i++) {
+        uint8_t color[4] = {i, i, i, 0};  // R=G=B=i, альфа=0
+        out_write(out, color, 4);
+    }
+    return 0;
+}
+
+/*
+ * PNG: строки фильтруются и сжимаются полосами по PNG_BAND_BYTES байт,
+ * по полосе на задачу пула. Сжатые полосы - независимые фрагменты потока
+ * DEFLATE (deflate_compress); каждая записывается отдельным блоком IDAT,
+ * суммы Adler-32 полос объединяются. Словарь полосы - последние 32 КБ
+ * отфильтрованных строк перед ней: строки предыдущей полосы фильтруются
+ * повторно, поэтому полосы не ждут друг друга.
+ */
+
+// Размер отфильтрованных данных полосы PNG в байтах
+#define PNG_BAND_BYTES (1 << 18)
+
+/**
+ * @brief Состояние записи PNG между группами полос
+ */
+struct png_state
+{
+    int level;                          // Уровень сжатия
+    bool started;                       // Заголовок zlib уже записан
+    uint32_t adler;                     // Adler-32 записанных данных
+    pixel_coord band_rows;              // Строк в полосе
+    pixel_coord group_rows;             // Строк в группе (полоса на поток)
+    pixel_coord pending;                // Строк в буфере rows
+    pixel_data *rows;                   // Строки неполной группы
+    pixel_data *prev_row;               // Последняя записанная строка
+    bool has_prev;                      // prev_row заполнена
+    size_t window_size;                 // Заполнено байт окна
+    uint8_t window[DEFLATE_WINDOW];     // Последние отфильтрованные байты
+};
+
+/**
+ * @brief Потоковая запись изображения по строкам
+ */
+struct image_writer
+{
+    image_format_t format;      // Формат файла
+    pixel_coord width, height;  // Размеры изображения
+    pixel_coord rows;           // Записано строк
+    struct png_state *png;      // Состояние PNG (NULL для других форматов)
+    struct out_buffer out;      // Буфер вывода
+};
+
+// Таблица CRC-32 (полином 0xEDB88320) по полубайтам
+static const uint32_t png_crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Продолжает CRC-32 (без финального инвертирования)
+static uint32_t png_crc(uint32_t crc, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ png_crc_table[crc & 15];
+        crc = (crc >> 4) ^ png_crc_table[crc & 15];
+    }
+    return crc;
+}
+
+// Записывает 32-битное число в порядке big-endian
+static void png_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// Записывает блок PNG с готовой CRC (crc - по типу и данным, не инвертирована)
+static void out_write_png_chunk(struct out_buffer *out, const char type[4],
+                                const uint8_t *data, uint32_t size, uint32_t crc)
+{
+    uint8_t field[4];
+    png_put32(field, size);
+    out_write(out, field, 4);
+    out_write(out, type, 4);
+    if (size > 0)
+        out_write(out, data, size);
+    png_put32(field, crc ^ 0xFFFFFFFFu);
+    out_write(out, field, 4);
+}
+
+// Записывает сигнатуру и заголовок IHDR (8 бит, оттенки серого)
+static int out_write_png_header(struct out_buffer *out, pixel_coord width,
+                                pixel_coord height)
+{
+    static const uint8_t signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    if (width > INT32_MAX || height > INT32_MAX)
+        return -1;
+    out_write(out, signature, sizeof(signature));
+
+    uint8_t ihdr[13];
+    png_put32(ihdr, width);
+    png_put32(ihdr + 4, height);
+    ihdr[8] = 8;        /* Бит на отсчет */
+    ihdr[9] = 0;        /* Оттенки серого */
+    ihdr[10] = 0;       /* Сжатие DEFLATE */
+    ihdr[11] = 0;       /* Адаптивная фильтрация */
+    ihdr[12] = 0;       /* Без чередования строк */
+    uint32_t crc = png_crc(png_crc(0xFFFFFFFFu, (const uint8_t *)"IHDR", 4),
+                           ihdr, sizeof(ihdr));
+    out_write_png_chunk(out, "IHDR", ihdr, sizeof(ihdr), crc);
+    return 0;
+}
+
+// Предсказатель Paeth (PNG, фильтр 4)
+static inline int png_paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// Модуль остатка фильтра как знакового байта
+static inline unsigned int png_cost(int residual)
+{
+    return (unsigned int)abs((int8_t)(uint8_t)residual);
+}
+
+/**
+ * @brief Фильтрует строку PNG
+ *
+ * Из пяти фильтров выбирается дающий наименьшую сумму модулей остатков
+ * (эвристика из спецификации PNG); при adaptive == false - фильтр None.
+ *
+ * @param row Строка пикселей
+ * @param prev Предыдущая строка (NULL для первой строки изображения)
+ * @param width Ширина строки
+ * @param adaptive Выбирать фильтр
+ * @param out Результат: байт типа фильтра и width байт остатков
+ */
+static void png_filter_row(const pixel_data *row, const pixel_data *prev,
+                           pixel_coord width, bool adaptive, uint8_t *out)
+{
+    int filter = 0;
+    if (adaptive) {
+        unsigned long cost[5] = {0, 0, 0, 0, 0};
+        for (pixel_coord x = 0; x < width; ++x) {
+            int v = row[x];
+            int a = x > 0 ? row[x - 1] : 0;
+            int b = prev ? prev[x] : 0;
+            int c = prev && x > 0 ? prev[x - 1] : 0;
+            cost[0] += png_cost(v);
+            cost[1] += png_cost(v - a);
+            cost[2] += png_cost(v - b);
+            cost[3] += png_cost(v - ((a + b) >> 1));
+            cost[4] += png_cost(v - png_paeth(a, b, c));
         }
+        for (int f = 1; f < 5; ++f)
+            if (cost[f] < cost[filter])
+                filter = f;
+    }
+
+    out[0] = (uint8_t)filter;
+    for (pixel_coord x = 0; x < width; ++x) {
+        int v = row[x];
+        int a = x > 0 ? row[x - 1] : 0;
+        int b = prev ? prev[x] : 0;
+        int c = prev && x > 0 ? prev[x - 1] : 0;
+        int predicted = 0;
+        switch (filter) {
+        case 1: predicted = a; break;
+        case 2: predicted = b; break;
+        case 3: predicted = (a + b) >> 1; break;
+        case 4: predicted = png_paeth(a, b, c); break;
+        }
+        out[x + 1] = (uint8_t)(v - predicted);
+    }
+}
+
+/**
+ * @brief Полоса PNG: результат задачи сжатия
+ */
+struct png_band
+{
+    uint8_t *data;      // Словарь и отфильтрованные строки
+    size_t dict_size;   // Размер словаря в data
+    size_t size;        // Размер отфильтрованных строк
+    uint8_t *out;       // Сжатые данные (с заголовком и суммой zlib)
+    size_t out_size;    // Размер сжатых данных
+    uint32_t adler;     // Adler-32 отфильтрованных строк
+    uint32_t crc;       // CRC блока IDAT без суммы zlib
+    bool error;         // Не хватило памяти
+};
+
+/**
+ * @brief Контекст сжатия группы полос на пуле потоков
+ */
+struct png_group
+{
+    const struct png_state *png;    // Состояние записи
+    const pixel_data *rows;         // Строки группы
+    pixel_coord width;              // Ширина строки
+    pixel_coord count;              // Строк в группе
+    pixel_coord dict_rows;          // Строк, покрывающих окно DEFLATE
+    unsigned int bands;             // Количество полос
+    bool last;                      // Группа завершает изображение
+    struct png_band *band;          // Полосы
+};
+
+// Возвращает строку группы, предшествующую y (NULL перед первой строкой)
+static const pixel_data *png_prev_row(const struct png_group *g, pixel_coord y)
+{
+    if (y > 0)
+        return g->rows + (size_t)(y - 1) * g->width;
+    return g->png->has_prev ? g->png->prev_row : NULL;
+}
+
+// Фильтрует и сжимает одну полосу группы
+static void png_band_task(void *ctx, unsigned int task, int worker)
+{
+    (void)worker;
+    const struct png_group *g = ctx;
+    const struct png_state *png = g->png;
+    struct png_band *band = &g->band[task];
+    size_t row_bytes = (size_t)g->width + 1;
+    bool adaptive = png->level > 0;
+
+    pixel_coord y0 = (pixel_coord)task * png->band_rows;
+    pixel_coord y1 = g->count - y0 > png->band_rows ? y0 + png->band_rows : g->count;
+    pixel_coord d0 = y0 > g->dict_rows ? y0 - g->dict_rows : 0;
+
+    band->dict_size = task == 0 ? png->window_size : (size_t)(y0 - d0) * row_bytes;
+    band->size = (size_t)(y1 - y0) * row_bytes;
+    band->data = malloc(band->dict_size + band->size);
+    /* 2 байта заголовка и 4 байта суммы zlib */
+    band->out = malloc(deflate_bound(band->size) + 6);
+    if (!band->data || !band->out) {
+        band->error = true;
+        return;
     }
 
-    fclose(to);
+    // Словарь: окно прошлой группы или повторно отфильтрованные строки
+    if (task == 0)
+        memcpy(band->data, png->window, band->dict_size);
+    else
+        for (pixel_coord y = d0; y < y0; ++y)
+            png_filter_row(g->rows + (size_t)y * g->width, png_prev_row(g, y),
+                           g->width, adaptive,
+                           band->data + (size_t)(y - d0) * row_bytes);
+
+    uint8_t *filtered = band->data + band->dict_size;
+    for (pixel_coord y = y0; y < y1; ++y)
+        png_filter_row(g->rows + (size_t)y * g->width, png_prev_row(g, y),
+                       g->width, adaptive, filtered + (size_t)(y - y0) * row_bytes);
+    band->adler = deflate_adler32(1, filtered, band->size);
+
+    size_t head = 0;
+    if (task == 0 && !png->started) {
+        /* Заголовок zlib: окно 32 КБ и признак уровня сжатия */
+        static const uint8_t flags[4] = {0x01, 0x5E, 0x9C, 0xDA};
+        int index = png->level < 2 ? 0 : png->level < 6 ? 1 : png->level == 6 ? 2 : 3;
+        band->out[0] = 0x78;
+        band->out[1] = flags[index];
+        head = 2;
+    }
+    size_t size;
+    if (deflate_compress(band->data, band->dict_size, band->size, png->level,
+                         g->last && task == g->bands - 1,
+                         band->out + head, &size) != 0) {
+        band->error = true;
+        return;
+    }
+    band->out_size = head + size;
+    band->crc = png_crc(png_crc(0xFFFFFFFFu, (const uint8_t *)"IDAT", 4),
+                        band->out, band->out_size);
+}
+
+/**
+ * @brief Сжимает группу строк и записывает ее блоками IDAT
+ *
+ * @param w Объект записи PNG
+ * @param rows Строки группы
+ * @param count Количество строк (не больше group_rows)
+ * @param last Группа завершает изображение
+ * @returns 0 при успехе, -1 при нехватке памяти
+ */
+static int png_write_group(image_writer_t *w, const pixel_data *rows,
+                           pixel_coord count, bool last)
+{
+    struct png_state *png = w->png;
+    size_t row_bytes = (size_t)w->width + 1;
+    struct png_group g = {
+        .png = png,
+        .rows = rows,
+        .width = w->width,
+        .count = count,
+        .dict_rows = (pixel_coord)((DEFLATE_WINDOW + row_bytes - 1) / row_bytes),
+        .bands = (count + png->band_rows - 1) / png->band_rows,
+        .last = last,
+    };
+    g.band = calloc(g.bands, sizeof(struct png_band));
+    if (!g.band)
+        return -1;
+
+    pool_run(g.bands, 0, png_band_task, &g);
+
+    int result = 0;
+    for (unsigned int i = 0; i < g.bands; ++i)
+        if (g.band[i].error)
+            result = -1;
+
+    if (result == 0) {
+        for (unsigned int i = 0; i < g.bands; ++i) {
+            struct png_band *band = &g.band[i];
+            png->adler = deflate_adler32_combine(png->adler, band->adler,
+                                                 band->size);
+            if (last && i == g.bands - 1) {
+                png_put32(band->out + band->out_size, png->adler);
+                band->crc = png_crc(band->crc, band->out + band->out_size, 4);
+                band->out_size += 4;
+            }
+            out_write_png_chunk(&w->out, "IDAT", band->out,
+                                (uint32_t)band->out_size, band->crc);
+        }
+        png->started = true;
+
+        // Окно для следующей группы - хвост словаря и данных последней полосы
+        struct png_band *band = &g.band[g.bands - 1];
+        size_t total = band->dict_size + band->size;
+        png->window_size = total < DEFLATE_WINDOW ? total : DEFLATE_WINDOW;
+        memcpy(png->window, band->data + total - png->window_size,
+               png->window_size);
+        memcpy(png->prev_row, rows + (size_t)(count - 1) * w->width, w->width);
+        png->has_prev = true;
+    }
+
+    for (unsigned int i = 0; i < g.bands; ++i) {
+        free(g.band[i].data);
+        free(g.band[i].out);
+    }
+    free(g.band);
+    return result;
+}
+
+// Создает состояние записи PNG
+static struct png_state *png_state_create(pixel_coord width)
+{
+    struct png_state *png = malloc(sizeof(struct png_state));
+    if (!png)
+        return NULL;
+    png->level = IMAGE_PNG_LEVEL_DEFAULT;
+    png->started = false;
+    png->adler = 1;
+    png->band_rows = PNG_BAND_BYTES / ((size_t)width + 1);
+    if (png->band_rows == 0)
+        png->band_rows = 1;
+    png->group_rows = png->band_rows * (pixel_coord)pool_default_threads();
+    png->pending = 0;
+    png->rows = NULL;
+    png->prev_row = malloc(width);
+    png->has_prev = false;
+    png->window_size = 0;
+    if (!png->prev_row) {
+        free(png);
+        return NULL;
+    }
+    return png;
+}
+
+// Освобождает состояние записи PNG
+static void png_state_free(struct png_state *png)
+{
+    if (png) {
+        free(png->rows);
+        free(png->prev_row);
+        free(png);
+    }
+}
+
+/**
+ * @brief Записывает строки PNG
+ *
+ * Полные группы сжимаются прямо из переданных строк, остаток копируется
+ * в буфер до следующего вызова.
+ */
+static int png_write_rows(image_writer_t *w, const pixel_data *rows,
+                          pixel_coord count)
+{
+    struct png_state *png = w->png;
+    pixel_coord written = w->rows;  /* Строки до этого вызова */
+    size_t width = w->width;
+
+    while (count > 0) {
+        if (png->pending == 0 && count >= png->group_rows) {
+            pixel_coord n = png->group_rows;
+            written += n;
+            if (png_write_group(w, rows, n, written == w->height) != 0)
+                return -1;
+            rows += (size_t)n * width;
+            count -= n;
+            continue;
+        }
+
+        if (!png->rows) {
+            png->rows = malloc((size_t)png->group_rows * width);
+            if (!png->rows)
+                return -1;
+        }
+        pixel_coord n = png->group_rows - png->pending;
+        if (n > count)
+            n = count;
+        memcpy(png->rows + (size_t)png->pending * width, rows, (size_t)n * width);
+        png->pending += n;
+        rows += (size_t)n * width;
+        count -= n;
+        written += n;
+        if (png->pending == png->group_rows || written == w->height) {
+            if (png_write_group(w, png->rows, png->pending,
+                                written == w->height) != 0)
+                return -1;
+            png->pending = 0;
+        }
+    }
     return 0;
 }
 
+// Открывает файл и записывает заголовок
+image_writer_p image_writer_open(const char *filename, image_format_t format,
+                                 pixel_coord width, pixel_coord height)
+{
+    assert(filename != NULL);
+    assert(width > 0 && height > 0);
+
+    metrics_span_t span = metrics_begin(METRICS_STAGE_SAVE);
+    image_writer_t *w = malloc(sizeof(image_writer_t));
+    if (!w) {
+        metrics_end(&span);
+        return NULL;
+    }
+    w->format = format;
+    w->width = width;
+    w->height = height;
+    w->rows = 0;
+    w->png = NULL;
+    w->out.used = 0;
+    w->out.error = false;
+    w->out.file = fopen(filename, format == IMAGE_FORMAT_PGM_ASCII ? "w" : "wb");
+    if (!w->out.file) {
+        free(w);
+        metrics_end(&span);
+        return NULL;
+    }
+
+    char header[64];
+    int len;
+    switch (format) {
+    case IMAGE_FORMAT_PGM_ASCII:
+    case IMAGE_FORMAT_PGM_BINARY:
+        len = snprintf(header, sizeof(header), "%s\n%u %u\n255\n",
+                       format == IMAGE_FORMAT_PGM_ASCII ? "P2" : "P5",
+                       width, height);
+        out_write(&w->out, header, (size_t)len);
+        break;
+    case IMAGE_FORMAT_BMP:
+        /* Строки поступают сверху вниз, поэтому высота отрицательная */
+        if (height > INT32_MAX ||
+            out_write_bmp_header(&w->out, width, -(int32_t)height) != 0)
+            w->out.error = true;
+        break;
+    case IMAGE_FORMAT_PNG:
+        w->png = png_state_create(width);
+        if (!w->png || out_write_png_header(&w->out, width, height) != 0)
+            w->out.error = true;
+        break;
+    }
+
+    metrics_end(&span);
+    if (w->out.error) {
+        fclose(w->out.file);
+        png_state_free(w->png);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+// Устанавливает уровень сжатия PNG
+int image_writer_set_level(image_writer_p w, int level)
+{
+    assert(w != NULL);
+    if (level < 0 || level > DEFLATE_LEVEL_MAX || w->rows > 0)
+        return -1;
+    if (w->png)
+        w->png->level = level;
+    return 0;
+}
+
+// Возвращает ширину записываемого изображения
+pixel_coord image_writer_width(image_writer_p w)
+{
+    assert(w != NULL);
+    return w->width;
+}
+
+// Возвращает высоту записываемого изображения
+pixel_coord image_writer_height(image_writer_p w)
+{
+    assert(w != NULL);
+    return w->height;
+}
+
+// Записывает очередные строки изображения
+int image_writer_write_rows(image_writer_p w, const pixel_data *rows,
+                            pixel_coord count)
+{
+    assert(w != NULL);
+    assert(rows != NULL || count == 0);
+    if (count > w->height - w->rows)
+        return -1;
+
+    metrics_span_t span = metrics_begin(METRICS_STAGE_SAVE);
+    if (w->format == IMAGE_FORMAT_PNG) {
+        if (png_write_rows(w, rows, count) != 0)
+            w->out.error = true;
+        w->rows += count;
+        metrics_end(&span);
+        return w->out.error ? -1 : 0;
+    }
+
+    uint8_t padding[3] = {0, 0, 0};
+    pixel_coord pad_size = ((w->width + 3) & ~3u) - w->width;
+
+    for (pixel_coord y = 0; y < count; ++y, rows += w->width) {
+        switch (w->format) {
+        case IMAGE_FORMAT_PGM_ASCII:
+            out_write_ascii_row(&w->out, rows, w->width);
+            break;
+        case IMAGE_FORMAT_PGM_BINARY:
+            out_write(&w->out, rows, w->width);
+            break;
+        case IMAGE_FORMAT_BMP:
+            out_write(&w->out, rows, w->width);
+            if (pad_size > 0)
+                out_write(&w->out, padding, pad_size);
+            break;
+        case IMAGE_FORMAT_PNG:
+            break;
+        }
+    }
+    w->rows += count;
+    metrics_end(&span);
+    return w->out.error ? -1 : 0;
+}
+
+// Записывает первые rows строк изображения
+int image_writer_write_image(image_writer_p w, image_p picture, pixel_coord rows)
+{
+    assert(w != NULL);
+    assert(picture != NULL);
+    assert(picture->width == w->width && rows <= picture->height);
+    return image_writer_write_rows(w, picture->data, rows);
+}
+
+// Дописывает буфер и закрывает файл
+int image_writer_close(image_writer_p w)
+{
+    if (!w)
+        return -1;
+    metrics_span_t span = metrics_begin(METRICS_STAGE_SAVE);
+    if (w->png && !w->out.error && w->rows == w->height)
+        out_write_png_chunk(&w->out, "IEND", NULL, 0,
+                            png_crc(0xFFFFFFFFu, (const uint8_t *)"IEND", 4));
+    png_state_free(w->png);
+    out_flush(&w->out);
+    bool ok = !w->out.error && w->rows == w->height;
+    if (fclose(w->out.file) != 0)
+        ok = false;
+    free(w);
+    metrics_end(&span);
+    return ok ? 0 : -1;
+}
+
+// Сохраняет изображение в формате PGM (Portable Graymap)
+static int save_pgm_format(image_p picture, const char *filename,
+                           image_format_t format)
+{
+    assert(picture != NULL);
+    assert(filename != NULL);
+
+    image_writer_p w = image_writer_open(filename, format, picture->width,
+                                         picture->height);
+    if (!w)
+        return -1;
+    image_writer_write_rows(w, picture->data, picture->height);
+    return image_writer_close(w);
+}
+
+// Сохраняет изображение в текстовом формате PGM (P2)
+int save_pgm(image_p picture, const char *filename)
+{
+    return save_pgm_format(picture, filename, IMAGE_FORMAT_PGM_ASCII);
+}
+
+// Сохраняет изображение в двоичном формате PGM (P5)
+int save_pgm_binary(image_p picture, const char *filename)
+{
+    return save_pgm_format(picture, filename, IMAGE_FORMAT_PGM_BINARY);
+}
+
 // Устанавливает цвет пикселя в заданной позиции
 void set_pixel(image_p picture, pixel_coord x, pixel_coord y, pixel_data color)
 {
-    assert(("Координаты вне изображения", x >= 0 && y >= 0 && x < picture->width && y < picture->height));
-    picture->data[picture->width * y + x] = color;
+    assert(x < picture->width && y < picture->height); // Координаты вне изображения
+    picture->data[(size_t)picture->width * y + x] = color;
 }
 
 // Получает цвет пикселя из заданной позиции
 pixel_data get_pixel(image_p picture, pixel_coord x, pixel_coord y)
 {
-    assert(("Координаты вне изображения", x >= 0 && y >= 0 && x < picture->width && y < picture->height));
-    return picture->data[picture->width * y + x];
+    assert(x < picture->width && y < picture->height); // Координаты вне изображения
+    return picture->data[(size_t)picture->width * y + x];
 }
 
 // Возвращает ширину изображения
@@ -116,80 +952,103 @@ pixel_coord get_image_height(image_p picture)
     return picture->height;
 }
 
+// Возвращает указатель на начало строки
+pixel_data *image_row(image_p picture, pixel_coord y)
+{
+    assert(picture != NULL);
+    assert(y < picture->height); // Строка вне изображения
+    return picture->data + (size_t)picture->width * y;
+}
+
+// Возвращает шаг строк в пикселях
+size_t image_stride(image_p picture)
+{
+    assert(picture != NULL);
+    return picture->width;
+}
+
+// Возвращает описание прямого доступа к пикселям
+image_view_t image_get_view(image_p picture)
+{
+    assert(picture != NULL);
+    image_view_t view = {
+        .data = picture->data,
+        .stride = picture->width,
+        .width = picture->width,
+        .height = picture->height,
+    };
+    return view;
+}
+
 // Сохраняет изображение в формате BMP
 int save_bmp(image_p picture, const char *filename)
 {
     assert(picture != NULL);
     assert(filename != NULL);
     
+    if (picture->height > INT32_MAX)
+        return -1;
+
     // Открываем файл для записи в бинарном режиме
-    FILE *f = fopen(filename, "wb");
-    if (!f)
+    struct out_buffer *out = malloc(sizeof(struct out_buffer));
+    if (!out)
+        return -1;
+    out->used = 0;
+    out->error = false;
+    out->file = fopen(filename, "wb");
+    if (!out->file) {
+        free(out);
         return -1;
-    
-    /* BMP требует выравнивания строк по границе 4 байт */
-    pixel_coord row_padded = (picture->width + 3) & (~3);
-    uint32_t image_size = row_padded * picture->height;
-    uint32_t file_size = 54 + image_size; /* 54 = размер заголовка */
-    
-    /* Заголовок BMP (14 байт) */
-    uint8_t bmp_header[14] = {
-        'B', 'M',                    /* Магическое число */
-        file_size & 0xFF,            /* Размер файла */
-        (file_size >> 8) & 0xFF,
-        (file_size >> 16) & 0xFF,
-        (file_size >> 24) & 0xFF,
-        0, 0, 0, 0,                  /* Зарезервировано */
-        54, 0, 0, 0                  /* Смещение до данных пикселей */
-    };
-    
-    /* Заголовок DIB (40 байт) */
-    uint8_t dib_header[40] = {
-        40, 0, 0, 0,                            /* Размер заголовка DIB */
-        picture->width & 0xFF,                  /* Ширина */
-        (picture->width >> 8) & 0xFF,
-        (picture->width >> 16) & 0xFF,
-        (picture->width >> 24) & 0xFF,
-        picture->height & 0xFF,                 /* Высота */
-        (picture->height >> 8) & 0xFF,
-        (picture->height >> 16) & 0xFF,
-        (picture->height >> 24) & 0xFF,
-        1, 0,                                   /* Количество цветовых плоскостей */
-        8, 0,                                   /* Бит на пиксель */
-        0, 0, 0, 0,                            /* Без сжатия */
-        image_size & 0xFF,                      /* Размер изображения */
-        (image_size >> 8) & 0xFF,
-        (image_size >> 16) & 0xFF,
-        (image_size >> 24) & 0xFF,
-        0x13, 0x0B, 0, 0,                      /* Разрешение печати */
-        0x13, 0x0B, 0, 0,
-        0, 0, 0, 0,                            /* Количество цветов в палитре */
-        0, 0, 0, 0                             /* Важные цвета */
-    };
-    
-    // Записываем заголовки
-    fwrite(bmp_header, 1, 14, f);
-    fwrite(dib_header, 1, 40, f);
-    
-    /* Записываем палитру оттенков серого (256 цветов) */
-    for (int i = 0; i < 256; i++) {
-        uint8_t color[4] = {i, i, i, 0};  // R=G=B=i, альфа=0
-        fwrite(color, 1, 4, f);
     }
+    metrics_span_t span = metrics_begin(METRICS_STAGE_SAVE);
+    
+    // Записываем заголовки и палитру
+    if (out_write_bmp_header(out, picture->width, (int32_t)picture->height) != 0)
+        out->error = true;
     
     /* Записываем данные пикселей (BMP хранится снизу вверх) */
     uint8_t padding[3] = {0, 0, 0};
-    pixel_coord pad_size = row_padded - picture->width;
+    pixel_coord pad_size = ((picture->width + 3) & ~3u) - picture->width;
     
     // Проходим по строкам снизу вверх
-    for (int y = picture->height - 1; y >= 0; y--) {
+    for (pixel_coord y = picture->height; y-- > 0 && !out->error;) {
         // Записываем строку пикселей
-        fwrite(&picture->data[y * picture->width], 1, picture->width, f);
+        out_write(out, &picture->data[(size_t)y * picture->width], picture->width);
         // Добавляем выравнивание, если нужно
         if (pad_size > 0)
-            fwrite(padding, 1, pad_size, f);
+            out_write(out, padding, pad_size);
     }
     
-    fclose(f);
-    return 0;
+    out_flush(out);
+    bool ok = !out->error;
+    if (fclose(out->file) != 0)
+        ok = false;
+    free(out);
+    metrics_end(&span);
+    return ok ? 0 : -1;
+}
+
+// Сохраняет изображение в формате PNG
+int save_png(image_p picture, const char *filename, int level)
+{
+    assert(picture != NULL);
+    assert(filename != NULL);
+
+    image_writer_p w = image_writer_open(filename, IMAGE_FORMAT_PNG,
+                                         picture->width, picture->height);
+    if (!w)
+        return -1;
+    if (image_writer_set_level(w, level) == 0)
+        image_writer_write_rows(w, picture->data, picture->height);
+    return image_writer_close(w);
+}
+
+// Сохраняет изображение в заданном формате
+int save_image(image_p picture, const char *filename, image_format_t format)
+{
+    if (format == IMAGE_FORMAT_BMP)
+        return save_bmp(picture, filename);
+    if (format == IMAGE_FORMAT_PNG)
+        return save_png(picture, filename, IMAGE_PNG_LEVEL_DEFAULT);
+    return save_pgm_format(picture, filename, format);
 }
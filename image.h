@@ -2,6 +2,7 @@
 #define _IMAGE_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -33,6 +34,38 @@ typedef struct image image_t, *image_p;
  */
 image_p create_image(pixel_coord width, pixel_coord height);
 
+/**
+ * @brief Создает изображение, хранящееся в файле, отображенном в память
+ *
+ * Позволяет работать с изображениями больше оперативной памяти: страницы
+ * подгружаются и выгружаются операционной системой по мере обращения.
+ * Файл сразу имеет формат двоичного PGM (P5), поэтому после free_image
+ * он является готовым результатом. Доступно на POSIX-системах.
+ *
+ * @param width,height Размеры изображения
+ * @param filename Имя файла (создается или перезаписывается)
+ * @returns указатель на изображение или NULL при ошибке
+ */
+image_p create_image_mapped(pixel_coord width, pixel_coord height,
+                            const char *filename);
+
+/**
+ * @brief Проверяет, хранится ли изображение в файле
+ *
+ * @param picture Изображение
+ * @returns true для изображений, созданных create_image_mapped
+ */
+bool image_is_mapped(image_p picture);
+
+/**
+ * @brief Сбрасывает готовые строки изображения в файл и освобождает
+ * занимаемую ими память (для изображений в памяти ничего не делает)
+ *
+ * @param picture Изображение
+ * @param y_begin,y_end Полуинтервал строк [y_begin, y_end)
+ */
+void image_evict_rows(image_p picture, pixel_coord y_begin, pixel_coord y_end);
+
 /**
  * @brief Заполняет изображение случайными значениями
  * @param picture Изображение для заполнения
@@ -59,6 +92,17 @@ void free_image(image_p picture);
  */
 int save_pgm(image_p picture, const char *filename);
 
+/**
+ * @brief Сохраняет изображение в двоичном формате PGM (P5)
+ *
+ * Файл примерно в 4 раза меньше текстового P2 и записывается целыми блоками.
+ *
+ * @param picture Изображение для сохранения
+ * @param filename Имя выходного файла
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int save_pgm_binary(image_p picture, const char *filename);
+
 /**
  * @brief Устанавливает цвет пикселя изображения
  *
@@ -93,6 +137,83 @@ pixel_coord get_image_width(image_p picture);
  */
 pixel_coord get_image_height(image_p picture);
 
+/**
+ * @brief Возвращает указатель на начало строки изображения для записи
+ *
+ * Строки хранятся подряд без выравнивания, поэтому строка y + 1 начинается
+ * через image_stride() пикселей после строки y.
+ *
+ * @param picture Изображение
+ * @param y Номер строки
+ * @returns указатель на пиксель (0, y)
+ */
+pixel_data *image_row(image_p picture, pixel_coord y);
+
+/**
+ * @brief Возвращает расстояние между началами соседних строк в пикселях
+ *
+ * @param picture Изображение
+ * @returns шаг строк
+ */
+size_t image_stride(image_p picture);
+
+/**
+ * @brief Прямой доступ к пикселям изображения
+ *
+ * Получается один раз через image_get_view() и позволяет обращаться
+ * к пикселям встраиваемыми функциями без вызовов и проверок границ.
+ * Действителен, пока изображение не освобождено.
+ */
+typedef struct image_view {
+    pixel_data *data;           // Пиксель (0, 0)
+    size_t stride;              // Шаг строк в пикселях
+    pixel_coord width, height;  // Размеры изображения
+} image_view_t;
+
+/**
+ * @brief Возвращает описание прямого доступа к пикселям изображения
+ *
+ * @param picture Изображение
+ * @returns описание прямого доступа
+ */
+image_view_t image_get_view(image_p picture);
+
+/**
+ * @brief Возвращает указатель на строку y (без проверки границ)
+ */
+static inline pixel_data *image_view_row(const image_view_t *view,
+                                         pixel_coord y)
+{
+    return view->data + view->stride * y;
+}
+
+/**
+ * @brief Устанавливает цвет пикселя (без проверки границ)
+ */
+static inline void image_view_set(const image_view_t *view, pixel_coord x,
+                                  pixel_coord y, pixel_data color)
+{
+    view->data[view->stride * y + x] = color;
+}
+
+/**
+ * @brief Получает цвет пикселя (без проверки границ)
+ */
+static inline pixel_data image_view_get(const image_view_t *view,
+                                        pixel_coord x, pixel_coord y)
+{
+    return view->data[view->stride * y + x];
+}
+
+/**
+ * @brief Проверяет, лежит ли точка со знаковыми координатами в изображении
+ */
+static inline bool image_view_contains(const image_view_t *view, int x, int y)
+{
+    return x >= 0 && y >= 0 &&
+           (pixel_coord)x < view->width && (pixel_coord)y < view->height;
+}
+
 /**
  * @brief Сохраняет изображение в формате BMP
  *
@@ -102,4 +223,117 @@ pixel_coord get_image_height(image_p picture);
  */
 int save_bmp(image_p picture, const char *filename);
 
+/**
+ * @brief Размер буфера записи файлов изображений в байтах
+ */
+#define IMAGE_WRITE_BUFFER (1 << 16)
+
+/**
+ * @brief Формат файла изображения
+ */
+typedef enum image_format {
+    IMAGE_FORMAT_PGM_ASCII,     // PGM, текстовый (P2)
+    IMAGE_FORMAT_PGM_BINARY,    // PGM, двоичный (P5)
+    IMAGE_FORMAT_BMP,           // BMP, 8 бит с палитрой оттенков серого
+    IMAGE_FORMAT_PNG,           // PNG, 8 бит в оттенках серого, сжатие DEFLATE
+} image_format_t;
+
+/**
+ * @brief Уровень сжатия PNG по умолчанию (0 - без сжатия, 9 - наилучшее)
+ */
+#define IMAGE_PNG_LEVEL_DEFAULT 6
+
+/**
+ * @brief Сохраняет изображение в формате PNG
+ *
+ * Строки делятся на полосы, которые фильтруются и сжимаются параллельно
+ * на пуле потоков (как в pigz): каждая полоса - независимый фрагмент
+ * потока DEFLATE со словарем из предыдущих 32 КБ и отдельный блок IDAT.
+ *
+ * @param picture Изображение для сохранения
+ * @param filename Имя выходного файла
+ * @param level Уровень сжатия (0..9)
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int save_png(image_p picture, const char *filename, int level);
+
+/**
+ * @brief Сохраняет изображение в заданном формате
+ * @param picture Изображение для сохранения
+ * @param filename Имя выходного файла
+ * @param format Формат файла
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int save_image(image_p picture, const char *filename, image_format_t format);
+
+// Предварительное объявление структуры потоковой записи
+struct image_writer;
+
+/**
+ * @brief Потоковая запись изображения
+ * Позволяет записывать изображение полосами строк сверху вниз, не держа
+ * его целиком в памяти
+ */
+typedef struct image_writer image_writer_t, *image_writer_p;
+
+/**
+ * @brief Открывает файл для потоковой записи и записывает заголовок
+ *
+ * @param filename Имя выходного файла
+ * @param format Формат файла
+ * @param width,height Размеры изображения
+ * @returns объект записи или NULL при ошибке
+ */
+image_writer_p image_writer_open(const char *filename, image_format_t format,
+                                 pixel_coord width, pixel_coord height);
+
+/**
+ * @brief Устанавливает уровень сжатия PNG (по умолчанию
+ * IMAGE_PNG_LEVEL_DEFAULT); для остальных форматов ничего не делает
+ *
+ * @param w Объект записи, в который еще не записаны строки
+ * @param level Уровень сжатия (0..9)
+ * @returns 0 при успехе, -1 при неверном уровне или после записи строк
+ */
+int image_writer_set_level(image_writer_p w, int level);
+
+/**
+ * @brief Возвращает ширину записываемого изображения
+ */
+pixel_coord image_writer_width(image_writer_p w);
+
+/**
+ * @brief Возвращает высоту записываемого изображения
+ */
+pixel_coord image_writer_height(image_writer_p w);
+
+/**
+ * @brief Записывает очередные строки изображения (сверху вниз)
+ *
+ * @param w Объект записи
+ * @param rows Строки пикселей, по width байт каждая, без выравнивания
+ * @param count Количество строк
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int image_writer_write_rows(image_writer_p w, const pixel_data *rows,
+                            pixel_coord count);
+
+/**
+ * @brief Записывает первые rows строк изображения
+ *
+ * @param w Объект записи
+ * @param picture Изображение той же ширины
+ * @param rows Количество строк
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int image_writer_write_image(image_writer_p w, image_p picture, pixel_coord rows);
+
+/**
+ * @brief Завершает запись и закрывает файл
+ *
+ * @param w Объект записи
+ * @returns 0, если записаны все строки и не было ошибок, иначе -1
+ */
+int image_writer_close(image_writer_p w);
+
 #endif // _IMAGE_H_
@@ -0,0 +1,637 @@
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deflate.h"
+#include "distrib.h"
+#include "escape.h"
+#include "job.h"
+
+/**
+ * @brief Описание фрактала: имя в задании и размеры по умолчанию
+ */
+static const struct {
+	const char *name;
+	pixel_coord width, height;
+} kinds[] = {
+	[FRACTAL_JOB_MANDELBROT] = { "mandelbrot", 800, 600 },
+	[FRACTAL_JOB_JULIA] = { "julia", 800, 600 },
+	[FRACTAL_JOB_DEEP] = { "deep", 800, 600 },
+	[FRACTAL_JOB_SIERPINSKI] = { "sierpinski", 800, 700 },
+	[FRACTAL_JOB_SIERPINSKI_FAST] = { "sierpinski_fast", 800, 700 },
+	[FRACTAL_JOB_TREE] = { "tree", 800, 800 },
+	[FRACTAL_JOB_TREE_AA] = { "tree_aa", 800, 800 },
+	[FRACTAL_JOB_ANIMATION] = { "animation", 800, 600 },
+};
+
+/**
+ * @brief Ключевые кадры анимации по умолчанию: от обзорного вида
+ * Мандельброта к долине морских коньков
+ */
+static const anim_keyframe_t default_keys[] = {
+	{ -0.5, 0.0, 3.5, 256, 0.0, 0.0 },
+	{ -0.743643887, 0.131825904, 1e-3, 1024, 0.0, 0.0 },
+};
+
+/**
+ * @brief Имена и расширения форматов вывода
+ */
+static const struct {
+	const char *name;
+	const char *ext;
+	image_format_t format;
+} formats[] = {
+	{ "bmp", "bmp", IMAGE_FORMAT_BMP },
+	{ "pgm", "pgm", IMAGE_FORMAT_PGM_BINARY },
+	{ "pgm-ascii", "pgm", IMAGE_FORMAT_PGM_ASCII },
+	{ "png", "png", IMAGE_FORMAT_PNG },
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+void fractal_job_init(fractal_job_t *job)
+{
+	assert(job != NULL);
+	memset(job, 0, sizeof(*job));
+	job->kind = FRACTAL_JOB_MANDELBROT;
+	job->c_real = -0.7;
+	job->c_imag = 0.27015;
+	strcpy(job->center_re, "-0.75");
+	strcpy(job->center_im, "0");
+	job->span = 3.5;
+	job->depth = -1;
+	job->formats[0] = IMAGE_FORMAT_BMP;
+	job->format_count = 1;
+	job->png_level = IMAGE_PNG_LEVEL_DEFAULT;
+	job->worker_timeout = DISTRIB_TIMEOUT_MS;
+	job->frames = 60;
+	fractal_options_init(&job->options);
+}
+
+/**
+ * @brief Разбирает count чисел через запятую
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int parse_doubles(const char *s, double *out, int count)
+{
+	for (int i = 0; i < count; i++) {
+		char *end;
+		out[i] = strtod(s, &end);
+		if (end == s)
+			return -1;
+		if (i + 1 < count && *end != ',')
+			return -1;
+		s = end + 1;
+		if (i + 1 == count && *end != '\0')
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Разбирает целое число не меньше min
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int parse_int(const char *s, int min, int *out)
+{
+	char *end;
+	long v = strtol(s, &end, 10);
+	if (end == s || *end != '\0' || v < min || v > 1000000000L)
+		return -1;
+	*out = (int)v;
+	return 0;
+}
+
+/**
+ * @brief Разбирает логическое значение (0/1, no/yes, off/on)
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int parse_bool(const char *s, bool *out)
+{
+	if (strcmp(s, "1") == 0 || strcmp(s, "yes") == 0 || strcmp(s, "on") == 0)
+		*out = true;
+	else if (strcmp(s, "0") == 0 || strcmp(s, "no") == 0 ||
+		 strcmp(s, "off") == 0)
+		*out = false;
+	else
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Копирует строку в буфер задания
+ * @returns 0 при успехе, -1 если строка не поместилась
+ */
+static int copy_name(char *dst, const char *src, size_t len)
+{
+	if (len == 0 || len >= FRACTAL_JOB_NAME_MAX)
+		return -1;
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+	return 0;
+}
+
+/**
+ * @brief Разбирает список форматов через запятую
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int parse_formats(fractal_job_t *job, const char *s)
+{
+	size_t chosen[FRACTAL_JOB_MAX_FORMATS];
+	int count = 0;
+	while (*s != '\0') {
+		size_t len = strcspn(s, ",");
+		size_t i;
+		for (i = 0; i < COUNT(formats); i++)
+			if (strlen(formats[i].name) == len &&
+			    strncmp(formats[i].name, s, len) == 0)
+				break;
+		if (i == COUNT(formats) || count == FRACTAL_JOB_MAX_FORMATS)
+			return -1;
+		// Форматы с одним расширением записали бы один и тот же файл
+		for (int k = 0; k < count; k++)
+			if (strcmp(formats[chosen[k]].ext, formats[i].ext) == 0)
+				return -1;
+		chosen[count] = i;
+		job->formats[count++] = formats[i].format;
+		s += len;
+		if (*s == ',')
+			s++;
+	}
+	if (count == 0)
+		return -1;
+	job->format_count = count;
+	return 0;
+}
+
+/**
+ * @brief Устанавливает имя вывода; известное расширение задает формат
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int parse_output(fractal_job_t *job, const char *s)
+{
+	size_t len = strlen(s);
+	const char *dot = strrchr(s, '.');
+	if (dot != NULL && strchr(dot, '/') == NULL) {
+		for (size_t i = 0; i < COUNT(formats); i++)
+			if (strcmp(dot + 1, formats[i].name) == 0) {
+				job->formats[0] = formats[i].format;
+				job->format_count = 1;
+				len = (size_t)(dot - s);
+				break;
+			}
+	}
+	return copy_name(job->output, s, len);
+}
+
+int fractal_job_set(fractal_job_t *job, const char *token)
+{
+	assert(job != NULL && token != NULL);
+
+	const char *eq = strchr(token, '=');
+	if (eq == NULL)
+		return -1;
+	size_t klen = (size_t)(eq - token);
+	const char *v = eq + 1;
+	double d[4];
+	int n;
+
+#define KEY(name) (klen == sizeof(name) - 1 && strncmp(token, name, klen) == 0)
+
+	if (KEY("fractal")) {
+		for (size_t i = 0; i < COUNT(kinds); i++)
+			if (strcmp(v, kinds[i].name) == 0) {
+				job->kind = (fractal_job_kind_t)i;
+				return 0;
+			}
+		return -1;
+	}
+	if (KEY("size")) {
+		unsigned long w, h;
+		char *end;
+		w = strtoul(v, &end, 10);
+		if (end == v || *end != 'x')
+			return -1;
+		v = end + 1;
+		h = strtoul(v, &end, 10);
+		if (end == v || *end != '\0' || w == 0 || h == 0 ||
+		    w > 1000000UL || h > 1000000UL)
+			return -1;
+		job->width = (pixel_coord)w;
+		job->height = (pixel_coord)h;
+		return 0;
+	}
+	if (KEY("bounds")) {
+		if (parse_doubles(v, d, 4) != 0 || !(d[0] < d[1]) || !(d[2] < d[3]))
+			return -1;
+		memcpy(job->bounds, d, sizeof(job->bounds));
+		job->has_bounds = true;
+		return 0;
+	}
+	if (KEY("c")) {
+		if (parse_doubles(v, d, 2) != 0)
+			return -1;
+		job->c_real = d[0];
+		job->c_imag = d[1];
+		return 0;
+	}
+	if (KEY("formula")) {
+		static const char *names[] = {
+			[FRACTAL_FORMULA_POWER] = "power",
+			[FRACTAL_FORMULA_BURNING_SHIP] = "burning_ship",
+			[FRACTAL_FORMULA_TRICORN] = "tricorn",
+		};
+		for (size_t i = 0; i < COUNT(names); i++)
+			if (strcmp(v, names[i]) == 0) {
+				job->formula = (fractal_formula_kind_t)i;
+				return 0;
+			}
+		return -1;
+	}
+	if (KEY("power")) {
+		if (parse_int(v, 2, &n) != 0 || n > FRACTAL_POWER_MAX)
+			return -1;
+		job->power = n;
+		return 0;
+	}
+	if (KEY("center")) {
+		// Строки сохраняются как есть: точность deep не ограничена double
+		size_t len = strcspn(v, ",");
+		if (v[len] != ',' || parse_doubles(v, d, 2) != 0)
+			return -1;
+		if (copy_name(job->center_re, v, len) != 0 ||
+		    copy_name(job->center_im, v + len + 1, strlen(v + len + 1)) != 0)
+			return -1;
+		return 0;
+	}
+	if (KEY("span")) {
+		if (parse_doubles(v, d, 1) != 0 || !(d[0] > 0))
+			return -1;
+		job->span = d[0];
+		return 0;
+	}
+	if (KEY("iters"))
+		return parse_int(v, 1, &job->max_iter);
+	if (KEY("origin")) {
+		if (parse_doubles(v, d, 2) != 0)
+			return -1;
+		job->origin_x = d[0];
+		job->origin_y = d[1];
+		job->has_origin = true;
+		return 0;
+	}
+	if (KEY("length")) {
+		if (parse_doubles(v, d, 1) != 0 || !(d[0] > 0))
+			return -1;
+		job->length = d[0];
+		return 0;
+	}
+	if (KEY("angle"))
+		return parse_doubles(v, &job->angle, 1);
+	if (KEY("depth"))
+		return parse_int(v, 0, &job->depth);
+	if (KEY("format"))
+		return parse_formats(job, v);
+	if (KEY("output"))
+		return parse_output(job, v);
+	if (KEY("png_level")) {
+		if (parse_int(v, 0, &n) != 0 || n > DEFLATE_LEVEL_MAX)
+			return -1;
+		job->png_level = n;
+		return 0;
+	}
+	if (KEY("stream"))
+		return parse_bool(v, &job->stream);
+	if (KEY("workers"))
+		return parse_int(v, 0, &job->workers);
+	if (KEY("hosts"))
+		return copy_name(job->hosts, v, strlen(v));
+	if (KEY("worker_timeout"))
+		return parse_int(v, 0, &job->worker_timeout);
+	if (KEY("frames"))
+		return parse_int(v, 1, &job->frames);
+	if (KEY("key")) {
+		// Константа c необязательна: без нее берется c задания
+		double k[6];
+		bool with_c = parse_doubles(v, k, 6) == 0;
+		if ((!with_c && parse_doubles(v, k, 4) != 0) || !(k[2] > 0) ||
+		    !(k[3] >= 1 && k[3] <= 1000000000.0) ||
+		    job->key_count == FRACTAL_JOB_MAX_KEYS)
+			return -1;
+		anim_keyframe_t *key = &job->keys[job->key_count++];
+		key->center_x = k[0];
+		key->center_y = k[1];
+		key->scale = k[2];
+		key->max_iter = (int)k[3];
+		key->c_real = with_c ? k[4] : NAN;
+		key->c_imag = with_c ? k[5] : NAN;
+		return 0;
+	}
+	if (KEY("julia"))
+		return parse_bool(v, &job->julia);
+	if (KEY("threads"))
+		return parse_int(v, 0, &job->options.threads);
+	if (KEY("strategy")) {
+		if (strcmp(v, "brute") == 0)
+			job->options.strategy = FRACTAL_STRATEGY_BRUTE;
+		else if (strcmp(v, "subdivide") == 0)
+			job->options.strategy = FRACTAL_STRATEGY_SUBDIVIDE;
+		else if (strcmp(v, "progressive") == 0)
+			job->options.strategy = FRACTAL_STRATEGY_PROGRESSIVE;
+		else
+			return -1;
+		return 0;
+	}
+	if (KEY("simd")) {
+		static const char *names[] = {
+			[FRACTAL_SIMD_AUTO] = "auto",
+			[FRACTAL_SIMD_SCALAR] = "scalar",
+			[FRACTAL_SIMD_SSE2] = "sse2",
+			[FRACTAL_SIMD_AVX2] = "avx2",
+			[FRACTAL_SIMD_AVX512] = "avx512",
+		};
+		for (size_t i = 0; i < COUNT(names); i++)
+			if (strcmp(v, names[i]) == 0) {
+				job->options.simd = (fractal_simd_t)i;
+				return 0;
+			}
+		return -1;
+	}
+	if (KEY("precision")) {
+		static const char *names[] = {
+			[FRACTAL_PRECISION_AUTO] = "auto",
+			[FRACTAL_PRECISION_FLOAT] = "float",
+			[FRACTAL_PRECISION_DOUBLE] = "double",
+			[FRACTAL_PRECISION_DOUBLE_DOUBLE] = "dd",
+		};
+		for (size_t i = 0; i < COUNT(names); i++)
+			if (strcmp(v, names[i]) == 0) {
+				job->options.precision = (fractal_precision_t)i;
+				return 0;
+			}
+		return -1;
+	}
+	if (KEY("antialias")) {
+		if (parse_int(v, 0, &n) != 0 || n > ESCAPE_AA_MAX)
+			return -1;
+		job->options.antialias = n;
+		return 0;
+	}
+	if (KEY("jitter"))
+		return parse_bool(v, &job->options.antialias_jitter);
+	if (KEY("interior"))
+		return parse_bool(v, &job->options.interior_check);
+	if (KEY("periodicity"))
+		return parse_bool(v, &job->options.periodicity);
+#undef KEY
+	return -1;
+}
+
+int fractal_job_parse(fractal_job_t *job, const char *line)
+{
+	assert(job != NULL && line != NULL);
+
+	int count = 0;
+	char token[FRACTAL_JOB_NAME_MAX * 2];
+	for (;;) {
+		while (isspace((unsigned char)*line))
+			line++;
+		if (*line == '\0' || *line == '#')
+			break;
+		size_t len = 0;
+		while (line[len] != '\0' && !isspace((unsigned char)line[len]))
+			len++;
+		if (len >= sizeof(token))
+			return -1;
+		memcpy(token, line, len);
+		token[len] = '\0';
+		if (fractal_job_set(job, token) != 0)
+			return -1;
+		count++;
+		line += len;
+	}
+	return count;
+}
+
+const char *fractal_job_name(const fractal_job_t *job)
+{
+	assert(job != NULL);
+	return kinds[job->kind].name;
+}
+
+int fractal_job_output(const fractal_job_t *job, int i, char *path,
+		       size_t size)
+{
+	assert(job != NULL && path != NULL);
+	assert(i >= 0 && i < job->format_count);
+
+	const char *base = job->output[0] != '\0' ? job->output
+						  : fractal_job_name(job);
+	const char *ext = "bmp";
+	for (size_t k = 0; k < COUNT(formats); k++)
+		if (formats[k].format == job->formats[i]) {
+			ext = formats[k].ext;
+			break;
+		}
+	if (job->kind != FRACTAL_JOB_ANIMATION) {
+		int n = snprintf(path, size, "%s.%s", base, ext);
+		return n < 0 || (size_t)n >= size ? -1 : 0;
+	}
+	// Шаблон кадра: % в имени удваивается, чтобы printf вывел его как есть
+	size_t n = 0;
+	for (; *base != '\0' && n + 2 < size; base++) {
+		if (*base == '%')
+			path[n++] = '%';
+		path[n++] = *base;
+	}
+	if (*base != '\0')
+		return -1;
+	int m = snprintf(path + n, size - n, "_%%05d.%s", ext);
+	return m < 0 || (size_t)m >= size - n ? -1 : 0;
+}
+
+/**
+ * @brief Итерируемая функция задания mandelbrot или julia
+ */
+static fractal_formula_t job_formula(const fractal_job_t *job)
+{
+	fractal_formula_t formula = {
+		.kind = job->formula,
+		.power = job->power,
+		.julia = job->kind == FRACTAL_JOB_JULIA,
+		.c_real = job->c_real,
+		.c_imag = job->c_imag,
+	};
+	return formula;
+}
+
+/**
+ * @brief Рендерит кадры анимации задания в файлы (см. anim_render)
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int run_animation(const fractal_job_t *job, pixel_coord width,
+			 pixel_coord height)
+{
+	// Кадры пишутся в одном формате: у каждого формата свой файл кадра
+	char pattern[2 * FRACTAL_JOB_NAME_MAX + 16];
+	if (job->format_count != 1 ||
+	    fractal_job_output(job, 0, pattern, sizeof(pattern)) != 0)
+		return -1;
+
+	anim_keyframe_t keys[FRACTAL_JOB_MAX_KEYS];
+	int count = job->key_count;
+	if (count == 0) {
+		count = (int)COUNT(default_keys);
+		memcpy(keys, default_keys, sizeof(default_keys));
+	} else {
+		memcpy(keys, job->keys, sizeof(keys[0]) * count);
+	}
+	for (int i = 0; i < count; i++)
+		if (isnan(keys[i].c_real)) {
+			keys[i].c_real = job->c_real;
+			keys[i].c_imag = job->c_imag;
+		}
+
+	anim_options_t opt;
+	anim_options_init(&opt);
+	opt.width = width;
+	opt.height = height;
+	opt.julia = job->julia;
+	opt.format = job->formats[0];
+	opt.pattern = pattern;
+	opt.render = &job->options;
+	return anim_render(keys, count, job->frames, &opt);
+}
+
+/**
+ * @brief Рисует фрактал задания с временем убегания полосами прямо в файл
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int run_stream(const fractal_job_t *job, pixel_coord width,
+		      pixel_coord height, const double *b, int max_iter)
+{
+	char path[FRACTAL_JOB_NAME_MAX + 16];
+	if (fractal_job_output(job, 0, path, sizeof(path)) != 0)
+		return -1;
+	image_writer_p w = image_writer_open(path, job->formats[0], width, height);
+	if (w == NULL)
+		return -1;
+	image_writer_set_level(w, job->png_level);
+	fractal_formula_t formula = job_formula(job);
+	int result = formula_fractal_stream(w, &formula, b[0], b[1], b[2], b[3],
+					    max_iter, &job->options);
+	if (image_writer_close(w) != 0)
+		result = -1;
+	return result;
+}
+
+int fractal_job_run(const fractal_job_t *job, image_p *shared)
+{
+	assert(job != NULL && shared != NULL);
+
+	fractal_job_kind_t kind = job->kind;
+	pixel_coord width = job->width ? job->width : kinds[kind].width;
+	pixel_coord height = job->height ? job->height : kinds[kind].height;
+	int max_iter = job->max_iter > 0 ? job->max_iter : 256;
+	static const double mandelbrot_bounds[4] = { -2.5, 1.0, -1.0, 1.0 };
+	static const double julia_bounds[4] = { -1.5, 1.5, -1.0, 1.0 };
+	const double *b = job->has_bounds ? job->bounds
+		: kind == FRACTAL_JOB_JULIA ? julia_bounds : mandelbrot_bounds;
+	bool escape = kind == FRACTAL_JOB_MANDELBROT || kind == FRACTAL_JOB_JULIA;
+
+	// Полосами пишется только один файл: остальные форматы требуют
+	// изображения целиком
+	if (job->stream && escape && job->format_count == 1)
+		return run_stream(job, width, height, b, max_iter);
+	// Анимация использует собственный пул изображений
+	if (kind == FRACTAL_JOB_ANIMATION)
+		return run_animation(job, width, height);
+
+	image_p picture = *shared;
+	if (picture != NULL) {
+		image_view_t view = image_get_view(picture);
+		if (view.width != width || view.height != height) {
+			free_image(picture);
+			picture = *shared = NULL;
+		}
+	}
+	if (picture == NULL && (picture = *shared = create_image(width, height)) == NULL)
+		return -1;
+
+	int result = 0;
+	switch (kind) {
+	case FRACTAL_JOB_MANDELBROT:
+	case FRACTAL_JOB_JULIA: {
+		fractal_formula_t formula = job_formula(job);
+		if (job->workers > 0 || job->hosts[0] != '\0') {
+			distrib_options_t d;
+			distrib_options_init(&d);
+			d.workers = job->workers;
+			d.hosts = job->hosts[0] != '\0' ? job->hosts : NULL;
+			d.timeout_ms = job->worker_timeout;
+			result = distrib_render(picture, &formula, b[0], b[1], b[2],
+						b[3], max_iter, &job->options, &d,
+						NULL);
+		} else {
+			formula_fractal_ex(picture, &formula, b[0], b[1], b[2],
+					   b[3], max_iter, &job->options);
+		}
+		break;
+	}
+	case FRACTAL_JOB_DEEP:
+		result = mandelbrot_deep_fractal(picture, job->center_re,
+						 job->center_im, job->span,
+						 max_iter, &job->options);
+		break;
+	case FRACTAL_JOB_SIERPINSKI:
+	case FRACTAL_JOB_SIERPINSKI_FAST: {
+		// По умолчанию треугольник по центру с отступом 50 сверху
+		int size = job->length > 0 ? (int)job->length
+			: (int)(height > 100 ? height - 100 : height);
+		int x = job->has_origin ? (int)job->origin_x : (int)(width / 2);
+		int y = job->has_origin ? (int)job->origin_y : 50;
+		int depth = job->depth >= 0 ? job->depth : 7;
+		clear_image(picture);
+		if (kind == FRACTAL_JOB_SIERPINSKI)
+			sierpinski_triangle(picture, x, y, size, depth);
+		else
+			sierpinski_triangle_fast(picture, x, y, size, depth);
+		break;
+	}
+	case FRACTAL_JOB_TREE:
+	case FRACTAL_JOB_TREE_AA: {
+		// По умолчанию ствол растет от середины нижнего края
+		double length = job->length > 0 ? job->length : 150.0;
+		double x = job->has_origin ? job->origin_x : (double)(width / 2);
+		double y = job->has_origin ? job->origin_y
+			: (double)(height > 50 ? height - 50 : height - 1);
+		int depth = job->depth >= 0 ? job->depth : 10;
+		clear_image(picture);
+		if (kind == FRACTAL_JOB_TREE)
+			tree_fractal(picture, (int)x, (int)y, job->angle, length,
+				     depth);
+		else
+			tree_fractal_aa(picture, x, y, job->angle, length, depth);
+		break;
+	}
+	case FRACTAL_JOB_ANIMATION:
+		break;
+	}
+	if (result != 0)
+		return -1;
+
+	for (int i = 0; i < job->format_count; i++) {
+		char path[FRACTAL_JOB_NAME_MAX + 16];
+		if (fractal_job_output(job, i, path, sizeof(path)) != 0)
+			return -1;
+		int saved = job->formats[i] == IMAGE_FORMAT_PNG
+			? save_png(picture, path, job->png_level)
+			: save_image(picture, path, job->formats[i]);
+		if (saved != 0)
+			return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+#ifndef _JOB_H_
+#define _JOB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "image.h"
+#include "fractal.h"
+#include "animation.h"
+
+/**
+ * @brief Наибольшее количество форматов вывода одного задания (все
+ * форматы: bmp, pgm, pgm-ascii, png)
+ */
+#define FRACTAL_JOB_MAX_FORMATS 4
+
+/**
+ * @brief Наибольшее количество ключевых кадров анимации
+ */
+#define FRACTAL_JOB_MAX_KEYS 32
+
+/**
+ * @brief Наибольшая длина имени выходного файла и строк центра вида
+ */
+#define FRACTAL_JOB_NAME_MAX 512
+
+/**
+ * @brief Фрактал задания
+ */
+typedef enum fractal_job_kind {
+	FRACTAL_JOB_MANDELBROT = 0,    // mandelbrot
+	FRACTAL_JOB_JULIA,             // julia
+	FRACTAL_JOB_DEEP,              // deep: глубокое увеличение Мандельброта
+	FRACTAL_JOB_SIERPINSKI,        // sierpinski
+	FRACTAL_JOB_SIERPINSKI_FAST,   // sierpinski_fast
+	FRACTAL_JOB_TREE,              // tree
+	FRACTAL_JOB_TREE_AA,           // tree_aa
+	FRACTAL_JOB_ANIMATION,         // animation: кадры по ключевым кадрам
+} fractal_job_kind_t;
+
+/**
+ * @brief Задание на рендеринг одного изображения
+ *
+ * Задается строкой из параметров вида ключ=значение, разделенных
+ * пробелами (см. fractal_job_set). Не заданные параметры берутся по
+ * умолчанию для выбранного фрактала.
+ */
+typedef struct fractal_job {
+	fractal_job_kind_t kind;
+	pixel_coord width, height;          // size=WxH
+	bool has_bounds;
+	double bounds[4];                   // bounds=XMIN,XMAX,YMIN,YMAX
+	double c_real, c_imag;              // c=RE,IM (Жюлиа)
+	fractal_formula_kind_t formula;     // formula=power|burning_ship|tricorn
+	int power;                          // power=N (z^N + c, 0 - 2)
+	char center_re[FRACTAL_JOB_NAME_MAX];   // center=RE,IM (deep)
+	char center_im[FRACTAL_JOB_NAME_MAX];
+	double span;                        // span=W (deep)
+	int max_iter;                       // iters=N
+	bool has_origin;
+	double origin_x, origin_y;          // origin=X,Y (геометрические)
+	double length;                      // length=L: размер треугольника, длина ствола
+	double angle;                       // angle=A (дерево, градусы)
+	int depth;                          // depth=N
+	image_format_t formats[FRACTAL_JOB_MAX_FORMATS];  // format=bmp,pgm,...
+	int format_count;
+	int png_level;                      // png_level=0..9 (сжатие PNG)
+	char output[FRACTAL_JOB_NAME_MAX];  // output=ИМЯ (без расширения)
+	bool stream;                        // stream=1: запись полосами
+	int workers;                        // workers=N: локальные рабочие процессы
+	char hosts[FRACTAL_JOB_NAME_MAX];   // hosts=УЗЕЛ:ПОРТ,...: рабочие по TCP
+	int worker_timeout;                 // worker_timeout=МС: срок тайла
+	int frames;                         // frames=N (анимация)
+	anim_keyframe_t keys[FRACTAL_JOB_MAX_KEYS];  // key=RE,IM,W,N[,CRE,CIM]
+	int key_count;
+	bool julia;                         // julia=0|1: анимация множества Жюлиа
+	fractal_options_t options;          // threads, strategy, simd, ...
+} fractal_job_t;
+
+/**
+ * @brief Заполняет задание значениями по умолчанию (Мандельброт 800x600,
+ * 256 итераций, BMP в файл с именем фрактала)
+ *
+ * @param job Задание
+ */
+void fractal_job_init(fractal_job_t *job);
+
+/**
+ * @brief Устанавливает один параметр задания
+ *
+ * Ключи: fractal, size, bounds, c, formula (power, burning_ship, tricorn;
+ * для mandelbrot и julia), power, center, span, iters, origin, length,
+ * angle, depth, format (bmp, pgm, pgm-ascii, png через запятую; pgm и
+ * pgm-ascii пишут один файл .pgm, поэтому вместе не допускаются), output
+ * (имя; расширение .bmp, .pgm или .png задает формат), png_level, stream,
+ * workers, hosts, worker_timeout (распределенный рендеринг mandelbrot и
+ * julia, см. distrib.h), frames, key (ключевой кадр анимации: центр,
+ * ширина вида, итерации и, для Жюлиа, константа c; повторяется), julia
+ * (анимация множества Жюлиа), threads, strategy
+ * (brute, subdivide, progressive), simd (auto, scalar, sse2, avx2, avx512),
+ * precision (auto, float, double, dd), antialias, jitter, interior,
+ * periodicity.
+ *
+ * @param job Задание
+ * @param token Строка "ключ=значение"
+ * @returns 0 при успехе, -1 при неизвестном ключе или неверном значении
+ */
+int fractal_job_set(fractal_job_t *job, const char *token);
+
+/**
+ * @brief Разбирает строку задания (параметры через пробелы, # - комментарий)
+ *
+ * @param job Задание, заполненное fractal_job_init
+ * @param line Строка
+ * @returns количество разобранных параметров (0 для пустой строки) или -1
+ */
+int fractal_job_parse(fractal_job_t *job, const char *line);
+
+/**
+ * @brief Возвращает название фрактала задания
+ */
+const char *fractal_job_name(const fractal_job_t *job);
+
+/**
+ * @brief Формирует имя i-го выходного файла задания
+ *
+ * Для анимации это шаблон имени кадра для printf с номером кадра
+ * (например, "animation_%05d.bmp").
+ *
+ * @returns 0 при успехе, -1 если имя не поместилось в буфер
+ */
+int fractal_job_output(const fractal_job_t *job, int i, char *path,
+		       size_t size);
+
+/**
+ * @brief Выполняет задание
+ *
+ * Изображение *shared используется повторно, если размеры совпадают, иначе
+ * пересоздается, поэтому последовательность заданий одного размера не
+ * выделяет память заново. Потоки рендеринга общие для всех заданий (пул).
+ *
+ * @param job Задание
+ * @param shared Общее изображение (может указывать на NULL); освобождается
+ * вызывающим через free_image
+ * @returns 0 при успехе, -1 при ошибке записи или неверных параметрах
+ */
+int fractal_job_run(const fractal_job_t *job, image_p *shared);
+
+#endif // _JOB_H_
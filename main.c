@@ -1,61 +1,246 @@
+/**
+ * @file main.c
+ * @brief Генератор фракталов: задания из командной строки или файла
+ *
+ * Каждое задание - набор параметров ключ=значение (см. job.h). Задания
+ * выполняются по очереди в одном процессе: пул потоков рендеринга и
+ * изображение одного размера используются всеми заданиями.
+ */
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+
 #include "image.h"
-#include "fractal.h"
+#include "job.h"
+#include "metrics.h"
+
+/**
+ * @brief Наибольшая длина строки файла заданий
+ */
+#define MAIN_LINE_MAX 4096
+
+/**
+ * @brief Задания без аргументов: четыре фрактала в BMP и текстовом PGM
+ *
+ * Точность double задана явно: результат совпадает с mandelbrot_fractal и
+ * julia_fractal.
+ */
+static const char *default_jobs[] = {
+	"fractal=mandelbrot size=800x600 bounds=-2.5,1,-1,1 iters=256 precision=double format=bmp,pgm-ascii",
+	"fractal=julia size=800x600 c=-0.7,0.27015 bounds=-1.5,1.5,-1,1 iters=256 precision=double format=bmp,pgm-ascii",
+	"fractal=sierpinski size=800x700 origin=400,50 length=600 depth=7 format=bmp,pgm-ascii",
+	"fractal=tree size=800x800 origin=400,750 angle=0 length=150 depth=10 format=bmp,pgm-ascii",
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Использование: %s [--threads N] [-j ФАЙЛ] [ключ=значение ...] [-- ...]\n"
+		"  -j ФАЙЛ        задания из файла, по одному на строку (- - stdin)\n"
+		"  --threads N    количество потоков для всех заданий\n"
+		"  --metrics ФАЙЛ замеры стадий, итераций и тайлов в JSON\n"
+		"  --heatmap ФАЙЛ тепловая карта времени тайлов последнего вида (PGM)\n"
+		"  --             разделитель заданий в командной строке\n"
+		"Ключи задания:\n"
+		"  fractal=mandelbrot|julia|deep|sierpinski|sierpinski_fast|tree|tree_aa|\n"
+		"          animation\n"
+		"  size=WxH  bounds=XMIN,XMAX,YMIN,YMAX  iters=N  c=RE,IM\n"
+		"  formula=power|burning_ship|tricorn  power=2..8  (mandelbrot, julia)\n"
+		"  center=RE,IM  span=W  (deep)\n"
+		"  origin=X,Y  length=L  angle=A  depth=N  (sierpinski, tree)\n"
+		"  format=bmp|pgm|pgm-ascii|png[,...]  output=ИМЯ[.bmp|.pgm|.png]  stream=0|1\n"
+		"  png_level=0..9  (сжатие PNG, 6)\n"
+		"  workers=N  hosts=УЗЕЛ:ПОРТ,...  worker_timeout=МС  (mandelbrot, julia)\n"
+		"  frames=N  key=RE,IM,W,ITERS[,CRE,CIM] ...  julia=0|1  (animation;\n"
+		"            кадры ИМЯ_00000.bmp, ...)\n"
+		"  threads=N  strategy=brute|subdivide|progressive\n"
+		"  simd=auto|scalar|sse2|avx2|avx512  precision=auto|float|double|dd\n"
+		"  antialias=N  jitter=0|1  interior=0|1  periodicity=0|1\n"
+		"Без аргументов рисуются mandelbrot, julia, sierpinski и tree.\n",
+		prog);
+}
+
+/**
+ * @brief Выполняет задание и сообщает о результате
+ * @returns 0 при успехе, -1 при ошибке
+ */
+static int run_job(const fractal_job_t *job, image_p *shared)
+{
+	char path[FRACTAL_JOB_NAME_MAX + 16];
+
+	printf("Генерация: %s...\n", fractal_job_name(job));
+	if (fractal_job_run(job, shared) != 0) {
+		fprintf(stderr, "  Ошибка: задание %s не выполнено\n",
+			fractal_job_name(job));
+		return -1;
+	}
+	printf("  Сохранено:");
+	for (int i = 0; i < job->format_count; i++)
+		if (fractal_job_output(job, i, path, sizeof(path)) == 0)
+			printf(" %s", path);
+	printf("\n");
+	return 0;
+}
 
-int main(void)
+/**
+ * @brief Выполняет задания из файла (по одному на строку)
+ * @returns количество неудачных заданий или -1 при ошибке чтения
+ */
+static int run_file(const char *name, const fractal_job_t *base,
+		    image_p *shared)
 {
-	printf("Генератор фракталов - создание нескольких фрактальных изображений...\n");
-	
-	/* Инициализация генератора случайных чисел */
-	srand((unsigned int)time(NULL));
-	
-	/* 1. Множество Мандельброта */
-	printf("Генерация множества Мандельброта...\n");
-	image_p mandelbrot = create_image(800, 600);  // Создаем изображение 800x600
-	clear_image(mandelbrot);                      // Очищаем (черный фон)
-	// Генерируем фрактал: область [-2.5,1.0]x[-1.0,1.0], 256 итераций
-	mandelbrot_fractal(mandelbrot, -2.5, 1.0, -1.0, 1.0, 256);
-	save_bmp(mandelbrot, "mandelbrot.bmp");      // Сохраняем в BMP
-	save_pgm(mandelbrot, "mandelbrot.pgm");      // Сохраняем в PGM
-	free_image(mandelbrot);                       // Освобождаем память
-	printf("  Сохранено: mandelbrot.bmp и mandelbrot.pgm\n");
-	
-	/* 2. Множество Жюлиа */
-	printf("Генерация множества Жюлиа...\n");
-	image_p julia = create_image(800, 600);      // Создаем изображение 800x600
-	clear_image(julia);                          // Очищаем (черный фон)
-	// Генерируем фрактал Жюлиа с константой c = (-0.7, 0.27015i)
-	// Область [-1.5,1.5]x[-1.0,1.0], 256 итераций
-	julia_fractal(julia, -0.7, 0.27015, -1.5, 1.5, -1.0, 1.0, 256);
-	save_bmp(julia, "julia.bmp");                // Сохраняем в BMP
-	save_pgm(julia, "julia.pgm");                // Сохраняем в PGM
-	free_image(julia);                           // Освобождаем память
-	printf("  Сохранено: julia.bmp и julia.pgm\n");
-	
-	/* 3. Треугольник Серпинского */
-	printf("Генерация треугольника Серпинского...\n");
-	image_p sierpinski = create_image(800, 700);  // Создаем изображение 800x700
-	clear_image(sierpinski);                     // Очищаем (черный фон)
-	// Рисуем треугольник Серпинского: верхняя вершина (400,50), размер 600, глубина 7
-	sierpinski_triangle(sierpinski, 400, 50, 600, 7);
-	save_bmp(sierpinski, "sierpinski.bmp");      // Сохраняем в BMP
-	save_pgm(sierpinski, "sierpinski.pgm");      // Сохраняем в PGM
-	free_image(sierpinski);                      // Освобождаем память
-	printf("  Сохранено: sierpinski.bmp и sierpinski.pgm\n");
-	
-	/* 4. Древовидный фрактал */
-	printf("Генерация древовидного фрактала...\n");
-	image_p tree = create_image(800, 800);       // Создаем квадратное изображение 800x800
-	clear_image(tree);                           // Очищаем (черный фон)
-	// Рисуем фрактальное дерево: начало (400,750), угол 0°, длина 150, глубина 10
-	tree_fractal(tree, 400, 750, 0.0, 150.0, 10);
-	save_bmp(tree, "tree.bmp");                  // Сохраняем в BMP
-	save_pgm(tree, "tree.pgm");                  // Сохраняем в PGM
-	free_image(tree);                            // Освобождаем память
-	printf("  Сохранено: tree.bmp и tree.pgm\n");
-	
+	FILE *in = strcmp(name, "-") == 0 ? stdin : fopen(name, "r");
+	if (in == NULL) {
+		perror(name);
+		return -1;
+	}
+
+	char line[MAIN_LINE_MAX];
+	int failed = 0, number = 0;
+	while (fgets(line, sizeof(line), in) != NULL) {
+		number++;
+		if (strchr(line, '\n') == NULL && !feof(in)) {
+			fprintf(stderr, "%s:%d: слишком длинная строка\n", name, number);
+			failed = -1;
+			break;
+		}
+		fractal_job_t job = *base;
+		int count = fractal_job_parse(&job, line);
+		if (count < 0) {
+			fprintf(stderr, "%s:%d: неверное задание\n", name, number);
+			failed++;
+		} else if (count > 0 && run_job(&job, shared) != 0) {
+			failed++;
+		}
+	}
+	if (failed >= 0 && ferror(in)) {
+		perror(name);
+		failed = -1;
+	}
+	if (in != stdin)
+		fclose(in);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	fractal_job_t base;
+	fractal_job_init(&base);
+	const char *metrics_file = NULL, *heatmap_file = NULL;
+
+	// Общие параметры разбираются до заданий, чтобы действовать на все
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+			usage(argv[0]);
+			return 0;
+		}
+		if (strcmp(argv[i], "--threads") == 0) {
+			char token[32];
+			if (i + 1 >= argc ||
+			    snprintf(token, sizeof(token), "threads=%s", argv[i + 1]) >=
+				    (int)sizeof(token) ||
+			    fractal_job_set(&base, token) != 0) {
+				usage(argv[0]);
+				return 2;
+			}
+			i++;
+		} else if (strcmp(argv[i], "--metrics") == 0 ||
+			   strcmp(argv[i], "--heatmap") == 0) {
+			if (i + 1 >= argc) {
+				usage(argv[0]);
+				return 2;
+			}
+			if (strcmp(argv[i], "--metrics") == 0)
+				metrics_file = argv[i + 1];
+			else
+				heatmap_file = argv[i + 1];
+			i++;
+		}
+	}
+
+	// Замеры включаются только по запросу
+	metrics_t *metrics = NULL;
+	if (metrics_file != NULL || heatmap_file != NULL) {
+		metrics = metrics_create();
+		if (metrics == NULL) {
+			fprintf(stderr, "Недостаточно памяти для замеров\n");
+			return 2;
+		}
+		metrics_enable(metrics);
+	}
+
+	printf("Генератор фракталов - создание фрактальных изображений...\n");
+	image_p shared = NULL;
+	int failed = 0, jobs = 0;
+
+	fractal_job_t job = base;
+	int tokens = 0;
+	for (int i = 1; i <= argc && failed >= 0; i++) {
+		const char *arg = i < argc ? argv[i] : "--";
+		if (strcmp(arg, "--threads") == 0 || strcmp(arg, "--metrics") == 0 ||
+		    strcmp(arg, "--heatmap") == 0) {
+			i++;
+		} else if (strcmp(arg, "-j") == 0) {
+			if (i + 1 >= argc) {
+				usage(argv[0]);
+				failed = -1;
+				break;
+			}
+			int result = run_file(argv[++i], &base, &shared);
+			failed = result < 0 ? -1 : failed + result;
+			jobs++;
+		} else if (strcmp(arg, "--") == 0) {
+			if (tokens > 0) {
+				if (run_job(&job, &shared) != 0)
+					failed++;
+				jobs++;
+			}
+			job = base;
+			tokens = 0;
+		} else if (fractal_job_set(&job, arg) == 0) {
+			tokens++;
+		} else {
+			fprintf(stderr, "Неверный параметр: %s\n", arg);
+			usage(argv[0]);
+			failed = -1;
+		}
+	}
+
+	if (failed >= 0 && jobs == 0) {
+		for (size_t i = 0; i < sizeof(default_jobs) / sizeof(default_jobs[0]); i++) {
+			job = base;
+			if (fractal_job_parse(&job, default_jobs[i]) < 0 ||
+			    run_job(&job, &shared) != 0)
+				failed++;
+		}
+	}
+
+	if (shared != NULL)
+		free_image(shared);
+	if (metrics != NULL) {
+		metrics_enable(NULL);
+		FILE *out = metrics_file != NULL ? fopen(metrics_file, "w") : NULL;
+		if (metrics_file != NULL &&
+		    (out == NULL || metrics_write_json(metrics, out) != 0)) {
+			fprintf(stderr, "Не удалось записать замеры: %s\n", metrics_file);
+			failed = failed < 0 ? failed : failed + 1;
+		}
+		if (out != NULL)
+			fclose(out);
+		if (heatmap_file != NULL &&
+		    metrics_save_heatmap(metrics, heatmap_file, 8) != 0) {
+			fprintf(stderr, "Не удалось записать тепловую карту: %s\n",
+				heatmap_file);
+			failed = failed < 0 ? failed : failed + 1;
+		}
+		metrics_free(metrics);
+	}
+	if (failed < 0)
+		return 2;
+	if (failed > 0) {
+		fprintf(stderr, "\nНе выполнено заданий: %d\n", failed);
+		return 1;
+	}
 	printf("\nВсе фракталы успешно сгенерированы!\n");
 	return 0;
 }
@@ -0,0 +1,268 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "image.h"
+#include "metrics.h"
+
+/*
+ * Счетчики обновляются атомарно без блокировок: тайлы учитываются из
+ * потоков пула, а запись файлов может идти в отдельном потоке (анимация).
+ * Сетка тайлов меняется только между рендерингами, в вызывающем потоке.
+ */
+
+#define ADD(var, value) __atomic_fetch_add(&(var), (value), __ATOMIC_RELAXED)
+
+/**
+ * @brief Суммарное время стадии
+ */
+struct metrics_stage_total {
+	uint64_t calls;                 // Количество замеров
+	uint64_t wall_ns;               // Реальное время
+	uint64_t cpu_ns;                // Процессорное время всех потоков
+};
+
+/**
+ * @brief Стоимость тайла
+ */
+struct metrics_tile_cost {
+	uint64_t ns;                    // Время рендеринга
+	uint64_t iterations;            // Выполненные итерации вычисленных пикселей
+};
+
+struct metrics {
+	struct metrics_stage_total stages[METRICS_STAGE_COUNT];
+	uint64_t iterations;            // Выполненные итерации вычисленных пикселей
+	uint64_t pixels;                // Пикселей в гистограмме
+	uint64_t inside;                // Пикселей, достигших предела итераций
+	uint64_t overflow;              // Пикселей с METRICS_HIST_BINS итераций и больше
+	uint64_t histogram[METRICS_HIST_BINS];
+	uint64_t bytes;                 // Записано байт
+	unsigned int columns, rows;     // Сетка тайлов
+	unsigned int tile_size;         // Сторона тайла
+	struct metrics_tile_cost *tiles; // Тайлы (columns * rows)
+};
+
+metrics_t *metrics_current = NULL;
+
+static const char *stage_names[METRICS_STAGE_COUNT] = {
+	[METRICS_STAGE_ESCAPE] = "escape",
+	[METRICS_STAGE_REFERENCE] = "reference",
+	[METRICS_STAGE_RASTER] = "raster",
+	[METRICS_STAGE_SAVE] = "save",
+};
+
+metrics_t *metrics_create(void)
+{
+	return calloc(1, sizeof(metrics_t));
+}
+
+void metrics_free(metrics_t *m)
+{
+	if (m == NULL)
+		return;
+	if (metrics_current == m)
+		metrics_current = NULL;
+	free(m->tiles);
+	free(m);
+}
+
+void metrics_enable(metrics_t *m)
+{
+	metrics_current = m;
+}
+
+int64_t metrics_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Процессорное время процесса (всех потоков) в наносекундах
+ */
+static int64_t cpu_now(void)
+{
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+	struct timespec ts;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+		return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+	return (int64_t)((double)clock() * 1e9 / CLOCKS_PER_SEC);
+}
+
+void metrics_span_start(metrics_span_t *span)
+{
+	assert(span != NULL && span->m != NULL);
+	span->wall = metrics_now();
+	span->cpu = cpu_now();
+}
+
+void metrics_span_finish(metrics_span_t *span)
+{
+	assert(span != NULL && span->m != NULL);
+	assert(span->stage < METRICS_STAGE_COUNT);
+	struct metrics_stage_total *s = &span->m->stages[span->stage];
+	ADD(s->calls, 1);
+	ADD(s->wall_ns, (uint64_t)(metrics_now() - span->wall));
+	ADD(s->cpu_ns, (uint64_t)(cpu_now() - span->cpu));
+}
+
+void metrics_add_bytes(metrics_t *m, uint64_t bytes)
+{
+	if (m != NULL)
+		ADD(m->bytes, bytes);
+}
+
+void metrics_tile_grid(metrics_t *m, unsigned int columns, unsigned int rows,
+		       unsigned int tile_size)
+{
+	assert(m != NULL);
+	if (m->tiles != NULL && m->columns == columns && m->rows == rows &&
+	    m->tile_size == tile_size)
+		return;
+	free(m->tiles);
+	m->tiles = calloc((size_t)columns * rows, sizeof(struct metrics_tile_cost));
+	m->columns = m->tiles != NULL ? columns : 0;
+	m->rows = m->tiles != NULL ? rows : 0;
+	m->tile_size = tile_size;
+}
+
+void metrics_tile(metrics_t *m, unsigned int column, unsigned int row,
+		  int64_t ns, uint64_t iterations)
+{
+	assert(m != NULL);
+	ADD(m->iterations, iterations);
+	if (column < m->columns && row < m->rows) {
+		struct metrics_tile_cost *t = &m->tiles[(size_t)row * m->columns + column];
+		ADD(t->ns, (uint64_t)ns);
+		ADD(t->iterations, iterations);
+	}
+}
+
+void metrics_add_iterations(metrics_t *m, uint64_t iterations)
+{
+	assert(m != NULL);
+	ADD(m->iterations, iterations);
+}
+
+void metrics_histogram(metrics_t *m, const int *iters, size_t width,
+		       size_t height, size_t stride, int max_iter)
+{
+	assert(m != NULL);
+	assert(iters != NULL || width * height == 0);
+
+	// Сначала локальная гистограмма, затем атомарно только непустые ячейки
+	uint32_t local[METRICS_HIST_BINS];
+	uint32_t inside = 0, overflow = 0;
+	memset(local, 0, sizeof(local));
+	for (size_t y = 0; y < height; y++, iters += stride)
+		for (size_t x = 0; x < width; x++) {
+			int it = iters[x];
+			if (it >= max_iter)
+				inside++;
+			else if (it >= METRICS_HIST_BINS)
+				overflow++;
+			else if (it >= 0)
+				local[it]++;
+		}
+	for (int i = 0; i < METRICS_HIST_BINS; i++)
+		if (local[i] != 0)
+			ADD(m->histogram[i], local[i]);
+	ADD(m->inside, inside);
+	ADD(m->overflow, overflow);
+	ADD(m->pixels, (uint64_t)width * height);
+}
+
+int metrics_write_json(const metrics_t *m, FILE *out)
+{
+	assert(m != NULL && out != NULL);
+
+	fprintf(out, "{\n  \"stages\": {");
+	for (int s = 0; s < METRICS_STAGE_COUNT; s++) {
+		const struct metrics_stage_total *t = &m->stages[s];
+		fprintf(out, "%s\n    \"%s\": { \"calls\": %llu, \"wall_seconds\": %.6f, "
+			"\"cpu_seconds\": %.6f }", s ? "," : "", stage_names[s],
+			(unsigned long long)t->calls, t->wall_ns * 1e-9,
+			t->cpu_ns * 1e-9);
+	}
+	fprintf(out, "\n  },\n");
+	fprintf(out, "  \"iterations\": %llu,\n", (unsigned long long)m->iterations);
+	fprintf(out, "  \"bytes_written\": %llu,\n", (unsigned long long)m->bytes);
+
+	// Гистограмма обрезается после последней непустой ячейки
+	int last = METRICS_HIST_BINS;
+	while (last > 0 && m->histogram[last - 1] == 0)
+		last--;
+	fprintf(out, "  \"histogram\": {\n    \"pixels\": %llu, \"inside\": %llu, "
+		"\"overflow\": %llu,\n    \"bins\": [",
+		(unsigned long long)m->pixels, (unsigned long long)m->inside,
+		(unsigned long long)m->overflow);
+	for (int i = 0; i < last; i++)
+		fprintf(out, "%s%llu", i ? (i % 16 ? ", " : ",\n      ") : "",
+			(unsigned long long)m->histogram[i]);
+	fprintf(out, "]\n  },\n");
+
+	uint64_t max_ns = 0, total_ns = 0;
+	size_t count = (size_t)m->columns * m->rows;
+	for (size_t i = 0; i < count; i++) {
+		if (m->tiles[i].ns > max_ns)
+			max_ns = m->tiles[i].ns;
+		total_ns += m->tiles[i].ns;
+	}
+	fprintf(out, "  \"tiles\": {\n    \"size\": %u, \"columns\": %u, \"rows\": %u, "
+		"\"max_ms\": %.3f, \"mean_ms\": %.3f,\n    \"ms\": [",
+		m->tile_size, m->columns, m->rows, max_ns * 1e-6,
+		count ? total_ns * 1e-6 / count : 0.0);
+	for (unsigned int r = 0; r < m->rows; r++) {
+		fprintf(out, "%s\n      [", r ? "," : "");
+		for (unsigned int c = 0; c < m->columns; c++)
+			fprintf(out, "%s%.3f", c ? ", " : "",
+				m->tiles[(size_t)r * m->columns + c].ns * 1e-6);
+		fprintf(out, "]");
+	}
+	fprintf(out, "%s],\n    \"iterations\": [", m->rows ? "\n    " : "");
+	for (unsigned int r = 0; r < m->rows; r++) {
+		fprintf(out, "%s\n      [", r ? "," : "");
+		for (unsigned int c = 0; c < m->columns; c++)
+			fprintf(out, "%s%llu", c ? ", " : "", (unsigned long long)
+				m->tiles[(size_t)r * m->columns + c].iterations);
+		fprintf(out, "]");
+	}
+	fprintf(out, "%s]\n  }\n}\n", m->rows ? "\n    " : "");
+	return ferror(out) ? -1 : 0;
+}
+
+int metrics_save_heatmap(const metrics_t *m, const char *filename, int scale)
+{
+	assert(m != NULL && filename != NULL);
+	if (m->tiles == NULL || scale < 1)
+		return -1;
+
+	uint64_t max_ns = 1;
+	size_t count = (size_t)m->columns * m->rows;
+	for (size_t i = 0; i < count; i++)
+		if (m->tiles[i].ns > max_ns)
+			max_ns = m->tiles[i].ns;
+
+	image_p picture = create_image(m->columns * (pixel_coord)scale,
+				       m->rows * (pixel_coord)scale);
+	for (unsigned int r = 0; r < m->rows; r++)
+		for (unsigned int c = 0; c < m->columns; c++) {
+			uint64_t ns = m->tiles[(size_t)r * m->columns + c].ns;
+			pixel_data v = (pixel_data)((ns * 255 + max_ns / 2) / max_ns);
+			for (int y = 0; y < scale; y++)
+				memset(image_row(picture, r * scale + y) + (size_t)c * scale,
+				       v, (size_t)scale);
+		}
+
+	// Сама карта в замеры не попадает
+	metrics_t *active = metrics_current;
+	metrics_current = NULL;
+	int result = save_pgm_binary(picture, filename);
+	metrics_current = active;
+	free_image(picture);
+	return result;
+}
@@ -0,0 +1,183 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file metrics.h
+ * @brief Замеры рендеринга: время стадий, итерации и стоимость тайлов
+ *
+ * Сбор включается явно (metrics_enable) и действует на весь процесс. Пока
+ * он выключен, каждая точка замера - одна проверка указателя
+ * metrics_current. Собираются:
+ * - время стадий (реальное и процессорное время всех потоков, поэтому их
+ *   отношение - средняя загрузка потоков);
+ * - сумма итераций, выполненных ядрами для вычисленных пикселей (без
+ *   выборок сглаживания): точка, отсеченная проверкой кардиоиды, не
+ *   итерируется, а остановленная проверкой периодичности дает итерации
+ *   до обнаружения цикла;
+ * - гистограмма количества итераций по пикселям изображений;
+ * - стоимость (время и итерации) каждого тайла ESCAPE_TILE x ESCAPE_TILE
+ *   последнего вида: тепловая карта для подбора размера тайла и поиска
+ *   медленных областей; виды того же размера накапливаются в одной карте;
+ * - количество байт, записанных в файлы изображений.
+ */
+
+/**
+ * @brief Количество ячеек гистограммы итераций (ячейка i - ровно i итераций)
+ */
+#define METRICS_HIST_BINS 1024
+
+/**
+ * @brief Стадия рендеринга
+ */
+typedef enum metrics_stage {
+	METRICS_STAGE_ESCAPE = 0,       // Итерации фракталов с временем убегания
+	METRICS_STAGE_REFERENCE,        // Опорная орбита метода возмущений
+	METRICS_STAGE_RASTER,           // Растеризация треугольников и линий
+	METRICS_STAGE_SAVE,             // Кодирование и запись изображений
+	METRICS_STAGE_COUNT
+} metrics_stage_t;
+
+/**
+ * @brief Сборщик замеров (непрозрачный тип)
+ */
+typedef struct metrics metrics_t;
+
+/**
+ * @brief Активный сборщик (NULL - сбор выключен)
+ */
+extern metrics_t *metrics_current;
+
+/**
+ * @brief Замер одной стадии: создается metrics_begin, закрывается metrics_end
+ */
+typedef struct metrics_span {
+	metrics_t *m;                   // Сборщик (NULL - замер выключен)
+	metrics_stage_t stage;          // Стадия
+	int64_t wall, cpu;              // Время начала, нс
+} metrics_span_t;
+
+/**
+ * @brief Создает пустой сборщик
+ * @returns сборщик или NULL при нехватке памяти
+ */
+metrics_t *metrics_create(void);
+
+/**
+ * @brief Освобождает сборщик (и выключает сбор, если он активен)
+ */
+void metrics_free(metrics_t *m);
+
+/**
+ * @brief Делает сборщик активным
+ *
+ * @param m Сборщик (NULL - выключить сбор)
+ */
+void metrics_enable(metrics_t *m);
+
+/**
+ * @brief Монотонное время в наносекундах
+ */
+int64_t metrics_now(void);
+
+/**
+ * @brief Засекает начало стадии (вызывается из metrics_begin)
+ */
+void metrics_span_start(metrics_span_t *span);
+
+/**
+ * @brief Добавляет время стадии к сборщику (вызывается из metrics_end)
+ */
+void metrics_span_finish(metrics_span_t *span);
+
+/**
+ * @brief Начинает замер стадии, если сбор включен
+ */
+static inline metrics_span_t metrics_begin(metrics_stage_t stage)
+{
+	metrics_span_t span = { metrics_current, stage, 0, 0 };
+	if (span.m != NULL)
+		metrics_span_start(&span);
+	return span;
+}
+
+/**
+ * @brief Завершает замер стадии
+ */
+static inline void metrics_end(metrics_span_t *span)
+{
+	if (span->m != NULL)
+		metrics_span_finish(span);
+}
+
+/**
+ * @brief Учитывает байты, записанные в файл
+ */
+void metrics_add_bytes(metrics_t *m, uint64_t bytes);
+
+/**
+ * @brief Задает сетку тайлов вида; карта обнуляется, если размеры
+ * отличаются от предыдущего вида
+ *
+ * @param m Сборщик
+ * @param columns,rows Количество тайлов по горизонтали и вертикали
+ * @param tile_size Сторона тайла в пикселях
+ */
+void metrics_tile_grid(metrics_t *m, unsigned int columns, unsigned int rows,
+		       unsigned int tile_size);
+
+/**
+ * @brief Учитывает вычисленный тайл (потокобезопасно)
+ *
+ * @param m Сборщик
+ * @param column,row Положение тайла в сетке
+ * @param ns Время рендеринга тайла
+ * @param iterations Выполненные итерации вычисленных пикселей тайла
+ */
+void metrics_tile(metrics_t *m, unsigned int column, unsigned int row,
+		  int64_t ns, uint64_t iterations);
+
+/**
+ * @brief Учитывает итерации без привязки к тайлу (потокобезопасно)
+ */
+void metrics_add_iterations(metrics_t *m, uint64_t iterations);
+
+/**
+ * @brief Добавляет пиксели в гистограмму итераций (потокобезопасно)
+ *
+ * @param m Сборщик
+ * @param iters Количества итераций пикселей прямоугольника
+ * @param width,height Размеры прямоугольника
+ * @param stride Шаг строк в iters
+ * @param max_iter Предел итераций (такие пиксели считаются внутренними)
+ */
+void metrics_histogram(metrics_t *m, const int *iters, size_t width,
+		       size_t height, size_t stride, int max_iter);
+
+/**
+ * @brief Записывает замеры в JSON
+ *
+ * @param m Сборщик
+ * @param out Выходной поток
+ * @returns 0 при успехе, -1 при ошибке записи
+ */
+int metrics_write_json(const metrics_t *m, FILE *out);
+
+/**
+ * @brief Сохраняет тепловую карту времени тайлов в двоичном PGM
+ *
+ * Тайл изображается квадратом scale x scale пикселей; яркость
+ * пропорциональна времени тайла (255 - самый медленный).
+ *
+ * @param m Сборщик
+ * @param filename Имя файла
+ * @param scale Сторона квадрата тайла в пикселях
+ * @returns 0 при успехе, -1 если тайлов не было или при ошибке записи
+ */
+int metrics_save_heatmap(const metrics_t *m, const char *filename, int scale);
+
+#endif // _METRICS_H_
@@ -0,0 +1,259 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "palette.h"
+
+/**
+ * @brief Оттенок серого цвета (яркость по BT.601, серый цвет не меняется)
+ */
+static inline pixel_data rgb_gray(palette_rgb_t c)
+{
+	return (pixel_data)((77 * c.r + 150 * c.g + 29 * c.b) >> 8);
+}
+
+void palette_init_gray(palette_t *pal, int max_iter)
+{
+	assert(pal != NULL);
+	assert(max_iter > 0);
+	for (unsigned int i = 0; i < 256; i++)
+		pal->colors[i] = (palette_rgb_t){ i, i, i };
+	pal->size = 256;
+	pal->interior = (palette_rgb_t){ 0, 0, 0 };
+	// t = v * 255 / max_iter, как в escape_color
+	pal->period = max_iter;
+	pal->offset = 0.0;
+	pal->cyclic = false;
+}
+
+int palette_init_gradient(palette_t *pal, const palette_rgb_t *stops,
+			  unsigned int count, unsigned int size, double period)
+{
+	assert(pal != NULL);
+	assert(stops != NULL);
+	if (count == 0 || size == 0 || size > PALETTE_MAX_COLORS || !(period > 0))
+		return -1;
+
+	for (unsigned int i = 0; i < size; i++) {
+		// Положение цвета среди опорных (после последнего - снова первый)
+		double s = (double)i * count / size;
+		unsigned int a = (unsigned int)s;
+		unsigned int b = a + 1 < count ? a + 1 : 0;
+		double w = s - a;
+		pal->colors[i] = (palette_rgb_t){
+			(uint8_t)lround(stops[a].r + (stops[b].r - stops[a].r) * w),
+			(uint8_t)lround(stops[a].g + (stops[b].g - stops[a].g) * w),
+			(uint8_t)lround(stops[a].b + (stops[b].b - stops[a].b) * w),
+		};
+	}
+	pal->size = size;
+	pal->interior = (palette_rgb_t){ 0, 0, 0 };
+	/* Позиция t проходит size - 1 цветов за period итераций, а
+	   циклическая таблица повторяется через size цветов */
+	pal->period = period * (size - 1) / size;
+	if (size == 1)
+		pal->period = period;
+	pal->offset = 0.0;
+	pal->cyclic = true;
+	return 0;
+}
+
+/**
+ * @brief Цвет палитры для позиции t таблицы
+ *
+ * @param pal Палитра
+ * @param t Позиция (см. palette_t)
+ * @param interpolate Смешивать соседние цвета по дробной части позиции
+ */
+static inline palette_rgb_t palette_color(const palette_t *pal, double t,
+					  bool interpolate)
+{
+	unsigned int n = pal->size;
+	double f = floor(t);
+	unsigned int a, b;
+
+	if (pal->cyclic) {
+		double m = f - n * floor(f / n);
+		a = m < n ? (unsigned int)m : 0;
+		b = a + 1 < n ? a + 1 : 0;
+	} else if (f < 0) {
+		a = b = 0;
+	} else if (f >= n - 1) {
+		a = b = n - 1;
+	} else {
+		a = (unsigned int)f;
+		b = a + 1;
+	}
+	if (!interpolate || a == b)
+		return pal->colors[a];
+
+	palette_rgb_t ca = pal->colors[a], cb = pal->colors[b];
+	int w = (int)((t - f) * 256.0);
+	return (palette_rgb_t){
+		(uint8_t)(ca.r + (((cb.r - ca.r) * w + 128) >> 8)),
+		(uint8_t)(ca.g + (((cb.g - ca.g) * w + 128) >> 8)),
+		(uint8_t)(ca.b + (((cb.b - ca.b) * w + 128) >> 8)),
+	};
+}
+
+/**
+ * @brief Строит таблицу цветов по целому количеству итераций
+ * (элемент max_iter - цвет множества)
+ *
+ * @returns таблица из max_iter + 1 цветов или NULL, если буфер дробный,
+ * max_iter слишком велик или не хватило памяти
+ */
+static palette_rgb_t *build_lut(const palette_t *pal,
+				const escape_buffer_t *buffer)
+{
+	if (buffer->smooth || buffer->max_iter > PALETTE_LUT_MAX)
+		return NULL;
+	palette_rgb_t *lut = malloc(sizeof(palette_rgb_t) *
+				    ((size_t)buffer->max_iter + 1));
+	if (lut == NULL)
+		return NULL;
+	/* Деление (а не умножение на обратное) дает точный floor позиции
+	   для целых значений, поэтому серая палитра совпадает с escape_color */
+	for (int i = 0; i < buffer->max_iter; i++)
+		lut[i] = palette_color(pal, (i + pal->offset) * (pal->size - 1) /
+				       pal->period, false);
+	lut[buffer->max_iter] = pal->interior;
+	return lut;
+}
+
+/**
+ * @brief Раскрашивает строку буфера итераций
+ *
+ * @param lut Таблица по количеству итераций (или NULL)
+ * @param out Цвета строки
+ */
+static void color_row(const palette_t *pal, const escape_buffer_t *buffer,
+		      const palette_rgb_t *lut, pixel_coord y,
+		      palette_rgb_t *out)
+{
+	const float *v = &buffer->values[(size_t)y * buffer->width];
+	float max_iter = (float)buffer->max_iter;
+
+	if (lut != NULL) {
+		for (pixel_coord x = 0; x < buffer->width; x++) {
+			float c = v[x] < 0.0f ? 0.0f : v[x] < max_iter ? v[x] : max_iter;
+			out[x] = lut[(int)c];
+		}
+		return;
+	}
+	double scale = (pal->size - 1) / pal->period;
+	if (!buffer->smooth || !pal->cyclic || pal->offset < 0) {
+		for (pixel_coord x = 0; x < buffer->width; x++)
+			out[x] = v[x] >= max_iter ? pal->interior :
+				palette_color(pal, (v[x] + pal->offset) * scale,
+					      buffer->smooth);
+		return;
+	}
+
+	/* Основной случай сглаженной раскраски: позиция неотрицательна,
+	   поэтому считаем ее в фиксированной точке с 8 битами дробной части */
+	unsigned int n = pal->size;
+	float fscale = (float)(scale * 256.0);
+	float foffset = (float)pal->offset;
+	for (pixel_coord x = 0; x < buffer->width; x++) {
+		if (v[x] >= max_iter || v[x] < 0.0f) {
+			out[x] = v[x] >= max_iter ? pal->interior : pal->colors[0];
+			continue;
+		}
+		uint64_t t = (uint64_t)((v[x] + foffset) * fscale);
+		unsigned int a = (unsigned int)((t >> 8) % n);
+		unsigned int b = a + 1 < n ? a + 1 : 0;
+		int w = (int)(t & 255);
+		palette_rgb_t ca = pal->colors[a], cb = pal->colors[b];
+		out[x] = (palette_rgb_t){
+			(uint8_t)(ca.r + (((cb.r - ca.r) * w + 128) >> 8)),
+			(uint8_t)(ca.g + (((cb.g - ca.g) * w + 128) >> 8)),
+			(uint8_t)(ca.b + (((cb.b - ca.b) * w + 128) >> 8)),
+		};
+	}
+}
+
+void palette_apply(const palette_t *pal, const escape_buffer_t *buffer,
+		   image_p picture)
+{
+	assert(pal != NULL && pal->size > 0);
+	assert(buffer != NULL);
+	assert(picture != NULL);
+	assert(get_image_width(picture) == buffer->width);
+	assert(get_image_height(picture) == buffer->height);
+
+	palette_rgb_t *lut = build_lut(pal, buffer);
+	// Для таблицы по итерациям сразу переводим ее цвета в оттенки серого
+	pixel_data *gray = NULL;
+	if (lut != NULL) {
+		gray = malloc((size_t)buffer->max_iter + 1);
+		for (int i = 0; gray != NULL && i <= buffer->max_iter; i++)
+			gray[i] = rgb_gray(lut[i]);
+	}
+	palette_rgb_t *row = malloc(sizeof(palette_rgb_t) * buffer->width);
+	assert(row != NULL);
+	float max_iter = (float)buffer->max_iter;
+
+	for (pixel_coord y = 0; y < buffer->height; y++) {
+		pixel_data *out = image_row(picture, y);
+		if (gray != NULL) {
+			const float *v = &buffer->values[(size_t)y * buffer->width];
+			for (pixel_coord x = 0; x < buffer->width; x++) {
+				float c = v[x] < 0.0f ? 0.0f :
+					v[x] < max_iter ? v[x] : max_iter;
+				out[x] = gray[(int)c];
+			}
+			continue;
+		}
+		color_row(pal, buffer, lut, y, row);
+		for (pixel_coord x = 0; x < buffer->width; x++)
+			out[x] = rgb_gray(row[x]);
+	}
+	free(row);
+	free(gray);
+	free(lut);
+}
+
+void palette_apply_rgb(const palette_t *pal, const escape_buffer_t *buffer,
+		       uint8_t *rgb, size_t stride)
+{
+	assert(pal != NULL && pal->size > 0);
+	assert(buffer != NULL);
+	assert(rgb != NULL);
+	assert(stride >= 3 * (size_t)buffer->width);
+	assert(sizeof(palette_rgb_t) == 3);
+
+	palette_rgb_t *lut = build_lut(pal, buffer);
+	for (pixel_coord y = 0; y < buffer->height; y++)
+		color_row(pal, buffer, lut, y,
+			  (palette_rgb_t *)(rgb + stride * y));
+	free(lut);
+}
+
+int palette_save_ppm(const palette_t *pal, const escape_buffer_t *buffer,
+		     const char *filename)
+{
+	assert(buffer != NULL);
+	assert(filename != NULL);
+
+	size_t stride = 3 * (size_t)buffer->width;
+	uint8_t *rgb = malloc(stride * buffer->height);
+	if (rgb == NULL)
+		return -1;
+	palette_apply_rgb(pal, buffer, rgb, stride);
+
+	int result = -1;
+	FILE *file = fopen(filename, "wb");
+	if (file != NULL) {
+		result = 0;
+		if (fprintf(file, "P6\n%u %u\n255\n", buffer->width,
+			    buffer->height) < 0 ||
+		    fwrite(rgb, stride, buffer->height, file) != buffer->height)
+			result = -1;
+		if (fclose(file) != 0)
+			result = -1;
+	}
+	free(rgb);
+	return result;
+}
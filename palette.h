@@ -0,0 +1,105 @@
+#ifndef _PALETTE_H_
+#define _PALETTE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+#include "escape.h"
+
+/**
+ * @brief Наибольшее количество цветов в таблице палитры
+ */
+#define PALETTE_MAX_COLORS 4096
+
+/**
+ * @brief Наибольший max_iter, для которого целочисленный буфер
+ * раскрашивается через таблицу цветов по количеству итераций
+ */
+#define PALETTE_LUT_MAX (1 << 20)
+
+/**
+ * @brief Цвет RGB
+ */
+typedef struct palette_rgb {
+	uint8_t r, g, b;
+} palette_rgb_t;
+
+/**
+ * @brief Палитра: отображение количества итераций в цвет
+ *
+ * Значение v буфера итераций переводится в позицию таблицы
+ * t = (v + offset) * (size - 1) / period. Для целочисленных буферов берется
+ * цвет floor(t), для буферов с дробными значениями - линейная интерполяция
+ * между соседними цветами. Точки множества (v >= max_iter) получают цвет
+ * interior. Оттенок серого цвета таблицы - яркость по BT.601.
+ */
+typedef struct palette {
+	palette_rgb_t colors[PALETTE_MAX_COLORS];   // Таблица цветов
+	unsigned int size;                          // Количество цветов (от 1)
+	palette_rgb_t interior;                     // Цвет точек множества
+	double period;      // Итераций от первого до последнего цвета таблицы
+	double offset;      // Сдвиг по итерациям
+	bool cyclic;        // Повторять таблицу (иначе - последний цвет дальше)
+} palette_t;
+
+/**
+ * @brief Заполняет палитру оттенков серого, совпадающую с escape_color
+ *
+ * @param pal Палитра
+ * @param max_iter Максимальное количество итераций вида
+ */
+void palette_init_gray(palette_t *pal, int max_iter);
+
+/**
+ * @brief Заполняет циклическую палитру линейным градиентом по опорным цветам
+ *
+ * Опорные цвета равномерно распределяются по таблице, последний плавно
+ * переходит в первый.
+ *
+ * @param pal Палитра
+ * @param stops Опорные цвета
+ * @param count Количество опорных цветов (от 1)
+ * @param size Количество цветов таблицы (от 1 до PALETTE_MAX_COLORS)
+ * @param period Количество итераций на один проход таблицы
+ * @returns 0 при успехе, -1 при неверных параметрах
+ */
+int palette_init_gradient(palette_t *pal, const palette_rgb_t *stops,
+			  unsigned int count, unsigned int size, double period);
+
+/**
+ * @brief Раскрашивает буфер итераций в оттенки серого
+ *
+ * @param pal Палитра
+ * @param buffer Буфер итераций
+ * @param picture Изображение размером с буфер
+ */
+void palette_apply(const palette_t *pal, const escape_buffer_t *buffer,
+		   image_p picture);
+
+/**
+ * @brief Раскрашивает буфер итераций в RGB
+ *
+ * @param pal Палитра
+ * @param buffer Буфер итераций
+ * @param rgb Результат: по 3 байта (R, G, B) на пиксель
+ * @param stride Расстояние между началами строк результата в байтах
+ * (не меньше 3 * ширина буфера)
+ */
+void palette_apply_rgb(const palette_t *pal, const escape_buffer_t *buffer,
+		       uint8_t *rgb, size_t stride);
+
+/**
+ * @brief Раскрашивает буфер итераций и сохраняет результат в двоичном
+ * формате PPM (P6)
+ *
+ * @param pal Палитра
+ * @param buffer Буфер итераций
+ * @param filename Имя выходного файла
+ * @returns 0 при успехе, -1 при ошибке
+ */
+int palette_save_ppm(const palette_t *pal, const escape_buffer_t *buffer,
+		     const char *filename);
+
+#endif // _PALETTE_H_
@@ -0,0 +1,139 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "bignum.h"
+#include "metrics.h"
+#include "perturb.h"
+
+escape_reference_t *perturb_reference_create(const char *center_re,
+					     const char *center_im,
+					     double pixel_size, int max_iter)
+{
+	assert(center_re != NULL && center_im != NULL);
+	assert(max_iter > 0);
+	if (!(pixel_size > 0.0))
+		return NULL;
+
+	// Точность: порядок размера пикселя плюс запас
+	int bits = (int)ceil(-log2(pixel_size)) + 64;
+	int limbs = bignum_limbs_for_bits(bits > 64 ? bits : 64);
+	if (limbs == 0)
+		return NULL;
+
+	bignum_t cr, ci;
+	if (bignum_from_string(&cr, center_re, limbs) != 0 ||
+	    bignum_from_string(&ci, center_im, limbs) != 0)
+		return NULL;
+
+	escape_reference_t *ref = malloc(sizeof(escape_reference_t));
+	if (ref == NULL)
+		return NULL;
+	ref->re = malloc(sizeof(double) * ((size_t)max_iter + 1));
+	ref->im = malloc(sizeof(double) * ((size_t)max_iter + 1));
+	if (ref->re == NULL || ref->im == NULL) {
+		perturb_reference_free(ref);
+		return NULL;
+	}
+
+	/* Итерируем Z_{n+1} = Z_n^2 + C с полной точностью */
+	metrics_span_t span = metrics_begin(METRICS_STAGE_REFERENCE);
+	bignum_t zr, zi, zr2, zi2, zri;
+	bignum_zero(&zr, limbs);
+	bignum_zero(&zi, limbs);
+	ref->re[0] = 0.0;
+	ref->im[0] = 0.0;
+	ref->length = max_iter;
+
+	for (int n = 0; n < max_iter; n++) {
+		bignum_mul(&zr2, &zr, &zr);
+		bignum_mul(&zi2, &zi, &zi);
+		bignum_mul(&zri, &zr, &zi);
+		// Re: zr^2 - zi^2 + cr
+		bignum_sub(&zr, &zr2, &zi2);
+		bignum_add(&zr, &zr, &cr);
+		// Im: 2 zr zi + ci
+		bignum_add(&zi, &zri, &zri);
+		bignum_add(&zi, &zi, &ci);
+
+		double x = bignum_to_double(&zr);
+		double y = bignum_to_double(&zi);
+		ref->re[n + 1] = x;
+		ref->im[n + 1] = y;
+		// После выхода точки орбита дальше не нужна
+		if (x * x + y * y > 4.0) {
+			ref->length = n + 1;
+			break;
+		}
+	}
+	if (span.m != NULL)
+		metrics_add_iterations(span.m, (uint64_t)ref->length);
+	metrics_end(&span);
+	return ref;
+}
+
+void perturb_reference_free(escape_reference_t *ref)
+{
+	if (ref) {
+		free(ref->re);
+		free(ref->im);
+		free(ref);
+	}
+}
+
+uint64_t escape_row_perturb(const escape_params_t *p, pixel_coord py,
+			    pixel_coord x_begin, pixel_coord x_end,
+			    pixel_coord step, int *out)
+{
+	assert(p != NULL && p->reference != NULL);
+	assert(out != NULL);
+	assert(step > 0);
+	const escape_reference_t *ref = p->reference;
+	const double *zr = ref->re, *zi = ref->im;
+
+	// Смещение от опорной точки по мнимой оси
+	double dcy = p->y_min + (p->y_max - p->y_min) * py / p->height;
+	uint64_t total = 0;
+
+	for (pixel_coord px = x_begin; px < x_end; px += step) {
+		double dcx = p->x_min + (p->x_max - p->x_min) * px / p->width;
+
+		/* Орбита пикселя z_n = Z_m + dz, где dz - малое отклонение:
+		   dz' = (2 Z_m + dz) dz + dc */
+		double dzx = 0.0, dzy = 0.0;
+		int m = 0;
+		int iteration = 0;
+
+		while (iteration < p->max_iter) {
+			double x = zr[m] + dzx;
+			double y = zi[m] + dzy;
+			if (x * x + y * y > 4.0)
+				break;
+
+			double tx = 2.0 * zr[m] + dzx;
+			double ty = 2.0 * zi[m] + dzy;
+			double nx = tx * dzx - ty * dzy + dcx;
+			dzy = tx * dzy + ty * dzx + dcy;
+			dzx = nx;
+			m++;
+			iteration++;
+
+			/* Перебазирование: когда |z| становится меньше |dz|,
+			   отклонение теряет точность относительно опорной орбиты
+			   (источник "глитчей"), поэтому орбита пикселя продолжается
+			   от начала опорной с dz = z. То же делается, если опорная
+			   орбита закончилась раньше орбиты пикселя */
+			x = zr[m] + dzx;
+			y = zi[m] + dzy;
+			if (m == ref->length ||
+			    x * x + y * y < dzx * dzx + dzy * dzy) {
+				dzx = x;
+				dzy = y;
+				m = 0;
+			}
+		}
+		*out++ = iteration;
+		total += (unsigned int)iteration;
+	}
+	return total;
+}
@@ -0,0 +1,47 @@
+#ifndef _PERTURB_H_
+#define _PERTURB_H_
+
+#include "escape.h"
+
+/**
+ * @brief Опорная орбита для рендеринга методом возмущений
+ *
+ * Орбита Z_{n+1} = Z_n^2 + C опорной точки C вычисляется с произвольной
+ * точностью и хранится округленной до double: этого достаточно, так как
+ * все остальные пиксели считаются как малые отклонения от нее.
+ */
+typedef struct escape_reference {
+	double *re, *im;    // Z_0 .. Z_length
+	int length;         // Итерация выхода опорной точки за радиус 2 (или max_iter)
+} escape_reference_t;
+
+/**
+ * @brief Вычисляет опорную орбиту множества Мандельброта
+ *
+ * Точность выбирается по размеру пикселя: его двоичный порядок плюс
+ * 64 запасных бита.
+ *
+ * @param center_re,center_im Опорная точка в десятичной записи
+ * @param pixel_size Размер пикселя в комплексной плоскости
+ * @param max_iter Максимальное количество итераций
+ * @returns орбита или NULL при ошибке разбора или слишком большой глубине
+ */
+escape_reference_t *perturb_reference_create(const char *center_re,
+					     const char *center_im,
+					     double pixel_size, int max_iter);
+
+/**
+ * @brief Освобождает опорную орбиту
+ */
+void perturb_reference_free(escape_reference_t *ref);
+
+/**
+ * @brief Ядро метода возмущений (заменяет обычное ядро, если задана
+ * опорная орбита; x_min..y_max описывают смещения от опорной точки)
+ * @see escape_row_fn
+ */
+uint64_t escape_row_perturb(const escape_params_t *p, pixel_coord py,
+			    pixel_coord x_begin, pixel_coord x_end,
+			    pixel_coord step, int *out);
+
+#endif // _PERTURB_H_
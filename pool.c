@@ -0,0 +1,212 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+#ifdef FRACTAL_USE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+int pool_default_threads(void)
+{
+	/* Явное переопределение через переменную окружения */
+	const char *env = getenv("FRACTAL_THREADS");
+	if (env != NULL) {
+		int n = atoi(env);
+		if (n > 0)
+			return n > POOL_MAX_THREADS ? POOL_MAX_THREADS : n;
+	}
+
+#if defined(FRACTAL_USE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0)
+		return cpus > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)cpus;
+#endif
+	return 1;
+}
+
+/**
+ * @brief Последовательное выполнение всех задач в вызывающем потоке
+ */
+static void run_serial(unsigned int tasks, pool_task_fn fn, void *ctx)
+{
+	for (unsigned int t = 0; t < tasks; t++)
+		fn(ctx, t, 0);
+}
+
+#ifdef FRACTAL_USE_PTHREADS
+
+/**
+ * @brief Задание пула: один вызов pool_run
+ *
+ * Лежит в стеке вызывающего потока и стоит в очереди, пока вызов не
+ * завершится. Несколько вызовов из разных потоков выполняются одними и
+ * теми же фоновыми потоками одновременно.
+ */
+struct pool_job {
+	pool_task_fn fn;          // Функция-задача
+	void *ctx;                // Контекст задачи
+	unsigned int tasks;       // Общее количество задач
+	unsigned int next;        // Номер следующей свободной задачи
+	int threads;              // Наибольшее количество участвующих потоков
+	int joined;               // Фоновых потоков, присоединившихся к заданию
+	int running;              // Фоновых потоков, еще выполняющих задачи
+	struct pool_job *next_job; // Следующее задание очереди
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_t pool_threads[POOL_MAX_THREADS];
+static int pool_size = 0;                 // Количество запущенных фоновых потоков
+static struct pool_job *pool_queue = NULL; // Очередь заданий (старые первыми)
+static bool pool_stop = false;            // Запрошена остановка потоков
+static bool pool_atexit = false;          // Обработчик завершения установлен
+
+/**
+ * @brief Забирает и выполняет задачи задания, пока они не закончатся
+ *
+ * Вызывается и возвращает управление с захваченной блокировкой пула.
+ *
+ * @param worker Номер потока внутри задания (0 - вызывающий)
+ */
+static void run_tasks(struct pool_job *job, int worker)
+{
+	while (job->next < job->tasks) {
+		unsigned int task = job->next++;
+		pthread_mutex_unlock(&pool_lock);
+
+		job->fn(job->ctx, task, worker);
+
+		pthread_mutex_lock(&pool_lock);
+	}
+}
+
+/**
+ * @brief Первое задание очереди, к которому может присоединиться фоновый
+ * поток (остались задачи и не набрано количество потоков)
+ */
+static struct pool_job *find_job(void)
+{
+	for (struct pool_job *job = pool_queue; job != NULL; job = job->next_job)
+		if (job->next < job->tasks && job->joined < job->threads - 1)
+			return job;
+	return NULL;
+}
+
+/**
+ * @brief Основной цикл фонового потока
+ */
+static void *worker_main(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		// Ждем задания, которому нужны потоки, или команды остановки
+		struct pool_job *job;
+		while ((job = find_job()) == NULL && !pool_stop)
+			pthread_cond_wait(&pool_start, &pool_lock);
+		if (job == NULL)
+			break;
+		/* Номера потоков задания различны: поток покидает задание, только
+		   когда задачи кончились, и после этого к нему никто не
+		   присоединяется */
+		int worker = ++job->joined;
+		job->running++;
+
+		run_tasks(job, worker);
+
+		if (--job->running == 0)
+			pthread_cond_broadcast(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return NULL;
+}
+
+void pool_run(unsigned int tasks, int threads, pool_task_fn fn, void *ctx)
+{
+	assert(fn != NULL);
+
+	if (threads <= 0)
+		threads = pool_default_threads();
+	if (threads > POOL_MAX_THREADS)
+		threads = POOL_MAX_THREADS;
+	if ((unsigned int)threads > tasks)
+		threads = (int)tasks;
+	if (threads <= 1) {
+		run_serial(tasks, fn, ctx);
+		return;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	/* Дозапускаем недостающие фоновые потоки (поток 0 - вызывающий).
+	   Потоки общие для всех заданий, поэтому параллельные и вложенные
+	   вызовы не создают новых, а делят существующие */
+	if (!pool_atexit)
+		pool_atexit = atexit(pool_shutdown) == 0;
+	while (pool_size < threads - 1) {
+		if (pthread_create(&pool_threads[pool_size], NULL, worker_main,
+				   NULL) != 0)
+			break;
+		pool_size++;
+	}
+	if (threads - 1 > pool_size)
+		threads = pool_size + 1;
+
+	struct pool_job job = {
+		.fn = fn,
+		.ctx = ctx,
+		.tasks = tasks,
+		.threads = threads,
+	};
+	struct pool_job **tail = &pool_queue;
+	while (*tail != NULL)
+		tail = &(*tail)->next_job;
+	*tail = &job;
+	pthread_cond_broadcast(&pool_start);
+
+	/* Вызывающий поток выполняет задачи своего задания сам, поэтому оно
+	   завершается, даже если все фоновые потоки заняты другими */
+	run_tasks(&job, 0);
+
+	while (job.running > 0)
+		pthread_cond_wait(&pool_done, &pool_lock);
+	for (tail = &pool_queue; *tail != &job; tail = &(*tail)->next_job)
+		;
+	*tail = job.next_job;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void pool_shutdown(void)
+{
+	pthread_mutex_lock(&pool_lock);
+	pool_stop = true;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (int i = 0; i < pool_size; i++)
+		pthread_join(pool_threads[i], NULL);
+
+	pthread_mutex_lock(&pool_lock);
+	pool_size = 0;
+	pool_stop = false;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+#else /* !FRACTAL_USE_PTHREADS */
+
+void pool_run(unsigned int tasks, int threads, pool_task_fn fn, void *ctx)
+{
+	assert(fn != NULL);
+	(void)threads;
+	run_serial(tasks, fn, ctx);
+}
+
+void pool_shutdown(void)
+{
+}
+
+#endif /* FRACTAL_USE_PTHREADS */
@@ -0,0 +1,54 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+/**
+ * @brief Максимальное количество потоков в пуле
+ */
+#define POOL_MAX_THREADS 256
+
+/**
+ * @brief Функция-задача для пула потоков
+ *
+ * @param ctx Пользовательский контекст, переданный в pool_run
+ * @param task Номер задачи (от 0 до tasks - 1)
+ * @param worker Номер потока, выполняющего задачу (от 0 до threads - 1)
+ */
+typedef void (*pool_task_fn)(void *ctx, unsigned int task, int worker);
+
+/**
+ * @brief Возвращает количество потоков по умолчанию
+ *
+ * Значение берется из переменной окружения FRACTAL_THREADS, а если она
+ * не задана - равно числу доступных процессорных ядер.
+ *
+ * @returns количество потоков (не меньше 1)
+ */
+int pool_default_threads(void);
+
+/**
+ * @brief Выполняет задачи 0..tasks-1 на пуле потоков
+ *
+ * Задачи раздаются динамически: каждый освободившийся поток забирает
+ * следующую невыполненную задачу, поэтому неравномерная стоимость задач
+ * не оставляет потоки без работы. Вызывающий поток участвует в работе
+ * как поток номер 0. Функция возвращает управление после завершения
+ * всех задач. Фоновые потоки общие: параллельные вызовы из разных потоков
+ * и вложенные вызовы из задач ставятся в одну очередь и выполняются ими
+ * одновременно, а вызывающий поток всегда выполняет задачи своего вызова
+ * сам. Номера потоков внутри одного вызова различны.
+ *
+ * @param tasks Количество задач
+ * @param threads Количество потоков (0 - по умолчанию)
+ * @param fn Функция-задача
+ * @param ctx Контекст для функции-задачи
+ */
+void pool_run(unsigned int tasks, int threads, pool_task_fn fn, void *ctx);
+
+/**
+ * @brief Останавливает и освобождает потоки пула
+ *
+ * Вызывается автоматически при завершении программы.
+ */
+void pool_shutdown(void);
+
+#endif // _POOL_H_
@@ -0,0 +1,52 @@
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+
+#include "image.h"
+
+/**
+ * @file test.h
+ * @brief Общие проверки тестов (ctest)
+ *
+ * Тест - отдельная программа: CHECK печатает непрошедшую проверку и
+ * увеличивает test_failures, а main возвращает TEST_RESULT.
+ */
+
+static int test_failures = 0;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fputc('\n', stderr); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define TEST_RESULT (test_failures == 0 ? 0 : 1)
+
+/**
+ * @brief Считает отличающиеся пиксели изображений одного размера
+ * @returns количество пикселей или -1, если размеры разные
+ */
+static inline long test_image_diff(image_p a, image_p b)
+{
+	pixel_coord width = get_image_width(a);
+	pixel_coord height = get_image_height(a);
+	if (width != get_image_width(b) || height != get_image_height(b))
+		return -1;
+	long diff = 0;
+	for (pixel_coord y = 0; y < height; y++) {
+		const pixel_data *ra = image_row(a, y);
+		const pixel_data *rb = image_row(b, y);
+		if (memcmp(ra, rb, width) == 0)
+			continue;
+		for (pixel_coord x = 0; x < width; x++)
+			diff += ra[x] != rb[x];
+	}
+	return diff;
+}
+
+#endif // _TEST_H_
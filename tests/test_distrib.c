@@ -0,0 +1,133 @@
+/**
+ * @file test_distrib.c
+ * @brief Распределенный рендеринг совпадает с локальным побайтово
+ *
+ * Рабочие - fractal_worker из каталога сборки (FRACTAL_WORKER_PATH).
+ */
+#include <stdlib.h>
+
+#include "distrib.h"
+#include "test.h"
+
+#define WIDTH 700
+#define HEIGHT 500
+
+/**
+ * @brief Вид и параметры рендеринга одного случая
+ */
+struct render_case {
+	const char *name;
+	fractal_formula_t formula;
+	double x_min, x_max, y_min, y_max;
+	int max_iter;
+	fractal_precision_t precision;
+	fractal_strategy_t strategy;
+	int antialias;
+	pixel_coord width, height;      // 0 - WIDTH x HEIGHT
+	bool exact;                     // Без проверок внутренности и периодичности
+};
+
+static const struct render_case cases[] = {
+	{ "auto", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -2.5, 1.0, -1.0, 1.0, 256, FRACTAL_PRECISION_AUTO,
+	  FRACTAL_STRATEGY_BRUTE, 0, 0, 0, false },
+	{ "float", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -2.5, 1.0, -1.0, 1.0, 256, FRACTAL_PRECISION_FLOAT,
+	  FRACTAL_STRATEGY_BRUTE, 0, 0, 0, false },
+	{ "antialias", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -0.75, -0.73, 0.1, 0.115, 512, FRACTAL_PRECISION_AUTO,
+	  FRACTAL_STRATEGY_BRUTE, 3, 0, 0, false },
+	{ "subdivide", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -2.5, 1.0, -1.0, 1.0, 256, FRACTAL_PRECISION_DOUBLE,
+	  FRACTAL_STRATEGY_SUBDIVIDE, 0, 0, 0, false },
+	{ "progressive", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -2.5, 1.0, -1.0, 1.0, 256, FRACTAL_PRECISION_DOUBLE,
+	  FRACTAL_STRATEGY_PROGRESSIVE, 0, 0, 0, false },
+	{ "julia_cubic", { FRACTAL_FORMULA_POWER, 3, true, 0.4, 0.1 },
+	  -1.5, 1.5, -1.0, 1.0, 200, FRACTAL_PRECISION_AUTO,
+	  FRACTAL_STRATEGY_BRUTE, 2, 0, 0, false },
+};
+
+/* Два тайла: верхний убегает сразу, нижний почти целиком внутри
+   кардиоиды и без проверок считается секунды */
+static const struct render_case slow_case =
+	{ "slow", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -0.3, -0.1, -1.9, 0.1, 1000000, FRACTAL_PRECISION_DOUBLE,
+	  FRACTAL_STRATEGY_BRUTE, 0, 64, 128, true };
+
+/**
+ * @brief Рендерит случай распределенно и локально и сравнивает результат
+ */
+static void check_case(const struct render_case *c, const char *command,
+		       int workers, pixel_coord tile_size, int timeout_ms,
+		       distrib_stats_t *stats)
+{
+	fractal_options_t opt;
+	fractal_options_init(&opt);
+	opt.threads = 2;
+	opt.precision = c->precision;
+	opt.strategy = c->strategy;
+	opt.antialias = c->antialias;
+	opt.interior_check = !c->exact;
+	opt.periodicity = !c->exact;
+	pixel_coord width = c->width > 0 ? c->width : WIDTH;
+	pixel_coord height = c->height > 0 ? c->height : HEIGHT;
+
+	image_p local = create_image(width, height);
+	formula_fractal_ex(local, &c->formula, c->x_min, c->x_max, c->y_min,
+			   c->y_max, c->max_iter, &opt);
+
+	distrib_options_t d;
+	distrib_options_init(&d);
+	d.workers = workers;
+	d.worker_command = command;
+	d.tile_size = tile_size;
+	d.timeout_ms = timeout_ms;
+	image_p remote = create_image(width, height);
+	int result = distrib_render(remote, &c->formula, c->x_min, c->x_max,
+				    c->y_min, c->y_max, c->max_iter, &opt, &d,
+				    stats);
+	CHECK(result == 0, "%s: distrib_render вернула %d", c->name, result);
+	long diff = test_image_diff(remote, local);
+	CHECK(diff == 0, "%s (%s, тайл %u): отличаются %ld пикселей", c->name,
+	      command, tile_size, diff);
+
+	free_image(local);
+	free_image(remote);
+}
+
+int main(void)
+{
+	unsetenv("FRACTAL_PRECISION");
+	const char *worker = "'" FRACTAL_WORKER_PATH "' --stdio";
+	distrib_stats_t stats;
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		check_case(&cases[i], worker, 3, 128, DISTRIB_TIMEOUT_MS, &stats);
+		// Сторона, не кратная тайлу escape.c, округляется
+		check_case(&cases[i], worker, 2, 100, DISTRIB_TIMEOUT_MS, &stats);
+	}
+	// Рабочий сразу завершается: все тайлы досчитывает координатор
+	check_case(&cases[2], "exit 0", 2, 128, DISTRIB_TIMEOUT_MS, &stats);
+	CHECK(stats.local == stats.tiles, "exit 0: координатор отрендерил "
+	      "%lu тайлов из %lu", stats.local, stats.tiles);
+
+	/* Зависшие рабочие: соединение открыто, но ответов нет (или ответ
+	   обрывается). Без отключения по сроку рендеринг не завершился бы */
+	check_case(&cases[0], "sleep 100", 2, 128, 200, &stats);
+	CHECK(stats.stalled == 2, "sleep: зависшими признаны %d рабочих из 2",
+	      stats.stalled);
+	check_case(&cases[0], "'" FRACTAL_WORKER_PATH "' --stdio | head -c 300",
+		   2, 128, 200, &stats);
+	CHECK(stats.failed == 2, "head: отключены %d рабочих из 2",
+	      stats.failed);
+
+	/* Медленный тайл дольше срока молчания: рабочий шлет busy и не
+	   отключается, тайл дублируется на свободном рабочем */
+	check_case(&slow_case, worker, 3, 64, 300, &stats);
+	CHECK(stats.stalled == 0 && stats.failed == 0 && stats.local == 0,
+	      "slow: зависшими признаны %d, упали %d, в координаторе %lu тайлов",
+	      stats.stalled, stats.failed, stats.local);
+
+	return TEST_RESULT;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file test_geometry.c
+ * @brief Быстрые геометрические фракталы совпадают с рекурсивными
+ *
+ * sierpinski_triangle_fast должен попиксельно совпадать с
+ * sierpinski_triangle при любой глубине, в том числе больше log2(size).
+ * Сглаженное дерево с огромной длиной или NaN в параметрах рисуется
+ * отсеченными линиями, а не переполнением координат.
+ */
+#include <math.h>
+
+#include "fractal.h"
+#include "test.h"
+
+/**
+ * @brief Размер и глубина треугольника
+ */
+struct sierpinski_case {
+	int size;
+	int depth;
+};
+
+static const struct sierpinski_case sierpinski_cases[] = {
+	{ 100, 0 }, { 100, 3 }, { 100, 6 },
+	// Глубина больше log2(size): листья размером 1 пиксель
+	{ 100, 7 }, { 100, 12 }, { 257, 20 }, { 1, 5 },
+	// Листья крупнее маски
+	{ 700, 2 },
+};
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(sierpinski_cases) / sizeof(sierpinski_cases[0]); i++) {
+		const struct sierpinski_case *c = &sierpinski_cases[i];
+		pixel_coord width = c->size + 3, height = c->size + 3;
+		image_p recursive = create_image(width, height);
+		image_p fast = create_image(width, height);
+		clear_image(recursive);
+		clear_image(fast);
+		sierpinski_triangle(recursive, width / 2, 1, c->size, c->depth);
+		sierpinski_triangle_fast(fast, width / 2, 1, c->size, c->depth);
+		long diff = test_image_diff(recursive, fast);
+		CHECK(diff == 0, "sierpinski size=%d depth=%d: отличаются %ld пикселей",
+		      c->size, c->depth, diff);
+		free_image(recursive);
+		free_image(fast);
+	}
+
+	/* Ствол длиной 1e11 выходит за изображение так же, как ствол длиной
+	   1000, а при NaN ничего не рисуется */
+	image_p huge = create_image(100, 100);
+	image_p reference = create_image(100, 100);
+	clear_image(huge);
+	clear_image(reference);
+	tree_fractal_aa(huge, 50.5, 90.0, 0.0, 1e11, 1);
+	tree_fractal_aa(reference, 50.5, 90.0, 0.0, 1000.0, 1);
+	long diff = test_image_diff(huge, reference);
+	CHECK(diff == 0, "tree_aa length=1e11: отличаются %ld пикселей", diff);
+	clear_image(huge);
+	tree_fractal_aa(huge, 50.5, 90.0, NAN, 50.0, 3);
+	tree_fractal_aa(huge, INFINITY, 90.0, 0.0, 50.0, 3);
+	clear_image(reference);
+	diff = test_image_diff(huge, reference);
+	CHECK(diff == 0, "tree_aa с NaN: нарисовано %ld пикселей", diff);
+	free_image(huge);
+	free_image(reference);
+	return TEST_RESULT;
+}
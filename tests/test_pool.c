@@ -0,0 +1,83 @@
+/**
+ * @file test_pool.c
+ * @brief Параллельные и вложенные вызовы pool_run
+ *
+ * Несколько потоков одновременно вызывают pool_run, а задачи вызывают его
+ * еще раз. Каждая задача должна выполниться ровно один раз, а номера
+ * потоков одного вызова не должны пересекаться.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "pool.h"
+#include "test.h"
+
+#define CALLERS 4
+#define TASKS 64
+#define NESTED_TASKS 16
+#define THREADS 4
+
+/**
+ * @brief Один вызов pool_run: счетчики задач и занятость номеров потоков
+ */
+struct call {
+	atomic_int done[TASKS];
+	atomic_int busy[THREADS];   // Задач, выполняющихся потоком с номером
+	atomic_int overlaps;        // Номер потока использовался дважды сразу
+	int nested;                 // Вызывать ли pool_run из задач
+};
+
+static void nested_task(void *ctx, unsigned int task, int worker)
+{
+	struct call *c = ctx;
+	(void)worker;
+	atomic_fetch_add(&c->done[task], 1);
+}
+
+static void task(void *ctx, unsigned int task, int worker)
+{
+	struct call *c = ctx;
+	if (atomic_fetch_add(&c->busy[worker], 1) != 0)
+		atomic_fetch_add(&c->overlaps, 1);
+	if (c->nested) {
+		struct call inner = { .nested = 0 };
+		pool_run(NESTED_TASKS, THREADS, nested_task, &inner);
+		for (int i = 0; i < NESTED_TASKS; i++)
+			if (atomic_load(&inner.done[i]) != 1)
+				atomic_fetch_add(&c->overlaps, 1);
+	}
+	atomic_fetch_sub(&c->busy[worker], 1);
+	atomic_fetch_add(&c->done[task], 1);
+}
+
+static void *caller_main(void *arg)
+{
+	struct call *c = arg;
+	for (int repeat = 0; repeat < 50; repeat++)
+		pool_run(TASKS, THREADS, task, c);
+	return NULL;
+}
+
+int main(void)
+{
+	static struct call calls[CALLERS];
+	pthread_t threads[CALLERS];
+	for (int i = 0; i < CALLERS; i++) {
+		calls[i].nested = i % 2;
+		CHECK(pthread_create(&threads[i], NULL, caller_main, &calls[i]) == 0,
+		      "не удалось создать поток %d", i);
+	}
+	for (int i = 0; i < CALLERS; i++)
+		pthread_join(threads[i], NULL);
+
+	for (int i = 0; i < CALLERS; i++) {
+		for (int t = 0; t < TASKS; t++)
+			CHECK(atomic_load(&calls[i].done[t]) == 50,
+			      "вызов %d: задача %d выполнена %d раз вместо 50", i, t,
+			      atomic_load(&calls[i].done[t]));
+		CHECK(atomic_load(&calls[i].overlaps) == 0,
+		      "вызов %d: номер потока занят дважды (%d)", i,
+		      atomic_load(&calls[i].overlaps));
+	}
+	return TEST_RESULT;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file test_precision.c
+ * @brief Автоматический выбор точности не меняет обзорные виды
+ *
+ * Виды заданий генератора без аргументов в AUTO должны совпадать с double
+ * побайтово (float на них дает тысячи отличающихся пикселей).
+ */
+#include <stdlib.h>
+
+#include "escape.h"
+#include "fractal.h"
+#include "test.h"
+
+/**
+ * @brief Вид задания по умолчанию
+ */
+struct view {
+	const char *name;
+	fractal_formula_t formula;
+	double x_min, x_max, y_min, y_max;
+	int max_iter;
+};
+
+static const struct view views[] = {
+	{ "mandelbrot", { FRACTAL_FORMULA_POWER, 2, false, 0.0, 0.0 },
+	  -2.5, 1.0, -1.0, 1.0, 256 },
+	{ "julia", { FRACTAL_FORMULA_POWER, 2, true, -0.7, 0.27015 },
+	  -1.5, 1.5, -1.0, 1.0, 256 },
+};
+
+/**
+ * @brief Рисует вид с заданной точностью
+ */
+static image_p render(const struct view *v, fractal_precision_t precision)
+{
+	image_p picture = create_image(800, 600);
+	fractal_options_t opt;
+	fractal_options_init(&opt);
+	opt.precision = precision;
+	formula_fractal_ex(picture, &v->formula, v->x_min, v->x_max, v->y_min,
+			   v->y_max, v->max_iter, &opt);
+	return picture;
+}
+
+int main(void)
+{
+	// Переменная окружения подменила бы автоматический выбор
+	unsetenv("FRACTAL_PRECISION");
+
+	for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); i++) {
+		const struct view *v = &views[i];
+		image_p automatic = render(v, FRACTAL_PRECISION_AUTO);
+		image_p reference = render(v, FRACTAL_PRECISION_DOUBLE);
+		long diff = test_image_diff(automatic, reference);
+		CHECK(diff == 0, "%s: AUTO и double отличаются в %ld пикселях",
+		      v->name, diff);
+
+		// Исходные функции - всегда double
+		image_p legacy = create_image(800, 600);
+		if (v->formula.julia)
+			julia_fractal(legacy, v->formula.c_real, v->formula.c_imag,
+				      v->x_min, v->x_max, v->y_min, v->y_max,
+				      v->max_iter);
+		else
+			mandelbrot_fractal(legacy, v->x_min, v->x_max, v->y_min,
+					   v->y_max, v->max_iter);
+		diff = test_image_diff(legacy, reference);
+		CHECK(diff == 0, "%s: исходная функция и double отличаются в %ld "
+		      "пикселях", v->name, diff);
+
+		free_image(automatic);
+		free_image(reference);
+		free_image(legacy);
+	}
+
+	// float остается для грубых видов с малым max_iter
+	escape_params_t p = {
+		.width = 80, .height = 60,
+		.x_min = -2.5, .x_max = 1.0, .y_min = -1.0, .y_max = 1.0,
+		.max_iter = 16,
+	};
+	CHECK(escape_select_precision(&p, FRACTAL_PRECISION_AUTO) ==
+	      FRACTAL_PRECISION_FLOAT, "грубый вид: ожидался float");
+	p.max_iter = 256;
+	CHECK(escape_select_precision(&p, FRACTAL_PRECISION_AUTO) ==
+	      FRACTAL_PRECISION_DOUBLE, "256 итераций: ожидался double");
+
+	return TEST_RESULT;
+}
@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define tiles_mkdir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define tiles_mkdir(path) mkdir(path, 0755)
+#endif
+
+#include "tiles.h"
+#include "escape.h"
+
+/**
+ * @brief Наибольшая длина имени файла тайла
+ */
+#define TILES_PATH_MAX 4096
+
+void tile_pyramid_init(tile_pyramid_t *pyr, const char *root)
+{
+	assert(pyr != NULL);
+	assert(root != NULL);
+	pyr->root = root;
+	pyr->format = IMAGE_FORMAT_PGM_BINARY;
+	pyr->tile_size = TILE_PYRAMID_SIZE;
+	pyr->x_min = -2.5;
+	pyr->y_min = -2.0;
+	pyr->span = 4.0;
+	pyr->max_iter = 256;
+	pyr->iter_step = 64;
+	pyr->julia = false;
+	pyr->c_real = 0.0;
+	pyr->c_imag = 0.0;
+	fractal_options_init(&pyr->options);
+	pyr->rendered = 0;
+	pyr->reused = 0;
+}
+
+/**
+ * @brief Проверяет номер тайла
+ */
+static bool tile_valid(int z, long x, long y)
+{
+	if (z < 0 || z > TILE_PYRAMID_MAX_ZOOM)
+		return false;
+	long n = 1L << z;
+	return x >= 0 && y >= 0 && x < n && y < n;
+}
+
+int tile_pyramid_path(const tile_pyramid_t *pyr, int z, long x, long y,
+		      char *path, size_t size)
+{
+	assert(pyr != NULL);
+	assert(path != NULL);
+	if (!tile_valid(z, x, y))
+		return -1;
+	const char *ext = pyr->format == IMAGE_FORMAT_BMP ? "bmp"
+		: pyr->format == IMAGE_FORMAT_PNG ? "png" : "pgm";
+	int n = snprintf(path, size, "%s/%d/%ld/%ld.%s", pyr->root, z, x, y, ext);
+	return n >= 0 && (size_t)n < size ? 0 : -1;
+}
+
+/**
+ * @brief Создает каталоги root/z и root/z/x
+ * @returns 0 при успехе (в том числе если каталоги уже есть), -1 при ошибке
+ */
+static int make_tile_dirs(const tile_pyramid_t *pyr, int z, long x)
+{
+	char dir[TILES_PATH_MAX];
+	int n = snprintf(dir, sizeof(dir), "%s/%d", pyr->root, z);
+	if (n < 0 || (size_t)n >= sizeof(dir))
+		return -1;
+	if (tiles_mkdir(dir) != 0 && errno != EEXIST)
+		return -1;
+	n = snprintf(dir, sizeof(dir), "%s/%d/%ld", pyr->root, z, x);
+	if (n < 0 || (size_t)n >= sizeof(dir))
+		return -1;
+	if (tiles_mkdir(dir) != 0 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+int tile_pyramid_tile(tile_pyramid_t *pyr, int z, long x, long y)
+{
+	assert(pyr != NULL);
+	assert(pyr->tile_size > 0 && pyr->span > 0);
+
+	char path[TILES_PATH_MAX], tmp[TILES_PATH_MAX + 8];
+	if (tile_pyramid_path(pyr, z, x, y, path, sizeof(path)) != 0)
+		return -1;
+
+	// Готовый тайл не пересчитывается
+	FILE *file = fopen(path, "rb");
+	if (file != NULL) {
+		fclose(file);
+		pyr->reused++;
+		return 0;
+	}
+	if (make_tile_dirs(pyr, z, x) != 0)
+		return -1;
+
+	double span = ldexp(pyr->span, -z);
+	escape_params_t params = {
+		.width = pyr->tile_size,
+		.height = pyr->tile_size,
+		.x_min = pyr->x_min + span * x,
+		.x_max = pyr->x_min + span * (x + 1),
+		.y_min = pyr->y_min + span * y,
+		.y_max = pyr->y_min + span * (y + 1),
+		.max_iter = pyr->max_iter + pyr->iter_step * z,
+		.julia = pyr->julia,
+		.c_real = pyr->c_real,
+		.c_imag = pyr->c_imag,
+	};
+	image_p picture = create_image(pyr->tile_size, pyr->tile_size);
+	if (picture == NULL)
+		return -1;
+	escape_render(picture, &params, &pyr->options);
+
+	/* Тайл записывается во временный файл и переименовывается, чтобы
+	   читатели не видели недописанный файл */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	int result = save_image(picture, tmp, pyr->format);
+	free_image(picture);
+	if (result == 0 && rename(tmp, path) != 0)
+		result = -1;
+	if (result != 0) {
+		remove(tmp);
+		return -1;
+	}
+	pyr->rendered++;
+	return 1;
+}
+
+int tile_pyramid_view(tile_pyramid_t *pyr, int z, double x_min, double x_max,
+		      double y_min, double y_max)
+{
+	assert(pyr != NULL);
+	if (z < 0 || z > TILE_PYRAMID_MAX_ZOOM || !(x_max > x_min) ||
+	    !(y_max > y_min))
+		return -1;
+
+	// Диапазон номеров тайлов, пересекающих область, в пределах уровня
+	double span = ldexp(pyr->span, -z);
+	double n = ldexp(1.0, z);
+	double tx0 = floor((x_min - pyr->x_min) / span);
+	double tx1 = ceil((x_max - pyr->x_min) / span);
+	double ty0 = floor((y_min - pyr->y_min) / span);
+	double ty1 = ceil((y_max - pyr->y_min) / span);
+	tx0 = tx0 < 0 ? 0 : tx0;
+	ty0 = ty0 < 0 ? 0 : ty0;
+	tx1 = tx1 > n ? n : tx1;
+	ty1 = ty1 > n ? n : ty1;
+
+	int rendered = 0;
+	for (double ty = ty0; ty < ty1; ty++)
+		for (double tx = tx0; tx < tx1; tx++) {
+			int r = tile_pyramid_tile(pyr, z, (long)tx, (long)ty);
+			if (r < 0)
+				return -1;
+			rendered += r;
+		}
+	return rendered;
+}
+
+int tile_pyramid_command(tile_pyramid_t *pyr, const char *line, FILE *out)
+{
+	assert(pyr != NULL);
+	assert(line != NULL && out != NULL);
+
+	char cmd[16], path[TILES_PATH_MAX];
+	int z, r;
+	long x, y;
+	double x0, x1, y0, y1;
+	if (sscanf(line, "%15s", cmd) != 1)
+		return 0;
+
+	if (strcmp(cmd, "quit") == 0) {
+		return 1;
+	} else if (strcmp(cmd, "tile") == 0) {
+		if (sscanf(line, "%*s %d %ld %ld", &z, &x, &y) != 3)
+			fprintf(out, "error usage: tile Z X Y\n");
+		else if (tile_pyramid_tile(pyr, z, x, y) < 0 ||
+			 tile_pyramid_path(pyr, z, x, y, path, sizeof(path)) != 0)
+			fprintf(out, "error tile %d %ld %ld\n", z, x, y);
+		else
+			fprintf(out, "%s\n", path);
+	} else if (strcmp(cmd, "view") == 0) {
+		if (sscanf(line, "%*s %d %lf %lf %lf %lf", &z, &x0, &x1,
+			   &y0, &y1) != 5)
+			fprintf(out, "error usage: view Z XMIN XMAX YMIN YMAX\n");
+		else if ((r = tile_pyramid_view(pyr, z, x0, x1, y0, y1)) < 0)
+			fprintf(out, "error view %d\n", z);
+		else
+			fprintf(out, "ok %d\n", r);
+	} else if (strcmp(cmd, "stats") == 0) {
+		fprintf(out, "rendered %lu reused %lu\n", pyr->rendered,
+			pyr->reused);
+	} else {
+		fprintf(out, "error unknown command %s\n", cmd);
+	}
+	return fflush(out) == 0 ? 0 : -1;
+}
+
+int tile_pyramid_serve(tile_pyramid_t *pyr, FILE *in, FILE *out)
+{
+	assert(in != NULL);
+
+	char line[1024];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		int r = tile_pyramid_command(pyr, line, out);
+		if (r != 0)
+			return r > 0 ? 0 : -1;
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef _TILES_H_
+#define _TILES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "image.h"
+#include "fractal.h"
+
+/**
+ * @brief Сторона тайла пирамиды по умолчанию
+ */
+#define TILE_PYRAMID_SIZE 256
+
+/**
+ * @brief Наибольший уровень увеличения (пиксель около 1e-11 при стороне 256)
+ */
+#define TILE_PYRAMID_MAX_ZOOM 30
+
+/**
+ * @brief Пирамида тайлов для просмотра с увеличением
+ *
+ * Уровень 0 - один тайл, покрывающий квадрат [x_min, x_min + span] x
+ * [y_min, y_min + span] комплексной плоскости; на уровне z квадрат делится
+ * на 2^z x 2^z тайлов. Тайл (z, x, y) хранится в файле root/z/x/y.ext и
+ * рендерится только при первом обращении, поэтому при сдвиге вида
+ * вычисляются лишь открывшиеся тайлы. Строка 0 тайла соответствует
+ * меньшему y, как и в остальных функциях рендеринга.
+ */
+typedef struct tile_pyramid {
+	const char *root;               // Корневой каталог (должен существовать)
+	image_format_t format;          // Формат файлов тайлов
+	pixel_coord tile_size;          // Сторона тайла в пикселях
+	double x_min, y_min, span;      // Квадрат уровня 0
+	int max_iter;                   // Итерации на уровне 0
+	int iter_step;                  // Прибавка итераций на каждый уровень
+	bool julia;                     // true - Жюлиа, false - Мандельброт
+	double c_real, c_imag;          // Константа c для множества Жюлиа
+	fractal_options_t options;      // Параметры рендеринга тайлов
+	unsigned long rendered;         // Отрендерено тайлов
+	unsigned long reused;           // Найдено готовых тайлов
+} tile_pyramid_t;
+
+/**
+ * @brief Заполняет пирамиду значениями по умолчанию: множество Мандельброта
+ * в квадрате [-2.5, 1.5] x [-2, 2], тайлы TILE_PYRAMID_SIZE в двоичном PGM,
+ * 256 итераций плюс 64 на уровень
+ *
+ * @param pyr Пирамида
+ * @param root Корневой каталог тайлов
+ */
+void tile_pyramid_init(tile_pyramid_t *pyr, const char *root);
+
+/**
+ * @brief Формирует имя файла тайла
+ *
+ * @param pyr Пирамида
+ * @param z,x,y Уровень и номер тайла
+ * @param path Буфер для имени
+ * @param size Размер буфера
+ * @returns 0 при успехе, -1 если тайла нет на уровне или имя не поместилось
+ */
+int tile_pyramid_path(const tile_pyramid_t *pyr, int z, long x, long y,
+		      char *path, size_t size);
+
+/**
+ * @brief Обеспечивает наличие файла тайла, рендеря его при необходимости
+ *
+ * @param pyr Пирамида
+ * @param z,x,y Уровень и номер тайла
+ * @returns 1, если тайл отрендерен, 0, если уже был готов, -1 при неверном
+ * номере или ошибке записи
+ */
+int tile_pyramid_tile(tile_pyramid_t *pyr, int z, long x, long y);
+
+/**
+ * @brief Обеспечивает наличие всех тайлов уровня, пересекающих область
+ *
+ * @param pyr Пирамида
+ * @param z Уровень
+ * @param x_min,x_max,y_min,y_max Область комплексной плоскости
+ * @returns количество отрендеренных тайлов или -1 при ошибке
+ */
+int tile_pyramid_view(tile_pyramid_t *pyr, int z, double x_min, double x_max,
+		      double y_min, double y_max);
+
+/**
+ * @brief Выполняет одну команду запроса
+ *
+ * Команды:
+ *   tile Z X Y                        - путь к файлу тайла
+ *   view Z XMIN XMAX YMIN YMAX        - "ok отрендерено"
+ *   stats                             - "rendered N reused M"
+ *   quit                              - завершение
+ * На каждую команду, кроме quit, выводится одна строка ответа (ошибки -
+ * "error ..."), пустые строки пропускаются.
+ *
+ * @param pyr Пирамида
+ * @param line Строка команды
+ * @param out Поток ответов (сбрасывается после ответа)
+ * @returns 0 при успехе, 1 для quit, -1 при ошибке вывода
+ */
+int tile_pyramid_command(tile_pyramid_t *pyr, const char *line, FILE *out);
+
+/**
+ * @brief Обрабатывает запросы построчно до конца ввода или команды quit
+ * @see tile_pyramid_command
+ *
+ * @param pyr Пирамида
+ * @param in Поток запросов
+ * @param out Поток ответов
+ * @returns 0 при успехе, -1 при ошибке вывода
+ */
+int tile_pyramid_serve(tile_pyramid_t *pyr, FILE *in, FILE *out);
+
+#endif // _TILES_H_
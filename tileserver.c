@@ -0,0 +1,106 @@
+/**
+ * @file tileserver.c
+ * @brief Долгоживущий процесс, выдающий тайлы пирамиды увеличения
+ *
+ * Читает запросы из командной строки (-c) или построчно из stdin и
+ * рендерит только отсутствующие тайлы (см. tiles.h).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiles.h"
+
+/**
+ * @brief Наибольшее количество команд -c
+ */
+#define TILESERVER_MAX_COMMANDS 64
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Использование: %s КАТАЛОГ [параметры]\n"
+		"  --julia RE IM            множество Жюлиа с константой c\n"
+		"  --iters N                итерации на уровне 0 (256)\n"
+		"  --iter-step N            прибавка итераций на уровень (64)\n"
+		"  --tile N                 сторона тайла в пикселях (256)\n"
+		"  --format pgm|bmp|pgm-ascii|png  формат файлов тайлов (pgm)\n"
+		"  --threads N              количество потоков (0 - по умолчанию)\n"
+		"  -c КОМАНДА               выполнить команду вместо чтения stdin\n"
+		"Команды: tile Z X Y | view Z XMIN XMAX YMIN YMAX | stats | quit\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || argv[1][0] == '-') {
+		usage(argv[0]);
+		return 2;
+	}
+
+	tile_pyramid_t pyr;
+	tile_pyramid_init(&pyr, argv[1]);
+	const char *commands[TILESERVER_MAX_COMMANDS];
+	int count = 0;
+
+	for (int i = 2; i < argc; i++) {
+		const char *arg = argv[i];
+		int left = argc - i - 1;
+		if (strcmp(arg, "--julia") == 0 && left >= 2) {
+			pyr.julia = true;
+			pyr.c_real = atof(argv[++i]);
+			pyr.c_imag = atof(argv[++i]);
+			// Множество Жюлиа симметрично относительно нуля
+			pyr.x_min = pyr.y_min = -2.0;
+		} else if (strcmp(arg, "--iters") == 0 && left >= 1) {
+			pyr.max_iter = atoi(argv[++i]);
+		} else if (strcmp(arg, "--iter-step") == 0 && left >= 1) {
+			pyr.iter_step = atoi(argv[++i]);
+		} else if (strcmp(arg, "--tile") == 0 && left >= 1) {
+			// Отрицательная сторона стала бы огромной после приведения
+			int tile = atoi(argv[++i]);
+			if (tile <= 0) {
+				usage(argv[0]);
+				return 2;
+			}
+			pyr.tile_size = (pixel_coord)tile;
+		} else if (strcmp(arg, "--threads") == 0 && left >= 1) {
+			pyr.options.threads = atoi(argv[++i]);
+		} else if (strcmp(arg, "--format") == 0 && left >= 1) {
+			const char *f = argv[++i];
+			if (strcmp(f, "bmp") == 0)
+				pyr.format = IMAGE_FORMAT_BMP;
+			else if (strcmp(f, "pgm-ascii") == 0)
+				pyr.format = IMAGE_FORMAT_PGM_ASCII;
+			else if (strcmp(f, "pgm") == 0)
+				pyr.format = IMAGE_FORMAT_PGM_BINARY;
+			else if (strcmp(f, "png") == 0)
+				pyr.format = IMAGE_FORMAT_PNG;
+			else {
+				usage(argv[0]);
+				return 2;
+			}
+		} else if (strcmp(arg, "-c") == 0 && left >= 1 &&
+			   count < TILESERVER_MAX_COMMANDS) {
+			commands[count++] = argv[++i];
+		} else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (pyr.max_iter <= 0 || pyr.iter_step < 0 || pyr.tile_size == 0 ||
+	    pyr.options.threads < 0) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (count == 0)
+		return tile_pyramid_serve(&pyr, stdin, stdout) == 0 ? 0 : 1;
+
+	for (int i = 0; i < count; i++) {
+		int result = tile_pyramid_command(&pyr, commands[i], stdout);
+		if (result != 0)
+			return result > 0 ? 0 : 1;
+	}
+	return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file worker.c
+ * @brief Рабочий процесс распределенного рендеринга
+ *
+ * Рендерит тайлы по запросам координатора (см. distrib.h): через
+ * стандартные ввод и вывод (--stdio, так его запускает координатор или
+ * ssh) либо по TCP (--listen ПОРТ, соединения обслуживаются по очереди).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "distrib.h"
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Использование: %s --stdio | --listen ПОРТ [--threads N]\n"
+		"  --stdio         запросы из stdin, ответы в stdout\n"
+		"  --listen ПОРТ   принимать координаторов по TCP\n"
+		"  --threads N     потоков на тайл (по умолчанию - из запроса)\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	bool stdio = false;
+	int port = 0, threads = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		int left = argc - i - 1;
+		if (strcmp(arg, "--stdio") == 0) {
+			stdio = true;
+		} else if (strcmp(arg, "--listen") == 0 && left >= 1) {
+			port = atoi(argv[++i]);
+			if (port <= 0 || port > 65535)
+				port = -1;
+		} else if (strcmp(arg, "--threads") == 0 && left >= 1) {
+			threads = atoi(argv[++i]);
+		} else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (stdio == (port != 0) || port < 0 || threads < 0) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (stdio)
+		return distrib_worker_serve(STDIN_FILENO, STDOUT_FILENO, threads) == 0 ? 0 : 1;
+	distrib_worker_listen(port, threads);
+	perror("fractal_worker");
+	return 1;
+}